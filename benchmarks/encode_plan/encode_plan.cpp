@@ -0,0 +1,114 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "idl_encoder.h"
+
+using namespace zondax;
+
+namespace {
+
+constexpr int kCalls = 100000;
+
+// Best of several runs, in nanoseconds per call
+template <typename F>
+double measure(F &&encode) {
+  double best = 1e300;
+  for (int run = 0; run < 10; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kCalls; ++i) {
+      if (!encode()) {
+        std::fprintf(stderr, "encoding failed\n");
+        std::exit(1);
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    best = std::min(best, ns / kCalls);
+  }
+  return best;
+}
+
+// Compares building the type table on every call (IdlEncoder), the compiled
+// header (EncodePlan) and writing the values alone, which bounds what any
+// encoder can do.
+template <typename... Ts>
+void run(const char *name, const Ts &...args) {
+  IdlEncoder encoder;
+  double table = measure([&] {
+    encoder.clear();
+    if (!(encoder.arg(args) && ...)) return false;
+    return !encoder.finish().empty();
+  });
+
+  const auto &plan = EncodePlan<Ts...>::get();
+  std::vector<uint8_t> out;
+  double planned = measure([&] {
+    out.clear();
+    return plan.encode(out, args...);
+  });
+  auto size = out.size();
+
+  double values = measure([&] {
+    out.clear();
+    return (IdlEncode<Ts>::write(out, args) && ...);
+  });
+
+  std::printf(
+      "%-24s %4zu B (header %3zu B)  table %7.1f ns  plan %7.1f ns  "
+      "values %7.1f ns  x%.2f\n",
+      name, size, plan.header().size(), table, planned, values,
+      table / planned);
+}
+
+}  // namespace
+
+int main() {
+  // account, amount
+  run("(blob, nat64)", std::vector<uint8_t>(32, 7), uint64_t(100000000));
+
+  // an ICRC-1 like transfer argument: to, fee, memo, from_subaccount,
+  // created_at_time, amount
+  using Transfer =
+      std::tuple<std::tuple<Principal, std::optional<std::vector<uint8_t>>>,
+                 std::optional<uint64_t>, std::optional<std::vector<uint8_t>>,
+                 std::optional<std::vector<uint8_t>>, std::optional<uint64_t>,
+                 uint64_t>;
+  Transfer transfer{
+      std::make_tuple(Principal(std::vector<uint8_t>(29, 3)),
+                      std::make_optional(std::vector<uint8_t>(32, 1))),
+      10000,
+      std::vector<uint8_t>(8, 2),
+      std::nullopt,
+      1700000000000000000,
+      250000000};
+  run("transfer record", transfer);
+
+  // paging arguments of a query
+  run("(nat64, nat32, opt text)", uint64_t(5000000), uint32_t(100),
+      std::optional<std::string>("cursor"));
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "leb128.h"
+
+using namespace zondax::candid;
+
+namespace {
+
+using Kernel = std::size_t (*)(const uint8_t *, std::size_t, uint64_t *,
+                               std::size_t, std::size_t &);
+
+void push(std::vector<uint8_t> &out, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value != 0) byte |= 0x80;
+    out.push_back(byte);
+  } while (value != 0);
+}
+
+// Best of several runs, in nanoseconds per value
+double measure(Kernel kernel, const std::vector<uint8_t> &bytes,
+               std::vector<uint64_t> &out) {
+  double best = 1e300;
+  for (int run = 0; run < 20; ++run) {
+    std::size_t read;
+    auto start = std::chrono::steady_clock::now();
+    auto n = kernel(bytes.data(), bytes.size(), out.data(), out.size(), read);
+    auto end = std::chrono::steady_clock::now();
+
+    if (n != out.size() || read != bytes.size()) {
+      std::fprintf(stderr, "decoding failed\n");
+      std::exit(1);
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    best = std::min(best, ns / out.size());
+  }
+  return best;
+}
+
+void run(const char *name, const std::vector<uint64_t> &values) {
+  std::vector<uint8_t> bytes;
+  for (auto value : values) push(bytes, value);
+
+  std::vector<uint64_t> out(values.size());
+  double scalar = measure(&leb128::decodeUnsignedScalar, bytes, out);
+  double bulk = measure(&leb128::decodeUnsigned, bytes, out);
+
+  std::printf("%-26s %6.2f B/value  scalar %6.2f ns  %s %6.2f ns  x%.2f\n",
+              name, double(bytes.size()) / values.size(), scalar,
+              leb128::kernel(), bulk, scalar / bulk);
+}
+
+}  // namespace
+
+int main() {
+  // ledger sized vectors
+  constexpr std::size_t kCount = 1 << 20;
+  std::mt19937_64 rng(42);
+  std::vector<uint64_t> values(kCount);
+
+  // transfer counts, memo flags
+  for (auto &v : values) v = rng() % 100;
+  run("small (< 2^7)", values);
+
+  // block indexes of a ledger with a few million blocks
+  uint64_t block = 5000000;
+  for (auto &v : values) v = block += rng() % 4;
+  run("block indexes (~2^23)", values);
+
+  // balances in e8s, from dust to thousands of tokens
+  for (auto &v : values) v = rng() % (uint64_t(1) << (rng() % 44));
+  run("balances (e8s)", values);
+
+  // timestamps in nanoseconds
+  for (auto &v : values) v = 1700000000000000000 + rng() % 1000000000000;
+  run("timestamps (ns)", values);
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "candid.h"
+#include "idl_args.h"
+#include "idl_record.h"
+#include "idl_value.h"
+
+using namespace zondax;
+
+namespace {
+
+constexpr std::size_t kRows = 10000;
+
+// Best of several runs, in nanoseconds per row
+template <typename F>
+double measure(F &&run) {
+  double best = 1e300;
+  for (int i = 0; i < 5; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    if (!run()) {
+      std::fprintf(stderr, "benchmark failed\n");
+      std::exit(1);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    best = std::min(best, ns / kRows);
+  }
+  return best;
+}
+
+// A `vec record { id : nat64; balance : nat64; owner : text; active : bool }`
+std::vector<uint8_t> makeReply() {
+  std::vector<IdlRecord> rows;
+  rows.reserve(kRows);
+  for (std::size_t i = 0; i < kRows; ++i) {
+    IdlRecord row(4);
+    row.set("id", IdlValue(uint64_t{i}));
+    row.set("balance", IdlValue(uint64_t{i * 100000007}));
+    row.set("owner", IdlValue("account-" + std::to_string(i)));
+    row.set("active", IdlValue(i % 2 == 0));
+    rows.push_back(std::move(row));
+  }
+
+  std::vector<IdlValue> values;
+  values.emplace_back(std::move(rows));
+  return IdlArgs(values).getBytes();
+}
+
+}  // namespace
+
+// Decodes a vector of records whose type is only known at run time, as a map
+// of field names per row and as an IdlRecord per row, then reads one column.
+int main() {
+  auto bytes = makeReply();
+  constexpr auto kBalance = candid::idl_hash("balance");
+
+  double mapRead = measure([&] {
+    auto values = IdlArgs(bytes).getVec();
+    auto rows =
+        values[0]
+            .get<std::vector<std::unordered_map<std::string, IdlValue>>>();
+    if (!rows.has_value() || rows->size() != kRows) return false;
+
+    uint64_t sum = 0;
+    for (auto &row : *rows) {
+      // labels built from ids come back as their number
+      auto it = row.find(std::to_string(kBalance));
+      if (it == row.end()) return false;
+      sum += it->second.get<uint64_t>().value_or(0);
+    }
+    return sum != 0;
+  });
+
+  double recordRead = measure([&] {
+    auto values = IdlArgs(bytes).getVec();
+    auto rows = values[0].get<std::vector<IdlRecord>>();
+    if (!rows.has_value() || rows->size() != kRows) return false;
+
+    uint64_t sum = 0;
+    for (auto &row : *rows) {
+      auto *balance = row.find(kBalance);
+      if (balance == nullptr) return false;
+      sum += balance->get<uint64_t>().value_or(0);
+    }
+    return sum != 0;
+  });
+
+  std::printf("%zu records, %zu B\n", kRows, bytes.size());
+  std::printf("decode + read  unordered_map %8.1f ns/row  IdlRecord %8.1f "
+              "ns/row\n",
+              mapRead, recordRead);
+
+  return 0;
+}
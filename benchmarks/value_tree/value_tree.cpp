@@ -0,0 +1,184 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "idl_args.h"
+#include "idl_arena.h"
+#include "idl_tree.h"
+#include "idl_value.h"
+
+using namespace zondax;
+
+struct Row {
+  uint64_t id;
+  uint64_t balance;
+  std::vector<uint8_t> memo;
+  std::string name;
+};
+
+namespace zondax {
+template <>
+struct IdlRecordFields<Row> {
+  using type =
+      std::tuple<RecordField<candid::idl_hash("id"), &Row::id>,
+                 RecordField<candid::idl_hash("balance"), &Row::balance>,
+                 RecordField<candid::idl_hash("memo"), &Row::memo>,
+                 RecordField<candid::idl_hash("name"), &Row::name>>;
+};
+
+template <>
+inline IdlValue::IdlValue(Row arg) {
+  initializeFromRecord(arg);
+}
+template <>
+inline std::optional<Row> IdlValue::getImpl(helper::tag_type<Row>) {
+  return getFromRecord<Row>();
+}
+}  // namespace zondax
+
+namespace {
+
+constexpr std::size_t kRows = 10000;
+
+// Best of several runs, in nanoseconds per row
+template <typename F>
+double measure(F &&run) {
+  double best = 1e300;
+  for (int i = 0; i < 5; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    if (!run()) {
+      std::fprintf(stderr, "benchmark failed\n");
+      std::exit(1);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    best = std::min(best, ns / kRows);
+  }
+  return best;
+}
+
+std::vector<Row> makeRows() {
+  std::vector<Row> rows(kRows);
+  for (std::size_t i = 0; i < kRows; ++i) {
+    rows[i].id = i;
+    rows[i].balance = i * 100000007;
+    rows[i].memo.assign(16, static_cast<uint8_t>(i));
+    rows[i].name = "account-" + std::to_string(i);
+  }
+  return rows;
+}
+
+void buildTree(IdlTree &tree, const std::vector<Row> &rows) {
+  tree.clear();
+  tree.beginVec();
+  for (const auto &row : rows) {
+    tree.beginRecord()
+        .field("id")
+        .add(row.id)
+        .field("balance")
+        .add(row.balance)
+        .field("memo")
+        .blob(BlobView(row.memo))
+        .field("name")
+        .text(row.name)
+        .endRecord();
+  }
+  tree.endVec();
+}
+
+bool readTree(const IdlTree &tree, std::vector<Row> &rows) {
+  rows.clear();
+  for (auto record : tree[0]) {
+    // fields are in label order, as decoded
+    Row row;
+    auto id = record[0].get<uint64_t>();
+    auto balance = record[1].get<uint64_t>();
+    auto memo = record[2].get<std::vector<uint8_t>>();
+    auto name = record[3].get<std::string>();
+    if (!id || !balance || !memo || !name) return false;
+
+    row.id = *id;
+    row.balance = *balance;
+    row.memo = std::move(*memo);
+    row.name = std::move(*name);
+    rows.push_back(std::move(row));
+  }
+  return rows.size() == kRows;
+}
+
+}  // namespace
+
+// Builds, encodes, decodes and reads a vector of records, through IdlValue
+// (one Rust allocation and FFI call per node) and through IdlTree, on the
+// heap and in an arena.
+int main() {
+  auto rows = makeRows();
+  std::vector<uint8_t> bytes;
+  std::vector<Row> read;
+
+  double valueBuild = measure([&] {
+    std::vector<IdlValue> values;
+    values.emplace_back(rows);
+    bytes = IdlArgs(values).getBytes();
+    return !bytes.empty();
+  });
+  double valueRead = measure([&] {
+    auto values = IdlArgs(bytes).getVec();
+    auto decoded = values[0].get<std::vector<Row>>();
+    return decoded.has_value() && decoded->size() == kRows;
+  });
+
+  IdlTree tree;
+  double treeBuild = measure([&] {
+    buildTree(tree, rows);
+    auto encoded = tree.encode();
+    if (encoded.index() == 1) return false;
+    bytes = std::move(std::get<0>(encoded));
+    return true;
+  });
+  double treeRead = measure([&] {
+    auto decoded = IdlTree::decode(bytes);
+    return decoded.index() == 0 && readTree(std::get<0>(decoded), read);
+  });
+
+  // the same, with the tree of each call in an arena released afterwards
+  IdlArena arena;
+  double arenaRead = measure([&] {
+    bool ok = false;
+    {
+      auto decoded = IdlTree::decode(bytes, &arena);
+      ok = decoded.index() == 0 && readTree(std::get<0>(decoded), read);
+    }
+    arena.release();
+    return ok;
+  });
+
+  std::printf("%zu records, %zu B\n", kRows, bytes.size());
+  std::printf("build + encode   IdlValue %8.1f ns/row  IdlTree %8.1f ns/row\n",
+              valueBuild, treeBuild);
+  std::printf("decode + read    IdlValue %8.1f ns/row  IdlTree %8.1f ns/row\n",
+              valueRead, treeRead);
+  std::printf("decode + read    IdlTree in an arena %8.1f ns/row\n", arenaRead);
+
+  return 0;
+}
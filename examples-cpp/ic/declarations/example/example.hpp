@@ -6,12 +6,13 @@
 #include <optional>
 #include <stdint.h>
 #include <string>
-#include <unordered_map>
+#include <tuple>
 #include <variant>
 #include <vector>
 
 //lib-agent-cpp
 #include "agent.h"
+#include "candid.h"
 #include "func.h"
 #include "idl_value.h"
 #include "principal.h"
@@ -26,35 +27,14 @@ struct InternetIdentityInit {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(InternetIdentityInit arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("assigned_user_number_range");
-        auto val = IdlValue(std::move(arg.assigned_user_number_range));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<
-    InternetIdentityInit
-  >IdlValue::getImpl(helper::tag_type<InternetIdentityInit>){
-    InternetIdentityInit result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["assigned_user_number_range"]);
-        auto val = field.get<
-        InternetIdentityInit_assigned_user_number_range
-      >();
-      if (val.has_value()) {
-            result.assigned_user_number_range = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<InternetIdentityInit> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("assigned_user_number_range"), &InternetIdentityInit::assigned_user_number_range>>;
+  };
+
+  template <> inline IdlValue::IdlValue(InternetIdentityInit arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<InternetIdentityInit> IdlValue::getImpl(helper::tag_type<InternetIdentityInit>) {
+    return getFromRecord<InternetIdentityInit>();
   }
 }
 
@@ -188,91 +168,18 @@ struct DeviceData {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(DeviceData arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("alias");
-        auto val = IdlValue(std::move(arg.alias));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("pubkey");
-        auto val = IdlValue(std::move(arg.pubkey));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("key_type");
-        auto val = IdlValue(std::move(arg.key_type));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("purpose");
-        auto val = IdlValue(std::move(arg.purpose));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("credential_id");
-        auto val = IdlValue(std::move(arg.credential_id));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<DeviceData>IdlValue::getImpl(helper::tag_type<
-    DeviceData
-  >){
-    DeviceData result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["alias"]);
-        auto val = field.get<
-        std::string
-      >();
-      if (val.has_value()) {
-            result.alias = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["pubkey"]);
-        auto val = field.get<
-        DeviceKey
-      >();
-      if (val.has_value()) {
-            result.pubkey = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["key_type"]);
-        auto val = field.get<
-        KeyType
-      >();
-      if (val.has_value()) {
-            result.key_type = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["purpose"]);
-        auto val = field.get<
-        Purpose
-      >();
-      if (val.has_value()) {
-            result.purpose = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["credential_id"]);
-        auto val = field.get<
-        std::optional<CredentialId>
-      >();
-      if (val.has_value()) {
-            result.credential_id = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<DeviceData> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("alias"), &DeviceData::alias>,
+    RecordField<zondax::candid::idl_hash("pubkey"), &DeviceData::pubkey>,
+    RecordField<zondax::candid::idl_hash("key_type"), &DeviceData::key_type>,
+    RecordField<zondax::candid::idl_hash("purpose"), &DeviceData::purpose>,
+    RecordField<zondax::candid::idl_hash("credential_id"), &DeviceData::credential_id>>;
+  };
+
+  template <> inline IdlValue::IdlValue(DeviceData arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<DeviceData> IdlValue::getImpl(helper::tag_type<DeviceData>) {
+    return getFromRecord<DeviceData>();
   }
 }
 
@@ -325,53 +232,15 @@ struct AddTentativeDeviceResponse_added_tentatively {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(
-    AddTentativeDeviceResponse_added_tentatively
-   arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("verification_code");
-        auto val = IdlValue(std::move(arg.verification_code));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("device_registration_timeout");
-        auto val = IdlValue(std::move(arg.device_registration_timeout));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<
-    AddTentativeDeviceResponse_added_tentatively
-  >IdlValue::getImpl(helper::tag_type<
-    AddTentativeDeviceResponse_added_tentatively
-  >){
-    AddTentativeDeviceResponse_added_tentatively result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["verification_code"]);
-        auto val = field.get<
-        std::string
-      >();
-      if (val.has_value()) {
-            result.verification_code = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["device_registration_timeout"]);
-        auto val = field.get<
-        Timestamp
-      >();
-      if (val.has_value()) {
-            result.device_registration_timeout = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<AddTentativeDeviceResponse_added_tentatively> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("verification_code"), &AddTentativeDeviceResponse_added_tentatively::verification_code>,
+    RecordField<zondax::candid::idl_hash("device_registration_timeout"), &AddTentativeDeviceResponse_added_tentatively::device_registration_timeout>>;
+  };
+
+  template <> inline IdlValue::IdlValue(AddTentativeDeviceResponse_added_tentatively arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<AddTentativeDeviceResponse_added_tentatively> IdlValue::getImpl(helper::tag_type<AddTentativeDeviceResponse_added_tentatively>) {
+    return getFromRecord<AddTentativeDeviceResponse_added_tentatively>();
   }
 }
 
@@ -384,49 +253,15 @@ using AddTentativeDeviceResponse = std::variant<
 using ChallengeKey = std::string;
 struct Challenge {std::string png_base64;ChallengeKey challenge_key;};
 namespace zondax {
-  template <> IdlValue::IdlValue(Challenge arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("png_base64");
-        auto val = IdlValue(std::move(arg.png_base64));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("challenge_key");
-        auto val = IdlValue(std::move(arg.challenge_key));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<Challenge>IdlValue::getImpl(helper::tag_type<
-    Challenge
-  >){
-    Challenge result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["png_base64"]);
-        auto val = field.get<
-        std::string
-      >();
-      if (val.has_value()) {
-            result.png_base64 = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["challenge_key"]);
-        auto val = field.get<
-        ChallengeKey
-      >();
-      if (val.has_value()) {
-            result.challenge_key = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<Challenge> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("png_base64"), &Challenge::png_base64>,
+    RecordField<zondax::candid::idl_hash("challenge_key"), &Challenge::challenge_key>>;
+  };
+
+  template <> inline IdlValue::IdlValue(Challenge arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<Challenge> IdlValue::getImpl(helper::tag_type<Challenge>) {
+    return getFromRecord<Challenge>();
   }
 }
 
@@ -436,49 +271,15 @@ struct DeviceRegistrationInfo {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(DeviceRegistrationInfo arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("tentative_device");
-        auto val = IdlValue(std::move(arg.tentative_device));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("expiration");
-        auto val = IdlValue(std::move(arg.expiration));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<
-    DeviceRegistrationInfo
-  >IdlValue::getImpl(helper::tag_type<DeviceRegistrationInfo>){
-    DeviceRegistrationInfo result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["tentative_device"]);
-        auto val = field.get<
-        std::optional<DeviceData>
-      >();
-      if (val.has_value()) {
-            result.tentative_device = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["expiration"]);
-        auto val = field.get<
-        Timestamp
-      >();
-      if (val.has_value()) {
-            result.expiration = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<DeviceRegistrationInfo> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("tentative_device"), &DeviceRegistrationInfo::tentative_device>,
+    RecordField<zondax::candid::idl_hash("expiration"), &DeviceRegistrationInfo::expiration>>;
+  };
+
+  template <> inline IdlValue::IdlValue(DeviceRegistrationInfo arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<DeviceRegistrationInfo> IdlValue::getImpl(helper::tag_type<DeviceRegistrationInfo>) {
+    return getFromRecord<DeviceRegistrationInfo>();
   }
 }
 
@@ -488,49 +289,15 @@ struct IdentityAnchorInfo {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(IdentityAnchorInfo arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("devices");
-        auto val = IdlValue(std::move(arg.devices));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("device_registration");
-        auto val = IdlValue(std::move(arg.device_registration));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<
-    IdentityAnchorInfo
-  >IdlValue::getImpl(helper::tag_type<IdentityAnchorInfo>){
-    IdentityAnchorInfo result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["devices"]);
-        auto val = field.get<
-        std::vector<DeviceData>
-      >();
-      if (val.has_value()) {
-            result.devices = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["device_registration"]);
-        auto val = field.get<
-        std::optional<DeviceRegistrationInfo>
-      >();
-      if (val.has_value()) {
-            result.device_registration = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<IdentityAnchorInfo> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("devices"), &IdentityAnchorInfo::devices>,
+    RecordField<zondax::candid::idl_hash("device_registration"), &IdentityAnchorInfo::device_registration>>;
+  };
+
+  template <> inline IdlValue::IdlValue(IdentityAnchorInfo arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<IdentityAnchorInfo> IdlValue::getImpl(helper::tag_type<IdentityAnchorInfo>) {
+    return getFromRecord<IdentityAnchorInfo>();
   }
 }
 
@@ -563,63 +330,16 @@ struct Delegation {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(Delegation arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("pubkey");
-        auto val = IdlValue(std::move(arg.pubkey));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("targets");
-        auto val = IdlValue(std::move(arg.targets));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("expiration");
-        auto val = IdlValue(std::move(arg.expiration));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<Delegation>IdlValue::getImpl(helper::tag_type<
-    Delegation
-  >){
-    Delegation result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["pubkey"]);
-        auto val = field.get<
-        PublicKey
-      >();
-      if (val.has_value()) {
-            result.pubkey = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["targets"]);
-        auto val = field.get<
-        std::optional<std::vector<zondax::Principal>>
-      >();
-      if (val.has_value()) {
-            result.targets = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["expiration"]);
-        auto val = field.get<
-        Timestamp
-      >();
-      if (val.has_value()) {
-            result.expiration = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<Delegation> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("pubkey"), &Delegation::pubkey>,
+    RecordField<zondax::candid::idl_hash("targets"), &Delegation::targets>,
+    RecordField<zondax::candid::idl_hash("expiration"), &Delegation::expiration>>;
+  };
+
+  template <> inline IdlValue::IdlValue(Delegation arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<Delegation> IdlValue::getImpl(helper::tag_type<Delegation>) {
+    return getFromRecord<Delegation>();
   }
 }
 
@@ -631,49 +351,15 @@ struct SignedDelegation {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(SignedDelegation arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("signature");
-        auto val = IdlValue(std::move(arg.signature));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("delegation");
-        auto val = IdlValue(std::move(arg.delegation));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<SignedDelegation>IdlValue::getImpl(helper::tag_type<
-    SignedDelegation
-  >){
-    SignedDelegation result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["signature"]);
-        auto val = field.get<
-        std::vector<uint8_t>
-      >();
-      if (val.has_value()) {
-            result.signature = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["delegation"]);
-        auto val = field.get<
-        Delegation
-      >();
-      if (val.has_value()) {
-            result.delegation = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<SignedDelegation> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("signature"), &SignedDelegation::signature>,
+    RecordField<zondax::candid::idl_hash("delegation"), &SignedDelegation::delegation>>;
+  };
+
+  template <> inline IdlValue::IdlValue(SignedDelegation arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<SignedDelegation> IdlValue::getImpl(helper::tag_type<SignedDelegation>) {
+    return getFromRecord<SignedDelegation>();
   }
 }
 
@@ -692,77 +378,17 @@ struct HttpRequest {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(HttpRequest arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("url");
-        auto val = IdlValue(std::move(arg.url));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("method");
-        auto val = IdlValue(std::move(arg.method));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("body");
-        auto val = IdlValue(std::move(arg.body));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("headers");
-        auto val = IdlValue(std::move(arg.headers));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<HttpRequest>IdlValue::getImpl(helper::tag_type<
-    HttpRequest
-  >){
-    HttpRequest result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["url"]);
-        auto val = field.get<
-        std::string
-      >();
-      if (val.has_value()) {
-            result.url = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["method"]);
-        auto val = field.get<
-        std::string
-      >();
-      if (val.has_value()) {
-            result.method = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["body"]);
-        auto val = field.get<
-        std::vector<uint8_t>
-      >();
-      if (val.has_value()) {
-            result.body = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["headers"]);
-        auto val = field.get<
-        std::vector<HeaderField>
-      >();
-      if (val.has_value()) {
-            result.headers = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<HttpRequest> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("url"), &HttpRequest::url>,
+    RecordField<zondax::candid::idl_hash("method"), &HttpRequest::method>,
+    RecordField<zondax::candid::idl_hash("body"), &HttpRequest::body>,
+    RecordField<zondax::candid::idl_hash("headers"), &HttpRequest::headers>>;
+  };
+
+  template <> inline IdlValue::IdlValue(HttpRequest arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<HttpRequest> IdlValue::getImpl(helper::tag_type<HttpRequest>) {
+    return getFromRecord<HttpRequest>();
   }
 }
 
@@ -788,49 +414,15 @@ struct StreamingCallbackHttpResponse {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(StreamingCallbackHttpResponse arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("token");
-        auto val = IdlValue(std::move(arg.token));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("body");
-        auto val = IdlValue(std::move(arg.body));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<
-    StreamingCallbackHttpResponse
-  >IdlValue::getImpl(helper::tag_type<StreamingCallbackHttpResponse>){
-    StreamingCallbackHttpResponse result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["token"]);
-        auto val = field.get<
-        std::optional<Token>
-      >();
-      if (val.has_value()) {
-            result.token = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["body"]);
-        auto val = field.get<
-        std::vector<uint8_t>
-      >();
-      if (val.has_value()) {
-            result.body = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<StreamingCallbackHttpResponse> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("token"), &StreamingCallbackHttpResponse::token>,
+    RecordField<zondax::candid::idl_hash("body"), &StreamingCallbackHttpResponse::body>>;
+  };
+
+  template <> inline IdlValue::IdlValue(StreamingCallbackHttpResponse arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<StreamingCallbackHttpResponse> IdlValue::getImpl(helper::tag_type<StreamingCallbackHttpResponse>) {
+    return getFromRecord<StreamingCallbackHttpResponse>();
   }
 }
 
@@ -842,49 +434,15 @@ struct StreamingStrategy_Callback {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(StreamingStrategy_Callback arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("token");
-        auto val = IdlValue(std::move(arg.token));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("callback");
-        auto val = IdlValue(std::move(arg.callback));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<
-    StreamingStrategy_Callback
-  >IdlValue::getImpl(helper::tag_type<StreamingStrategy_Callback>){
-    StreamingStrategy_Callback result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["token"]);
-        auto val = field.get<
-        Token
-      >();
-      if (val.has_value()) {
-            result.token = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["callback"]);
-        auto val = field.get<
-        zondax::Func
-      >();
-      if (val.has_value()) {
-            result.callback = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<StreamingStrategy_Callback> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("token"), &StreamingStrategy_Callback::token>,
+    RecordField<zondax::candid::idl_hash("callback"), &StreamingStrategy_Callback::callback>>;
+  };
+
+  template <> inline IdlValue::IdlValue(StreamingStrategy_Callback arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<StreamingStrategy_Callback> IdlValue::getImpl(helper::tag_type<StreamingStrategy_Callback>) {
+    return getFromRecord<StreamingStrategy_Callback>();
   }
 }
 
@@ -898,126 +456,32 @@ struct HttpResponse {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(HttpResponse arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("body");
-        auto val = IdlValue(std::move(arg.body));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("headers");
-        auto val = IdlValue(std::move(arg.headers));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("streaming_strategy");
-        auto val = IdlValue(std::move(arg.streaming_strategy));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("status_code");
-        auto val = IdlValue(std::move(arg.status_code));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<HttpResponse>IdlValue::getImpl(helper::tag_type<
-    HttpResponse
-  >){
-    HttpResponse result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["body"]);
-        auto val = field.get<
-        std::vector<uint8_t>
-      >();
-      if (val.has_value()) {
-            result.body = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["headers"]);
-        auto val = field.get<
-        std::vector<HeaderField>
-      >();
-      if (val.has_value()) {
-            result.headers = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["streaming_strategy"]);
-        auto val = field.get<
-        std::optional<StreamingStrategy>
-      >();
-      if (val.has_value()) {
-            result.streaming_strategy = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["status_code"]);
-        auto val = field.get<
-        uint16_t
-      >();
-      if (val.has_value()) {
-            result.status_code = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<HttpResponse> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("body"), &HttpResponse::body>,
+    RecordField<zondax::candid::idl_hash("headers"), &HttpResponse::headers>,
+    RecordField<zondax::candid::idl_hash("streaming_strategy"), &HttpResponse::streaming_strategy>,
+    RecordField<zondax::candid::idl_hash("status_code"), &HttpResponse::status_code>>;
+  };
+
+  template <> inline IdlValue::IdlValue(HttpResponse arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<HttpResponse> IdlValue::getImpl(helper::tag_type<HttpResponse>) {
+    return getFromRecord<HttpResponse>();
   }
 }
 
 using UserKey = PublicKey;
 struct ChallengeResult {ChallengeKey key;std::string chars;};
 namespace zondax {
-  template <> IdlValue::IdlValue(ChallengeResult arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("key");
-        auto val = IdlValue(std::move(arg.key));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("chars");
-        auto val = IdlValue(std::move(arg.chars));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<ChallengeResult>IdlValue::getImpl(helper::tag_type<
-    ChallengeResult
-  >){
-    ChallengeResult result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["key"]);
-        auto val = field.get<
-        ChallengeKey
-      >();
-      if (val.has_value()) {
-            result.key = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["chars"]);
-        auto val = field.get<
-        std::string
-      >();
-      if (val.has_value()) {
-            result.chars = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<ChallengeResult> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("key"), &ChallengeResult::key>,
+    RecordField<zondax::candid::idl_hash("chars"), &ChallengeResult::chars>>;
+  };
+
+  template <> inline IdlValue::IdlValue(ChallengeResult arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<ChallengeResult> IdlValue::getImpl(helper::tag_type<ChallengeResult>) {
+    return getFromRecord<ChallengeResult>();
   }
 }
 
@@ -1064,35 +528,14 @@ struct RegisterResponse_registered {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(RegisterResponse_registered arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("user_number");
-        auto val = IdlValue(std::move(arg.user_number));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<
-    RegisterResponse_registered
-  >IdlValue::getImpl(helper::tag_type<RegisterResponse_registered>){
-    RegisterResponse_registered result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["user_number"]);
-        auto val = field.get<
-        UserNumber
-      >();
-      if (val.has_value()) {
-            result.user_number = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<RegisterResponse_registered> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("user_number"), &RegisterResponse_registered::user_number>>;
+  };
+
+  template <> inline IdlValue::IdlValue(RegisterResponse_registered arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<RegisterResponse_registered> IdlValue::getImpl(helper::tag_type<RegisterResponse_registered>) {
+    return getFromRecord<RegisterResponse_registered>();
   }
 }
 
@@ -1113,49 +556,15 @@ struct InternetIdentityStats {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(InternetIdentityStats arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("users_registered");
-        auto val = IdlValue(std::move(arg.users_registered));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }{
-        auto name = std::string("assigned_user_number_range");
-        auto val = IdlValue(std::move(arg.assigned_user_number_range));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<
-    InternetIdentityStats
-  >IdlValue::getImpl(helper::tag_type<InternetIdentityStats>){
-    InternetIdentityStats result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["users_registered"]);
-        auto val = field.get<
-        uint64_t
-      >();
-      if (val.has_value()) {
-            result.users_registered = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }{
-      auto field = std::move(fields["assigned_user_number_range"]);
-        auto val = field.get<
-        InternetIdentityStats_assigned_user_number_range
-      >();
-      if (val.has_value()) {
-            result.assigned_user_number_range = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<InternetIdentityStats> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("users_registered"), &InternetIdentityStats::users_registered>,
+    RecordField<zondax::candid::idl_hash("assigned_user_number_range"), &InternetIdentityStats::assigned_user_number_range>>;
+  };
+
+  template <> inline IdlValue::IdlValue(InternetIdentityStats arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<InternetIdentityStats> IdlValue::getImpl(helper::tag_type<InternetIdentityStats>) {
+    return getFromRecord<InternetIdentityStats>();
   }
 }
 
@@ -1206,37 +615,14 @@ struct VerifyTentativeDeviceResponse_wrong_code {
   
 };
 namespace zondax {
-  template <> IdlValue::IdlValue(VerifyTentativeDeviceResponse_wrong_code arg){
-    std::unordered_map<std::string, IdlValue> fields;
-
-      {
-        auto name = std::string("retries_left");
-        auto val = IdlValue(std::move(arg.retries_left));
-        fields.emplace(std::make_pair(name, std::move(val)));
-      }
-    
-     *this = std::move(IdlValue::FromRecord(fields));
-  }
-  
-  template <> std::optional<
-    VerifyTentativeDeviceResponse_wrong_code
-  >IdlValue::getImpl(helper::tag_type<
-    VerifyTentativeDeviceResponse_wrong_code
-  >){
-    VerifyTentativeDeviceResponse_wrong_code result;
-    auto fields = getRecord();
-    {
-      auto field = std::move(fields["retries_left"]);
-        auto val = field.get<
-        uint8_t
-      >();
-      if (val.has_value()) {
-            result.retries_left = std::move(val.value());
-        } else {
-            return std::nullopt;
-        }
-    }
-    	return std::make_optional(std::move(result));
+  template <> struct IdlRecordFields<VerifyTentativeDeviceResponse_wrong_code> {
+    using type = std::tuple<
+    RecordField<zondax::candid::idl_hash("retries_left"), &VerifyTentativeDeviceResponse_wrong_code::retries_left>>;
+  };
+
+  template <> inline IdlValue::IdlValue(VerifyTentativeDeviceResponse_wrong_code arg) { initializeFromRecord(arg); }
+  template <> inline std::optional<VerifyTentativeDeviceResponse_wrong_code> IdlValue::getImpl(helper::tag_type<VerifyTentativeDeviceResponse_wrong_code>) {
+    return getFromRecord<VerifyTentativeDeviceResponse_wrong_code>();
   }
 }
 
@@ -1432,7 +818,7 @@ std::variant<std::tuple<UserKey, Timestamp>, std::string>prepare_delegation(
   std::optional<uint64_t> arg3
 ){
   auto result = agent.Update<
-    std::tuple<UserKey, Timestamp>
+    UserKey, Timestamp
   >("prepare_delegation", arg0, arg1, arg2, arg3);
   if (result.index() == 0){
     return std::variant<
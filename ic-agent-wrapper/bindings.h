@@ -41,7 +41,8 @@ typedef struct CIDLValuesVec CIDLValuesVec;
 typedef struct CIdentitySign CIdentitySign;
 
 /**
- * Struture that holds a Record IDLValue with a Vector of keys (CText) and Vector of IDLValues
+ * Struture that holds a Record IDLValue with a Vector of keys (CText), the ids of
+ * the keys and a Vector of IDLValues
  */
 typedef struct CRecord CRecord;
 
@@ -65,6 +66,14 @@ typedef struct CPrincipal {
   uintptr_t len;
 } CPrincipal;
 
+/**
+ * A record field passed to idl_value_with_record_ids, its label id and value
+ */
+typedef struct CRecordField {
+  uint32_t id;
+  IDLValue *val;
+} CRecordField;
+
 /**
  * CallBack Ptr creation with size and len
  */
@@ -89,6 +98,14 @@ uint8_t idl_value_type(const IDLValue *value);
  */
 void idl_value_destroy(IDLValue *_ptr);
 
+/**
+ * @brief Copy an IDLValue
+ *
+ * @param ptr Pointer to IDLValue
+ * @return Pointer to the copy, owned by the caller
+ */
+IDLValue *idl_value_clone(const IDLValue *ptr);
+
 /**
  * @brief Free allocated CText
  *
@@ -139,6 +156,23 @@ const uint8_t *cbytes_ptr(const struct CBytes *ptr);
  */
 uintptr_t cbytes_len(const struct CBytes *ptr);
 
+/**
+ * @brief Create an empty CBytes, to be filled with cbytes_append
+ *
+ * @param capacity Number of bytes to reserve up front
+ * @return Pointer to the CBytes structure
+ */
+struct CBytes *cbytes_with_capacity(uintptr_t capacity);
+
+/**
+ * @brief Append bytes to a CBytes
+ *
+ * @param ptr CBytes structure pointer
+ * @param data Pointer to the bytes, they are copied
+ * @param data_len Number of bytes
+ */
+void cbytes_append(struct CBytes *ptr, const uint8_t *data, uintptr_t data_len);
+
 /**
  * @brief Free allocated CIDLValuesVec
  *
@@ -220,6 +254,14 @@ struct CText *crecord_take_key(struct CRecord *ptr, uintptr_t index);
  */
 uintptr_t crecord_keys_len(const struct CRecord *ptr);
 
+/**
+ * @brief Get pointer to the label ids of a CRecord, one per value
+ *
+ * @param ptr CRecord structure pointer
+ * @return Pointer to the ids, crecord_vals_len of them
+ */
+const uint32_t *crecord_ids(const struct CRecord *ptr);
+
 /**
  * @brief Get pointer to CRecord Values vector
  *
@@ -425,6 +467,95 @@ IDLArgs *agent_update_wrap(const struct FFIAgent *agent_ptr,
                            const char *method_args,
                            struct RetError *error_ret);
 
+/**
+ * @brief Calls a query and returns its reply undecoded
+ *
+ * @param agent_ptr Pointer to FFI structure that holds agent info
+ * @param method Pointer service/method name from did information
+ * @param method_args Pointer to the arguments required by method
+ * @param error_ret CallBack to get error
+ * @return Pointer to CBytes holding the Candid encoded reply
+ * If the function returns a NULL CBytes the user should check
+ * The error callback, to attain the error
+ */
+struct CBytes *agent_query_raw_wrap(const struct FFIAgent *agent_ptr,
+                                    const char *method,
+                                    const char *method_args,
+                                    struct RetError *error_ret);
+
+/**
+ * @brief Calls a query with Candid encoded arguments and returns its reply
+ * undecoded
+ *
+ * @param agent_ptr Pointer to FFI structure that holds agent info
+ * @param method Pointer service/method name from did information
+ * @param args Pointer to the encoded arguments, checked against the argument
+ * types of the method
+ * @param args_len Length of the arguments
+ * @param error_ret CallBack to get error
+ * @return Pointer to CBytes holding the Candid encoded reply
+ * If the function returns a NULL CBytes the user should check
+ * The error callback, to attain the error
+ */
+struct CBytes *agent_query_bytes_wrap(const struct FFIAgent *agent_ptr,
+                                      const char *method,
+                                      const uint8_t *args,
+                                      uintptr_t args_len,
+                                      struct RetError *error_ret);
+
+/**
+ * @brief Calls an update and returns its reply undecoded
+ *
+ * @param agent_ptr Pointer to FFI structure that holds agent info
+ * @param method Pointer service/method name from did information
+ * @param method_args Pointer to the arguments required by method
+ * @param error_ret CallBack to get error
+ * @return Pointer to CBytes holding the Candid encoded reply
+ * If the function returns a NULL CBytes the user should check
+ * The error callback, to attain the error
+ */
+struct CBytes *agent_update_raw_wrap(const struct FFIAgent *agent_ptr,
+                                     const char *method,
+                                     const char *method_args,
+                                     struct RetError *error_ret);
+
+/**
+ * @brief Calls an update with Candid encoded arguments and returns its reply
+ * undecoded
+ *
+ * @param agent_ptr Pointer to FFI structure that holds agent info
+ * @param method Pointer service/method name from did information
+ * @param args CBytes holding the encoded arguments, ownership is taken and
+ * the buffer is moved into the request once checked against the argument
+ * types of the method
+ * @param error_ret CallBack to get error
+ * @return Pointer to CBytes holding the Candid encoded reply
+ * If the function returns a NULL CBytes the user should check
+ * The error callback, to attain the error
+ */
+struct CBytes *agent_update_bytes_wrap(const struct FFIAgent *agent_ptr,
+                                       const char *method,
+                                       struct CBytes *args,
+                                       struct RetError *error_ret);
+
+/**
+ * @brief Decodes the reply of a method with the return types from the did
+ *
+ * @param agent_ptr Pointer to FFI structure that holds agent info
+ * @param method Pointer service/method name from did information
+ * @param reply Pointer to the Candid encoded reply
+ * @param reply_len Length of the reply
+ * @param error_ret CallBack to get error
+ * @return Pointer to IDLArgs
+ * If the function returns a NULL IDLArgs the user should check
+ * The error callback, to attain the error
+ */
+IDLArgs *agent_decode_reply_wrap(const struct FFIAgent *agent_ptr,
+                                 const char *method,
+                                 const uint8_t *reply,
+                                 uintptr_t reply_len,
+                                 struct RetError *error_ret);
+
 /**
  * @brief Free allocated Agent
  *
@@ -510,6 +641,16 @@ IDLArgs *idl_args_from_vec(const IDLValue *const *elems, int elems_len);
  */
 struct CIDLValuesVec *idl_args_to_vec(const IDLArgs *ptr);
 
+/**
+ * @brief Move the IDLValues out of IDLArgs
+ *
+ * Unlike idl_args_to_vec the values are not copied, the IDLArgs is left empty
+ *
+ * @param ptr Pointer to IDLArgs Array
+ * @return Pointer to the Array of IDLValues , i.e. CIDLValuesVec struture
+ */
+struct CIDLValuesVec *idl_args_take_vec(IDLArgs *ptr);
+
 /**
  * @brief Number of elements in IDLArgs
  *
@@ -518,6 +659,26 @@ struct CIDLValuesVec *idl_args_to_vec(const IDLArgs *ptr);
  */
 uintptr_t idl_args_len(const IDLArgs *ptr);
 
+/**
+ * @brief Borrow an IDLValue of IDLArgs, without copying it
+ *
+ * @param ptr Pointer to IDLArgs Array
+ * @param index Position of the value
+ * @return Pointer to the IDLValue, owned by ptr, NULL if index is out of range
+ */
+const IDLValue *idl_args_value_ref(const IDLArgs *ptr, uintptr_t index);
+
+/**
+ * @brief Move an IDLValue out of IDLArgs
+ *
+ * The value is not copied, it is replaced by null in the IDLArgs
+ *
+ * @param ptr Pointer to IDLArgs Array
+ * @param index Position of the value
+ * @return Pointer to the IDLValue, NULL if index is out of range
+ */
+IDLValue *idl_args_take_value(IDLArgs *ptr, uintptr_t index);
+
 /**
  * @brief Free allocated memory
  *
@@ -781,6 +942,23 @@ IDLValue *idl_value_with_none(void);
  */
 IDLValue *idl_value_with_text(const char *text, struct RetError *error_ret);
 
+/**
+ * @brief Create IDLValue with text given by pointer and length
+ *
+ * Unlike idl_value_with_text the text does not need to be NUL terminated, it
+ * may contain NULs and is not scanned for its length. It is copied once
+ *
+ * @param text Pointer to UTF-8 text, may be NULL when text_len is 0
+ * @param text_len Length of the text in bytes
+ * @param error_ret CallBack to get error
+ * @return Pointer to the IDLValue Structure
+ * If the function returns a NULL IDLValue the user should check
+ * The error callback, to attain the error
+ */
+IDLValue *idl_value_with_text_len(const uint8_t *text,
+                                  uintptr_t text_len,
+                                  struct RetError *error_ret);
+
 /**
  * @brief Get Text from IDLValue
  *
@@ -789,6 +967,17 @@ IDLValue *idl_value_with_text(const char *text, struct RetError *error_ret);
  */
 struct CText *text_from_idl_value(const IDLValue *ptr);
 
+/**
+ * @brief Borrow the text of a Text IDLValue, without copying it
+ *
+ * The text is not NUL terminated and may contain NULs
+ *
+ * @param ptr Pointer to IDLValue Structure
+ * @param len Where the length of the text in bytes is written
+ * @return Pointer to the text, owned by ptr, NULL if ptr is not a Text
+ */
+const uint8_t *text_ref_from_idl_value(const IDLValue *ptr, uintptr_t *len);
+
 /**
  * @brief Create IDLValue with Principal
  *
@@ -868,6 +1057,17 @@ IDLValue *idl_value_with_opt(IDLValue *value);
  */
 IDLValue *opt_from_idl_value(const IDLValue *ptr);
 
+/**
+ * @brief Move the IDLValue out of an Opt
+ *
+ * Unlike opt_from_idl_value the value is not copied, the Opt is left holding
+ * null
+ *
+ * @param ptr Pointer to Opt IDLValue
+ * @return Pointer to IDLValue Structure, NULL if ptr is not an Opt
+ */
+IDLValue *opt_take_from_idl_value(IDLValue *ptr);
+
 /**
  * @brief Create Reserved IDLValue
  *
@@ -894,6 +1094,234 @@ IDLValue *idl_value_with_vec(const IDLValue *const *elems, int elems_len);
  */
 struct CIDLValuesVec *vec_from_idl_value(const IDLValue *ptr);
 
+/**
+ * @brief Move the elements out of a Vec IDLValue
+ *
+ * Unlike vec_from_idl_value the elements are not copied, the Vec is left
+ * empty
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to Array of IDLValues , CIDLValuesVec
+ */
+struct CIDLValuesVec *vec_take_from_idl_value(IDLValue *ptr);
+
+/**
+ * @brief Number of elements of a Vec IDLValue
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Number of elements, 0 if ptr is not a Vec
+ */
+uintptr_t vec_elems_len(const IDLValue *ptr);
+
+/**
+ * @brief Borrow an element of a Vec IDLValue, without copying it
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @param index Position of the element
+ * @return Pointer to the element, owned by ptr, NULL if ptr is not a Vec or
+ * index is out of range
+ */
+const IDLValue *vec_elem_ref(const IDLValue *ptr, uintptr_t index);
+
+/**
+ * @brief Create IDLValue Vec of nat8 from a contiguous array of bytes
+ *
+ * @param data Pointer to the bytes, they are copied
+ * @param data_len Number of bytes
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_blob(const uint8_t *data, uintptr_t data_len);
+
+/**
+ * @brief Get the bytes of an IDLValue Vec of nat8
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the bytes, NULL if the value is not
+ * a Vec of nat8
+ */
+struct CBytes *blob_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of nat16 from a contiguous array
+ *
+ * @param data Pointer to the values, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_nat16(const uint16_t *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of nat16
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the values as an array of u16 in native
+ * byte order, NULL if the value is not a Vec of nat16
+ */
+struct CBytes *vec_nat16_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of nat32 from a contiguous array
+ *
+ * @param data Pointer to the values, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_nat32(const uint32_t *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of nat32
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the values as an array of u32 in native
+ * byte order, NULL if the value is not a Vec of nat32
+ */
+struct CBytes *vec_nat32_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of nat64 from a contiguous array
+ *
+ * @param data Pointer to the values, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_nat64(const uint64_t *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of nat64
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the values as an array of u64 in native
+ * byte order, NULL if the value is not a Vec of nat64
+ */
+struct CBytes *vec_nat64_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of int8 from a contiguous array
+ *
+ * @param data Pointer to the values, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_int8(const int8_t *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of int8
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the values as an array of i8 in native
+ * byte order, NULL if the value is not a Vec of int8
+ */
+struct CBytes *vec_int8_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of int16 from a contiguous array
+ *
+ * @param data Pointer to the values, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_int16(const int16_t *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of int16
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the values as an array of i16 in native
+ * byte order, NULL if the value is not a Vec of int16
+ */
+struct CBytes *vec_int16_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of int32 from a contiguous array
+ *
+ * @param data Pointer to the values, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_int32(const int32_t *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of int32
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the values as an array of i32 in native
+ * byte order, NULL if the value is not a Vec of int32
+ */
+struct CBytes *vec_int32_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of int64 from a contiguous array
+ *
+ * @param data Pointer to the values, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_int64(const int64_t *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of int64
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the values as an array of i64 in native
+ * byte order, NULL if the value is not a Vec of int64
+ */
+struct CBytes *vec_int64_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of float32 from a contiguous array
+ *
+ * @param data Pointer to the values, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_float32(const float *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of float32
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the values as an array of f32 in native
+ * byte order, NULL if the value is not a Vec of float32
+ */
+struct CBytes *vec_float32_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of float64 from a contiguous array
+ *
+ * @param data Pointer to the values, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_float64(const double *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of float64
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding the values as an array of f64 in native
+ * byte order, NULL if the value is not a Vec of float64
+ */
+struct CBytes *vec_float64_from_idl_value(const IDLValue *ptr);
+
+/**
+ * @brief Create IDLValue Vec of bool from a contiguous array
+ *
+ * @param data Pointer to the values, one byte each where any non zero value
+ * is true, they are copied
+ * @param data_len Number of values
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_vec_bool(const uint8_t *data, uintptr_t data_len);
+
+/**
+ * @brief Get the values of an IDLValue Vec of bool
+ *
+ * @param ptr Pointer to IDLValue structure
+ * @return Pointer to CBytes holding one byte per value, 0 or 1, NULL if the
+ * value is not a Vec of bool
+ */
+struct CBytes *vec_bool_from_idl_value(const IDLValue *ptr);
+
 /**
  * @brief Create IDLValue with array of keys and values where each pair represents an IDLField
  *
@@ -918,6 +1346,17 @@ IDLValue *idl_value_with_record(const char *const *keys,
                                 int vals_len,
                                 bool keys_are_ids);
 
+/**
+ * @brief Create a Record IDLValue with id labels
+ *
+ * @param fields Pointer to array of fields, rust takes ownership of each of
+ * their values, so the user should not use them after calling this function
+ * @param len Number of fields
+ *
+ * @return Pointer to IDLValue Structure
+ */
+IDLValue *idl_value_with_record_ids(const struct CRecordField *fields, uintptr_t len);
+
 /**
  * @brief Get Record from IDLValue
  *
@@ -926,6 +1365,56 @@ IDLValue *idl_value_with_record(const char *const *keys,
  */
 struct CRecord *record_from_idl_value(const IDLValue *ptr);
 
+/**
+ * @brief Move the fields out of a Record IDLValue
+ *
+ * Unlike record_from_idl_value the values are not copied, the record is left
+ * without fields
+ *
+ * @param ptr Pointer to IDLValue Structure
+ * @return Pointer to CRecord structure where user can access array of keys and IDLValues
+ */
+struct CRecord *record_take_from_idl_value(IDLValue *ptr);
+
+/**
+ * @brief Get Record from IDLValue, with the label ids only
+ *
+ * The keys are left empty, the labels are read with crecord_ids. The values
+ * are moved out rather than copied, the record is left without fields
+ *
+ * @param ptr Pointer to IDLValue Structure
+ * @return Pointer to CRecord structure where user can access array of ids and IDLValues
+ */
+struct CRecord *record_ids_from_idl_value(IDLValue *ptr);
+
+/**
+ * @brief Number of fields of a Record IDLValue
+ *
+ * @param ptr Pointer to IDLValue Structure
+ * @return Number of fields, 0 if ptr is not a Record
+ */
+uintptr_t record_fields_len(const IDLValue *ptr);
+
+/**
+ * @brief Borrow a field of a Record IDLValue, without copying it
+ *
+ * Nothing is allocated: the name of a named label is borrowed from the
+ * record, and is not NUL terminated
+ *
+ * @param ptr Pointer to IDLValue Structure
+ * @param index Position of the field
+ * @param id Where the id of the label is written
+ * @param name Where the name of the label is written, NULL for id labels
+ * @param name_len Where the length of the name is written
+ * @return Pointer to the value of the field, owned by ptr, NULL if ptr is not
+ * a Record or index is out of range
+ */
+const IDLValue *record_field_ref(const IDLValue *ptr,
+                                 uintptr_t index,
+                                 uint32_t *id,
+                                 const uint8_t **name,
+                                 uintptr_t *name_len);
+
 /**
  * @brief Create Variant IDLValue with key, IDValue and code
  *
@@ -946,6 +1435,29 @@ IDLValue *idl_value_with_variant(const char *key, const IDLValue *val, uint64_t
  */
 struct CVariant *variant_from_idl_value(const IDLValue *ptr);
 
+/**
+ * @brief Get the label id and the value of a Variant IDLValue
+ *
+ * Unlike variant_from_idl_value, the label is not converted to a string
+ *
+ * @param ptr Pointer to IDLValue Structure
+ * @param id Where the id of the label is written
+ * @return Pointer to the value of the variant, NULL if ptr is not a Variant
+ */
+IDLValue *variant_id_from_idl_value(const IDLValue *ptr, uint32_t *id);
+
+/**
+ * @brief Move the value out of a Variant IDLValue, with the id of its label
+ *
+ * Unlike variant_id_from_idl_value the value is not copied, the variant is
+ * left holding null
+ *
+ * @param ptr Pointer to IDLValue Structure
+ * @param id Where the id of the label is written
+ * @return Pointer to the value of the variant, NULL if ptr is not a Variant
+ */
+IDLValue *variant_take_from_idl_value(IDLValue *ptr, uint32_t *id);
+
 /**
  * @brief Create Func IDLValue with Principal and Function Name
  *
@@ -10,12 +10,13 @@ pub fn compile(env: &TypeEnv, actor: &Option<Type>) -> String {
 #include <optional>
 #include <stdint.h>
 #include <string>
-#include <unordered_map>
+#include <tuple>
 #include <variant>
 #include <vector>
 
 //lib-agent-cpp
 #include "agent.h"
+#include "candid.h"
 #include "func.h"
 #include "idl_value.h"
 #include "principal.h"
@@ -259,70 +260,65 @@ fn pp_record_fields<'a, 'b>(fs: &'a [Field], recs: &'b RecPoints) -> RcDoc<'a> {
 }
 
 fn pp_record_conversion<'a>(name: &'a str, fs: &'a [Field]) -> RcDoc<'a> {
-    let convert_field = |id| {
-        RcDoc::text(format!(
-            r#"auto name = std::string("{id}");
-        auto val = IdlValue(std::move(arg.{id}));
-        fields.emplace(std::make_pair(name, std::move(val)));"#
-        ))
-    };
-
-    let all_fields = RcDoc::concat(
-        fs.iter()
-            .map(|Field { id, .. }| enclose_space("{", convert_field(id), "}")),
-    );
-
-    let body = enclose(
-        "std::unordered_map<std::string, IdlValue> fields;\n",
-        all_fields,
-        "\n     *this = std::move(IdlValue::FromRecord(fields));",
-    );
-    let body = enclose_space("{", body, "}");
+    // fields are listed in the order they take on the wire, sorted by label id
+    let mut sorted: Vec<&Field> = fs.iter().collect();
+    sorted.sort_by_key(|f| f.id.get_id());
 
-    let ctor = str("template <> IdlValue::IdlValue")
-        .append(enclose("(", str(name), " arg)"))
-        .append(body);
-
-    let get_field = |id, ty| {
-        RcDoc::text(format!(
-            r#"auto field = std::move(fields["{id}"]);
-        auto val = field.get"#
-        ))
-        .append(enclose("<", ty, ">();"))
-        .append(RcDoc::hardline())
-        .append(RcDoc::text(format!(
-            r#"if (val.has_value()) {{
-            result.{id} = std::move(val.value());
-        }} else {{
-            return std::nullopt;
-        }}"#
-        )))
+    let pp_field_id = |id: &'a Label| match id {
+        Label::Named(label) => RcDoc::text(format!(r#"zondax::candid::idl_hash("{label}")"#)),
+        Label::Id(n) | Label::Unnamed(n) => RcDoc::as_string(n),
+    };
+    let pp_field = |f: &'a Field| {
+        str("RecordField")
+            .append(enclose(
+                "<",
+                pp_field_id(&f.id)
+                    .append(",")
+                    .append(RcDoc::space())
+                    .append("&")
+                    .append(name)
+                    .append("::")
+                    .append(pp_label(&f.id)),
+                ">",
+            ))
+            .group()
     };
 
-    let all_fields = RcDoc::concat(fs.iter().map(|Field { id, ty }| {
-        enclose_space("{", get_field(id, pp_ty(ty, &BTreeSet::new())), "}")
-    }));
-
-    let body = str(name)
-        .append(" result;")
-        .append(RcDoc::hardline())
-        .append("auto fields = getRecord();")
-        .append(RcDoc::hardline())
-        .append(all_fields)
-        .append(RcDoc::hardline())
-        .append("\treturn std::make_optional(std::move(result));");
-    let getter = str("template <> std::optional")
+    let fields = str("template <> struct IdlRecordFields")
+        .append(enclose("<", str(name), "> "))
+        .append(enclose_space(
+            "{",
+            str("using type = std::tuple").append(enclose(
+                "<",
+                strict_concat(sorted.iter().copied().map(pp_field), ","),
+                ">;",
+            )),
+            "};",
+        ));
+
+    let ctor = str("template <> inline IdlValue::IdlValue")
+        .append(enclose("(", str(name), " arg) "))
+        .append("{ initializeFromRecord(arg); }");
+
+    let getter = str("template <> inline std::optional")
         .append(enclose("<", str(name), ">"))
         .append(enclose(
-            "IdlValue::getImpl(helper::tag_type<",
+            " IdlValue::getImpl(helper::tag_type<",
             str(name),
-            ">)",
+            ">) ",
         ))
-        .append(enclose("{", body, "}"));
+        .append(enclose(
+            "{",
+            str("return getFromRecord<").append(name).append(">();"),
+            "}",
+        ));
 
     enclose_space(
         "namespace zondax {",
-        ctor.append(RcDoc::hardline())
+        fields
+            .append(RcDoc::hardline())
+            .append(RcDoc::hardline())
+            .append(ctor)
             .append(RcDoc::hardline())
             .append(getter),
         "}",
@@ -479,6 +475,13 @@ fn pp_function<'a>(id: &'a str, func: &'a Function) -> RcDoc<'a> {
         ),
     };
 
+    // Methods returning several values read them as one tuple, through the
+    // overload taking one template argument per value
+    let call_rets = match func.rets.as_slice() {
+        rets @ [_, _, ..] => strict_concat(rets.iter().map(|ty| pp_ty(ty, &empty)), ","),
+        _ => rets.clone(),
+    };
+
     let inner_ret_ty = enclose("std::variant<", rets.clone(), ", std::string>");
 
     let sig = inner_ret_ty
@@ -492,7 +495,7 @@ fn pp_function<'a>(id: &'a str, func: &'a Function) -> RcDoc<'a> {
     let agent_method = if is_query { "Query" } else { "Update" };
 
     let body = RcDoc::text(format!("auto result = agent.{agent_method}"))
-        .append(enclose("<", rets.clone(), ">"))
+        .append(enclose("<", call_rets, ">"))
         .append(RcDoc::text(format!(r#"("{method}""#)))
         .append(args)
         .append(");");
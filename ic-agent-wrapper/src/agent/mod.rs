@@ -13,7 +13,7 @@
 *  See the License for the specific language governing permissions and
 *  limitations under the License.
 ********************************************************************************/
-use crate::{identity::IdentityType, AnyErr, AnyResult, CText, RetError};
+use crate::{identity::IdentityType, AnyErr, AnyResult, CBytes, CText, RetError};
 use anyhow::{anyhow, bail, Context};
 use candid::{
     check_prog,
@@ -42,13 +42,17 @@ pub struct FFIAgent {
     identity: Arc<dyn Identity>,
     canister_id: Principal,
     did_content: String,
+    // The interface from did_content, parsed once when the agent is created
+    // rather than on every call
+    ty_env: TypeEnv,
+    actor: Option<Type>,
 }
 
 // taking in consideration a similar structure as agent unity has defined with icx info
 impl FFIAgent {
     // Parse a candid file
-    fn inner_parse_candid_file(&self) -> AnyResult<(TypeEnv, Option<Type>)> {
-        let ast = self.did_content.parse::<IDLProg>().map_err(AnyErr::from)?;
+    fn inner_parse_candid_file(did_content: &str) -> AnyResult<(TypeEnv, Option<Type>)> {
+        let ast = did_content.parse::<IDLProg>().map_err(AnyErr::from)?;
 
         let mut env = TypeEnv::new();
         let actor = check_prog(&mut env, &ast).map_err(AnyErr::from)?;
@@ -56,17 +60,14 @@ impl FFIAgent {
         Ok((env, actor))
     }
 
-    fn get_method_signature(
-        method_name: &str,
-        ty_env: &TypeEnv,
-        actor: &Option<Type>,
-    ) -> AnyResult<Function> {
-        match actor {
+    // Signature of a method of the parsed interface, borrowed from it
+    fn get_method_signature(&self, method_name: &str) -> AnyResult<&Function> {
+        match &self.actor {
             Some(actor) => {
-                let method_sig = ty_env
+                let method_sig = self
+                    .ty_env
                     .get_method(actor, method_name)
-                    .map_err(AnyErr::from)?
-                    .clone();
+                    .map_err(AnyErr::from)?;
 
                 Ok(method_sig)
             }
@@ -153,11 +154,36 @@ impl FFIAgent {
 
     // Update Call directly from the ic agent
     pub async fn inner_ic_update(&self, method: &str, method_args: &str) -> AnyResult<IDLArgs> {
-        let (ty_env, actor) = self.inner_parse_candid_file()?;
-        let func_sig = Self::get_method_signature(method, &ty_env, &actor)?;
+        let rst_blb = self.inner_ic_update_raw(method, method_args).await?;
+        self.inner_decode_reply(method, rst_blb.as_slice())
+    }
+
+    // Update Call returning the undecoded reply
+    pub async fn inner_ic_update_raw(&self, method: &str, method_args: &str) -> AnyResult<Vec<u8>> {
+        let func_sig = self.get_method_signature(method)?;
+
+        let args_blb = Self::inner_blob_from_raw(method_args, &self.ty_env, func_sig)?;
+
+        self.inner_ic_update_blob(method, args_blb).await
+    }
 
-        let args_blb = Self::inner_blob_from_raw(method_args, &ty_env, &func_sig)?;
+    // Update Call with arguments already Candid encoded, the buffer is handed
+    // to the request as is once checked against the argument types of the
+    // method
+    pub async fn inner_ic_update_bytes(
+        &self,
+        method: &str,
+        args_blb: Vec<u8>,
+    ) -> AnyResult<Vec<u8>> {
+        let func_sig = self.get_method_signature(method)?;
+
+        Self::inner_check_blob(args_blb.as_slice(), &self.ty_env, func_sig)?;
+
+        self.inner_ic_update_blob(method, args_blb).await
+    }
 
+    // Update Call with arguments encoded with the types of the method
+    async fn inner_ic_update_blob(&self, method: &str, args_blb: Vec<u8>) -> AnyResult<Vec<u8>> {
         let effective_canister_id =
             Self::get_effective_canister_id(method, args_blb.as_slice(), &self.canister_id)?;
 
@@ -171,17 +197,40 @@ impl FFIAgent {
             .await
             .map_err(AnyErr::from)?;
 
-        let rst_idl = Self::idl_from_blob(rst_blb.as_slice(), &ty_env, &func_sig)?;
-        Ok(rst_idl)
+        Ok(rst_blb)
     }
 
     // Query Call directly from the ic agent
     pub async fn inner_ic_query(&self, method: &str, method_args: &str) -> AnyResult<IDLArgs> {
-        let (ty_env, actor) = self.inner_parse_candid_file()?;
-        let func_sig = Self::get_method_signature(method, &ty_env, &actor)?;
+        let rst_blb = self.inner_ic_query_raw(method, method_args).await?;
+        self.inner_decode_reply(method, rst_blb.as_slice())
+    }
+
+    // Query Call returning the undecoded reply
+    pub async fn inner_ic_query_raw(&self, method: &str, method_args: &str) -> AnyResult<Vec<u8>> {
+        let func_sig = self.get_method_signature(method)?;
 
-        let args_blb = Self::inner_blob_from_raw(method_args, &ty_env, &func_sig)?;
+        let args_blb = Self::inner_blob_from_raw(method_args, &self.ty_env, func_sig)?;
 
+        self.inner_ic_query_blob(method, args_blb).await
+    }
+
+    // Query Call with arguments already Candid encoded, checked against the
+    // argument types of the method as updates are
+    pub async fn inner_ic_query_bytes(
+        &self,
+        method: &str,
+        args_blb: Vec<u8>,
+    ) -> AnyResult<Vec<u8>> {
+        let func_sig = self.get_method_signature(method)?;
+
+        Self::inner_check_blob(args_blb.as_slice(), &self.ty_env, func_sig)?;
+
+        self.inner_ic_query_blob(method, args_blb).await
+    }
+
+    // Query Call with arguments encoded with the types of the method
+    async fn inner_ic_query_blob(&self, method: &str, args_blb: Vec<u8>) -> AnyResult<Vec<u8>> {
         let effective_canister_id =
             Self::get_effective_canister_id(method, args_blb.as_slice(), &self.canister_id)?;
 
@@ -195,9 +244,14 @@ impl FFIAgent {
             .await
             .map_err(AnyErr::from)?;
 
-        let rst_idl = Self::idl_from_blob(rst_blb.as_slice(), &ty_env, &func_sig)?;
+        Ok(rst_blb)
+    }
 
-        Ok(rst_idl)
+    // Decode a reply with the return types of the method
+    pub fn inner_decode_reply(&self, method: &str, reply: &[u8]) -> AnyResult<IDLArgs> {
+        let func_sig = self.get_method_signature(method)?;
+
+        Self::idl_from_blob(reply, &self.ty_env, func_sig)
     }
 
     fn inner_blob_from_raw(
@@ -214,6 +268,14 @@ impl FFIAgent {
         Ok(args_blob)
     }
 
+    // Arguments encoded by the caller must have the types the method takes,
+    // the canister would reject them otherwise
+    fn inner_check_blob(args_blb: &[u8], ty_env: &TypeEnv, meth_sig: &Function) -> AnyResult<()> {
+        IDLArgs::from_bytes_with_types(args_blb, ty_env, &meth_sig.args)
+            .map(|_| ())
+            .context("Arguments do not match the method signature")
+    }
+
     fn idl_from_blob(args_blb: &[u8], ty_env: &TypeEnv, meth_sig: &Function) -> AnyResult<IDLArgs> {
         IDLArgs::from_bytes_with_types(args_blb, ty_env, &meth_sig.rets).map_err(AnyErr::from)
     }
@@ -245,6 +307,7 @@ pub extern "C" fn agent_create_wrap(
         let path = unsafe { CStr::from_ptr(path).to_str().map_err(AnyErr::from) }?.to_string();
         let did_content =
             unsafe { CStr::from_ptr(did_content).to_str().map_err(AnyErr::from) }?.to_string();
+        let (ty_env, actor) = FFIAgent::inner_parse_candid_file(&did_content)?;
 
         let slice = unsafe { std::slice::from_raw_parts(canister_id, canister_id_len as usize) };
         let canister_id = Principal::from_slice(slice);
@@ -274,6 +337,8 @@ pub extern "C" fn agent_create_wrap(
             identity,
             canister_id,
             did_content,
+            ty_env,
+            actor,
         })
     };
 
@@ -438,6 +503,251 @@ pub extern "C" fn agent_update_wrap(
     }
 }
 
+/// @brief Calls a query and returns its reply undecoded
+///
+/// @param agent_ptr Pointer to FFI structure that holds agent info
+/// @param method Pointer service/method name from did information
+/// @param method_args Pointer to the arguments required by method
+/// @param error_ret CallBack to get error
+/// @return Pointer to CBytes holding the Candid encoded reply
+/// If the function returns a NULL CBytes the user should check
+/// The error callback, to attain the error
+#[no_mangle]
+pub extern "C" fn agent_query_raw_wrap(
+    agent_ptr: Option<&FFIAgent>,
+    method: *const c_char,
+    method_args: *const c_char,
+    error_ret: Option<&mut RetError>,
+) -> Option<Box<CBytes>> {
+    let computation = || -> AnyResult<_> {
+        let agent = agent_ptr.ok_or(anyhow!("FFIAgent instance null"))?;
+
+        let method = unsafe { CStr::from_ptr(method).to_str().map_err(AnyErr::from) }?;
+        let method_args = unsafe { CStr::from_ptr(method_args).to_str().map_err(AnyErr::from) }?;
+
+        let runtime = runtime::Runtime::new()?;
+        let rst_blb = runtime.block_on(agent.inner_ic_query_raw(method, method_args))?;
+
+        Ok(rst_blb)
+    };
+
+    match computation() {
+        Ok(data) => Some(Box::new(CBytes { data })),
+        Err(e) => {
+            let err_str = e.to_string();
+            let c_string = CString::new(err_str.clone()).unwrap_or_else(|_| {
+                let fallback_error = "Failed to convert error message to CString";
+                CString::new(fallback_error).expect("Fallback error message is invalid")
+            });
+            if let Some(error_ret) = error_ret {
+                (error_ret.call)(
+                    c_string.as_ptr() as _,
+                    c_string.as_bytes().len() as _,
+                    error_ret.user_data,
+                );
+            }
+            None
+        }
+    }
+}
+
+/// @brief Calls a query with Candid encoded arguments and returns its reply
+/// undecoded
+///
+/// @param agent_ptr Pointer to FFI structure that holds agent info
+/// @param method Pointer service/method name from did information
+/// @param args Pointer to the encoded arguments, checked against the argument
+/// types of the method
+/// @param args_len Length of the arguments
+/// @param error_ret CallBack to get error
+/// @return Pointer to CBytes holding the Candid encoded reply
+/// If the function returns a NULL CBytes the user should check
+/// The error callback, to attain the error
+#[no_mangle]
+pub extern "C" fn agent_query_bytes_wrap(
+    agent_ptr: Option<&FFIAgent>,
+    method: *const c_char,
+    args: *const u8,
+    args_len: usize,
+    error_ret: Option<&mut RetError>,
+) -> Option<Box<CBytes>> {
+    let computation = || -> AnyResult<_> {
+        let agent = agent_ptr.ok_or(anyhow!("FFIAgent instance null"))?;
+
+        let method = unsafe { CStr::from_ptr(method).to_str().map_err(AnyErr::from) }?;
+        let args = unsafe { std::slice::from_raw_parts(args, args_len) }.to_vec();
+
+        let runtime = runtime::Runtime::new()?;
+        let rst_blb = runtime.block_on(agent.inner_ic_query_bytes(method, args))?;
+
+        Ok(rst_blb)
+    };
+
+    match computation() {
+        Ok(data) => Some(Box::new(CBytes { data })),
+        Err(e) => {
+            let err_str = e.to_string();
+            let c_string = CString::new(err_str.clone()).unwrap_or_else(|_| {
+                let fallback_error = "Failed to convert error message to CString";
+                CString::new(fallback_error).expect("Fallback error message is invalid")
+            });
+            if let Some(error_ret) = error_ret {
+                (error_ret.call)(
+                    c_string.as_ptr() as _,
+                    c_string.as_bytes().len() as _,
+                    error_ret.user_data,
+                );
+            }
+            None
+        }
+    }
+}
+
+/// @brief Calls an update and returns its reply undecoded
+///
+/// @param agent_ptr Pointer to FFI structure that holds agent info
+/// @param method Pointer service/method name from did information
+/// @param method_args Pointer to the arguments required by method
+/// @param error_ret CallBack to get error
+/// @return Pointer to CBytes holding the Candid encoded reply
+/// If the function returns a NULL CBytes the user should check
+/// The error callback, to attain the error
+#[no_mangle]
+pub extern "C" fn agent_update_raw_wrap(
+    agent_ptr: Option<&FFIAgent>,
+    method: *const c_char,
+    method_args: *const c_char,
+    error_ret: Option<&mut RetError>,
+) -> Option<Box<CBytes>> {
+    let computation = || -> AnyResult<_> {
+        let agent = agent_ptr.ok_or(anyhow!("FFIAgent instance null"))?;
+
+        let method = unsafe { CStr::from_ptr(method).to_str().map_err(AnyErr::from) }?;
+        let method_args = unsafe { CStr::from_ptr(method_args).to_str().map_err(AnyErr::from) }?;
+
+        let runtime = runtime::Runtime::new()?;
+        let rst_blb = runtime.block_on(agent.inner_ic_update_raw(method, method_args))?;
+
+        Ok(rst_blb)
+    };
+
+    match computation() {
+        Ok(data) => Some(Box::new(CBytes { data })),
+        Err(e) => {
+            let err_str = e.to_string();
+            let c_string = CString::new(err_str.clone()).unwrap_or_else(|_| {
+                let fallback_error = "Failed to convert error message to CString";
+                CString::new(fallback_error).expect("Fallback error message is invalid")
+            });
+            if let Some(error_ret) = error_ret {
+                (error_ret.call)(
+                    c_string.as_ptr() as _,
+                    c_string.as_bytes().len() as _,
+                    error_ret.user_data,
+                );
+            }
+            None
+        }
+    }
+}
+
+/// @brief Calls an update with Candid encoded arguments and returns its reply
+/// undecoded
+///
+/// @param agent_ptr Pointer to FFI structure that holds agent info
+/// @param method Pointer service/method name from did information
+/// @param args CBytes holding the encoded arguments, ownership is taken and
+/// the buffer is moved into the request once checked against the argument
+/// types of the method
+/// @param error_ret CallBack to get error
+/// @return Pointer to CBytes holding the Candid encoded reply
+/// If the function returns a NULL CBytes the user should check
+/// The error callback, to attain the error
+#[no_mangle]
+pub extern "C" fn agent_update_bytes_wrap(
+    agent_ptr: Option<&FFIAgent>,
+    method: *const c_char,
+    args: Box<CBytes>,
+    error_ret: Option<&mut RetError>,
+) -> Option<Box<CBytes>> {
+    let computation = || -> AnyResult<_> {
+        let agent = agent_ptr.ok_or(anyhow!("FFIAgent instance null"))?;
+
+        let method = unsafe { CStr::from_ptr(method).to_str().map_err(AnyErr::from) }?;
+
+        let runtime = runtime::Runtime::new()?;
+        let rst_blb = runtime.block_on(agent.inner_ic_update_bytes(method, args.data))?;
+
+        Ok(rst_blb)
+    };
+
+    match computation() {
+        Ok(data) => Some(Box::new(CBytes { data })),
+        Err(e) => {
+            let err_str = e.to_string();
+            let c_string = CString::new(err_str.clone()).unwrap_or_else(|_| {
+                let fallback_error = "Failed to convert error message to CString";
+                CString::new(fallback_error).expect("Fallback error message is invalid")
+            });
+            if let Some(error_ret) = error_ret {
+                (error_ret.call)(
+                    c_string.as_ptr() as _,
+                    c_string.as_bytes().len() as _,
+                    error_ret.user_data,
+                );
+            }
+            None
+        }
+    }
+}
+
+/// @brief Decodes the reply of a method with the return types from the did
+///
+/// @param agent_ptr Pointer to FFI structure that holds agent info
+/// @param method Pointer service/method name from did information
+/// @param reply Pointer to the Candid encoded reply
+/// @param reply_len Length of the reply
+/// @param error_ret CallBack to get error
+/// @return Pointer to IDLArgs
+/// If the function returns a NULL IDLArgs the user should check
+/// The error callback, to attain the error
+#[no_mangle]
+pub extern "C" fn agent_decode_reply_wrap(
+    agent_ptr: Option<&FFIAgent>,
+    method: *const c_char,
+    reply: *const u8,
+    reply_len: usize,
+    error_ret: Option<&mut RetError>,
+) -> *mut IDLArgs {
+    let computation = || -> AnyResult<_> {
+        let agent = agent_ptr.ok_or(anyhow!("FFIAgent instance null"))?;
+
+        let method = unsafe { CStr::from_ptr(method).to_str().map_err(AnyErr::from) }?;
+        let reply = unsafe { std::slice::from_raw_parts(reply, reply_len) };
+
+        agent.inner_decode_reply(method, reply)
+    };
+
+    match computation() {
+        Ok(idl) => Box::into_raw(Box::new(idl)) as *mut IDLArgs,
+        Err(e) => {
+            let err_str = e.to_string();
+            let c_string = CString::new(err_str.clone()).unwrap_or_else(|_| {
+                let fallback_error = "Failed to convert error message to CString";
+                CString::new(fallback_error).expect("Fallback error message is invalid")
+            });
+            if let Some(error_ret) = error_ret {
+                (error_ret.call)(
+                    c_string.as_ptr() as _,
+                    c_string.as_bytes().len() as _,
+                    error_ret.user_data,
+                );
+            }
+            ptr::null_mut()
+        }
+    }
+}
+
 /// @brief Free allocated Agent
 ///
 /// @param agent_ptr Pointer to FFI structure that holds agent info
@@ -489,6 +799,24 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_check_blob_against_signature() {
+        let did = cbytes_to_str(II_DID_CONTENT_BYTES);
+        let (env, actor) = FFIAgent::inner_parse_candid_file(did).unwrap();
+        let greet = env.get_method(&actor.unwrap(), "greet").unwrap().clone();
+
+        let text = "(\"World\")".parse::<IDLArgs>().unwrap();
+        let text_blb = text.to_bytes().unwrap();
+        assert!(FFIAgent::inner_check_blob(&text_blb, &env, &greet).is_ok());
+
+        // greet takes a text, not a nat
+        let nat = "(42 : nat)".parse::<IDLArgs>().unwrap();
+        let nat_blb = nat.to_bytes().unwrap();
+        assert!(FFIAgent::inner_check_blob(&nat_blb, &env, &greet).is_err());
+
+        assert!(FFIAgent::inner_check_blob(b"DIDL", &env, &greet).is_err());
+    }
+
     #[test]
     fn test_agent_query() {
         const EXPECTED: &str = "(\"Hello, World!\")";
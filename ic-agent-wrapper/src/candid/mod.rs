@@ -214,6 +214,21 @@ pub extern "C" fn idl_args_to_vec(ptr: &IDLArgs) -> Option<Box<CIDLValuesVec>> {
     Some(Box::new(CIDLValuesVec { data: r }))
 }
 
+/// @brief Move the IDLValues out of IDLArgs
+///
+/// Unlike idl_args_to_vec the values are not copied, the IDLArgs is left empty
+///
+/// @param ptr Pointer to IDLArgs Array
+/// @return Pointer to the Array of IDLValues , i.e. CIDLValuesVec struture
+#[no_mangle]
+pub extern "C" fn idl_args_take_vec(ptr: &mut IDLArgs) -> Box<CIDLValuesVec> {
+    let data = std::mem::take(&mut ptr.args)
+        .into_iter()
+        .map(|value| Box::into_raw(Box::new(value)) as _)
+        .collect();
+    Box::new(CIDLValuesVec { data })
+}
+
 /// @brief Number of elements in IDLArgs
 ///
 /// @param ptr Pointer to IDLArgs Array
@@ -223,6 +238,29 @@ pub extern "C" fn idl_args_len(ptr: &IDLArgs) -> usize {
     return ptr.args.len();
 }
 
+/// @brief Borrow an IDLValue of IDLArgs, without copying it
+///
+/// @param ptr Pointer to IDLArgs Array
+/// @param index Position of the value
+/// @return Pointer to the IDLValue, owned by ptr, NULL if index is out of range
+#[no_mangle]
+pub extern "C" fn idl_args_value_ref(ptr: &IDLArgs, index: usize) -> *const IDLValue {
+    ptr.args.get(index).map_or(std::ptr::null(), |v| v as _)
+}
+
+/// @brief Move an IDLValue out of IDLArgs
+///
+/// The value is not copied, it is replaced by null in the IDLArgs
+///
+/// @param ptr Pointer to IDLArgs Array
+/// @param index Position of the value
+/// @return Pointer to the IDLValue, NULL if index is out of range
+#[no_mangle]
+pub extern "C" fn idl_args_take_value(ptr: &mut IDLArgs, index: usize) -> Option<Box<IDLValue>> {
+    let value = ptr.args.get_mut(index)?;
+    Some(Box::new(std::mem::replace(value, IDLValue::Null)))
+}
+
 /// @brief Free allocated memory
 ///
 /// @param _ptr Pointer to IDLArgs Array
@@ -698,6 +736,49 @@ pub extern "C" fn idl_value_with_text(
     }
 }
 
+/// @brief Create IDLValue with text given by pointer and length
+///
+/// Unlike idl_value_with_text the text does not need to be NUL terminated, it
+/// may contain NULs and is not scanned for its length. It is copied once
+///
+/// @param text Pointer to UTF-8 text, may be NULL when text_len is 0
+/// @param text_len Length of the text in bytes
+/// @param error_ret CallBack to get error
+/// @return Pointer to the IDLValue Structure
+/// If the function returns a NULL IDLValue the user should check
+/// The error callback, to attain the error
+#[no_mangle]
+pub extern "C" fn idl_value_with_text_len(
+    text: *const u8,
+    text_len: usize,
+    error_ret: Option<&mut RetError>,
+) -> Option<Box<IDLValue>> {
+    let bytes = if text_len == 0 {
+        &[]
+    } else {
+        unsafe { std::slice::from_raw_parts(text, text_len) }
+    };
+
+    match std::str::from_utf8(bytes) {
+        Ok(text) => Some(Box::new(IDLValue::Text(text.to_string()))),
+        Err(e) => {
+            let err_str = e.to_string();
+            let c_string = CString::new(err_str.clone()).unwrap_or_else(|_| {
+                let fallback_error = "Failed to convert error message to CString";
+                CString::new(fallback_error).expect("Fallback error message is invalid")
+            });
+            if let Some(error_ret) = error_ret {
+                (error_ret.call)(
+                    c_string.as_ptr() as _,
+                    c_string.as_bytes().len() as _,
+                    error_ret.user_data,
+                );
+            }
+            None
+        }
+    }
+}
+
 /// @brief Get Text from IDLValue
 ///
 /// @param ptr Pointer to IDLValue
@@ -716,6 +797,24 @@ pub extern "C" fn text_from_idl_value(ptr: &IDLValue) -> Option<Box<CText>> {
     Some(c_text)
 }
 
+/// @brief Borrow the text of a Text IDLValue, without copying it
+///
+/// The text is not NUL terminated and may contain NULs
+///
+/// @param ptr Pointer to IDLValue Structure
+/// @param len Where the length of the text in bytes is written
+/// @return Pointer to the text, owned by ptr, NULL if ptr is not a Text
+#[no_mangle]
+pub extern "C" fn text_ref_from_idl_value(ptr: &IDLValue, len: &mut usize) -> *const u8 {
+    let IDLValue::Text(text) = ptr else {
+        *len = 0;
+        return std::ptr::null();
+    };
+
+    *len = text.len();
+    text.as_ptr()
+}
+
 /// @brief Create IDLValue with Principal
 ///
 /// @param principal Pointer to Principal bytes
@@ -914,6 +1013,22 @@ pub extern "C" fn opt_from_idl_value(ptr: &IDLValue) -> Option<Box<IDLValue>> {
     }
 }
 
+/// @brief Move the IDLValue out of an Opt
+///
+/// Unlike opt_from_idl_value the value is not copied, the Opt is left holding
+/// null
+///
+/// @param ptr Pointer to Opt IDLValue
+/// @return Pointer to IDLValue Structure, NULL if ptr is not an Opt
+#[no_mangle]
+pub extern "C" fn opt_take_from_idl_value(ptr: &mut IDLValue) -> Option<Box<IDLValue>> {
+    let IDLValue::Opt(v) = ptr else {
+        return None;
+    };
+
+    Some(Box::new(std::mem::replace(v.as_mut(), IDLValue::Null)))
+}
+
 /// @brief Create Reserved IDLValue
 ///
 /// @return Pointer to the Reserved IDLValue Structure
@@ -971,6 +1086,343 @@ pub extern "C" fn vec_from_idl_value(ptr: &IDLValue) -> Option<Box<CIDLValuesVec
     Some(Box::new(CIDLValuesVec { data: r }))
 }
 
+/// @brief Move the elements out of a Vec IDLValue
+///
+/// Unlike vec_from_idl_value the elements are not copied, the Vec is left
+/// empty
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to Array of IDLValues , CIDLValuesVec
+#[no_mangle]
+pub extern "C" fn vec_take_from_idl_value(ptr: &mut IDLValue) -> Option<Box<CIDLValuesVec>> {
+    let IDLValue::Vec(vec) = ptr else {
+        return None;
+    };
+
+    let data = std::mem::take(vec)
+        .into_iter()
+        .map(|inner| Box::into_raw(Box::new(inner)) as _)
+        .collect();
+
+    Some(Box::new(CIDLValuesVec { data }))
+}
+
+/// @brief Number of elements of a Vec IDLValue
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Number of elements, 0 if ptr is not a Vec
+#[no_mangle]
+pub extern "C" fn vec_elems_len(ptr: &IDLValue) -> usize {
+    match ptr {
+        IDLValue::Vec(vec) => vec.len(),
+        _ => 0,
+    }
+}
+
+/// @brief Borrow an element of a Vec IDLValue, without copying it
+///
+/// @param ptr Pointer to IDLValue structure
+/// @param index Position of the element
+/// @return Pointer to the element, owned by ptr, NULL if ptr is not a Vec or
+/// index is out of range
+#[no_mangle]
+pub extern "C" fn vec_elem_ref(ptr: &IDLValue, index: usize) -> *const IDLValue {
+    match ptr {
+        IDLValue::Vec(vec) => vec.get(index).map_or(std::ptr::null(), |v| v as _),
+        _ => std::ptr::null(),
+    }
+}
+
+/// Builds a Vec from a contiguous C array, `data` may be NULL when `data_len`
+/// is 0
+fn idl_value_with_slice<T: Copy>(
+    data: *const T,
+    data_len: usize,
+    wrap: fn(T) -> IDLValue,
+) -> Box<IDLValue> {
+    let elems = if data_len == 0 {
+        &[]
+    } else {
+        unsafe { std::slice::from_raw_parts(data, data_len) }
+    };
+
+    Box::new(IDLValue::Vec(elems.iter().map(|v| wrap(*v)).collect()))
+}
+
+/// Copies the elements of a Vec into a contiguous array in native byte order,
+/// None if the value is not a Vec or an element is not of the expected type
+fn bytes_from_idl_vec<T: Copy>(
+    ptr: &IDLValue,
+    unwrap: fn(&IDLValue) -> Option<T>,
+) -> Option<Box<CBytes>> {
+    let IDLValue::Vec(vec) = ptr else {
+        return None;
+    };
+
+    let size = std::mem::size_of::<T>();
+    let mut data = vec![0u8; vec.len() * size];
+    for (i, v) in vec.iter().enumerate() {
+        let value = unwrap(v)?;
+        unsafe { std::ptr::write_unaligned(data.as_mut_ptr().add(i * size) as *mut T, value) };
+    }
+
+    Some(Box::new(CBytes { data }))
+}
+
+/// @brief Create IDLValue Vec of nat8 from a contiguous array of bytes
+///
+/// @param data Pointer to the bytes, they are copied
+/// @param data_len Number of bytes
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_blob(data: *const u8, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Nat8)
+}
+
+/// @brief Get the bytes of an IDLValue Vec of nat8
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the bytes, NULL if the value is not
+/// a Vec of nat8
+#[no_mangle]
+pub extern "C" fn blob_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Nat8(b) => Some(*b),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of nat16 from a contiguous array
+///
+/// @param data Pointer to the values, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_nat16(data: *const u16, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Nat16)
+}
+
+/// @brief Get the values of an IDLValue Vec of nat16
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the values as an array of u16 in native
+/// byte order, NULL if the value is not a Vec of nat16
+#[no_mangle]
+pub extern "C" fn vec_nat16_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Nat16(x) => Some(*x),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of nat32 from a contiguous array
+///
+/// @param data Pointer to the values, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_nat32(data: *const u32, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Nat32)
+}
+
+/// @brief Get the values of an IDLValue Vec of nat32
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the values as an array of u32 in native
+/// byte order, NULL if the value is not a Vec of nat32
+#[no_mangle]
+pub extern "C" fn vec_nat32_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Nat32(x) => Some(*x),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of nat64 from a contiguous array
+///
+/// @param data Pointer to the values, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_nat64(data: *const u64, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Nat64)
+}
+
+/// @brief Get the values of an IDLValue Vec of nat64
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the values as an array of u64 in native
+/// byte order, NULL if the value is not a Vec of nat64
+#[no_mangle]
+pub extern "C" fn vec_nat64_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Nat64(x) => Some(*x),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of int8 from a contiguous array
+///
+/// @param data Pointer to the values, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_int8(data: *const i8, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Int8)
+}
+
+/// @brief Get the values of an IDLValue Vec of int8
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the values as an array of i8 in native
+/// byte order, NULL if the value is not a Vec of int8
+#[no_mangle]
+pub extern "C" fn vec_int8_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Int8(x) => Some(*x),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of int16 from a contiguous array
+///
+/// @param data Pointer to the values, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_int16(data: *const i16, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Int16)
+}
+
+/// @brief Get the values of an IDLValue Vec of int16
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the values as an array of i16 in native
+/// byte order, NULL if the value is not a Vec of int16
+#[no_mangle]
+pub extern "C" fn vec_int16_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Int16(x) => Some(*x),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of int32 from a contiguous array
+///
+/// @param data Pointer to the values, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_int32(data: *const i32, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Int32)
+}
+
+/// @brief Get the values of an IDLValue Vec of int32
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the values as an array of i32 in native
+/// byte order, NULL if the value is not a Vec of int32
+#[no_mangle]
+pub extern "C" fn vec_int32_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Int32(x) => Some(*x),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of int64 from a contiguous array
+///
+/// @param data Pointer to the values, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_int64(data: *const i64, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Int64)
+}
+
+/// @brief Get the values of an IDLValue Vec of int64
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the values as an array of i64 in native
+/// byte order, NULL if the value is not a Vec of int64
+#[no_mangle]
+pub extern "C" fn vec_int64_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Int64(x) => Some(*x),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of float32 from a contiguous array
+///
+/// @param data Pointer to the values, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_float32(data: *const f32, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Float32)
+}
+
+/// @brief Get the values of an IDLValue Vec of float32
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the values as an array of f32 in native
+/// byte order, NULL if the value is not a Vec of float32
+#[no_mangle]
+pub extern "C" fn vec_float32_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Float32(x) => Some(*x),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of float64 from a contiguous array
+///
+/// @param data Pointer to the values, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_float64(data: *const f64, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, IDLValue::Float64)
+}
+
+/// @brief Get the values of an IDLValue Vec of float64
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding the values as an array of f64 in native
+/// byte order, NULL if the value is not a Vec of float64
+#[no_mangle]
+pub extern "C" fn vec_float64_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Float64(x) => Some(*x),
+        _ => None,
+    })
+}
+
+/// @brief Create IDLValue Vec of bool from a contiguous array
+///
+/// @param data Pointer to the values, one byte each where any non zero value
+/// is true, they are copied
+/// @param data_len Number of values
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_vec_bool(data: *const u8, data_len: usize) -> Box<IDLValue> {
+    idl_value_with_slice(data, data_len, |b| IDLValue::Bool(b != 0))
+}
+
+/// @brief Get the values of an IDLValue Vec of bool
+///
+/// @param ptr Pointer to IDLValue structure
+/// @return Pointer to CBytes holding one byte per value, 0 or 1, NULL if the
+/// value is not a Vec of bool
+#[no_mangle]
+pub extern "C" fn vec_bool_from_idl_value(ptr: &IDLValue) -> Option<Box<CBytes>> {
+    bytes_from_idl_vec(ptr, |v| match v {
+        IDLValue::Bool(b) => Some(*b as u8),
+        _ => None,
+    })
+}
+
 /// @brief Create IDLValue with array of keys and values where each pair represents an IDLField
 ///
 /// @param keys Pointer to array of keys
@@ -1062,6 +1514,42 @@ pub extern "C" fn idl_value_with_record(
     Some(Box::new(once().ok()?))
 }
 
+/// A record field passed to idl_value_with_record_ids, its label id and value
+#[repr(C)]
+pub struct CRecordField {
+    pub id: u32,
+    pub val: *mut IDLValue,
+}
+
+/// @brief Create a Record IDLValue with id labels
+///
+/// @param fields Pointer to array of fields, rust takes ownership of each of
+/// their values, so the user should not use them after calling this function
+/// @param len Number of fields
+///
+/// @return Pointer to IDLValue Structure
+#[no_mangle]
+pub extern "C" fn idl_value_with_record_ids(
+    fields: *const CRecordField,
+    len: usize,
+) -> Box<IDLValue> {
+    if len == 0 {
+        return Box::new(IDLValue::Record(Vec::new()));
+    }
+
+    let fields = unsafe { std::slice::from_raw_parts(fields, len) };
+
+    let fields = fields
+        .iter()
+        .map(|field| IDLField {
+            id: Label::Id(field.id),
+            val: *unsafe { Box::from_raw(field.val) },
+        })
+        .collect();
+
+    Box::new(IDLValue::Record(fields))
+}
+
 /// @brief Get Record from IDLValue
 ///
 /// @param ptr Pointer to IDLValue Structure
@@ -1074,7 +1562,10 @@ pub extern "C" fn record_from_idl_value(ptr: &IDLValue) -> Option<Box<CRecord>>
         let mut keys_vec = Vec::new();
         let mut vals_vec = Vec::new();
 
+        let mut ids_vec = Vec::new();
+
         for IDLField { id, val } in fields {
+            ids_vec.push(id.get_id());
             let id = CText {
                 data: (id.to_string() + "\0").into_bytes(),
             };
@@ -1084,6 +1575,7 @@ pub extern "C" fn record_from_idl_value(ptr: &IDLValue) -> Option<Box<CRecord>>
 
         Some(Box::new(CRecord {
             keys: keys_vec,
+            ids: ids_vec,
             vals: vals_vec,
         }))
     } else {
@@ -1091,6 +1583,121 @@ pub extern "C" fn record_from_idl_value(ptr: &IDLValue) -> Option<Box<CRecord>>
     }
 }
 
+/// @brief Move the fields out of a Record IDLValue
+///
+/// Unlike record_from_idl_value the values are not copied, the record is left
+/// without fields
+///
+/// @param ptr Pointer to IDLValue Structure
+/// @return Pointer to CRecord structure where user can access array of keys and IDLValues
+#[no_mangle]
+pub extern "C" fn record_take_from_idl_value(ptr: &mut IDLValue) -> Option<Box<CRecord>> {
+    let IDLValue::Record(v) = ptr else {
+        return None;
+    };
+
+    let fields = std::mem::take(v);
+    let mut keys = Vec::with_capacity(fields.len());
+    let mut ids = Vec::with_capacity(fields.len());
+    let mut vals = Vec::with_capacity(fields.len());
+
+    for IDLField { id, val } in fields {
+        ids.push(id.get_id());
+        keys.push(CText {
+            data: (id.to_string() + "\0").into_bytes(),
+        });
+        vals.push(val);
+    }
+
+    Some(Box::new(CRecord { keys, ids, vals }))
+}
+
+/// @brief Get Record from IDLValue, with the label ids only
+///
+/// The keys are left empty, the labels are read with crecord_ids. The values
+/// are moved out rather than copied, the record is left without fields
+///
+/// @param ptr Pointer to IDLValue Structure
+/// @return Pointer to CRecord structure where user can access array of ids and IDLValues
+#[no_mangle]
+pub extern "C" fn record_ids_from_idl_value(ptr: &mut IDLValue) -> Option<Box<CRecord>> {
+    if let IDLValue::Record(v) = ptr {
+        let (ids, vals) = std::mem::take(v)
+            .into_iter()
+            .map(|IDLField { id, val }| (id.get_id(), val))
+            .unzip();
+
+        Some(Box::new(CRecord {
+            keys: Vec::new(),
+            ids,
+            vals,
+        }))
+    } else {
+        None
+    }
+}
+
+/// @brief Number of fields of a Record IDLValue
+///
+/// @param ptr Pointer to IDLValue Structure
+/// @return Number of fields, 0 if ptr is not a Record
+#[no_mangle]
+pub extern "C" fn record_fields_len(ptr: &IDLValue) -> usize {
+    match ptr {
+        IDLValue::Record(fields) => fields.len(),
+        _ => 0,
+    }
+}
+
+/// @brief Borrow a field of a Record IDLValue, without copying it
+///
+/// Nothing is allocated: the name of a named label is borrowed from the
+/// record, and is not NUL terminated
+///
+/// @param ptr Pointer to IDLValue Structure
+/// @param index Position of the field
+/// @param id Where the id of the label is written
+/// @param name Where the name of the label is written, NULL for id labels
+/// @param name_len Where the length of the name is written
+/// @return Pointer to the value of the field, owned by ptr, NULL if ptr is not
+/// a Record or index is out of range
+#[no_mangle]
+pub extern "C" fn record_field_ref(
+    ptr: &IDLValue,
+    index: usize,
+    id: Option<&mut u32>,
+    name: Option<&mut *const u8>,
+    name_len: Option<&mut usize>,
+) -> *const IDLValue {
+    let IDLValue::Record(fields) = ptr else {
+        return std::ptr::null();
+    };
+    let Some(field) = fields.get(index) else {
+        return std::ptr::null();
+    };
+
+    if let Some(id) = id {
+        *id = field.id.get_id();
+    }
+
+    let label = match &field.id {
+        Label::Named(name) => name.as_bytes(),
+        _ => &[],
+    };
+    if let Some(name) = name {
+        *name = if label.is_empty() {
+            std::ptr::null()
+        } else {
+            label.as_ptr()
+        };
+    }
+    if let Some(name_len) = name_len {
+        *name_len = label.len();
+    }
+
+    &field.val
+}
+
 /// @brief Create Variant IDLValue with key, IDValue and code
 ///
 /// @param key Pointer to key
@@ -1145,6 +1752,53 @@ pub extern "C" fn variant_from_idl_value(ptr: &IDLValue) -> Option<Box<CVariant>
     }))
 }
 
+/// @brief Get the label id and the value of a Variant IDLValue
+///
+/// Unlike variant_from_idl_value, the label is not converted to a string
+///
+/// @param ptr Pointer to IDLValue Structure
+/// @param id Where the id of the label is written
+/// @return Pointer to the value of the variant, NULL if ptr is not a Variant
+#[no_mangle]
+pub extern "C" fn variant_id_from_idl_value(
+    ptr: &IDLValue,
+    id: Option<&mut u32>,
+) -> Option<Box<IDLValue>> {
+    let IDLValue::Variant(v) = ptr else {
+        return None;
+    };
+
+    if let Some(id) = id {
+        *id = v.0.id.get_id();
+    }
+
+    Some(Box::new(v.0.val.clone()))
+}
+
+/// @brief Move the value out of a Variant IDLValue, with the id of its label
+///
+/// Unlike variant_id_from_idl_value the value is not copied, the variant is
+/// left holding null
+///
+/// @param ptr Pointer to IDLValue Structure
+/// @param id Where the id of the label is written
+/// @return Pointer to the value of the variant, NULL if ptr is not a Variant
+#[no_mangle]
+pub extern "C" fn variant_take_from_idl_value(
+    ptr: &mut IDLValue,
+    id: Option<&mut u32>,
+) -> Option<Box<IDLValue>> {
+    let IDLValue::Variant(v) = ptr else {
+        return None;
+    };
+
+    if let Some(id) = id {
+        *id = v.0.id.get_id();
+    }
+
+    Some(Box::new(std::mem::replace(&mut v.0.val, IDLValue::Null)))
+}
+
 /// @brief Create Func IDLValue with Principal and Function Name
 ///
 /// @param bytes Principal array of bytes
@@ -1278,6 +1932,42 @@ mod tests {
         }
     }
 
+    #[test]
+    fn idl_args_take_vec_test() {
+        let mut idl_args = IDLArgs::new(&IDL_VALUES);
+        let result = idl_args_take_vec(&mut idl_args);
+        assert_eq!(result.data.len(), 3);
+        assert!(idl_args.args.is_empty());
+
+        for i in 0..result.data.len() as usize {
+            let element = result.data[i];
+            unsafe {
+                let idl_value = Box::from_raw(element as *mut IDLValue);
+                assert_eq!(&IDL_VALUES[i], idl_value.deref());
+            }
+        }
+    }
+
+    #[test]
+    fn idl_args_value_ref_test() {
+        let idl_args = IDLArgs::new(&IDL_VALUES);
+        for (i, value) in IDL_VALUES.iter().enumerate() {
+            let element = idl_args_value_ref(&idl_args, i);
+            assert_eq!(value, unsafe { &*element });
+        }
+        assert!(idl_args_value_ref(&idl_args, IDL_VALUES.len()).is_null());
+    }
+
+    #[test]
+    fn idl_args_take_value_test() {
+        let mut idl_args = IDLArgs::new(&IDL_VALUES);
+        let value = idl_args_take_value(&mut idl_args, 1).unwrap();
+        assert_eq!(IDL_VALUES[1], *value);
+        assert_eq!(IDLValue::Null, idl_args.args[1]);
+        assert_eq!(3, idl_args.args.len());
+        assert!(idl_args_take_value(&mut idl_args, 3).is_none());
+    }
+
     #[test]
     fn idl_value_with_nat_test() {
         const NAT: &str = "98989898989898989898";
@@ -1401,6 +2091,23 @@ mod tests {
         assert_eq!(&IDLValue::Text("Hello World".to_string()), result.deref());
     }
 
+    #[test]
+    fn idl_value_with_text_len_test() {
+        const BTEXT: &[u8] = b"Hello\0World";
+
+        let result = idl_value_with_text_len(BTEXT.as_ptr(), BTEXT.len(), None);
+        assert_eq!(
+            &IDLValue::Text("Hello\0World".to_string()),
+            result.unwrap().deref()
+        );
+
+        let empty = idl_value_with_text_len(std::ptr::null(), 0, None);
+        assert_eq!(&IDLValue::Text(String::new()), empty.unwrap().deref());
+
+        const INVALID: &[u8] = &[0xff, 0xfe];
+        assert!(idl_value_with_text_len(INVALID.as_ptr(), INVALID.len(), None).is_none());
+    }
+
     #[test]
     fn text_from_idl_value_test() {
         let idl_value = IDLValue::Text("123.45".to_owned());
@@ -1452,6 +2159,67 @@ mod tests {
         }
     }
 
+    #[test]
+    fn vec_take_from_idl_value_test() {
+        let values = create_value_list();
+
+        let mut idl_value = IDLValue::Vec(values.clone());
+        let result = vec_take_from_idl_value(&mut idl_value).unwrap();
+        assert_eq!(IDLValue::Vec(Vec::new()), idl_value);
+        assert_eq!(result.data.len(), values.len());
+
+        for i in 0..result.data.len() as usize {
+            let element = result.data[i];
+            unsafe {
+                let idl_value = Box::from_raw(element as *mut IDLValue);
+                assert_eq!(&values[i], idl_value.deref());
+            }
+        }
+
+        let mut text = IDLValue::Text("Zondax".to_string());
+        assert!(vec_take_from_idl_value(&mut text).is_none());
+    }
+
+    #[test]
+    fn vec_elem_ref_test() {
+        let values = create_value_list();
+        let idl_value = IDLValue::Vec(values.clone());
+        assert_eq!(values.len(), vec_elems_len(&idl_value));
+
+        for (i, value) in values.iter().enumerate() {
+            let element = vec_elem_ref(&idl_value, i);
+            assert_eq!(value, unsafe { &*element });
+        }
+        assert!(vec_elem_ref(&idl_value, values.len()).is_null());
+
+        let text = IDLValue::Text("Zondax".to_string());
+        assert_eq!(0, vec_elems_len(&text));
+        assert!(vec_elem_ref(&text, 0).is_null());
+    }
+
+    #[test]
+    fn text_ref_from_idl_value_test() {
+        let idl_value = IDLValue::Text("Zon\0dax".to_string());
+        let mut len = 0;
+        let text = text_ref_from_idl_value(&idl_value, &mut len);
+        let text = unsafe { std::slice::from_raw_parts(text, len) };
+        assert_eq!(b"Zon\0dax", text);
+
+        assert!(text_ref_from_idl_value(&IDLValue::Null, &mut len).is_null());
+        assert_eq!(0, len);
+    }
+
+    #[test]
+    fn opt_take_from_idl_value_test() {
+        let mut idl_value = IDLValue::Opt(Box::new(IDLValue::Int32(-12)));
+        let result = opt_take_from_idl_value(&mut idl_value).unwrap();
+        assert_eq!(IDLValue::Int32(-12), *result);
+        assert_eq!(IDLValue::Opt(Box::new(IDLValue::Null)), idl_value);
+
+        let mut none = IDLValue::None;
+        assert!(opt_take_from_idl_value(&mut none).is_none());
+    }
+
     #[test]
     fn idl_value_with_record_test() {
         const KEYS: &[*const c_char] = &[
@@ -1494,6 +2262,34 @@ mod tests {
         assert_eq!(&expected, result.deref());
     }
 
+    #[test]
+    fn idl_value_with_record_ids_test() {
+        let fields = [
+            CRecordField {
+                id: 1,
+                val: Box::into_raw(Box::new(IDLValue::Nat8(7))),
+            },
+            CRecordField {
+                id: candid::idl_hash("name"),
+                val: Box::into_raw(Box::new(IDLValue::Text("zondax".into()))),
+            },
+        ];
+
+        let expected = IDLValue::Record(vec![
+            IDLField {
+                id: Label::Id(1),
+                val: IDLValue::Nat8(7),
+            },
+            IDLField {
+                id: Label::Id(candid::idl_hash("name")),
+                val: IDLValue::Text("zondax".into()),
+            },
+        ]);
+
+        let result = idl_value_with_record_ids(fields.as_ptr(), fields.len());
+        assert_eq!(&expected, result.deref());
+    }
+
     #[test]
     fn record_from_idl_value_test() {
         const KEYS: [&str; 3] = ["Zondax01", "Zondax02", "666"];
@@ -1534,6 +2330,94 @@ mod tests {
         }
     }
 
+    #[test]
+    fn record_ids_from_idl_value_test() {
+        let mut idl_value = IDLValue::Record(vec![
+            IDLField {
+                id: Label::Named("Zondax01".to_string()),
+                val: IDLValue::Bool(true),
+            },
+            IDLField {
+                id: Label::Id(666),
+                val: IDLValue::Int64(-12),
+            },
+        ]);
+
+        let result = record_ids_from_idl_value(&mut idl_value).unwrap();
+        assert!(result.keys.is_empty());
+        assert_eq!(vec![candid::idl_hash("Zondax01"), 666], result.ids);
+        assert_eq!(
+            vec![IDLValue::Bool(true), IDLValue::Int64(-12)],
+            result.vals
+        );
+        assert_eq!(IDLValue::Record(Vec::new()), idl_value);
+    }
+
+    #[test]
+    fn record_field_ref_test() {
+        let idl_value = IDLValue::Record(vec![
+            IDLField {
+                id: Label::Named("Zondax01".to_string()),
+                val: IDLValue::Bool(true),
+            },
+            IDLField {
+                id: Label::Id(666),
+                val: IDLValue::Int64(-12),
+            },
+        ]);
+        assert_eq!(2, record_fields_len(&idl_value));
+
+        let mut id = 0;
+        let mut name = std::ptr::null();
+        let mut name_len = 0;
+        let val = record_field_ref(
+            &idl_value,
+            0,
+            Some(&mut id),
+            Some(&mut name),
+            Some(&mut name_len),
+        );
+        assert_eq!(candid::idl_hash("Zondax01"), id);
+        let name = unsafe { std::slice::from_raw_parts(name, name_len) };
+        assert_eq!(b"Zondax01", name);
+        assert_eq!(&IDLValue::Bool(true), unsafe { &*val });
+
+        let mut name = std::ptr::null();
+        let val = record_field_ref(&idl_value, 1, Some(&mut id), Some(&mut name), None);
+        assert_eq!(666, id);
+        assert!(name.is_null());
+        assert_eq!(&IDLValue::Int64(-12), unsafe { &*val });
+
+        assert!(record_field_ref(&idl_value, 2, None, None, None).is_null());
+
+        let text = IDLValue::Text("Zondax".to_string());
+        assert_eq!(0, record_fields_len(&text));
+        assert!(record_field_ref(&text, 0, None, None, None).is_null());
+    }
+
+    #[test]
+    fn record_take_from_idl_value_test() {
+        let mut idl_value = IDLValue::Record(vec![
+            IDLField {
+                id: Label::Named("Zondax01".to_string()),
+                val: IDLValue::Bool(true),
+            },
+            IDLField {
+                id: Label::Id(666),
+                val: IDLValue::Int64(-12),
+            },
+        ]);
+
+        let result = record_take_from_idl_value(&mut idl_value).unwrap();
+        assert_eq!(vec![candid::idl_hash("Zondax01"), 666], result.ids);
+        assert_eq!(b"Zondax01\0".as_slice(), result.keys[0].data.as_slice());
+        assert_eq!(
+            vec![IDLValue::Bool(true), IDLValue::Int64(-12)],
+            result.vals
+        );
+        assert_eq!(IDLValue::Record(Vec::new()), idl_value);
+    }
+
     #[test]
     fn idl_value_with_variant_test() {
         const KEY: *const c_char = b"Zondax\0".as_ptr() as *const c_char;
@@ -1576,6 +2460,46 @@ mod tests {
         assert_eq!(ID, str_slice.to_str().unwrap());
     }
 
+    #[test]
+    fn variant_id_from_idl_value_test() {
+        let idl_value = IDLValue::Variant(VariantValue(
+            Box::new(IDLField {
+                id: Label::Named("Zondax".to_string()),
+                val: IDLValue::Int64(-12),
+            }),
+            3,
+        ));
+
+        let mut id = 0;
+        let result = variant_id_from_idl_value(&idl_value, Some(&mut id)).unwrap();
+        assert_eq!(IDLValue::Int64(-12), *result);
+        assert_eq!(candid::idl_hash("Zondax"), id);
+
+        let text = IDLValue::Text("Zondax".to_string());
+        assert!(variant_id_from_idl_value(&text, None).is_none());
+    }
+
+    #[test]
+    fn variant_take_from_idl_value_test() {
+        let mut idl_value = IDLValue::Variant(VariantValue(
+            Box::new(IDLField {
+                id: Label::Named("Zondax".to_string()),
+                val: IDLValue::Int64(-12),
+            }),
+            3,
+        ));
+
+        let mut id = 0;
+        let result = variant_take_from_idl_value(&mut idl_value, Some(&mut id)).unwrap();
+        assert_eq!(IDLValue::Int64(-12), *result);
+        assert_eq!(candid::idl_hash("Zondax"), id);
+
+        let IDLValue::Variant(v) = idl_value else {
+            panic!("not a variant");
+        };
+        assert_eq!(IDLValue::Null, v.0.val);
+    }
+
     #[test]
     fn idl_value_with_func_test() {
         const PRINCIPAL: Principal = Principal::anonymous();
@@ -1603,4 +2527,51 @@ mod tests {
         assert_eq!(EXPECTED_PRINCIPAL, result.p);
         assert_eq!(EXPECTED_STR, string.to_str().unwrap());
     }
+
+    #[test]
+    fn idl_value_blob_test() {
+        let bytes = [0u8, 1, 2, 254, 255];
+        let idl = idl_value_with_blob(bytes.as_ptr(), bytes.len());
+        assert_eq!(
+            *idl,
+            IDLValue::Vec(bytes.iter().map(|b| IDLValue::Nat8(*b)).collect())
+        );
+
+        let blob = blob_from_idl_value(&idl).unwrap();
+        assert_eq!(blob.data, bytes);
+
+        let empty = idl_value_with_blob(std::ptr::null(), 0);
+        assert_eq!(blob_from_idl_value(&empty).unwrap().data.len(), 0);
+
+        let not_blob = IDLValue::Vec(vec![IDLValue::Nat16(1)]);
+        assert!(blob_from_idl_value(&not_blob).is_none());
+    }
+
+    #[test]
+    fn idl_value_numeric_vec_test() {
+        let values = [1i32, -2, i32::MAX, i32::MIN];
+        let idl = idl_value_with_vec_int32(values.as_ptr(), values.len());
+        assert_eq!(
+            *idl,
+            IDLValue::Vec(values.iter().map(|v| IDLValue::Int32(*v)).collect())
+        );
+
+        let bytes = vec_int32_from_idl_value(&idl).unwrap();
+        let expected: Vec<u8> = values.iter().flat_map(|v| v.to_ne_bytes()).collect();
+        assert_eq!(bytes.data, expected);
+        assert!(vec_nat32_from_idl_value(&idl).is_none());
+
+        let floats = [0.5f64, -1.25];
+        let idl = idl_value_with_vec_float64(floats.as_ptr(), floats.len());
+        let bytes = vec_float64_from_idl_value(&idl).unwrap();
+        let expected: Vec<u8> = floats.iter().flat_map(|v| v.to_ne_bytes()).collect();
+        assert_eq!(bytes.data, expected);
+
+        let bools = [1u8, 0, 7];
+        let idl = idl_value_with_vec_bool(bools.as_ptr(), bools.len());
+        assert_eq!(vec_bool_from_idl_value(&idl).unwrap().data, [1, 0, 1]);
+
+        let empty = idl_value_with_vec_nat64(std::ptr::null(), 0);
+        assert_eq!(vec_nat64_from_idl_value(&empty).unwrap().data.len(), 0);
+    }
 }
@@ -109,6 +109,15 @@ pub extern "C" fn idl_value_type(value: &IDLValue) -> u8 {
 #[no_mangle]
 pub extern "C" fn idl_value_destroy(_ptr: Option<Box<IDLValue>>) {}
 
+/// @brief Copy an IDLValue
+///
+/// @param ptr Pointer to IDLValue
+/// @return Pointer to the copy, owned by the caller
+#[no_mangle]
+pub extern "C" fn idl_value_clone(ptr: &IDLValue) -> Box<IDLValue> {
+    Box::new(ptr.clone())
+}
+
 /// Structure that holds Rust string
 #[derive(Debug, Clone)]
 pub struct CText {
@@ -172,6 +181,31 @@ pub extern "C" fn cbytes_len(ptr: &CBytes) -> usize {
     ptr.data.len()
 }
 
+/// @brief Create an empty CBytes, to be filled with cbytes_append
+///
+/// @param capacity Number of bytes to reserve up front
+/// @return Pointer to the CBytes structure
+#[no_mangle]
+pub extern "C" fn cbytes_with_capacity(capacity: usize) -> Box<CBytes> {
+    Box::new(CBytes {
+        data: Vec::with_capacity(capacity),
+    })
+}
+
+/// @brief Append bytes to a CBytes
+///
+/// @param ptr CBytes structure pointer
+/// @param data Pointer to the bytes, they are copied
+/// @param data_len Number of bytes
+#[no_mangle]
+pub extern "C" fn cbytes_append(ptr: &mut CBytes, data: *const u8, data_len: usize) {
+    if data_len == 0 {
+        return;
+    }
+    let bytes = unsafe { std::slice::from_raw_parts(data, data_len) };
+    ptr.data.extend_from_slice(bytes);
+}
+
 /// Struture that holds a vector of IDLValues
 pub struct CIDLValuesVec {
     data: Vec<*const IDLValue>,
@@ -248,10 +282,12 @@ pub extern "C" fn cidlval_vec_len(ptr: &CIDLValuesVec) -> usize {
     ptr.data.len()
 }
 
-/// Struture that holds a Record IDLValue with a Vector of keys (CText) and Vector of IDLValues
+/// Struture that holds a Record IDLValue with a Vector of keys (CText), the ids of
+/// the keys and a Vector of IDLValues
 #[derive(Debug, Clone)]
 pub struct CRecord {
     keys: Vec<CText>,
+    ids: Vec<u32>,
     vals: Vec<IDLValue>,
 }
 
@@ -306,6 +342,15 @@ pub extern "C" fn crecord_keys_len(ptr: &CRecord) -> usize {
     ptr.keys.len()
 }
 
+/// @brief Get pointer to the label ids of a CRecord, one per value
+///
+/// @param ptr CRecord structure pointer
+/// @return Pointer to the ids, crecord_vals_len of them
+#[no_mangle]
+pub extern "C" fn crecord_ids(ptr: &CRecord) -> *const u32 {
+    ptr.ids.as_ptr()
+}
+
 /// @brief Get pointer to CRecord Values vector
 ///
 /// @param ptr CRecord structure pointer
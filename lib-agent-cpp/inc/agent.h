@@ -16,20 +16,31 @@
 #ifndef AGENT_H
 #define AGENT_H
 
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <string>
 #include <type_traits>
 #include <variant>
 #include <vector>
 
+#include "arg_writer.h"
+#include "hedging.h"
 #include "identity.h"
 #include "idl_args.h"
+#include "idl_decoder.h"
+#include "idl_encoder.h"
+#include "idl_tree.h"
 #include "idl_value.h"
+#include "idl_visitor.h"
 #include "principal.h"
+#include "rate_limiter.h"
 #include "service.h"
+#include "single_flight.h"
 
 extern "C" {
 #include "zondax_ic.h"
@@ -75,13 +86,109 @@ inline constexpr bool has_at_least_two_types = sizeof...(Rest) >= 2;
 
 class Agent {
  private:
-  FFIAgent *agent;
-
-  Agent() noexcept { agent = nullptr; };
+  // Undecoded reply of a call, or an error message. Query results are shared
+  // between coalesced callers.
+  using Reply = std::variant<std::vector<uint8_t>, std::string>;
+  using QueryOutcome = Reply;
+
+  // A replica or boundary node the agent talks to. Both members are shared
+  // with hedged attempts that may outlive the query.
+  struct Endpoint {
+    std::shared_ptr<FFIAgent> agent;
+    std::shared_ptr<LatencyTracker> latency;
+  };
+
+  std::vector<Endpoint> endpoints;
+  HedgePolicy hedge;
+  // Runs hedged attempts, declared after the endpoints so that the attempts
+  // still in flight are waited for before they are released.
+  std::unique_ptr<QueryHedger> hedger;
+
+  // In flight queries, identical concurrent queries wait on the first one
+  // instead of going over the wire again.
+  std::unique_ptr<SingleFlight<QueryOutcome>> inflight;
+  bool coalesceQueries;
+
+  // Admission control, the canister id is the key of its limits.
+  std::vector<uint8_t> canister;
+  std::shared_ptr<RateLimiter> limiter;
+
+  Agent() noexcept
+      : hedger(std::make_unique<QueryHedger>()),
+        inflight(std::make_unique<SingleFlight<QueryOutcome>>()),
+        coalesceQueries(true){};
+
+  // Arguments of a query, as Candid text or as an encoded message
+  using QueryArgs = std::variant<std::string, std::vector<uint8_t>>;
+
+  static QueryOutcome queryEndpoint(const Endpoint &endpoint,
+                                    const std::string &method,
+                                    const QueryArgs &args);
+  QueryOutcome queryHedged(const std::string &method, const QueryArgs &args);
+  QueryOutcome queryOnce(const std::string &method, const QueryArgs &args);
+
+  // Waits for the rate limiter, returns an error if the call is rejected.
+  std::optional<std::string> admit(const std::string &method);
+
+  // Endpoint indexes sorted from the fastest to the slowest known p95.
+  std::vector<std::size_t> endpointOrder() const;
+  std::chrono::microseconds hedgeDelay(const Endpoint &endpoint) const;
 
   static void error_callback(const unsigned char *data, int len,
                              void *user_data);
 
+  // Sends a query or an update, returning the reply undecoded.
+  Reply QueryBytes(const std::string &method, zondax::IdlArgs &&args);
+  Reply UpdateBytes(const std::string &method, zondax::IdlArgs &&args);
+  Reply UpdateBytes(const std::string &method, ArgWriter &&args);
+  // The same with arguments already Candid encoded, sent as they are.
+  Reply QueryEncoded(const std::string &method,
+                     std::vector<uint8_t> &&message);
+  Reply UpdateEncoded(const std::string &method, CBytes *message);
+
+  // Admits and coalesces a query, then sends it.
+  Reply query(const std::string &method, QueryArgs &&args);
+
+  // Decodes a reply as IdlArgs, with the return types from the did file.
+  std::variant<IdlArgs, std::string> decodeReply(
+      const std::string &method, const std::vector<uint8_t> &reply);
+
+  /**
+   * Decodes a reply into the expected C++ types.
+   *
+   * Types supported by `IdlDecoder` are read straight from the reply bytes,
+   * other types go through `IdlArgs`.
+   *
+   * @return A variant containing the values, `std::nullopt` if the reply does
+   * not match the types, or an error string.
+   */
+  template <typename R>
+  std::variant<std::optional<R>, std::string> decodeReplyAs(
+      const std::string &method, const std::vector<uint8_t> &reply);
+
+  template <typename... Rs>
+  std::variant<std::optional<std::tuple<Rs...>>, std::string>
+  decodeReplyTuple(const std::string &method,
+                   const std::vector<uint8_t> &reply);
+
+  template <typename... Args>
+  static IdlArgs makeArgs(Args &&...rawArgs);
+
+  // Sends the arguments of a typed call. When every argument has a Candid
+  // type of its own (see `helper::is_idl_typed`) they are encoded straight to
+  // bytes and checked against the .did file by the Rust library, otherwise
+  // they go through IdlArgs.
+  template <typename... Args>
+  Reply QueryTyped(const std::string &method, Args &&...rawArgs);
+  template <typename... Args>
+  Reply UpdateTyped(const std::string &method, Args &&...rawArgs);
+
+  // Encodes a message into a buffer kept by the calling thread, which stops
+  // allocating once it has grown to the size of the messages. Returns nullptr
+  // if a value can not be encoded.
+  template <typename... Args>
+  static const std::vector<uint8_t> *encodeArgs(const Args &...args);
+
   /**
    * Performs a query using the specified method and arguments.
    *
@@ -124,11 +231,60 @@ class Agent {
       std::string url, zondax::Identity id, zondax::Principal &principal,
       const std::vector<char> &did_content);
 
+  /**
+   * Creates an agent that can reach the canister through several replica or
+   * boundary-node URLs. Updates use the first URL, queries can be hedged
+   * across all of them, see `setHedgePolicy`.
+   *
+   * @param urls The endpoints, at least one is required.
+   * @param id The identity used to sign the requests.
+   * @param principal The canister id.
+   * @param did_content The content of the canister .did file.
+   * @return A variant containing the agent or an error string.
+   */
+  static std::variant<Agent, std::string> create_agent(
+      const std::vector<std::string> &urls, zondax::Identity id,
+      zondax::Principal &principal, const std::vector<char> &did_content);
+
   ~Agent();
 
+  /**
+   * Enables or disables coalescing of identical concurrent queries.
+   *
+   * When enabled (the default), a query issued while an identical one (same
+   * method and arguments) is still in flight does not reach the network, it
+   * waits for the running one and gets a copy of its result. Updates are never
+   * coalesced.
+   *
+   * @param enabled Whether identical concurrent queries should be coalesced.
+   */
+  void setQueryCoalescing(bool enabled) noexcept;
+
+  /**
+   * Sets how queries are hedged when the agent has several endpoints.
+   *
+   * This should be configured before the agent is shared between threads.
+   *
+   * @param policy The hedging policy, disabled by default.
+   */
+  void setHedgePolicy(const HedgePolicy &policy) noexcept;
+
+  /**
+   * Sets the rate limiter applied to the calls of this agent.
+   *
+   * Every query or update must be admitted by the canister and method limits
+   * configured on the limiter, see `RateLimiter`. A rejected call returns an
+   * error without reaching the network. Coalesced queries are admitted once.
+   * The limiter can be shared with other agents.
+   *
+   * @param rateLimiter The limiter, or `nullptr` to disable rate limiting.
+   */
+  void setRateLimiter(std::shared_ptr<RateLimiter> rateLimiter) noexcept;
+
   /**
    * Performs a query using the specified method and arguments.
-   * The arguments `args` are forwarded to construct `IdlValue` objects.
+   * The arguments are encoded straight to Candid when `helper::is_idl_typed`
+   * holds for their types, otherwise they are converted to `IdlValue`.
    *
    * @tparam Args Variadic template parameter pack for the argument types.
    * @tparam R The return type of the query.
@@ -147,7 +303,8 @@ class Agent {
   /**
    * Performs a query using the specified method and arguments.
    * The return type `R` must be constructible from `IdlValue`.
-   * The arguments `rawArgs` are forwarded to construct `IdlValue` objects.
+   * The arguments are encoded straight to Candid when `helper::is_idl_typed`
+   * holds for their types, otherwise they are converted to `IdlValue`.
    *
    * @tparam Args Variadic template parameter pack for the argument types.
    * @tparam R The return type of the query.
@@ -182,14 +339,15 @@ class Agent {
           std::enable_if_t<(std::is_constructible_v<IdlValue, RArgs> && ...)>,
       typename =
           std::enable_if_t<(std::is_constructible_v<IdlValue, Args> && ...)>,
-      typename = std::enable_if_t<!std::is_same_v<IdlArgs, RArgs...>>,
+      typename = std::enable_if_t<!(std::is_same_v<IdlArgs, RArgs> || ...)>,
       typename = std::enable_if_t<helper::has_at_least_two_types<RArgs...>>>
   std::variant<std::optional<std::tuple<RArgs...>>, std::string> Query(
       const std::string &method, Args &&...args);
 
   /**
    * Performs an update using the specified method and arguments.
-   * The arguments `args` are forwarded to construct `IdlValue` objects.
+   * The arguments are encoded straight to Candid when `helper::is_idl_typed`
+   * holds for their types, otherwise they are converted to `IdlValue`.
    *
    * @tparam Args Variadic template parameter pack for the argument types.
    * @tparam R The return type of the call.
@@ -208,7 +366,8 @@ class Agent {
   /**
    * Performs an update using the specified method and arguments.
    * The return type `R` must be constructible from `IdlValue`.
-   * The arguments `args` are forwarded to construct `IdlValue` objects.
+   * The arguments are encoded straight to Candid when `helper::is_idl_typed`
+   * holds for their types, otherwise they are converted to `IdlValue`.
    *
    * @tparam Args Variadic template parameter pack for the argument types.
    * @tparam R The return type of the call.
@@ -244,126 +403,281 @@ class Agent {
           std::enable_if_t<(std::is_constructible_v<IdlValue, RArgs> && ...)>,
       typename =
           std::enable_if_t<(std::is_constructible_v<IdlValue, Args> && ...)>,
-      typename = std::enable_if_t<!std::is_same_v<IdlArgs, RArgs...>>,
+      typename = std::enable_if_t<!(std::is_same_v<IdlArgs, RArgs> || ...)>,
       typename = std::enable_if_t<helper::has_at_least_two_types<RArgs...>>>
   std::variant<std::optional<std::tuple<RArgs...>>, std::string> Update(
       const std::string &method, Args &&...args);
+
+  /**
+   * Performs a query and returns the reply undecoded, to be read with
+   * `IdlDecoder` or viewed with `IdlView`.
+   *
+   * @param method The method to query.
+   * @param args The arguments for the query.
+   * @return A variant containing the Candid encoded reply or an error string.
+   */
+  template <typename... Args,
+            typename = std::enable_if_t<
+                (std::is_constructible_v<IdlValue, Args> && ...)>>
+  std::variant<std::vector<uint8_t>, std::string> QueryRaw(
+      const std::string &method, Args &&...args) {
+    return QueryTyped(method, std::forward<Args>(args)...);
+  }
+
+  /**
+   * Performs an update with arguments encoded by an `ArgWriter`, whose buffer
+   * is handed to the request without further copies.
+   *
+   * @param method The method to call.
+   * @param args The arguments, every one of them must have been written.
+   * @return A variant containing the call result or an error string.
+   */
+  std::variant<IdlArgs, std::string> Update(const std::string &method,
+                                            ArgWriter &&args);
+
+  /**
+   * Performs an update with arguments encoded by an `ArgWriter`, converting
+   * the result to R.
+   *
+   * @tparam R The return type of the call.
+   * @param method The method to call.
+   * @param args The arguments, every one of them must have been written.
+   * @return A variant containing the converted call result (if the type
+   * matches) or an error string.
+   */
+  template <typename R>
+  std::variant<std::optional<R>, std::string> Update(const std::string &method,
+                                                    ArgWriter &&args);
+
+  /**
+   * Performs an update with arguments encoded by an `ArgWriter` and returns
+   * the reply undecoded.
+   */
+  std::variant<std::vector<uint8_t>, std::string> UpdateRaw(
+      const std::string &method, ArgWriter &&args) {
+    return UpdateBytes(method, std::move(args));
+  }
+
+  /**
+   * Performs a query with arguments held in an `IdlTree`, returning the reply
+   * as a tree. Arguments and results only cross the FFI as Candid messages;
+   * the arguments are checked against the method types and sent as encoded.
+   *
+   * @param method The method to query.
+   * @param args The arguments for the query.
+   * @param resource Where the reply tree is allocated, an `IdlArena` frees
+   * it all at once.
+   * @return A variant containing the results or an error string.
+   */
+  std::variant<IdlTree, std::string> QueryTree(
+      const std::string &method, const IdlTree &args,
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+  /**
+   * Performs an update with arguments held in an `IdlTree`, returning the
+   * reply as a tree.
+   */
+  std::variant<IdlTree, std::string> UpdateTree(
+      const std::string &method, const IdlTree &args,
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+  /**
+   * Performs a query and reports the values of the reply to a visitor as they
+   * are read, without building them (see `IdlVisitor`).
+   *
+   * @param method The method to query.
+   * @param visitor Receives the values.
+   * @param args The arguments for the query.
+   * @return An error string if the query failed or the reply is malformed.
+   */
+  template <typename... Args,
+            typename = std::enable_if_t<
+                (std::is_constructible_v<IdlValue, Args> && ...)>>
+  std::optional<std::string> QueryStream(const std::string &method,
+                                         IdlVisitor &visitor, Args &&...args);
+
+  /**
+   * Performs an update and returns the reply undecoded, to be read with
+   * `IdlDecoder` or viewed with `IdlView`.
+   *
+   * @param method The method to call.
+   * @param args The arguments for the call.
+   * @return A variant containing the Candid encoded reply or an error string.
+   */
+  template <typename... Args,
+            typename = std::enable_if_t<
+                (std::is_constructible_v<IdlValue, Args> && ...)>>
+  std::variant<std::vector<uint8_t>, std::string> UpdateRaw(
+      const std::string &method, Args &&...args) {
+    return UpdateTyped(method, std::forward<Args>(args)...);
+  }
 };
 
-template <typename... Args, typename, typename>
-std::variant<IdlArgs, std::string> Agent::Query(const std::string &method,
-                                                Args &&...rawArgs) {
+template <typename... Args>
+IdlArgs Agent::makeArgs(Args &&...rawArgs) {
   std::vector<IdlValue> v;
   v.reserve(sizeof...(rawArgs));
 
   (..., v.emplace_back(IdlValue(std::forward<Args>(rawArgs))));
 
-  IdlArgs args(v);
+  return IdlArgs(v);
+}
+
+template <typename... Args>
+const std::vector<uint8_t> *Agent::encodeArgs(const Args &...args) {
+  thread_local std::vector<uint8_t> message;
+  message.clear();
+  if (!EncodePlan<Args...>::get().encode(message, args...)) return nullptr;
 
-  return Query(method, std::move(args));
+  return &message;
 }
 
-template <typename R, typename... Args, typename, typename, typename>
-std::variant<std::optional<R>, std::string> Agent::Query(
-    const std::string &method, Args &&...rawArgs) {
-  auto result = Query(method, std::forward<Args>(rawArgs)...);
+template <typename... Args>
+Agent::Reply Agent::QueryTyped(const std::string &method, Args &&...rawArgs) {
+  if constexpr ((helper::is_idl_typed_v<std::decay_t<Args>> && ...)) {
+    const auto *message = encodeArgs(rawArgs...);
+    if (message == nullptr) return std::string("Argument can not be encoded");
 
-  if (result.index() == 1) return std::get<1>(result);
+    // the only allocation, sized to the message
+    return QueryEncoded(method, std::vector<uint8_t>(*message));
+  } else {
+    return QueryBytes(method, makeArgs(std::forward<Args>(rawArgs)...));
+  }
+}
 
-  auto returned_values = std::move(std::get<0>(result));
-  std::vector<IdlValue> values = std::move(returned_values.getVec());
+template <typename... Args>
+Agent::Reply Agent::UpdateTyped(const std::string &method, Args &&...rawArgs) {
+  if constexpr ((helper::is_idl_typed_v<std::decay_t<Args>> && ...)) {
+    const auto *message = encodeArgs(rawArgs...);
+    if (message == nullptr) return std::string("Argument can not be encoded");
 
-  if (values.size() != 1) return std::nullopt;
+    // copied once, into the buffer the request takes over
+    CBytes *bytes = cbytes_with_capacity(message->size());
+    cbytes_append(bytes, message->data(), message->size());
 
-  return values[0].get<R>();
+    return UpdateEncoded(method, bytes);
+  } else {
+    return UpdateBytes(method, makeArgs(std::forward<Args>(rawArgs)...));
+  }
 }
 
-template <typename... RArgs, typename... Args, typename, typename, typename,
-          typename>
-std::variant<std::optional<std::tuple<RArgs...>>, std::string> Agent::Query(
-    const std::string &method, Args &&...rawArgs) {
-  std::vector<IdlValue> v;
-  auto result = Query(method, std::forward<Args>(rawArgs)...);
+template <typename R>
+std::variant<std::optional<R>, std::string> Agent::decodeReplyAs(
+    const std::string &method, const std::vector<uint8_t> &reply) {
+  if constexpr (helper::is_idl_decodable_v<R>) {
+    auto result = decodeReplyTuple<R>(method, reply);
+    if (result.index() == 1) return std::get<1>(result);
+
+    auto &values = std::get<0>(result);
+    if (!values.has_value()) return std::nullopt;
 
-  if (result.index() == 1) return std::get<1>(result);
+    return std::make_optional<R>(std::move(std::get<0>(values.value())));
+  } else {
+    auto result = decodeReply(method, reply);
+    if (result.index() == 1) return std::get<1>(result);
 
-  auto returned_values = std::move(std::get<0>(result));
-  std::vector<IdlValue> values = std::move(returned_values.getVec());
+    auto values = std::move(std::get<0>(result)).takeVec();
+    if (values.size() != 1) return std::nullopt;
 
-  if (values.size() != sizeof...(RArgs)) return std::nullopt;
+    return std::move(values[0]).take<R>();
+  }
+}
 
-  std::tuple<RArgs...> tuple;
-  for (std::size_t i = 0; i < values.size(); ++i) {
-    IdlValue &val = values[i];
-    auto &loc = std::get<i>(tuple);
+template <typename... Rs>
+std::variant<std::optional<std::tuple<Rs...>>, std::string>
+Agent::decodeReplyTuple(const std::string &method,
+                        const std::vector<uint8_t> &reply) {
+  if constexpr ((helper::is_idl_decodable_v<Rs> && ...)) {
+    auto created = IdlDecoder::create(reply.data(), reply.size());
+    if (created.index() == 1) return std::get<1>(created);
 
-    auto mby_converted = val.get<decltype(loc)>();
-    if (mby_converted.has_value()) {
-      loc = std::move(mby_converted.value());
-    } else {
-      return std::nullopt;
-    }
+    return std::get<0>(created).template args<Rs...>();
+  } else {
+    auto result = decodeReply(method, reply);
+    if (result.index() == 1) return std::get<1>(result);
+
+    return std::move(std::get<0>(result)).takeTuple<Rs...>();
   }
+}
 
-  return std::make_optional(std::move(tuple));
+template <typename... Args, typename, typename>
+std::variant<IdlArgs, std::string> Agent::Query(const std::string &method,
+                                                Args &&...rawArgs) {
+  auto reply = QueryTyped(method, std::forward<Args>(rawArgs)...);
+  if (reply.index() == 1) return std::get<1>(reply);
+
+  return decodeReply(method, std::get<0>(reply));
+}
+
+template <typename R, typename... Args, typename, typename, typename>
+std::variant<std::optional<R>, std::string> Agent::Query(
+    const std::string &method, Args &&...rawArgs) {
+  auto reply = QueryTyped(method, std::forward<Args>(rawArgs)...);
+  if (reply.index() == 1) return std::get<1>(reply);
+
+  return decodeReplyAs<R>(method, std::get<0>(reply));
+}
+
+template <typename... RArgs, typename... Args, typename, typename, typename,
+          typename>
+std::variant<std::optional<std::tuple<RArgs...>>, std::string> Agent::Query(
+    const std::string &method, Args &&...rawArgs) {
+  auto reply = QueryTyped(method, std::forward<Args>(rawArgs)...);
+  if (reply.index() == 1) return std::get<1>(reply);
+
+  return decodeReplyTuple<RArgs...>(method, std::get<0>(reply));
 }
+template <typename... Args, typename>
+std::optional<std::string> Agent::QueryStream(const std::string &method,
+                                              IdlVisitor &visitor,
+                                              Args &&...rawArgs) {
+  auto reply = QueryTyped(method, std::forward<Args>(rawArgs)...);
+  if (reply.index() == 1) return std::get<1>(reply);
+
+  const auto &bytes = std::get<0>(reply);
+  auto decoder = IdlDecoder::create(bytes.data(), bytes.size());
+  if (decoder.index() == 1) return std::get<1>(decoder);
+
+  return std::get<0>(decoder).visit(visitor);
+}
+
 /* *********************** Update ************************/
 
 template <typename... Args, typename, typename>
 std::variant<IdlArgs, std::string> Agent::Update(const std::string &method,
                                                  Args &&...rawArgs) {
-  std::vector<IdlValue> v;
-  v.reserve(sizeof...(rawArgs));
+  auto reply = UpdateTyped(method, std::forward<Args>(rawArgs)...);
+  if (reply.index() == 1) return std::get<1>(reply);
 
-  (..., v.emplace_back(IdlValue(std::forward<Args>(rawArgs))));
-
-  IdlArgs args(v);
-
-  return Update(method, std::move(args));
+  return decodeReply(method, std::get<0>(reply));
 }
 
 template <typename R, typename... Args, typename, typename, typename>
 std::variant<std::optional<R>, std::string> Agent::Update(
     const std::string &method, Args &&...rawArgs) {
-  auto result = Update(method, std::forward<Args>(rawArgs)...);
-
-  if (result.index() == 1) return std::get<1>(result);
+  auto reply = UpdateTyped(method, std::forward<Args>(rawArgs)...);
+  if (reply.index() == 1) return std::get<1>(reply);
 
-  auto returned_values = std::move(std::get<0>(result));
-  std::vector<IdlValue> values = std::move(returned_values.getVec());
+  return decodeReplyAs<R>(method, std::get<0>(reply));
+}
 
-  if (values.size() != 1) return std::nullopt;
+template <typename R>
+std::variant<std::optional<R>, std::string> Agent::Update(
+    const std::string &method, ArgWriter &&args) {
+  auto reply = UpdateBytes(method, std::move(args));
+  if (reply.index() == 1) return std::get<1>(reply);
 
-  return values[0].get<R>();
+  return decodeReplyAs<R>(method, std::get<0>(reply));
 }
 
 template <typename... RArgs, typename... Args, typename, typename, typename,
           typename>
 std::variant<std::optional<std::tuple<RArgs...>>, std::string> Agent::Update(
     const std::string &method, Args &&...rawArgs) {
-  auto result = Update(method, std::forward<Args>(rawArgs)...);
-
-  if (result.index() == 1) return std::get<1>(result);
-
-  auto returned_values = std::move(std::get<0>(result));
-  std::vector<IdlValue> values = std::move(returned_values.getVec());
-
-  if (values.size() != sizeof...(RArgs)) return std::nullopt;
-
-  std::tuple<RArgs...> tuple;
-  for (std::size_t i = 0; i < values.size(); ++i) {
-    IdlValue &val = values[i];
-    auto &loc = std::get<i>(tuple);
-
-    auto mby_converted = val.get<decltype(loc)>();
-    if (mby_converted.has_value()) {
-      loc = std::move(mby_converted.value());
-    } else {
-      return std::nullopt;
-    }
-  }
+  auto reply = UpdateTyped(method, std::forward<Args>(rawArgs)...);
+  if (reply.index() == 1) return std::get<1>(reply);
 
-  return std::make_optional(std::move(tuple));
+  return decodeReplyTuple<RArgs...>(method, std::get<0>(reply));
 }
 
 }  // namespace zondax
@@ -0,0 +1,231 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef ARG_WRITER_H
+#define ARG_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "blob.h"
+#include "candid.h"
+#include "idl_encoder.h"
+
+extern "C" {
+#include "zondax_ic.h"
+}
+
+namespace zondax {
+
+/**
+ * Encodes the arguments of a call straight into the buffer that is sent with
+ * the request, which is owned by the Rust library.
+ *
+ * The argument types are given up front, as the Candid header comes before
+ * the values. Values are then written in order, through a small staging
+ * buffer flushed as it fills up; blobs are copied in directly. A vector
+ * argument can be written element by element with `beginVec()` and
+ * `element()`, so large batches never need to exist as a whole on the C++
+ * side.
+ *
+ * ```
+ * auto writer = ArgWriter::create<std::vector<Row>>();
+ * writer.beginVec<Row>(rows);
+ * while (...) writer.element(row);
+ * agent.Update<R>("ingest", std::move(writer));
+ * ```
+ */
+class ArgWriter {
+ public:
+  /**
+   * @brief Starts a message whose arguments have types Ts.
+   *
+   * @param sizeHint Expected size of the message, reserved up front.
+   */
+  template <typename... Ts>
+  static ArgWriter create(std::size_t sizeHint = 0);
+
+  ArgWriter(const ArgWriter &) = delete;
+  ArgWriter &operator=(const ArgWriter &) = delete;
+  ArgWriter(ArgWriter &&o) noexcept;
+  ArgWriter &operator=(ArgWriter &&o) noexcept;
+  ~ArgWriter();
+
+  /**
+   * @brief Writes the next argument.
+   *
+   * @return false if T is not the type declared for it or the value can not
+   * be encoded, nothing is written then.
+   */
+  template <typename T>
+  bool arg(const T &value);
+
+  /**
+   * @brief Starts the next argument, a `std::vector<T>` of `count` elements
+   * given by `element()`.
+   */
+  template <typename T>
+  bool beginVec(std::size_t count);
+
+  /**
+   * @brief Writes the next element of the vector begun by `beginVec<T>()`.
+   */
+  template <typename T>
+  bool element(const T &value);
+
+  /**
+   * @brief Whether every argument has been written.
+   */
+  bool complete() const {
+    return buffer != nullptr && nextArg == argTypes.size() && pending == 0;
+  }
+
+  /**
+   * @brief Number of bytes written so far.
+   */
+  std::size_t size() const;
+
+  /**
+   * @brief Hands the message over, the writer is left empty.
+   *
+   * @return A variant containing the buffer, to be given to
+   * `agent_update_bytes_wrap` or freed with `cbytes_destroy`, or an error
+   * string if arguments are missing.
+   */
+  std::variant<CBytes *, std::string> release();
+
+ private:
+  // Staged bytes are handed to the buffer past this size
+  static constexpr std::size_t kFlushSize = 64 * 1024;
+
+  explicit ArgWriter(std::size_t sizeHint);
+
+  // Whether the next argument has type T, without touching the table
+  template <typename T>
+  bool nextIs();
+
+  template <typename T>
+  static const void *tag() {
+    static const char id = 0;
+    return &id;
+  }
+
+  void flush(bool force = false);
+
+  CBytes *buffer;
+  std::vector<uint8_t> staging;
+  candid::TypeTable table;
+  std::vector<candid::TypeRef> argTypes;
+  std::size_t nextArg;
+  // Elements left in the vector being written, and their type
+  std::size_t pending;
+  const void *elementTag;
+};
+
+template <typename... Ts>
+ArgWriter ArgWriter::create(std::size_t sizeHint) {
+  static_assert((helper::is_idl_encodable_v<Ts> && ...),
+                "Type can not be encoded, an IdlEncode specialization is "
+                "missing");
+
+  ArgWriter writer(sizeHint);
+  (writer.argTypes.push_back(IdlEncode<Ts>::type(writer.table)), ...);
+
+  auto &out = writer.staging;
+  out.insert(out.end(), std::begin(candid::kMagic), std::end(candid::kMagic));
+  writer.table.write(out);
+  candid::writeLeb128(out, writer.argTypes.size());
+  for (auto type : writer.argTypes) candid::writeSleb128(out, type);
+
+  return writer;
+}
+
+template <typename T>
+bool ArgWriter::nextIs() {
+  if (buffer == nullptr || pending != 0 || nextArg >= argTypes.size())
+    return false;
+
+  auto tableSize = table.size();
+  auto type = IdlEncode<T>::type(table);
+  bool same = table.size() == tableSize && type == argTypes[nextArg];
+  table.truncate(tableSize);
+  return same;
+}
+
+template <typename T>
+bool ArgWriter::arg(const T &value) {
+  static_assert(helper::is_idl_encodable_v<T>,
+                "Type can not be encoded, an IdlEncode specialization is "
+                "missing");
+
+  if (!nextIs<T>()) return false;
+
+  if constexpr (std::is_same_v<T, BlobView> ||
+                std::is_same_v<T, std::vector<uint8_t>>) {
+    BlobView blob(value);
+    candid::writeLeb128(staging, blob.size());
+    if (blob.size() >= kFlushSize) {
+      flush(true);
+      cbytes_append(buffer, blob.data(), blob.size());
+    } else {
+      staging.insert(staging.end(), blob.begin(), blob.end());
+    }
+  } else {
+    auto stagedSize = staging.size();
+    if (!IdlEncode<T>::write(staging, value)) {
+      staging.resize(stagedSize);
+      return false;
+    }
+  }
+
+  ++nextArg;
+  flush();
+  return true;
+}
+
+template <typename T>
+bool ArgWriter::beginVec(std::size_t count) {
+  if (!nextIs<std::vector<T>>()) return false;
+
+  candid::writeLeb128(staging, count);
+  ++nextArg;
+  pending = count;
+  elementTag = tag<T>();
+  return true;
+}
+
+template <typename T>
+bool ArgWriter::element(const T &value) {
+  if (buffer == nullptr || pending == 0 || elementTag != tag<T>())
+    return false;
+
+  auto stagedSize = staging.size();
+  if (!IdlEncode<T>::write(staging, value)) {
+    staging.resize(stagedSize);
+    return false;
+  }
+
+  --pending;
+  flush();
+  return true;
+}
+
+}  // namespace zondax
+
+#endif  // ARG_WRITER_H
@@ -0,0 +1,67 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef BLOB_H
+#define BLOB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace zondax {
+
+/**
+ * Non owning view of a byte string, sent and read as a Candid blob
+ * (`vec nat8`) in one copy instead of one value per byte.
+ *
+ * It stands for `std::span<const uint8_t>`, which is not available in C++17.
+ * The viewed bytes must outlive the view.
+ */
+class BlobView {
+ public:
+  BlobView() : ptr(nullptr), len(0) {}
+  BlobView(const uint8_t *data, std::size_t size) : ptr(data), len(size) {}
+  BlobView(const std::vector<uint8_t> &bytes)
+      : ptr(bytes.data()), len(bytes.size()) {}
+  BlobView(std::string_view bytes)
+      : ptr(reinterpret_cast<const uint8_t *>(bytes.data())),
+        len(bytes.size()) {}
+
+  const uint8_t *data() const { return ptr; }
+  std::size_t size() const { return len; }
+  bool empty() const { return len == 0; }
+
+  const uint8_t *begin() const { return ptr; }
+  const uint8_t *end() const { return ptr + len; }
+
+  const uint8_t &operator[](std::size_t i) const { return ptr[i]; }
+
+  std::string_view asString() const {
+    return std::string_view(reinterpret_cast<const char *>(ptr), len);
+  }
+
+  std::vector<uint8_t> toVector() const {
+    return std::vector<uint8_t>(begin(), end());
+  }
+
+ private:
+  const uint8_t *ptr;
+  std::size_t len;
+};
+
+}  // namespace zondax
+
+#endif  // BLOB_H
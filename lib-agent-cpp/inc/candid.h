@@ -0,0 +1,397 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef CANDID_H
+#define CANDID_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "leb128.h"
+
+/**
+ * Building blocks of the Candid binary format, shared by the native encoder
+ * and decoder.
+ *
+ * See https://github.com/dfinity/candid/blob/master/spec/Candid.md
+ */
+namespace zondax::candid {
+
+/**
+ * Magic bytes every Candid message starts with.
+ */
+inline constexpr char kMagic[4] = {'D', 'I', 'D', 'L'};
+
+/**
+ * Type opcodes, written as SLEB128 in type references and type table entries.
+ */
+enum class Opcode : int64_t {
+  Null = -1,
+  Bool = -2,
+  Nat = -3,
+  Int = -4,
+  Nat8 = -5,
+  Nat16 = -6,
+  Nat32 = -7,
+  Nat64 = -8,
+  Int8 = -9,
+  Int16 = -10,
+  Int32 = -11,
+  Int64 = -12,
+  Float32 = -13,
+  Float64 = -14,
+  Text = -15,
+  Reserved = -16,
+  Empty = -17,
+  Opt = -18,
+  Vec = -19,
+  Record = -20,
+  Variant = -21,
+  Func = -22,
+  Service = -23,
+  Principal = -24,
+};
+
+/**
+ * A reference to a type: a negative opcode for primitive types or the index of
+ * an entry in the type table.
+ */
+using TypeRef = int64_t;
+
+inline constexpr TypeRef ref(Opcode op) { return static_cast<TypeRef>(op); }
+
+/**
+ * Hashes a field or variant label, labels are sorted and compared by hash.
+ */
+inline constexpr uint32_t idl_hash(std::string_view label) {
+  uint32_t h = 0;
+  for (char c : label) h = h * 223 + static_cast<uint8_t>(c);
+  return h;
+}
+
+/**
+ * Sorts label positions by hash, the order fields and variant alternatives
+ * take in the type table.
+ */
+template <std::size_t N>
+constexpr std::array<std::size_t, N> sortByHash(
+    const std::array<uint32_t, N> &hashes) {
+  std::array<std::size_t, N> order{};
+  for (std::size_t i = 0; i < N; ++i) order[i] = i;
+
+  // insertion sort, N is small and std::sort is not constexpr in C++17
+  for (std::size_t i = 1; i < N; ++i) {
+    for (std::size_t j = i; j > 0 && hashes[order[j]] < hashes[order[j - 1]];
+         --j) {
+      auto tmp = order[j];
+      order[j] = order[j - 1];
+      order[j - 1] = tmp;
+    }
+  }
+
+  return order;
+}
+
+/**
+ * Finds a label among N known at compile time, like the alternatives of a
+ * variant type: the hashes are sorted once, at compile time, and searched by
+ * bisection.
+ */
+template <std::size_t N>
+struct LabelIndex {
+  std::array<uint32_t, N> hashes{};
+  std::array<std::size_t, N> positions{};
+
+  constexpr explicit LabelIndex(const std::array<uint32_t, N> &labels) {
+    auto order = sortByHash(labels);
+    for (std::size_t i = 0; i < N; ++i) {
+      hashes[i] = labels[order[i]];
+      positions[i] = order[i];
+    }
+  }
+
+  // The position of the label in the list given, N if it is not there
+  constexpr std::size_t find(uint32_t hash) const {
+    std::size_t low = 0;
+    std::size_t high = N;
+    while (low < high) {
+      auto middle = low + (high - low) / 2;
+      if (hashes[middle] < hash) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    return low < N && hashes[low] == hash ? positions[low] : N;
+  }
+};
+
+inline void writeLeb128(std::vector<uint8_t> &out, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value != 0) byte |= 0x80;
+    out.push_back(byte);
+  } while (value != 0);
+}
+
+inline void writeSleb128(std::vector<uint8_t> &out, int64_t value) {
+  bool more = true;
+  while (more) {
+    uint8_t byte = value & 0x7f;
+    // arithmetic shift, keeps the sign
+    value >>= 7;
+    if ((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40))) {
+      more = false;
+    } else {
+      byte |= 0x80;
+    }
+    out.push_back(byte);
+  }
+}
+
+/**
+ * Appends `value` in little endian, as fixed size numbers are encoded.
+ */
+template <typename T>
+inline void writeFixed(std::vector<uint8_t> &out, T value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  uint8_t bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  std::reverse(bytes, bytes + sizeof(T));
+#endif
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+/**
+ * Encodes an arbitrary precision decimal number, as held by `zondax::Number`.
+ *
+ * @param out Where the LEB128 (nat) or SLEB128 (int) bytes are appended.
+ * @param decimal The number, optionally signed and with `_` separators.
+ * @param isSigned Whether to encode an int rather than a nat.
+ * @return false if `decimal` is not a valid number, `out` is left unchanged.
+ */
+bool writeBigNumber(std::vector<uint8_t> &out, std::string_view decimal,
+                    bool isSigned);
+
+/**
+ * Bounds checked cursor over an encoded message. Every read returns false,
+ * leaving the output untouched, when the data is exhausted or malformed.
+ */
+class Reader {
+ public:
+  Reader() : data(nullptr), size(0), pos(0) {}
+  Reader(const uint8_t *data, std::size_t size)
+      : data(data), size(size), pos(0) {}
+
+  std::size_t remaining() const { return size - pos; }
+  std::size_t position() const { return pos; }
+
+  bool readByte(uint8_t &out) {
+    if (pos >= size) return false;
+    out = data[pos++];
+    return true;
+  }
+
+  bool readLeb128(uint64_t &out) {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      uint8_t byte;
+      if (!readByte(byte)) return false;
+      // the last group only has room for one bit
+      if (shift == 63 && (byte & 0x7e)) return false;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        out = value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readSleb128(int64_t &out) {
+    uint64_t value = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do {
+      if (shift >= 64 || !readByte(byte)) return false;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+
+    if (shift < 64 && (byte & 0x40)) value |= ~uint64_t(0) << shift;
+    out = static_cast<int64_t>(value);
+    return true;
+  }
+
+  template <typename T>
+  bool readFixed(T &out) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (remaining() < sizeof(T)) return false;
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, data + pos, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::reverse(bytes, bytes + sizeof(T));
+#endif
+    std::memcpy(&out, bytes, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+
+  /**
+   * @brief Borrows the next `len` bytes.
+   */
+  bool readBytes(std::size_t len, const uint8_t *&out) {
+    if (remaining() < len) return false;
+    out = data + pos;
+    pos += len;
+    return true;
+  }
+
+  bool skip(std::size_t len) {
+    if (remaining() < len) return false;
+    pos += len;
+    return true;
+  }
+
+  /**
+   * @brief Moves to an absolute position, at most the end of the data.
+   */
+  bool seek(std::size_t position) {
+    if (position > size) return false;
+    pos = position;
+    return true;
+  }
+
+  /**
+   * @brief Reads up to `count` LEB128 numbers that fit in 64 bits.
+   *
+   * @return How many were read, reading stops before a truncated or larger
+   * number.
+   */
+  std::size_t readLeb128Bulk(uint64_t *out, std::size_t count) {
+    std::size_t read;
+    auto n = leb128::decodeUnsigned(data + pos, size - pos, out, count, read);
+    pos += read;
+    return n;
+  }
+
+  std::size_t readSleb128Bulk(int64_t *out, std::size_t count) {
+    std::size_t read;
+    auto n = leb128::decodeSigned(data + pos, size - pos, out, count, read);
+    pos += read;
+    return n;
+  }
+
+  /**
+   * @brief Skips `count` LEB128 or SLEB128 numbers of any size.
+   */
+  bool skipLeb128(std::size_t count) {
+    std::size_t read;
+    if (!leb128::skip(data + pos, size - pos, count, read)) return false;
+    pos += read;
+    return true;
+  }
+
+ private:
+  const uint8_t *data;
+  std::size_t size;
+  std::size_t pos;
+};
+
+// Longest encoding of a nat or int accepted when decoding, about 9800 digits.
+// The conversion to decimal is quadratic in the length, so a reply holding a
+// huge number could otherwise keep the decoder busy for a long time.
+constexpr std::size_t kMaxBigNumberBytes = 4096;
+
+/**
+ * Decodes an arbitrary precision LEB128 (nat) or SLEB128 (int) number into its
+ * decimal representation, as held by `zondax::Number`.
+ *
+ * @return false if the number is truncated or longer than
+ * `kMaxBigNumberBytes`.
+ */
+bool readBigNumber(Reader &in, bool isSigned, std::string &out);
+
+/**
+ * The type table of a message being encoded.
+ *
+ * Composite types get an entry, structurally equal types share it. Entries
+ * are numbered in pre-order, the index of a type is reserved before its
+ * components are added, which is the layout the reference implementation
+ * produces.
+ */
+class TypeTable {
+ public:
+  TypeTable() = default;
+
+  /**
+   * @brief Reserves the index of the composite type about to be described.
+   */
+  std::size_t reserve();
+
+  /**
+   * @brief Sets the entry of a reserved index.
+   *
+   * If an equal entry already exists the reservation is dropped and the
+   * existing index returned instead.
+   *
+   * @param index The reserved index.
+   * @param entry The entry bytes: the opcode followed by its components.
+   * @return The reference to use for the type.
+   */
+  TypeRef commit(std::size_t index, const std::vector<uint8_t> &entry);
+
+  /**
+   * @brief Number of entries.
+   */
+  std::size_t size() const { return entries.size(); }
+
+  /**
+   * @brief Drops every entry from `size` on.
+   */
+  void truncate(std::size_t size);
+
+  /**
+   * @brief Appends the table, as written in the message header.
+   */
+  void write(std::vector<uint8_t> &out) const;
+
+  void clear();
+
+ private:
+  std::vector<std::string> entries;
+  std::unordered_map<std::string, std::size_t> indexes;
+};
+
+/**
+ * Appends a message header: the magic bytes, the type table and the types of
+ * the arguments. The values follow it.
+ */
+void writeHeader(std::vector<uint8_t> &out, const TypeTable &table,
+                 const TypeRef *argTypes, std::size_t count);
+
+}  // namespace zondax::candid
+
+#endif  // CANDID_H
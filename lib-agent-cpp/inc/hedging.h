@@ -0,0 +1,168 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef HEDGING_H
+#define HEDGING_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace zondax {
+
+/**
+ * @brief Controls how queries are hedged across the agent endpoints.
+ *
+ * With hedging enabled, a query is sent to the fastest known endpoint and, if
+ * no answer arrived after the hedge delay, a duplicate is sent to the next
+ * endpoint. The first valid answer wins, a failed attempt triggers the next
+ * one right away. Only queries are hedged, as they have no side effects.
+ */
+struct HedgePolicy {
+  // Whether queries are hedged at all, requires at least two endpoints.
+  bool enabled = false;
+  // Delay before a duplicate request is sent when no percentile is known.
+  std::chrono::milliseconds delay{100};
+  // Use the p95 latency of the endpoint in flight as hedge delay once enough
+  // samples were collected.
+  bool adaptive = true;
+  // Maximum number of endpoints raced for a single query.
+  std::size_t maxAttempts = 2;
+  // Maximum number of threads running attempts, further attempts wait for a
+  // thread to be free.
+  std::size_t maxWorkers = 16;
+};
+
+/**
+ * @brief Keeps a sliding window of the latencies observed on an endpoint.
+ *
+ * This class is thread safe.
+ */
+class LatencyTracker {
+ public:
+  /**
+   * @brief Constructs a tracker.
+   *
+   * @param capacity Number of most recent samples kept.
+   * @param minSamples Samples required before percentiles are reported.
+   */
+  explicit LatencyTracker(std::size_t capacity = 128,
+                          std::size_t minSamples = 16);
+
+  // The inner mutex can not be copied or moved
+  LatencyTracker(const LatencyTracker &) = delete;
+  void operator=(const LatencyTracker &) = delete;
+
+  /**
+   * @brief Records the latency of a successful request.
+   */
+  void record(std::chrono::microseconds latency);
+
+  /**
+   * @brief Computes a percentile over the recorded window.
+   *
+   * @param p The percentile, in the range [0, 1].
+   * @return The latency or `std::nullopt` if there are not enough samples.
+   */
+  std::optional<std::chrono::microseconds> percentile(double p) const;
+
+ private:
+  mutable std::mutex mtx;
+  std::vector<int64_t> samples;
+  std::size_t capacity;
+  std::size_t minSamples;
+  std::size_t next;
+};
+
+/**
+ * @brief Races the attempts of a hedged query.
+ *
+ * Attempts run on worker threads owned by the hedger, which are reused
+ * between queries and only added when every worker is busy, up to
+ * `maxWorkers`; past it attempts are queued until a worker is free. An attempt
+ * that loses the race keeps running until it completes on its own, as a
+ * request in flight can not be cancelled; the destructor waits for those, so
+ * no attempt outlives its hedger.
+ *
+ * This class is thread safe.
+ */
+class QueryHedger {
+ public:
+  // Undecoded reply of an attempt, or an error message
+  using Outcome = std::variant<std::vector<uint8_t>, std::string>;
+  // Sends attempt `i`, attempts are numbered in the order they are launched
+  using Attempt = std::function<Outcome(std::size_t i)>;
+  // How long to wait for attempt `i` before launching the next one
+  using Delay = std::function<std::chrono::microseconds(std::size_t i)>;
+
+  explicit QueryHedger(std::size_t maxWorkers = HedgePolicy().maxWorkers)
+      : maxWorkers(std::max<std::size_t>(maxWorkers, 1)),
+        idle(0),
+        stopping(false) {}
+  ~QueryHedger();
+
+  // The workers refer to the hedger
+  QueryHedger(const QueryHedger &) = delete;
+  void operator=(const QueryHedger &) = delete;
+
+  /**
+   * @brief Runs up to `attempts` attempts and returns the first valid reply.
+   *
+   * The next attempt is launched when the ones in flight are slower than
+   * their delay, or right away when they all failed.
+   *
+   * @return The first reply, or the error of the last failed attempt when
+   * none succeeded.
+   */
+  Outcome race(std::size_t attempts, Attempt attempt, const Delay &delay);
+
+  /**
+   * @brief Number of worker threads started so far.
+   */
+  std::size_t workerCount();
+
+  /**
+   * @brief Sets the maximum number of worker threads. Workers already started
+   * past a lower maximum are kept.
+   */
+  void setMaxWorkers(std::size_t maxWorkers);
+
+ private:
+  void submit(std::function<void()> task);
+  void work();
+
+  std::mutex mtx;
+  std::condition_variable ready;
+  std::deque<std::function<void()>> tasks;
+  std::vector<std::thread> workers;
+  std::size_t maxWorkers;
+  // workers waiting for a task
+  std::size_t idle;
+  bool stopping;
+};
+
+}  // namespace zondax
+
+#endif  // HEDGING_H
@@ -0,0 +1,121 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef IDL_ARENA_H
+#define IDL_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace zondax {
+
+/**
+ * @brief Bump allocator for the values of a call, see `IdlTree`.
+ *
+ * Allocations are carved out of a caller provided buffer first, then out of
+ * chunks taken from an upstream resource, each twice as large as the one
+ * before. Nothing is freed one allocation at a time: `release()` drops
+ * everything at once, by returning the chunks and rewinding to the start of
+ * the buffer. When the buffer is large enough for a call, no chunk is taken
+ * and a call then a release never reach malloc.
+ *
+ * ```cpp
+ * alignas(std::max_align_t) static uint8_t buffer[1 << 20];
+ * zondax::IdlArena arena(buffer, sizeof(buffer));
+ * auto reply = agent.QueryTree("list", args, &arena);
+ * // ... read the reply, then drop it
+ * arena.release();
+ * ```
+ *
+ * An arena is a `std::pmr::memory_resource`; it is not thread safe.
+ */
+class IdlArena : public std::pmr::memory_resource {
+ public:
+  static constexpr std::size_t kDefaultChunk = 64 * 1024;
+
+  /**
+   * @brief An arena taking chunks from `upstream`, the first of `chunkSize`
+   * bytes.
+   */
+  explicit IdlArena(
+      std::size_t chunkSize = kDefaultChunk,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+
+  /**
+   * @brief An arena allocating from `buffer` before taking chunks from
+   * `upstream`. With `std::pmr::null_memory_resource()` as upstream, running
+   * out of buffer throws `std::bad_alloc`.
+   */
+  IdlArena(
+      void *buffer, std::size_t size,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+
+  IdlArena(const IdlArena &) = delete;
+  void operator=(const IdlArena &) = delete;
+
+  ~IdlArena() override { release(); }
+
+  /**
+   * @brief Frees every allocation, the values allocated from the arena must
+   * not be used anymore.
+   */
+  void release();
+
+  /**
+   * @brief Bytes handed out since the last release.
+   */
+  std::size_t used() const { return used_; }
+
+  /**
+   * @brief Chunks taken from upstream since the last release.
+   */
+  std::size_t chunks() const { return chunks_; }
+
+ private:
+  // Header of a chunk, followed by its bytes
+  struct Chunk {
+    Chunk *prev;
+    std::size_t size;
+  };
+
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+  // single allocations are only freed by release()
+  void do_deallocate(void *, std::size_t, std::size_t) override {}
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  // Moves to a chunk able to hold `bytes` aligned to `alignment`
+  void grow(std::size_t bytes, std::size_t alignment);
+
+  std::pmr::memory_resource *upstream;
+  uint8_t *buffer;
+  std::size_t bufferSize;
+  std::size_t nextChunk;
+
+  // the chunk being allocated from, null while in the buffer
+  Chunk *head;
+  uint8_t *cursor;
+  uint8_t *limit;
+
+  std::size_t used_;
+  std::size_t chunks_;
+};
+
+}  // namespace zondax
+
+#endif  // IDL_ARENA_H
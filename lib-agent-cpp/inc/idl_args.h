@@ -19,6 +19,9 @@
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <optional>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "idl_value.h"
@@ -48,6 +51,17 @@ class IdlArgs {
   // to represent a "void" return
   void ensureNonEmpty();
 
+  // Moves each value out and reads it as the matching type, in order
+  template <typename... Ts, std::size_t... Is>
+  std::optional<std::tuple<Ts...>> takeValues(std::index_sequence<Is...>) {
+    std::tuple<std::optional<Ts>...> values{
+        IdlValue(idl_args_take_value(ptr.get(), Is)).take<Ts>()...};
+
+    if (!(std::get<Is>(values).has_value() && ...)) return std::nullopt;
+    return std::make_optional<std::tuple<Ts...>>(
+        std::move(*std::get<Is>(values))...);
+  }
+
  public:
   // Disable copies, just move semantics
   IdlArgs(const IdlArgs &args) = delete;
@@ -72,9 +86,36 @@ class IdlArgs {
    */
   explicit IdlArgs(std::vector<zondax::IdlValue> &values);
 
-  std::string getText();
-  std::vector<uint8_t> getBytes();
+  std::string getText() const;
+  std::vector<uint8_t> getBytes() const;
   std::vector<zondax::IdlValue> getVec();
+  /**
+   * Moves the values out instead of copying them, leaving no values behind.
+   */
+  std::vector<zondax::IdlValue> takeVec() &&;
+
+  /**
+   * Moves the values out as a tuple, one value per type.
+   *
+   * @treturns The values, none if there are not as many values as types or a
+   * value can not be read as its type.
+   */
+  template <typename... Ts>
+  std::optional<std::tuple<Ts...>> takeTuple() && {
+    if (size() != sizeof...(Ts)) return std::nullopt;
+    return takeValues<Ts...>(std::index_sequence_for<Ts...>{});
+  }
+
+  /**
+   * Number of values.
+   */
+  std::size_t size() const;
+
+  /**
+   * Borrows the value at `index`, which must be less than `size()`, without
+   * copying it.
+   */
+  IdlValueRef operator[](std::size_t index) const;
 
   std::unique_ptr<IDLArgs> getPtr();
 };
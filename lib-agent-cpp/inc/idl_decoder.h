@@ -0,0 +1,710 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef IDL_DECODER_H
+#define IDL_DECODER_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "blob.h"
+#include "candid.h"
+#include "func.h"
+#include "idl_value.h"
+#include "principal.h"
+#include "service.h"
+
+namespace zondax {
+
+class IdlDecoder;
+class IdlTree;
+class IdlView;
+class IdlVisitor;
+
+/**
+ * Describes how values of type T are decoded from Candid, without going
+ * through IdlValue. Specializations provide:
+ *
+ * - `static std::optional<T> read(IdlDecoder &decoder, candid::TypeRef type)`,
+ *   which reads a value whose wire type is `type`, returning `std::nullopt`
+ *   if that type can not be decoded as T.
+ *
+ * The primary template is empty, meaning T is not supported.
+ */
+template <typename T, typename Enable = void>
+struct IdlDecode {};
+
+namespace helper {
+template <typename T, typename = void>
+struct is_idl_decodable : std::false_type {};
+
+template <typename T>
+struct is_idl_decodable<T, std::void_t<decltype(&IdlDecode<T>::read)>>
+    : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_idl_decodable_v = is_idl_decodable<T>::value;
+
+template <typename T, typename Fields>
+struct record_fields_decodable;
+
+template <typename T, typename... Fs>
+struct record_fields_decodable<T, std::tuple<Fs...>>
+    : std::bool_constant<(is_idl_decodable_v<record_member_t<T, Fs>> && ...)> {
+};
+
+// Records (see IdlRecordFields) whose members can all be decoded
+template <typename T, typename = void>
+struct is_record_decodable : std::false_type {};
+
+template <typename T>
+struct is_record_decodable<T, std::void_t<typename IdlRecordFields<T>::type>>
+    : record_fields_decodable<T, typename IdlRecordFields<T>::type> {};
+}  // namespace helper
+
+/**
+ * Decodes Candid messages straight into C++ values.
+ *
+ * The header (type table and argument types) is parsed once, then arguments
+ * are read in order with `arg<T>()`. Values are read in a single pass over
+ * the message, without FFI calls; a vector only allocates its own storage.
+ */
+class IdlDecoder {
+ public:
+  /**
+   * An entry of the type table. Record and variant fields are stored apart,
+   * `fieldCount` fields starting at `firstField`.
+   */
+  struct TypeEntry {
+    candid::Opcode op;
+    candid::TypeRef inner;
+    uint32_t firstField;
+    uint32_t fieldCount;
+  };
+
+  struct Field {
+    uint32_t hash;
+    candid::TypeRef type;
+  };
+
+  /**
+   * @brief Parses the header of a message.
+   *
+   * @param data The message, it must outlive the decoder.
+   * @param size The message length.
+   * @return A variant containing the decoder or an error string.
+   */
+  static std::variant<IdlDecoder, std::string> create(const uint8_t *data,
+                                                      std::size_t size);
+
+  /**
+   * @brief Decodes a full message.
+   *
+   * @tparam Ts The expected argument types.
+   * @param bytes The message.
+   * @return A variant containing the arguments or an error string.
+   */
+  template <typename... Ts>
+  static std::variant<std::tuple<Ts...>, std::string> decode(
+      const std::vector<uint8_t> &bytes);
+
+  /**
+   * @brief Number of arguments in the message.
+   */
+  std::size_t argCount() const { return argTypes.size(); }
+
+  /**
+   * @brief Reads the next argument.
+   *
+   * A missing argument is read as `std::nullopt` when T is an optional, as
+   * Candid allows trailing optional arguments to be left out.
+   *
+   * @return The value, or `std::nullopt` if it could not be decoded as T.
+   */
+  template <typename T>
+  std::optional<T> arg();
+
+  /**
+   * @brief Reads the next arguments, as many as types are given.
+   *
+   * @return The values, or `std::nullopt` if any could not be decoded.
+   */
+  template <typename... Ts>
+  std::optional<std::tuple<Ts...>> args();
+
+  /**
+   * @brief Views the next argument, without decoding it (see `IdlView`).
+   *
+   * The argument is checked to be well formed, then skipped.
+   *
+   * @return The view, or `std::nullopt` if there are no arguments left or the
+   * argument is malformed.
+   */
+  std::optional<IdlView> view();
+
+  /**
+   * @brief Reads the remaining arguments, reporting their values to a
+   * visitor as they are read (see `IdlVisitor`).
+   *
+   * When the visitor stops, the argument being visited is passed and the
+   * following ones are left to be read.
+   *
+   * @return An error string if the message is malformed, the visitor may
+   * have received part of it then. Nothing when the message was read or the
+   * visitor stopped.
+   */
+  std::optional<std::string> visit(IdlVisitor &visitor);
+
+  /**
+   * @brief Reads the remaining arguments into a tree (see `IdlTree`).
+   *
+   * @return An error string if the message is malformed.
+   */
+  std::optional<std::string> readTree(IdlTree &tree);
+
+  /******************** Used by IdlDecode ***********************/
+
+  candid::Reader &reader() { return in; }
+
+  /**
+   * @brief Gets the table entry of a composite type.
+   *
+   * @return The entry or `nullptr` if `type` is not a composite of type `op`.
+   */
+  const TypeEntry *entry(candid::TypeRef type, candid::Opcode op) const;
+
+  const Field &field(const TypeEntry &entry, std::size_t i) const {
+    return types->fields[entry.firstField + i];
+  }
+
+  /**
+   * @brief Skips a value, used for fields the C++ type does not have.
+   */
+  bool skip(candid::TypeRef type);
+
+  /**
+   * @brief Checks a vector length against the remaining bytes before its
+   * elements are read.
+   */
+  bool checkLength(candid::TypeRef type, uint64_t len) const;
+
+  /**
+   * @brief Size of the values of a type, if they all take the same.
+   *
+   * Sizes of the table entries are computed once with the header, sizes too
+   * large for any message saturate at `SIZE_MAX`.
+   */
+  std::optional<std::size_t> fixedSize(candid::TypeRef type) const;
+
+ private:
+  // Nesting allowed while reading values, wire types can be recursive
+  static constexpr std::size_t kMaxDepth = 512;
+
+  friend class IdlView;
+
+  // The type table, shared by a decoder with the cursors of its views
+  struct Types {
+    std::vector<TypeEntry> table;
+    std::vector<Field> fields;
+    // fixed size of the values of each entry, none when they vary
+    std::vector<std::optional<std::size_t>> sizes;
+  };
+
+  IdlDecoder()
+      : owned(std::make_unique<Types>()),
+        types(owned.get()),
+        nextArg(0),
+        depth(0) {}
+
+  // A cursor reading the message of `decoder` from `pos` on, with its types.
+  // Views read through cursors of their own, so they never move the decoder
+  // nor each other.
+  IdlDecoder(const IdlDecoder &decoder, std::size_t pos)
+      : in(decoder.in), types(decoder.types), nextArg(0), depth(0) {
+    in.seek(pos);
+  }
+
+  bool parseHeader(std::string &error);
+  bool validRef(candid::TypeRef type) const;
+  void computeSizes();
+
+  enum class Walked { Done, Stopped, Failed };
+  Walked walk(IdlVisitor &visitor, candid::TypeRef type);
+  bool buildTree(IdlTree &tree, candid::TypeRef type);
+
+  candid::Reader in;
+  // held apart, so that `types` stays valid when the decoder is moved
+  std::unique_ptr<Types> owned;
+  const Types *types;
+  std::vector<candid::TypeRef> argTypes;
+  std::size_t nextArg;
+  std::size_t depth;
+};
+
+#define IDL_DECODE_PRIMITIVE(T, opcode)                                   \
+  template <>                                                             \
+  struct IdlDecode<T> {                                                   \
+    static std::optional<T> read(IdlDecoder &decoder,                     \
+                                 candid::TypeRef type) {                  \
+      T value;                                                            \
+      if (type != candid::ref(candid::Opcode::opcode) ||                  \
+          !decoder.reader().readFixed(value))                             \
+        return std::nullopt;                                              \
+      return value;                                                       \
+    }                                                                     \
+  };
+
+IDL_DECODE_PRIMITIVE(uint8_t, Nat8)
+IDL_DECODE_PRIMITIVE(uint16_t, Nat16)
+IDL_DECODE_PRIMITIVE(uint32_t, Nat32)
+IDL_DECODE_PRIMITIVE(uint64_t, Nat64)
+IDL_DECODE_PRIMITIVE(int8_t, Int8)
+IDL_DECODE_PRIMITIVE(int16_t, Int16)
+IDL_DECODE_PRIMITIVE(int32_t, Int32)
+IDL_DECODE_PRIMITIVE(int64_t, Int64)
+IDL_DECODE_PRIMITIVE(float, Float32)
+IDL_DECODE_PRIMITIVE(double, Float64)
+
+#undef IDL_DECODE_PRIMITIVE
+
+template <>
+struct IdlDecode<bool> {
+  static std::optional<bool> read(IdlDecoder &decoder, candid::TypeRef type) {
+    uint8_t byte;
+    if (type != candid::ref(candid::Opcode::Bool) ||
+        !decoder.reader().readByte(byte) || byte > 1)
+      return std::nullopt;
+    return byte == 1;
+  }
+};
+
+template <>
+struct IdlDecode<std::monostate> {
+  static std::optional<std::monostate> read(IdlDecoder &,
+                                            candid::TypeRef type) {
+    if (type != candid::ref(candid::Opcode::Null)) return std::nullopt;
+    return std::monostate{};
+  }
+};
+
+template <>
+struct IdlDecode<std::string> {
+  static std::optional<std::string> read(IdlDecoder &decoder,
+                                         candid::TypeRef type) {
+    uint64_t len;
+    const uint8_t *bytes;
+    if (type != candid::ref(candid::Opcode::Text) ||
+        !decoder.reader().readLeb128(len) ||
+        !decoder.reader().readBytes(len, bytes))
+      return std::nullopt;
+    return std::string(reinterpret_cast<const char *>(bytes), len);
+  }
+};
+
+template <>
+struct IdlDecode<Number> {
+  static std::optional<Number> read(IdlDecoder &decoder,
+                                    candid::TypeRef type) {
+    bool isNat = type == candid::ref(candid::Opcode::Nat);
+    if (!isNat && type != candid::ref(candid::Opcode::Int)) return std::nullopt;
+
+    Number number;
+    if (!candid::readBigNumber(decoder.reader(), !isNat, number.value))
+      return std::nullopt;
+    return number;
+  }
+};
+
+namespace helper {
+// Reads the id of a principal, service or function reference
+inline bool read_principal_bytes(candid::Reader &in,
+                                 std::vector<uint8_t> &out) {
+  uint8_t flag;
+  uint64_t len;
+  const uint8_t *bytes;
+  // only transparent references are supported
+  if (!in.readByte(flag) || flag != 1 || !in.readLeb128(len) ||
+      !in.readBytes(len, bytes))
+    return false;
+  out.assign(bytes, bytes + len);
+  return true;
+}
+}  // namespace helper
+
+template <>
+struct IdlDecode<Principal> {
+  static std::optional<Principal> read(IdlDecoder &decoder,
+                                       candid::TypeRef type) {
+    std::vector<uint8_t> bytes;
+    if (type != candid::ref(candid::Opcode::Principal) ||
+        !helper::read_principal_bytes(decoder.reader(), bytes))
+      return std::nullopt;
+    return std::make_optional<Principal>(bytes);
+  }
+};
+
+template <>
+struct IdlDecode<Service> {
+  static std::optional<Service> read(IdlDecoder &decoder,
+                                     candid::TypeRef type) {
+    std::vector<uint8_t> bytes;
+    if (decoder.entry(type, candid::Opcode::Service) == nullptr ||
+        !helper::read_principal_bytes(decoder.reader(), bytes))
+      return std::nullopt;
+    return std::make_optional<Service>(Principal(bytes));
+  }
+};
+
+template <>
+struct IdlDecode<Func> {
+  static std::optional<Func> read(IdlDecoder &decoder, candid::TypeRef type) {
+    uint8_t flag;
+    std::vector<uint8_t> bytes;
+    if (decoder.entry(type, candid::Opcode::Func) == nullptr ||
+        !decoder.reader().readByte(flag) || flag != 1 ||
+        !helper::read_principal_bytes(decoder.reader(), bytes))
+      return std::nullopt;
+
+    auto method = IdlDecode<std::string>::read(
+        decoder, candid::ref(candid::Opcode::Text));
+    if (!method.has_value()) return std::nullopt;
+
+    return std::make_optional<Func>(Principal(bytes),
+                                    std::move(method.value()));
+  }
+};
+
+// A value that can not be read as T is read as null, as Candid's subtyping
+// rules for optionals require, once it was checked to be well formed.
+template <typename T>
+struct IdlDecode<std::optional<T>,
+                 std::enable_if_t<helper::is_idl_decodable_v<T>>> {
+  static std::optional<std::optional<T>> readOrNull(IdlDecoder &decoder,
+                                                    candid::TypeRef type) {
+    auto start = decoder.reader().position();
+    auto value = IdlDecode<T>::read(decoder, type);
+    if (value.has_value()) return std::make_optional(std::move(value));
+
+    if (!decoder.reader().seek(start) || !decoder.skip(type))
+      return std::nullopt;
+    return std::optional<T>();
+  }
+
+  static std::optional<std::optional<T>> read(IdlDecoder &decoder,
+                                              candid::TypeRef type) {
+    if (type == candid::ref(candid::Opcode::Null) ||
+        type == candid::ref(candid::Opcode::Reserved))
+      return std::optional<T>();
+
+    // a value of type T is also an opt T
+    auto opt = decoder.entry(type, candid::Opcode::Opt);
+    if (opt == nullptr) return readOrNull(decoder, type);
+
+    uint8_t flag;
+    if (!decoder.reader().readByte(flag) || flag > 1) return std::nullopt;
+    if (flag == 0) return std::optional<T>();
+
+    return readOrNull(decoder, opt->inner);
+  }
+};
+
+template <typename T>
+struct IdlDecode<std::vector<T>,
+                 std::enable_if_t<helper::is_idl_decodable_v<T>>> {
+  static std::optional<std::vector<T>> read(IdlDecoder &decoder,
+                                            candid::TypeRef type) {
+    auto vec = decoder.entry(type, candid::Opcode::Vec);
+    uint64_t len;
+    if (vec == nullptr || !decoder.reader().readLeb128(len) ||
+        !decoder.checkLength(vec->inner, len))
+      return std::nullopt;
+
+    std::vector<T> values;
+    values.reserve(len);
+
+    for (uint64_t i = 0; i < len; ++i) {
+      auto value = IdlDecode<T>::read(decoder, vec->inner);
+      if (!value.has_value()) return std::nullopt;
+      values.push_back(std::move(value.value()));
+    }
+
+    return std::make_optional(std::move(values));
+  }
+};
+
+// Vectors of nat or int are decoded in bulk
+template <>
+struct IdlDecode<std::vector<Number>> {
+  static std::optional<std::vector<Number>> read(IdlDecoder &decoder,
+                                                 candid::TypeRef type);
+};
+
+// Blobs are read in one copy, or viewed in the message
+template <>
+struct IdlDecode<BlobView> {
+  static std::optional<BlobView> read(IdlDecoder &decoder,
+                                      candid::TypeRef type) {
+    auto vec = decoder.entry(type, candid::Opcode::Vec);
+    uint64_t len;
+    const uint8_t *bytes;
+    if (vec == nullptr || vec->inner != candid::ref(candid::Opcode::Nat8) ||
+        !decoder.reader().readLeb128(len) ||
+        !decoder.reader().readBytes(len, bytes))
+      return std::nullopt;
+    return BlobView(bytes, len);
+  }
+};
+
+template <>
+struct IdlDecode<std::vector<uint8_t>> {
+  static std::optional<std::vector<uint8_t>> read(IdlDecoder &decoder,
+                                                  candid::TypeRef type) {
+    auto blob = IdlDecode<BlobView>::read(decoder, type);
+    if (!blob.has_value()) return std::nullopt;
+    return blob->toVector();
+  }
+};
+
+// Tuples are records whose labels are the field positions, fields unknown to
+// the tuple are skipped and missing ones are only allowed for optionals.
+template <typename... Ts>
+struct IdlDecode<std::tuple<Ts...>,
+                 std::enable_if_t<(helper::is_idl_decodable_v<Ts> && ...)>> {
+  using Fields = std::tuple<std::optional<Ts>...>;
+  using ReadFn = bool (*)(IdlDecoder &, candid::TypeRef, Fields &);
+
+  template <std::size_t I>
+  static bool readField(IdlDecoder &decoder, candid::TypeRef type,
+                        Fields &fields) {
+    using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+    std::get<I>(fields) = IdlDecode<T>::read(decoder, type);
+    return std::get<I>(fields).has_value();
+  }
+
+  // absent optional fields are null
+  template <std::size_t I>
+  static void fillAbsent(Fields &fields) {
+    using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+    if constexpr (helper::is_optional_v<T>) {
+      if (!std::get<I>(fields).has_value()) std::get<I>(fields).emplace();
+    }
+  }
+
+  template <std::size_t... Is>
+  static std::optional<std::tuple<Ts...>> readImpl(
+      IdlDecoder &decoder, candid::TypeRef type, std::index_sequence<Is...>) {
+    static constexpr std::array<ReadFn, sizeof...(Ts)> readers{
+        &readField<Is>...};
+
+    auto record = decoder.entry(type, candid::Opcode::Record);
+    if (record == nullptr) return std::nullopt;
+
+    Fields fields;
+    for (uint32_t i = 0; i < record->fieldCount; ++i) {
+      const auto &field = decoder.field(*record, i);
+      if (field.hash < readers.size()) {
+        if (!readers[field.hash](decoder, field.type, fields))
+          return std::nullopt;
+      } else if (!decoder.skip(field.type)) {
+        return std::nullopt;
+      }
+    }
+
+    (fillAbsent<Is>(fields), ...);
+
+    if (!(std::get<Is>(fields).has_value() && ...)) return std::nullopt;
+
+    return std::make_optional<std::tuple<Ts...>>(
+        std::move(*std::get<Is>(fields))...);
+  }
+
+  static std::optional<std::tuple<Ts...>> read(IdlDecoder &decoder,
+                                               candid::TypeRef type) {
+    return readImpl(decoder, type, std::index_sequence_for<Ts...>{});
+  }
+};
+
+// Records of the generated bindings. Wire fields and the field table are both
+// sorted by label id, so they are matched in one merge pass: fields unknown to
+// T are skipped and missing ones are only allowed for optionals.
+template <typename T>
+struct IdlDecode<T, std::enable_if_t<helper::is_record_decodable<T>::value>> {
+  using Fields = typename IdlRecordFields<T>::type;
+  static_assert(helper::record_ids_sorted<Fields>::value,
+                "Record fields must be listed by increasing label id");
+
+  template <typename F>
+  static bool readField(IdlDecoder &decoder, const IdlDecoder::TypeEntry &record,
+                        uint32_t &next, T &value) {
+    using M = helper::record_member_t<T, F>;
+
+    for (; next < record.fieldCount; ++next) {
+      const auto &field = decoder.field(record, next);
+      if (field.hash > F::id) break;
+
+      if (field.hash == F::id) {
+        ++next;
+        auto member = IdlDecode<M>::read(decoder, field.type);
+        if (!member.has_value()) return false;
+
+        value.*F::member = std::move(member.value());
+        return true;
+      }
+
+      if (!decoder.skip(field.type)) return false;
+    }
+
+    // absent optional fields are left null
+    return helper::is_optional_v<M>;
+  }
+
+  template <typename... Fs>
+  static std::optional<T> readImpl(IdlDecoder &decoder, candid::TypeRef type,
+                                   std::tuple<Fs...> *) {
+    auto record = decoder.entry(type, candid::Opcode::Record);
+    if (record == nullptr) return std::nullopt;
+
+    T value;
+    uint32_t next = 0;
+    if (!(readField<Fs>(decoder, *record, next, value) && ...))
+      return std::nullopt;
+
+    for (; next < record->fieldCount; ++next)
+      if (!decoder.skip(decoder.field(*record, next).type)) return std::nullopt;
+
+    return std::make_optional<T>(std::move(value));
+  }
+
+  static std::optional<T> read(IdlDecoder &decoder, candid::TypeRef type) {
+    return readImpl(decoder, type, static_cast<Fields *>(nullptr));
+  }
+};
+
+// Alternatives without fields are null
+template <typename T>
+struct IdlDecode<T, std::enable_if_t<helper::is_candid_variant_v<T> &&
+                                     std::is_empty_v<T>>> {
+  static std::optional<T> read(IdlDecoder &, candid::TypeRef type) {
+    if (type != candid::ref(candid::Opcode::Null) &&
+        type != candid::ref(candid::Opcode::Reserved))
+      return std::nullopt;
+    return T{};
+  }
+};
+
+template <typename... Ts>
+struct IdlDecode<
+    std::variant<Ts...>,
+    std::enable_if_t<((helper::is_candid_variant_v<Ts> &&
+                       helper::is_idl_decodable_v<Ts>) &&
+                      ...)>> {
+  using Variant = std::variant<Ts...>;
+  using ReadFn = std::optional<Variant> (*)(IdlDecoder &, candid::TypeRef);
+
+  template <std::size_t I>
+  static std::optional<Variant> readAlternative(IdlDecoder &decoder,
+                                                candid::TypeRef type) {
+    using T = std::variant_alternative_t<I, Variant>;
+    auto value = IdlDecode<T>::read(decoder, type);
+    if (!value.has_value()) return std::nullopt;
+    return std::make_optional<Variant>(std::in_place_index<I>,
+                                       std::move(value.value()));
+  }
+
+  template <std::size_t... Is>
+  static std::optional<Variant> readImpl(IdlDecoder &decoder,
+                                         candid::TypeRef type,
+                                         std::index_sequence<Is...>) {
+    static constexpr candid::LabelIndex<sizeof...(Ts)> labels{
+        {candid::idl_hash(Ts::__CANDID_VARIANT_NAME)...}};
+    static constexpr std::array<ReadFn, sizeof...(Ts)> readers{
+        &readAlternative<Is>...};
+
+    auto variant = decoder.entry(type, candid::Opcode::Variant);
+    uint64_t index;
+    if (variant == nullptr || !decoder.reader().readLeb128(index) ||
+        index >= variant->fieldCount)
+      return std::nullopt;
+
+    const auto &field = decoder.field(*variant, index);
+    auto alternative = labels.find(field.hash);
+    if (alternative == sizeof...(Ts)) return std::nullopt;
+
+    return readers[alternative](decoder, field.type);
+  }
+
+  static std::optional<Variant> read(IdlDecoder &decoder,
+                                     candid::TypeRef type) {
+    return readImpl(decoder, type, std::index_sequence_for<Ts...>{});
+  }
+};
+
+template <typename T>
+std::optional<T> IdlDecoder::arg() {
+  static_assert(helper::is_idl_decodable_v<T>,
+                "Type can not be decoded, an IdlDecode specialization is "
+                "missing");
+
+  if (nextArg >= argTypes.size()) {
+    if constexpr (helper::is_optional_v<T>) {
+      return std::make_optional<T>();
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  return IdlDecode<T>::read(*this, argTypes[nextArg++]);
+}
+
+template <typename... Ts>
+std::optional<std::tuple<Ts...>> IdlDecoder::args() {
+  // braced initialization, so the arguments are read in order
+  std::tuple<std::optional<Ts>...> values{arg<Ts>()...};
+
+  bool complete = std::apply(
+      [](const auto &...value) { return (value.has_value() && ...); }, values);
+  if (!complete) return std::nullopt;
+
+  return std::apply(
+      [](auto &...value) {
+        return std::make_optional<std::tuple<Ts...>>(std::move(*value)...);
+      },
+      values);
+}
+
+template <typename... Ts>
+std::variant<std::tuple<Ts...>, std::string> IdlDecoder::decode(
+    const std::vector<uint8_t> &bytes) {
+  auto created = create(bytes.data(), bytes.size());
+  if (created.index() == 1) return std::get<1>(created);
+
+  auto values = std::get<0>(created).args<Ts...>();
+  if (!values.has_value())
+    return std::string("Reply does not match the expected types");
+
+  return std::move(values.value());
+}
+
+}  // namespace zondax
+
+#endif  // IDL_DECODER_H
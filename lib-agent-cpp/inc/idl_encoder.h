@@ -0,0 +1,598 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef IDL_ENCODER_H
+#define IDL_ENCODER_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "blob.h"
+#include "candid.h"
+#include "func.h"
+#include "idl_value.h"
+#include "principal.h"
+#include "service.h"
+
+namespace zondax {
+
+/**
+ * Describes how values of type T are encoded in Candid, without going through
+ * IdlValue. Specializations provide:
+ *
+ * - `static candid::TypeRef type(candid::TypeTable &table)`, which adds the
+ *   type of T to the table (if it is a composite type) and returns a reference
+ *   to it.
+ * - `static bool write(std::vector<uint8_t> &out, const T &value)`, which
+ *   appends the encoded value and returns false if it can not be represented.
+ *
+ * The primary template is empty, meaning T is not supported.
+ */
+template <typename T, typename Enable = void>
+struct IdlEncode {};
+
+namespace helper {
+template <typename T, typename = void>
+struct is_idl_encodable : std::false_type {};
+
+template <typename T>
+struct is_idl_encodable<T, std::void_t<decltype(&IdlEncode<T>::type),
+                                       decltype(&IdlEncode<T>::write)>>
+    : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_idl_encodable_v = is_idl_encodable<T>::value;
+
+template <typename T, typename Fields>
+struct record_fields_encodable;
+
+template <typename T, typename... Fs>
+struct record_fields_encodable<T, std::tuple<Fs...>>
+    : std::bool_constant<(is_idl_encodable_v<record_member_t<T, Fs>> && ...)> {
+};
+
+// Records (see IdlRecordFields) whose members can all be encoded
+template <typename T, typename = void>
+struct is_record_encodable : std::false_type {};
+
+template <typename T>
+struct is_record_encodable<T, std::void_t<typename IdlRecordFields<T>::type>>
+    : record_fields_encodable<T, typename IdlRecordFields<T>::type> {};
+}  // namespace helper
+
+#define IDL_ENCODE_PRIMITIVE(T, opcode)                          \
+  template <>                                                    \
+  struct IdlEncode<T> {                                          \
+    static candid::TypeRef type(candid::TypeTable &) {           \
+      return candid::ref(candid::Opcode::opcode);                \
+    }                                                            \
+    static bool write(std::vector<uint8_t> &out, const T &value) { \
+      candid::writeFixed(out, value);                            \
+      return true;                                               \
+    }                                                            \
+  };
+
+IDL_ENCODE_PRIMITIVE(uint8_t, Nat8)
+IDL_ENCODE_PRIMITIVE(uint16_t, Nat16)
+IDL_ENCODE_PRIMITIVE(uint32_t, Nat32)
+IDL_ENCODE_PRIMITIVE(uint64_t, Nat64)
+IDL_ENCODE_PRIMITIVE(int8_t, Int8)
+IDL_ENCODE_PRIMITIVE(int16_t, Int16)
+IDL_ENCODE_PRIMITIVE(int32_t, Int32)
+IDL_ENCODE_PRIMITIVE(int64_t, Int64)
+IDL_ENCODE_PRIMITIVE(float, Float32)
+IDL_ENCODE_PRIMITIVE(double, Float64)
+
+#undef IDL_ENCODE_PRIMITIVE
+
+template <>
+struct IdlEncode<bool> {
+  static candid::TypeRef type(candid::TypeTable &) {
+    return candid::ref(candid::Opcode::Bool);
+  }
+  static bool write(std::vector<uint8_t> &out, bool value) {
+    out.push_back(value ? 1 : 0);
+    return true;
+  }
+};
+
+template <>
+struct IdlEncode<std::monostate> {
+  static candid::TypeRef type(candid::TypeTable &) {
+    return candid::ref(candid::Opcode::Null);
+  }
+  static bool write(std::vector<uint8_t> &, const std::monostate &) {
+    return true;
+  }
+};
+
+template <>
+struct IdlEncode<std::string> {
+  static candid::TypeRef type(candid::TypeTable &) {
+    return candid::ref(candid::Opcode::Text);
+  }
+  static bool write(std::vector<uint8_t> &out, const std::string &value) {
+    candid::writeLeb128(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+    return true;
+  }
+};
+
+// Number does not tell nat from int, it is encoded as int like the IdlValue
+// holding it would be.
+template <>
+struct IdlEncode<Number> {
+  static candid::TypeRef type(candid::TypeTable &) {
+    return candid::ref(candid::Opcode::Int);
+  }
+  static bool write(std::vector<uint8_t> &out, const Number &value) {
+    return candid::writeBigNumber(out, value.value, true);
+  }
+};
+
+template <>
+struct IdlEncode<Principal> {
+  static candid::TypeRef type(candid::TypeTable &) {
+    return candid::ref(candid::Opcode::Principal);
+  }
+  static bool write(std::vector<uint8_t> &out, const Principal &value) {
+    auto bytes = value.getBytes();
+    // 1 flags a transparent reference, followed by the id
+    out.push_back(1);
+    candid::writeLeb128(out, bytes.size());
+    out.insert(out.end(), bytes.begin(), bytes.end());
+    return true;
+  }
+};
+
+// Services and functions are typed without methods nor arguments, as their
+// signature is not known on the C++ side.
+template <>
+struct IdlEncode<Service> {
+  static candid::TypeRef type(candid::TypeTable &table) {
+    auto index = table.reserve();
+
+    std::vector<uint8_t> entry;
+    candid::writeSleb128(entry, candid::ref(candid::Opcode::Service));
+    candid::writeLeb128(entry, 0);
+
+    return table.commit(index, entry);
+  }
+  static bool write(std::vector<uint8_t> &out, const Service &value) {
+    return IdlEncode<Principal>::write(out, value.principal());
+  }
+};
+
+template <>
+struct IdlEncode<Func> {
+  static candid::TypeRef type(candid::TypeTable &table) {
+    auto index = table.reserve();
+
+    std::vector<uint8_t> entry;
+    candid::writeSleb128(entry, candid::ref(candid::Opcode::Func));
+    // arguments, results and annotations
+    candid::writeLeb128(entry, 0);
+    candid::writeLeb128(entry, 0);
+    candid::writeLeb128(entry, 0);
+
+    return table.commit(index, entry);
+  }
+  static bool write(std::vector<uint8_t> &out, const Func &value) {
+    out.push_back(1);
+    IdlEncode<Principal>::write(out, value.principal());
+    return IdlEncode<std::string>::write(out, value.method_name());
+  }
+};
+
+template <typename T>
+struct IdlEncode<std::optional<T>,
+                 std::enable_if_t<helper::is_idl_encodable_v<T>>> {
+  static candid::TypeRef type(candid::TypeTable &table) {
+    auto index = table.reserve();
+    auto inner = IdlEncode<T>::type(table);
+
+    std::vector<uint8_t> entry;
+    candid::writeSleb128(entry, candid::ref(candid::Opcode::Opt));
+    candid::writeSleb128(entry, inner);
+
+    return table.commit(index, entry);
+  }
+  static bool write(std::vector<uint8_t> &out, const std::optional<T> &value) {
+    if (!value.has_value()) {
+      out.push_back(0);
+      return true;
+    }
+    out.push_back(1);
+    return IdlEncode<T>::write(out, value.value());
+  }
+};
+
+template <typename T>
+struct IdlEncode<std::vector<T>,
+                 std::enable_if_t<helper::is_idl_encodable_v<T>>> {
+  static candid::TypeRef type(candid::TypeTable &table) {
+    auto index = table.reserve();
+    auto inner = IdlEncode<T>::type(table);
+
+    std::vector<uint8_t> entry;
+    candid::writeSleb128(entry, candid::ref(candid::Opcode::Vec));
+    candid::writeSleb128(entry, inner);
+
+    return table.commit(index, entry);
+  }
+  static bool write(std::vector<uint8_t> &out, const std::vector<T> &value) {
+    candid::writeLeb128(out, value.size());
+    for (const auto &elem : value)
+      if (!IdlEncode<T>::write(out, elem)) return false;
+    return true;
+  }
+};
+
+// Blobs are written in one copy
+template <>
+struct IdlEncode<BlobView> {
+  static candid::TypeRef type(candid::TypeTable &table) {
+    auto index = table.reserve();
+
+    std::vector<uint8_t> entry;
+    candid::writeSleb128(entry, candid::ref(candid::Opcode::Vec));
+    candid::writeSleb128(entry, candid::ref(candid::Opcode::Nat8));
+
+    return table.commit(index, entry);
+  }
+  static bool write(std::vector<uint8_t> &out, BlobView value) {
+    candid::writeLeb128(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+    return true;
+  }
+};
+
+template <>
+struct IdlEncode<std::vector<uint8_t>> : IdlEncode<BlobView> {};
+
+// Tuples are records whose labels are the field positions
+template <typename... Ts>
+struct IdlEncode<std::tuple<Ts...>,
+                 std::enable_if_t<(helper::is_idl_encodable_v<Ts> && ...)>> {
+  static candid::TypeRef type(candid::TypeTable &table) {
+    auto index = table.reserve();
+    std::array<candid::TypeRef, sizeof...(Ts)> fields{
+        IdlEncode<Ts>::type(table)...};
+
+    std::vector<uint8_t> entry;
+    candid::writeSleb128(entry, candid::ref(candid::Opcode::Record));
+    candid::writeLeb128(entry, fields.size());
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      candid::writeLeb128(entry, i);
+      candid::writeSleb128(entry, fields[i]);
+    }
+
+    return table.commit(index, entry);
+  }
+  static bool write(std::vector<uint8_t> &out, const std::tuple<Ts...> &value) {
+    return std::apply(
+        [&out](const auto &...fields) {
+          return (IdlEncode<std::decay_t<decltype(fields)>>::write(out,
+                                                                  fields) &&
+                  ...);
+        },
+        value);
+  }
+};
+
+// Records of the generated bindings, their field table is already sorted by
+// label id so fields are written in declaration order
+template <typename T>
+struct IdlEncode<T, std::enable_if_t<helper::is_record_encodable<T>::value>> {
+  using Fields = typename IdlRecordFields<T>::type;
+  static_assert(helper::record_ids_sorted<Fields>::value,
+                "Record fields must be listed by increasing label id");
+
+  template <typename... Fs>
+  static candid::TypeRef typeImpl(candid::TypeTable &table, std::tuple<Fs...> *) {
+    auto index = table.reserve();
+    std::array<candid::TypeRef, sizeof...(Fs)> fields{
+        IdlEncode<helper::record_member_t<T, Fs>>::type(table)...};
+    constexpr std::array<uint32_t, sizeof...(Fs)> ids{Fs::id...};
+
+    std::vector<uint8_t> entry;
+    candid::writeSleb128(entry, candid::ref(candid::Opcode::Record));
+    candid::writeLeb128(entry, fields.size());
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      candid::writeLeb128(entry, ids[i]);
+      candid::writeSleb128(entry, fields[i]);
+    }
+
+    return table.commit(index, entry);
+  }
+
+  template <typename... Fs>
+  static bool writeImpl(std::vector<uint8_t> &out, const T &value,
+                        std::tuple<Fs...> *) {
+    return (IdlEncode<helper::record_member_t<T, Fs>>::write(
+                out, value.*Fs::member) &&
+            ...);
+  }
+
+  static candid::TypeRef type(candid::TypeTable &table) {
+    return typeImpl(table, static_cast<Fields *>(nullptr));
+  }
+  static bool write(std::vector<uint8_t> &out, const T &value) {
+    return writeImpl(out, value, static_cast<Fields *>(nullptr));
+  }
+};
+
+// Alternatives without fields, like the ones generated for a variant case
+// with no payload, are null
+template <typename T>
+struct IdlEncode<T, std::enable_if_t<helper::is_candid_variant_v<T> &&
+                                     std::is_empty_v<T>>> {
+  static candid::TypeRef type(candid::TypeTable &) {
+    return candid::ref(candid::Opcode::Null);
+  }
+  static bool write(std::vector<uint8_t> &, const T &) { return true; }
+};
+
+template <typename... Ts>
+struct IdlEncode<
+    std::variant<Ts...>,
+    std::enable_if_t<((helper::is_candid_variant_v<Ts> &&
+                       helper::is_idl_encodable_v<Ts>) &&
+                      ...)>> {
+  // alternative indexes sorted by label hash
+  static constexpr auto kOrder = candid::sortByHash<sizeof...(Ts)>(
+      {candid::idl_hash(Ts::__CANDID_VARIANT_NAME)...});
+
+  static candid::TypeRef type(candid::TypeTable &table) {
+    using TypeFn = candid::TypeRef (*)(candid::TypeTable &);
+    constexpr std::array<TypeFn, sizeof...(Ts)> types{&IdlEncode<Ts>::type...};
+    constexpr std::array<uint32_t, sizeof...(Ts)> hashes{
+        candid::idl_hash(Ts::__CANDID_VARIANT_NAME)...};
+
+    auto index = table.reserve();
+    std::array<candid::TypeRef, sizeof...(Ts)> alternatives{};
+    for (auto i : kOrder) alternatives[i] = types[i](table);
+
+    std::vector<uint8_t> entry;
+    candid::writeSleb128(entry, candid::ref(candid::Opcode::Variant));
+    candid::writeLeb128(entry, alternatives.size());
+    for (auto i : kOrder) {
+      candid::writeLeb128(entry, hashes[i]);
+      candid::writeSleb128(entry, alternatives[i]);
+    }
+
+    return table.commit(index, entry);
+  }
+  static bool write(std::vector<uint8_t> &out,
+                    const std::variant<Ts...> &value) {
+    if (value.valueless_by_exception()) return false;
+
+    std::size_t position = 0;
+    while (kOrder[position] != value.index()) ++position;
+    candid::writeLeb128(out, position);
+
+    return std::visit(
+        [&out](const auto &alternative) {
+          return IdlEncode<std::decay_t<decltype(alternative)>>::write(
+              out, alternative);
+        },
+        value);
+  }
+};
+
+namespace helper {
+/**
+ * Whether T can be encoded with its full Candid type known from T alone.
+ * `Number` stands for both `nat` and `int`, so values holding one are only
+ * typed by the .did file, through IdlArgs.
+ */
+template <typename T, typename = void>
+struct is_idl_typed : std::bool_constant<is_idl_encodable_v<T>> {};
+
+template <>
+struct is_idl_typed<Number> : std::false_type {};
+
+template <typename T>
+struct is_idl_typed<std::optional<T>> : is_idl_typed<T> {};
+
+template <typename T>
+struct is_idl_typed<std::vector<T>> : is_idl_typed<T> {};
+
+template <typename... Ts>
+struct is_idl_typed<std::tuple<Ts...>>
+    : std::bool_constant<(is_idl_typed<Ts>::value && ...)> {};
+
+template <typename... Ts>
+struct is_idl_typed<std::variant<Ts...>>
+    : std::bool_constant<is_idl_encodable_v<std::variant<Ts...>> &&
+                         (is_idl_typed<Ts>::value && ...)> {};
+
+template <typename T, typename Fields>
+struct record_fields_typed;
+
+template <typename T, typename... Fs>
+struct record_fields_typed<T, std::tuple<Fs...>>
+    : std::bool_constant<(is_idl_typed<record_member_t<T, Fs>>::value && ...)> {
+};
+
+template <typename T>
+struct is_idl_typed<T, std::enable_if_t<is_record_encodable<T>::value>>
+    : record_fields_typed<T, typename IdlRecordFields<T>::type> {};
+
+template <typename T>
+inline constexpr bool is_idl_typed_v = is_idl_typed<T>::value;
+}  // namespace helper
+
+/**
+ * The header of the messages whose arguments have types Ts: the magic bytes,
+ * the type table and the argument types. It does not depend on the values, so
+ * it is compiled once per type list and a message then only costs its values.
+ *
+ * Field and alternative orders are resolved at compile time by the IdlEncode
+ * specializations, which leaves nothing but the values to write.
+ *
+ * ```cpp
+ * std::vector<uint8_t> out;
+ * EncodePlan<uint64_t, std::string>::get().encode(out, 42, name);
+ * ```
+ */
+template <typename... Ts>
+class EncodePlan {
+  static_assert((helper::is_idl_encodable_v<Ts> && ...),
+                "Type can not be encoded, an IdlEncode specialization is "
+                "missing");
+
+ public:
+  EncodePlan(const EncodePlan &) = delete;
+  EncodePlan &operator=(const EncodePlan &) = delete;
+
+  /**
+   * @brief The plan for Ts, compiled on first use and shared by every thread.
+   */
+  static const EncodePlan &get() {
+    static const EncodePlan plan;
+    return plan;
+  }
+
+  const std::vector<uint8_t> &header() const { return bytes; }
+
+  const std::array<candid::TypeRef, sizeof...(Ts)> &argTypes() const {
+    return types;
+  }
+
+  /**
+   * @brief Appends a message holding `values`.
+   *
+   * @return false if a value can not be encoded, `out` is then left as it was
+   * before the call.
+   */
+  bool encode(std::vector<uint8_t> &out, const Ts &...values) const {
+    auto size = out.size();
+    out.insert(out.end(), bytes.begin(), bytes.end());
+    if ((IdlEncode<Ts>::write(out, values) && ...)) return true;
+
+    out.resize(size);
+    return false;
+  }
+
+ private:
+  EncodePlan() {
+    candid::TypeTable table;
+    // braced initializers are evaluated in order, like IdlEncoder::arg calls
+    types = {IdlEncode<Ts>::type(table)...};
+    candid::writeHeader(bytes, table, types.data(), types.size());
+  }
+
+  std::vector<uint8_t> bytes;
+  std::array<candid::TypeRef, sizeof...(Ts)> types{};
+};
+
+/**
+ * Encodes Candid messages straight from C++ values.
+ *
+ * Arguments are appended one at a time, `finish` then assembles the message.
+ * The buffers are kept between messages, so an encoder reused through `clear`
+ * does not allocate once it has grown to the size of the messages.
+ *
+ * Types are derived from the C++ types rather than from the values, so
+ * `std::nullopt`, empty vectors and variants get their full type, where
+ * IdlValue would infer a narrower one.
+ */
+class IdlEncoder {
+ public:
+  IdlEncoder() = default;
+
+  /**
+   * @brief Appends an argument.
+   *
+   * @param value The argument, its type must have an IdlEncode specialization.
+   * @return false if the value can not be encoded, the encoder is then left as
+   * it was before the call.
+   */
+  template <typename T>
+  bool arg(const T &value);
+
+  /**
+   * @brief Assembles the message from the arguments appended so far.
+   *
+   * @return The message, valid until the encoder is modified.
+   */
+  const std::vector<uint8_t> &finish();
+
+  /**
+   * @brief Removes every argument, keeping the allocated buffers.
+   */
+  void clear();
+
+  /**
+   * @brief Encodes a full message, with the header of `EncodePlan<Args...>`.
+   *
+   * @param args The arguments.
+   * @return A variant containing the message or an error string.
+   */
+  template <typename... Args>
+  static std::variant<std::vector<uint8_t>, std::string> encode(
+      const Args &...args);
+
+ private:
+  candid::TypeTable table;
+  std::vector<candid::TypeRef> argTypes;
+  std::vector<uint8_t> values;
+  std::vector<uint8_t> message;
+};
+
+template <typename T>
+bool IdlEncoder::arg(const T &value) {
+  static_assert(helper::is_idl_encodable_v<T>,
+                "Type can not be encoded, an IdlEncode specialization is "
+                "missing");
+
+  auto tableSize = table.size();
+  auto valuesSize = values.size();
+
+  auto ref = IdlEncode<T>::type(table);
+  if (!IdlEncode<T>::write(values, value)) {
+    table.truncate(tableSize);
+    values.resize(valuesSize);
+    return false;
+  }
+
+  argTypes.push_back(ref);
+  return true;
+}
+
+template <typename... Args>
+std::variant<std::vector<uint8_t>, std::string> IdlEncoder::encode(
+    const Args &...args) {
+  const auto &plan = EncodePlan<Args...>::get();
+
+  std::vector<uint8_t> message;
+  message.reserve(plan.header().size() + 8 * sizeof...(Args));
+  if (!plan.encode(message, args...))
+    return std::string("Argument can not be encoded");
+
+  return message;
+}
+
+}  // namespace zondax
+
+#endif  // IDL_ENCODER_H
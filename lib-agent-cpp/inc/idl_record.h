@@ -0,0 +1,117 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef IDL_RECORD_H
+#define IDL_RECORD_H
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "candid.h"
+#include "idl_value.h"
+
+namespace zondax {
+
+/**
+ * @brief The fields of a record `IdlValue` whose type is only known at run
+ * time, see `IdlValue::getRecord()` and `IdlValue::FromRecord()`.
+ *
+ * Fields live in one vector sorted by label id, the order Candid sorts them
+ * in, and are found by binary search on the id or on the `candid::idl_hash`
+ * of a name. Names are not kept: a record crosses the FFI with id labels,
+ * which encode to the same bytes as the names they hash.
+ *
+ * ```cpp
+ * auto record = value.getRecord();
+ * if (auto *balance = record.find("balance"))
+ *   std::cout << balance->get<uint64_t>().value_or(0);
+ * ```
+ */
+class IdlRecord {
+ public:
+  struct Field {
+    uint32_t id;
+    IdlValue value;
+  };
+
+  using iterator = std::vector<Field>::iterator;
+  using const_iterator = std::vector<Field>::const_iterator;
+
+  IdlRecord() = default;
+  explicit IdlRecord(std::size_t capacity) { fields.reserve(capacity); }
+
+  /**
+   * @brief Sets a field, replacing the value of the field with the same label
+   * if there is one. Fields added by increasing id are appended.
+   */
+  IdlValue &set(uint32_t id, IdlValue value);
+  IdlValue &set(std::string_view name, IdlValue value) {
+    return set(candid::idl_hash(name), std::move(value));
+  }
+
+  /**
+   * @brief The value of a field, null if the record has no such field.
+   */
+  IdlValue *find(uint32_t id);
+  IdlValue *find(std::string_view name) { return find(candid::idl_hash(name)); }
+
+  bool contains(uint32_t id) const;
+  bool contains(std::string_view name) const {
+    return contains(candid::idl_hash(name));
+  }
+
+  /**
+   * @brief Moves the value of a field out of the record, removing the field.
+   */
+  std::optional<IdlValue> take(uint32_t id);
+  std::optional<IdlValue> take(std::string_view name) {
+    return take(candid::idl_hash(name));
+  }
+
+  std::size_t size() const { return fields.size(); }
+  bool empty() const { return fields.empty(); }
+  void reserve(std::size_t capacity) { fields.reserve(capacity); }
+
+  iterator begin() { return fields.begin(); }
+  iterator end() { return fields.end(); }
+  const_iterator begin() const { return fields.begin(); }
+  const_iterator end() const { return fields.end(); }
+
+ private:
+  friend class IdlValue;
+
+  // the first field whose id is not lower than `id`
+  const_iterator lowerBound(uint32_t id) const;
+  iterator lowerBound(uint32_t id);
+
+  std::vector<Field> fields;
+};
+
+template <>
+inline IdlValue::IdlValue(IdlRecord record) {
+  *this = FromRecord(std::move(record));
+}
+
+template <>
+inline std::optional<IdlRecord> IdlValue::getImpl(helper::tag_type<IdlRecord>) {
+  if (type() != IdlValueType::Record) return std::nullopt;
+  return getRecord();
+}
+
+}  // namespace zondax
+
+#endif  // IDL_RECORD_H
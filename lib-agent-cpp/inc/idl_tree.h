@@ -0,0 +1,510 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef IDL_TREE_H
+#define IDL_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "blob.h"
+#include "candid.h"
+#include "idl_value.h"
+#include "principal.h"
+
+namespace zondax {
+
+class IdlDecoder;
+
+/**
+ * Candid values held in C++, as a tree of tagged nodes.
+ *
+ * Where an `IdlValue` is a Rust box per node, reached through an FFI call on
+ * every access, a tree keeps all of its nodes in one array and all of its
+ * text, blobs and big numbers in one buffer. Nodes are laid out in pre-order,
+ * so the contents of a vector or a record directly follow it and a node
+ * records where its subtree ends. Building and reading a tree never crosses
+ * the FFI; it does when a call is made, as one Candid message, see
+ * `Agent::QueryTree`.
+ *
+ * A tree holds a list of values, the arguments or results of a call. Values
+ * are appended in order: composite values are begun, their contents
+ * appended, then ended.
+ *
+ * ```cpp
+ * zondax::IdlTree args;
+ * args.beginRecord()
+ *     .field("owner").principal(owner)
+ *     .field("subaccount").none()
+ *     .endRecord();
+ * args.add(uint64_t(10));
+ * ```
+ *
+ * A tree holds at most 4 GiB of nodes and of data.
+ */
+class IdlTree {
+  friend class IdlDecoder;
+
+ public:
+  class Ref;
+
+  IdlTree() : roots(0), pendingLabel(), valid(true) {}
+
+  /**
+   * @brief A tree allocating its nodes and data from `resource`, an
+   * `IdlArena` for instance, which must outlive it.
+   */
+  explicit IdlTree(std::pmr::memory_resource *resource)
+      : nodes(resource),
+        data(resource),
+        roots(0),
+        stack(resource),
+        pendingLabel(),
+        valid(true) {}
+
+  /******************** Building ***********************/
+
+  /**
+   * @brief Appends a bool, a fixed size number or a float.
+   */
+  template <typename T>
+  IdlTree &add(T value);
+
+  IdlTree &null();
+  IdlTree &reserved();
+  IdlTree &text(std::string_view value);
+  IdlTree &blob(BlobView value);
+
+  /**
+   * @brief Appends an arbitrary precision nat or int, numbers that fit in 64
+   * bits are held inline.
+   */
+  IdlTree &nat(const Number &value);
+  IdlTree &integer(const Number &value);
+
+  IdlTree &principal(BlobView bytes);
+  IdlTree &principal(const Principal &value) {
+    return principal(BlobView(value.getBytes()));
+  }
+  IdlTree &service(BlobView principal);
+  IdlTree &func(BlobView principal, std::string_view method);
+
+  /**
+   * @brief Appends an absent optional.
+   */
+  IdlTree &none();
+  /**
+   * @brief Begins a present optional, its value must be appended before
+   * `endOpt()`.
+   */
+  IdlTree &beginOpt();
+  IdlTree &endOpt();
+
+  IdlTree &beginVec();
+  IdlTree &endVec();
+
+  /**
+   * @brief Begins a record. Each value appended is labeled by the preceding
+   * `field()` call; values appended without one are numbered from 0 on, as
+   * the fields of a tuple. Fields may come in any order.
+   */
+  IdlTree &beginRecord();
+  IdlTree &field(uint32_t id);
+  IdlTree &field(std::string_view name) { return field(candid::idl_hash(name)); }
+  IdlTree &endRecord();
+
+  /**
+   * @brief Begins a variant holding the alternative `id`, its value must be
+   * appended before `endVariant()`.
+   */
+  IdlTree &beginVariant(uint32_t id);
+  IdlTree &beginVariant(std::string_view name) {
+    return beginVariant(candid::idl_hash(name));
+  }
+  IdlTree &endVariant();
+
+  void clear();
+
+  /******************** Reading ***********************/
+
+  /**
+   * @brief Number of values.
+   */
+  std::size_t size() const { return roots; }
+  bool empty() const { return roots == 0; }
+
+  class iterator;
+  iterator begin() const;
+  iterator end() const;
+
+  /**
+   * @brief The value at `i`, which must be less than `size()`.
+   */
+  Ref operator[](std::size_t i) const;
+
+  /******************** Conversions ***********************/
+
+  /**
+   * @brief Decodes a Candid message, as returned by `Agent::QueryRaw`.
+   *
+   * The tree is allocated from `resource`: from an `IdlArena`, decoding takes
+   * two allocations from it and the whole tree is freed with the arena.
+   *
+   * @return A variant containing the values or an error string.
+   */
+  static std::variant<IdlTree, std::string> decode(
+      const uint8_t *data, std::size_t size,
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+  static std::variant<IdlTree, std::string> decode(
+      const std::vector<uint8_t> &bytes,
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource()) {
+    return decode(bytes.data(), bytes.size(), resource);
+  }
+
+  /**
+   * @brief Encodes the values as a Candid message.
+   *
+   * Types are inferred from the values. The elements of a vector share one
+   * type, which absent optionals, empty vectors and variants holding other
+   * alternatives are merged into: `vec {null; opt 1}` is a `vec opt nat8`.
+   *
+   * @return A variant containing the message or an error string, if a
+   * composite value was left open or the elements of a vector have
+   * different types.
+   */
+  std::variant<std::vector<uint8_t>, std::string> encode() const;
+
+ private:
+  enum Flags : uint8_t {
+    // nat or int too large for 64 bits, held in decimal in the data buffer
+    kBig = 1,
+    // vec nat8 held in the data buffer
+    kBlob = 2,
+  };
+
+  struct Span {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  struct Children {
+    // one past the last node of the subtree
+    uint32_t end;
+    uint32_t count;
+  };
+
+  struct Node {
+    IdlValueType type() const { return static_cast<IdlValueType>(kind); }
+    // whether the node is followed by the nodes of its contents
+    bool composite() const {
+      switch (type()) {
+        case IdlValueType::Vec:
+          return !(flags & kBlob);
+        case IdlValueType::Opt:
+        case IdlValueType::Record:
+        case IdlValueType::Variant:
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    uint8_t kind;
+    uint8_t flags;
+    // field of a record or alternative of a variant this node is the value
+    // of
+    uint32_t label;
+    union {
+      bool b;
+      uint64_t nat;
+      int64_t integer;
+      float f32;
+      double f64;
+      Span span;
+      Children children;
+    };
+  };
+
+  static_assert(sizeof(Node) == 16);
+
+  class Encoder;
+
+  // Index of the node following the subtree of `index`. Values still being
+  // built end with the tree.
+  uint32_t next(uint32_t index) const {
+    const auto &node = nodes[index];
+    if (!node.composite()) return index + 1;
+    return std::min<uint32_t>(node.children.end, nodes.size());
+  }
+
+  Node &append(IdlValueType type, uint8_t flags = 0);
+  Span store(const void *data, std::size_t size);
+  IdlTree &leaf(IdlValueType type, Span span, uint8_t flags = 0);
+  IdlTree &beginComposite(IdlValueType type);
+  IdlTree &endComposite(IdlValueType type);
+
+  std::pmr::vector<Node> nodes;
+  std::pmr::vector<uint8_t> data;
+  std::size_t roots;
+
+  // composite values being built, and the label of the next value
+  std::pmr::vector<uint32_t> stack;
+  std::optional<uint32_t> pendingLabel;
+  // false once a value was ended without being begun
+  bool valid;
+};
+
+/**
+ * A value in a tree. It is a position, cheap to copy, valid as long as the
+ * tree is alive and unchanged.
+ */
+class IdlTree::Ref {
+  friend class IdlTree;
+
+ public:
+  /**
+   * @brief The type of the value. Blobs are vectors and absent optionals
+   * are `None`.
+   */
+  IdlValueType type() const { return node().type(); }
+
+  /**
+   * @brief The id of the record field or variant alternative this value is
+   * held by, 0 otherwise.
+   */
+  uint32_t label() const { return node().label; }
+
+  /**
+   * @brief Reads the value as T: bool, a fixed size number or float,
+   * `std::string`, `std::string_view`, `Number`, `std::monostate` (null),
+   * `Principal`, `BlobView` or `std::vector<uint8_t>` (blob).
+   *
+   * @return The value, or `std::nullopt` if it is not a T.
+   */
+  template <typename T>
+  std::optional<T> get() const;
+
+  std::optional<std::string_view> text() const;
+  std::optional<BlobView> blob() const;
+
+  /**
+   * @brief Whether the value is null, reserved or an absent optional.
+   */
+  bool isNull() const;
+
+  /**
+   * @brief The value of a present optional.
+   */
+  std::optional<Ref> opt() const;
+
+  /**
+   * @brief The alternative held by a variant, its id is its `label()`.
+   */
+  std::optional<Ref> variant() const;
+
+  /**
+   * @brief Looks a record field up by id or by name.
+   */
+  std::optional<Ref> field(uint32_t id) const;
+  std::optional<Ref> field(std::string_view name) const {
+    return field(candid::idl_hash(name));
+  }
+
+  /**
+   * @brief Number of elements of a vector (bytes of a blob) or fields of a
+   * record.
+   */
+  std::size_t size() const;
+
+  /**
+   * @brief The element or field at `i`, which must be less than `size()`.
+   * Vectors of scalars are indexed in constant time, other values by
+   * skipping the ones before.
+   */
+  Ref operator[](std::size_t i) const;
+
+  /**
+   * @brief The elements or fields, in the order they were added; none for
+   * blobs and scalars.
+   */
+  iterator begin() const;
+  iterator end() const;
+
+ private:
+  Ref(const IdlTree &tree, uint32_t index) : tree(&tree), index(index) {}
+
+  const Node &node() const { return tree->nodes[index]; }
+
+  std::optional<std::string_view> bytes(IdlValueType type) const;
+
+  const IdlTree *tree;
+  uint32_t index;
+};
+
+/**
+ * Iterates over the values of a tree or the contents of a value.
+ */
+class IdlTree::iterator {
+  friend class IdlTree;
+  friend class Ref;
+
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Ref;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = Ref;
+
+  Ref operator*() const { return Ref(*tree, index); }
+
+  iterator &operator++() {
+    index = tree->next(index);
+    return *this;
+  }
+
+  iterator operator++(int) {
+    auto prev = *this;
+    ++*this;
+    return prev;
+  }
+
+  bool operator==(const iterator &other) const { return index == other.index; }
+  bool operator!=(const iterator &other) const { return !(*this == other); }
+
+ private:
+  iterator(const IdlTree &tree, uint32_t index) : tree(&tree), index(index) {}
+
+  const IdlTree *tree;
+  uint32_t index;
+};
+
+namespace helper {
+// Node type of the fixed size values a tree holds inline
+template <typename T>
+struct tree_scalar : std::false_type {};
+
+#define TREE_SCALAR(T, type_)                               \
+  template <>                                               \
+  struct tree_scalar<T> : std::true_type {                  \
+    static constexpr IdlValueType type = IdlValueType::type_; \
+  };
+
+TREE_SCALAR(bool, Bool)
+TREE_SCALAR(uint8_t, Nat8)
+TREE_SCALAR(uint16_t, Nat16)
+TREE_SCALAR(uint32_t, Nat32)
+TREE_SCALAR(uint64_t, Nat64)
+TREE_SCALAR(int8_t, Int8)
+TREE_SCALAR(int16_t, Int16)
+TREE_SCALAR(int32_t, Int32)
+TREE_SCALAR(int64_t, Int64)
+TREE_SCALAR(float, Float32)
+TREE_SCALAR(double, Float64)
+
+#undef TREE_SCALAR
+}  // namespace helper
+
+template <typename T>
+IdlTree &IdlTree::add(T value) {
+  static_assert(helper::tree_scalar<T>::value,
+                "Only bools, fixed size numbers and floats are added as is");
+
+  auto &node = append(helper::tree_scalar<T>::type);
+  if constexpr (std::is_same_v<T, bool>) {
+    node.b = value;
+  } else if constexpr (std::is_same_v<T, float>) {
+    node.f32 = value;
+  } else if constexpr (std::is_same_v<T, double>) {
+    node.f64 = value;
+  } else if constexpr (std::is_signed_v<T>) {
+    node.integer = value;
+  } else {
+    node.nat = value;
+  }
+  return *this;
+}
+
+template <typename T>
+std::optional<T> IdlTree::Ref::get() const {
+  const auto &n = node();
+
+  if constexpr (helper::tree_scalar<T>::value) {
+    if (n.type() != helper::tree_scalar<T>::type) return std::nullopt;
+    if constexpr (std::is_same_v<T, bool>) {
+      return n.b;
+    } else if constexpr (std::is_same_v<T, float>) {
+      return n.f32;
+    } else if constexpr (std::is_same_v<T, double>) {
+      return n.f64;
+    } else if constexpr (std::is_signed_v<T>) {
+      return static_cast<T>(n.integer);
+    } else {
+      return static_cast<T>(n.nat);
+    }
+  } else if constexpr (std::is_same_v<T, std::string_view>) {
+    return text();
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    auto value = text();
+    if (!value.has_value()) return std::nullopt;
+    return std::string(value.value());
+  } else if constexpr (std::is_same_v<T, Number>) {
+    if (n.type() != IdlValueType::Nat && n.type() != IdlValueType::Int)
+      return std::nullopt;
+    if (n.flags & kBig) {
+      auto decimal = bytes(n.type());
+      return Number{std::string(decimal.value())};
+    }
+    return Number{n.type() == IdlValueType::Nat ? std::to_string(n.nat)
+                                                : std::to_string(n.integer)};
+  } else if constexpr (std::is_same_v<T, std::monostate>) {
+    if (n.type() != IdlValueType::Null) return std::nullopt;
+    return std::monostate{};
+  } else if constexpr (std::is_same_v<T, Principal>) {
+    auto id = bytes(IdlValueType::Principal);
+    if (!id.has_value()) return std::nullopt;
+    return std::make_optional<Principal>(BlobView(id.value()).toVector());
+  } else if constexpr (std::is_same_v<T, BlobView>) {
+    return blob();
+  } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+    if (auto view = blob()) return view->toVector();
+
+    // a vector of nat8 built element by element
+    if (n.type() != IdlValueType::Vec) return std::nullopt;
+    std::vector<uint8_t> values;
+    values.reserve(n.children.count);
+    for (auto elem : *this) {
+      auto byte = elem.get<uint8_t>();
+      if (!byte.has_value()) return std::nullopt;
+      values.push_back(byte.value());
+    }
+    return values;
+  } else {
+    static_assert(helper::tree_scalar<T>::value,
+                  "Type can not be read from an IdlTree");
+  }
+}
+
+}  // namespace zondax
+
+#endif  // IDL_TREE_H
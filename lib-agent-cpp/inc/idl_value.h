@@ -18,10 +18,12 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <string>
@@ -33,6 +35,8 @@
 #include <variant>
 #include <vector>
 
+#include "blob.h"
+#include "candid.h"
 #include "func.h"
 #include "idl_value_utils.h"
 #include "service.h"
@@ -131,15 +135,20 @@ inline std::ostream &operator<<(std::ostream &os, IdlValueType value) {
 
 namespace zondax {
 
-#define IDL_VALUE_PRIMITIVES(name, type)     \
-  template <>                                \
-  inline IdlValue::IdlValue(type value) {    \
-    ptr.reset(idl_value_with_##name(value)); \
+// Primitives are held inline, the Rust box is only made when needed
+#define IDL_VALUE_PRIMITIVES(kind, type)    \
+  template <>                               \
+  inline IdlValue::IdlValue(type value) {   \
+    setScalar(IdlValueType::kind, value);   \
   }
 
-#define PRIMITIVE_TYPES_GETTER(name, type)                                 \
+#define PRIMITIVE_TYPES_GETTER(name, kind, type)                             \
   template <>                                                              \
-  inline std::optional<type> IdlValue::getImpl(helper::tag_type<type> t) { \
+  inline std::optional<type> IdlValue::getImpl(helper::tag_type<type>) {   \
+    if (scalarType != IdlValueType::Invalid) {                             \
+      if (scalarType != IdlValueType::kind) return std::nullopt;           \
+      return scalarAs<type>();                                             \
+    }                                                                      \
     if (ptr == nullptr) return std::nullopt;                               \
     type value;                                                            \
     bool ret = name##_from_idl_value(ptr.get(), &value);                   \
@@ -189,6 +198,45 @@ struct is_vector : std::false_type {};
 template <typename T>
 struct is_vector<std::vector<T>> : std::true_type {};
 
+// FFI functions passing a vector of fixed size values as one contiguous
+// array, instead of one IDLValue per element
+template <typename T>
+struct contiguous_vec : std::false_type {};
+
+#define CONTIGUOUS_VEC(with, from, type)                             \
+  template <>                                                        \
+  struct contiguous_vec<type> : std::true_type {                     \
+    static IDLValue *make(const std::vector<type> &elems) {          \
+      return with(elems.data(), elems.size());                       \
+    }                                                                \
+    static CBytes *get(const IDLValue *ptr) { return from(ptr); }    \
+  };
+
+CONTIGUOUS_VEC(idl_value_with_blob, blob_from_idl_value, uint8_t)
+CONTIGUOUS_VEC(idl_value_with_vec_nat16, vec_nat16_from_idl_value, uint16_t)
+CONTIGUOUS_VEC(idl_value_with_vec_nat32, vec_nat32_from_idl_value, uint32_t)
+CONTIGUOUS_VEC(idl_value_with_vec_nat64, vec_nat64_from_idl_value, uint64_t)
+CONTIGUOUS_VEC(idl_value_with_vec_int8, vec_int8_from_idl_value, int8_t)
+CONTIGUOUS_VEC(idl_value_with_vec_int16, vec_int16_from_idl_value, int16_t)
+CONTIGUOUS_VEC(idl_value_with_vec_int32, vec_int32_from_idl_value, int32_t)
+CONTIGUOUS_VEC(idl_value_with_vec_int64, vec_int64_from_idl_value, int64_t)
+CONTIGUOUS_VEC(idl_value_with_vec_float32, vec_float32_from_idl_value, float)
+CONTIGUOUS_VEC(idl_value_with_vec_float64, vec_float64_from_idl_value, double)
+
+#undef CONTIGUOUS_VEC
+
+// std::vector<bool> is packed, so bools go through an array of bytes
+template <>
+struct contiguous_vec<bool> : std::true_type {
+  static IDLValue *make(const std::vector<bool> &elems) {
+    std::vector<uint8_t> bytes(elems.begin(), elems.end());
+    return idl_value_with_vec_bool(bytes.data(), bytes.size());
+  }
+  static CBytes *get(const IDLValue *ptr) {
+    return vec_bool_from_idl_value(ptr);
+  }
+};
+
 // A helper to convert a tuple to a variant
 template <typename T>
 struct tuple_to_variant;
@@ -275,8 +323,258 @@ struct Number {
   std::string value;
 };
 
+/**
+ * A field of a record type: the id of its Candid label (`candid::idl_hash` of
+ * its name, or its number) and the member holding it.
+ */
+template <uint32_t Id, auto Member>
+struct RecordField {
+  static constexpr uint32_t id = Id;
+  static constexpr auto member = Member;
+};
+
+/**
+ * The field table of a record type T, specialized by the generated bindings
+ * as `using type = std::tuple<RecordField<...>...>`. Fields are listed by
+ * increasing label id, the order Candid sorts them in, so records are encoded
+ * and decoded without looking labels up by name.
+ *
+ * The primary template is empty, meaning T is not a record.
+ */
+template <typename T>
+struct IdlRecordFields {};
+
+namespace helper {
+template <typename T, typename = void>
+struct is_idl_record : std::false_type {};
+
+template <typename T>
+struct is_idl_record<T, std::void_t<typename IdlRecordFields<T>::type>>
+    : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_idl_record_v = is_idl_record<T>::value;
+
+// Type of the member a RecordField refers to
+template <typename T, typename Field>
+using record_member_t =
+    std::remove_cv_t<std::remove_reference_t<decltype(std::declval<T &>().*
+                                                      Field::member)>>;
+
+template <typename Fields>
+struct record_ids_sorted;
+
+template <typename... Fs>
+struct record_ids_sorted<std::tuple<Fs...>> {
+  static constexpr bool check() {
+    constexpr std::array<uint32_t, sizeof...(Fs)> ids{Fs::id...};
+    for (std::size_t i = 1; i < ids.size(); ++i)
+      if (ids[i - 1] >= ids[i]) return false;
+    return true;
+  }
+  static constexpr bool value = check();
+};
+}  // namespace helper
+
+class IdlRecord;
+class IdlValue;
+
+/**
+ * Read only reference to a value held by an `IdlValue`, such as a record
+ * field or a vector element, see `IdlValue::fields()` and
+ * `IdlValue::elements()`. It does not own the value, which must outlive it,
+ * and is cheap to copy.
+ *
+ * Walking records and vectors, and reading numbers and text through a
+ * reference, allocates nothing.
+ */
+class IdlValueRef {
+ public:
+  struct Field;
+  class Fields;
+  class Elements;
+
+  explicit IdlValueRef(const IDLValue *ptr) : ptr(ptr) {}
+
+  IdlValueType type() const;
+
+  /**
+   * @brief Reads the value as `IdlValue::get<T>()` does, leaving it as it is.
+   * Tuples and generated records are read field by field in place.
+   */
+  template <typename T>
+  std::optional<T> get() const;
+
+  /**
+   * @brief Views a text value, which may contain NULs.
+   */
+  std::optional<std::string_view> text() const;
+
+  /**
+   * @brief The fields of a record, none if this is not a record.
+   */
+  Fields fields() const;
+
+  /**
+   * @brief The elements of a vector, none if this is not a vector.
+   */
+  Elements elements() const;
+
+ private:
+  const IDLValue *ptr;
+};
+
+/**
+ * A record field: the id of its label, the name of its label, empty when the
+ * label is an id, and its value.
+ */
+struct IdlValueRef::Field {
+  uint32_t id;
+  std::string_view name;
+  IdlValueRef value;
+};
+
+/**
+ * The fields of a record, in the order they are held.
+ */
+class IdlValueRef::Fields {
+  friend class IdlValueRef;
+
+ public:
+  class iterator {
+    friend class Fields;
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Field;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Field;
+
+    Field operator*() const {
+      uint32_t id = 0;
+      const uint8_t *name = nullptr;
+      uintptr_t nameLen = 0;
+      const IDLValue *value =
+          record_field_ref(ptr, index, &id, &name, &nameLen);
+
+      return Field{id,
+                   std::string_view(reinterpret_cast<const char *>(name),
+                                    nameLen),
+                   IdlValueRef(value)};
+    }
+
+    iterator &operator++() {
+      ++index;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      auto prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    bool operator==(const iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+   private:
+    iterator(const IDLValue *ptr, std::size_t index) : ptr(ptr), index(index) {}
+
+    const IDLValue *ptr;
+    std::size_t index;
+  };
+
+  std::size_t size() const { return len; }
+  bool empty() const { return len == 0; }
+
+  iterator begin() const { return iterator(ptr, 0); }
+  iterator end() const { return iterator(ptr, len); }
+
+ private:
+  explicit Fields(const IDLValue *ptr)
+      : ptr(ptr), len(ptr == nullptr ? 0 : record_fields_len(ptr)) {}
+
+  const IDLValue *ptr;
+  std::size_t len;
+};
+
+/**
+ * The elements of a vector.
+ */
+class IdlValueRef::Elements {
+  friend class IdlValueRef;
+
+ public:
+  class iterator {
+    friend class Elements;
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = IdlValueRef;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = IdlValueRef;
+
+    IdlValueRef operator*() const {
+      return IdlValueRef(vec_elem_ref(ptr, index));
+    }
+
+    iterator &operator++() {
+      ++index;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      auto prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    bool operator==(const iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+   private:
+    iterator(const IDLValue *ptr, std::size_t index) : ptr(ptr), index(index) {}
+
+    const IDLValue *ptr;
+    std::size_t index;
+  };
+
+  std::size_t size() const { return len; }
+  bool empty() const { return len == 0; }
+
+  iterator begin() const { return iterator(ptr, 0); }
+  iterator end() const { return iterator(ptr, len); }
+
+  /**
+   * @brief The element at `i`, which must be less than `size()`.
+   */
+  IdlValueRef operator[](std::size_t i) const {
+    return IdlValueRef(vec_elem_ref(ptr, i));
+  }
+
+ private:
+  explicit Elements(const IDLValue *ptr)
+      : ptr(ptr), len(ptr == nullptr ? 0 : vec_elems_len(ptr)) {}
+
+  const IDLValue *ptr;
+  std::size_t len;
+};
+
+inline IdlValueRef::Fields IdlValueRef::fields() const { return Fields(ptr); }
+
+inline IdlValueRef::Elements IdlValueRef::elements() const {
+  return Elements(ptr);
+}
+
 class IdlValue {
   friend class IdlArgs;
+  friend class IdlValueRef;
 
  private:
   template <typename T>
@@ -291,11 +589,116 @@ class IdlValue {
 
   std::unique_ptr<IDLValue> ptr;
 
+  // Bools, fixed size numbers, floats, null and reserved are held here
+  // instead of in a Rust box, which is only made when the value is handed to
+  // Rust. `scalarType` is Invalid when the value, if any, is in `ptr`.
+  IdlValueType scalarType = IdlValueType::Invalid;
+  union {
+    bool b;
+    uint64_t nat;
+    int64_t integer;
+    float f32;
+    double f64;
+  } scalar{};
+
+  // Set while take() reads the value: vectors, options, variants, records and
+  // maps are moved out of the Rust value instead of copied. Getters leave the
+  // value as it was otherwise.
+  bool taking = false;
+
+  template <typename T>
+  void setScalar(IdlValueType type, T value);
+  template <typename T>
+  T scalarAs() const;
+
+  // The Rust value, boxing an inline one first
+  IDLValue *raw();
+  // Hands the value over to Rust
+  IDLValue *release() {
+    raw();
+    return ptr.release();
+  }
+
+  // The elements of a Vec, moved out when taking
+  CIDLValuesVec *vecValues() {
+    if (ptr == nullptr) return nullptr;
+    return taking ? vec_take_from_idl_value(ptr.get())
+                  : vec_from_idl_value(ptr.get());
+  }
+
+  // Reads the elements of a Vec, each one is taken out of the vector
+  template <typename T>
+  std::optional<std::vector<T>> getElements() {
+    CIDLValuesVec *values = vecValues();
+    if (values == nullptr) return std::nullopt;
+
+    uintptr_t len = cidlval_vec_len(values);
+    std::vector<T> ret;
+    ret.reserve(len);
+
+    bool complete = true;
+    for (uintptr_t i = 0; i < len && complete; ++i) {
+      auto val = IdlValue(cidlval_vec_value_take(values, i)).take<T>();
+      complete = val.has_value();
+      if (complete) ret.emplace_back(std::move(val.value()));
+    }
+    cidlval_vec_destroy(values);
+
+    if (!complete) return std::nullopt;
+    return std::make_optional(std::move(ret));
+  }
+
   // Helper to initialize .ptr from an std::tuple-like set of items
   // used by IdlValue(std::tuple<Args...>) constructor
   template <typename Tuple, size_t... Indices>
   void initializeFromTuple(Tuple &tuple, std::index_sequence<Indices...>);
 
+  // The fields of the record held in a value, by position. When taking they
+  // are moved out of it, otherwise they are read in place and the value is
+  // left as it was, even if reading a field fails.
+  class RecordReader {
+   public:
+    RecordReader(IDLValue *value, bool taking);
+    RecordReader(const RecordReader &) = delete;
+    RecordReader &operator=(const RecordReader &) = delete;
+    ~RecordReader();
+
+    // Whether the value is a record
+    bool valid() const { return record != nullptr; }
+    std::size_t size() const { return len; }
+    uint32_t id(std::size_t i) const;
+
+    // Reads the i-th field, each field is read at most once
+    template <typename T>
+    std::optional<T> read(std::size_t i);
+    IdlValue value(std::size_t i);
+
+   private:
+    const IDLValue *record = nullptr;
+    // the moved out fields, only when taking
+    CRecord *fields = nullptr;
+    const uint32_t *ids = nullptr;
+    std::size_t len = 0;
+  };
+
+  // Helpers for the records described by IdlRecordFields<T>, used by the
+  // generated constructor and getter specializations. Labels cross the FFI as
+  // ids, the field names are never built.
+  template <typename T>
+  void initializeFromRecord(T &record) {
+    initializeFromRecord(
+        record, static_cast<typename IdlRecordFields<T>::type *>(nullptr));
+  }
+  template <typename T>
+  std::optional<T> getFromRecord() {
+    return getFromRecord<T>(
+        static_cast<typename IdlRecordFields<T>::type *>(nullptr));
+  }
+  template <typename T, typename... Fs>
+  void initializeFromRecord(T &record, std::tuple<Fs...> *);
+  template <typename T, typename... Fs>
+  std::optional<T> getFromRecord(std::tuple<Fs...> *);
+
   /**
    * Generic method meant to be specialized by users that wants to support their
    * custom types, and equivalent specialization must exist for constructors.
@@ -313,29 +716,7 @@ class IdlValue {
   template <typename... Args>
   std::optional<std::vector<std::tuple<Args...>>> getImpl(
       helper::tag_type<std::vector<std::tuple<Args...>>>) {
-    auto values_vec = vec_from_idl_value(ptr.get());
-
-    if (values_vec == nullptr) return std::nullopt;
-
-    auto vec_len = cidlval_vec_len(values_vec);
-    std::vector<std::tuple<Args...>> ret;
-
-    for (int i = 0; i < vec_len; ++i) {
-      auto p = cidlval_vec_value_take(values_vec, i);
-
-      if (p == nullptr) return std::nullopt;
-
-      IdlValue value(p);
-      auto val = value.get<std::tuple<Args...>>();
-
-      if (!val.has_value()) return std::nullopt;
-
-      ret.emplace_back(std::move(val.value()));
-    }
-
-    cidlval_vec_destroy(values_vec);
-
-    return ret;
+    return getElements<std::tuple<Args...>>();
   }
 
   template <typename Vec,
@@ -346,21 +727,33 @@ class IdlValue {
   std::optional<Vec> getImpl(helper::tag_type<Vec>) {
     using T = typename helper::inner_type<Vec>::type;
 
-    auto values_vec = vec_from_idl_value(ptr.get());
-    if (values_vec == nullptr) return std::nullopt;
-    auto vec_len = cidlval_vec_len(values_vec);
-    std::vector<T> ret;
-    for (int i = 0; i < vec_len; ++i) {
-      auto p = cidlval_vec_value_take(values_vec, i);
-      if (p == nullptr) return std::nullopt;
-      IdlValue value(p);
-      std::optional<T> val = value.get<T>();
-      if (!val.has_value()) return std::nullopt;
-      ret.emplace_back(std::move(val.value()));
+    if constexpr (helper::contiguous_vec<T>::value) {
+      return getContiguous<T>();
+    } else {
+      return getElements<T>();
     }
-    /*we took ownership of inner fields but still needs to destroy vector */
-    cidlval_vec_destroy(values_vec);
-    return std::make_optional<std::vector<T>>(std::move(ret));
+  }
+
+  // Vectors of fixed size values cross the FFI as one contiguous array
+  template <typename T>
+  std::optional<std::vector<T>> getContiguous() {
+    if (ptr == nullptr) return std::nullopt;
+
+    CBytes *array = helper::contiguous_vec<T>::get(ptr.get());
+    if (array == nullptr) return std::nullopt;
+
+    const uint8_t *data = cbytes_ptr(array);
+    std::size_t len = cbytes_len(array);
+    std::vector<T> values;
+    if constexpr (std::is_same_v<T, bool>) {
+      values.assign(data, data + len);
+    } else {
+      values.resize(len / sizeof(T));
+      if (len != 0) std::memcpy(values.data(), data, len);
+    }
+    cbytes_destroy(array);
+
+    return std::make_optional(std::move(values));
   }
 
   // Fallback function for non-variant, non-tuples, non-map-like
@@ -376,108 +769,70 @@ class IdlValue {
     return callGetVariant<T>::call(this);
   }
 
-  // Specialization for tuple
-  template <typename T, typename Tuple, std::size_t... I>
-  std::optional<T> getTupleHelper(Tuple &&, std::index_sequence<I...>) {
-    return getTuple<std::tuple_element_t<I, T>...>();
-  }
-
   // Specialization for tuple
   template <typename T>
   std::optional<T> getHelper(std::false_type, std::true_type) {
-    auto optTuple = getTupleHelper<T>(
-        T{}, std::make_index_sequence<std::tuple_size_v<T>>{});
-    if (!optTuple.has_value()) return std::nullopt;
-    return optTuple;
-  }
-
-  template <typename... Ts, std::size_t... Is>
-  static std::optional<std::tuple<Ts...>> vectorToTupleImpl(
-      std::vector<IdlValue> &vector, std::index_sequence<Is...>) {
-    using variant_t = std::tuple<std::optional<Ts>...>;
-    variant_t variantVector{vector[Is].get<Ts>()...};
-
-    // all this because std::move(std::nullopt) is undefined behavior in C++
-    if (!std::apply([](auto &&...opt) { return ((opt.has_value()) && ...); },
-                    variantVector)) {
-      return std::nullopt;
-    }
-    std::tuple<Ts...> tuple{std::move(*(std::get<Is>(variantVector)))...};
-
-    return std::optional<std::tuple<Ts...>>{std::move(tuple)};
+    return getTuple(static_cast<T *>(nullptr));
   }
 
   template <typename... Ts>
-  std::optional<std::tuple<Ts...>> vectorToTuple(
-      std::vector<IdlValue> &vector) {
-    return std::move(
-        vectorToTupleImpl<Ts...>(vector, std::index_sequence_for<Ts...>{}));
+  std::optional<std::tuple<Ts...>> getTuple(std::tuple<Ts...> *) {
+    return getTuple<Ts...>(std::index_sequence_for<Ts...>{});
   }
 
-  template <typename... Ts>
-  std::optional<std::tuple<Ts...>> getTuple() {
-    // tuples are in reality a list or records, we have an specialization for
-    // it, so lets use that here;
-    auto records = get<std::unordered_map<std::string, IdlValue>>();
-
-    if (!records.has_value()) return std::nullopt;
-
-    auto values = std::move(records.value());
-
-    std::vector<int> keys;
-    for (auto &pair : values) {
-      keys.push_back(std::stoi(pair.first));
-    }
-
-    // Sort the keys, yes why? because std::sort does not support sorting
-    // move-only types
-    std::sort(keys.begin(), keys.end());
+  // Tuples are records labelled 0, 1, ..., sorted by label, read by position
+  // in one pass. Extra fields are ignored.
+  template <typename... Ts, std::size_t... Is>
+  std::optional<std::tuple<Ts...>> getTuple(std::index_sequence<Is...>) {
+    RecordReader fields(ptr.get(), taking);
+    if (!fields.valid() || fields.size() < sizeof...(Ts) ||
+        !((fields.id(Is) == Is) && ...))
+      return std::nullopt;
 
-    // Create a vector of IdlValue objects in the order defined by keys
-    std::vector<IdlValue> vecValues;
+    std::tuple<std::optional<Ts>...> values{fields.template read<Ts>(Is)...};
+    if (!(std::get<Is>(values).has_value() && ...)) return std::nullopt;
 
-    for (int key : keys) {
-      vecValues.push_back(std::move(values[std::to_string(key)]));
-    }
-    return std::move(vectorToTuple<Ts...>(vecValues));
+    return std::make_optional<std::tuple<Ts...>>(
+        std::move(*std::get<Is>(values))...);
   }
 
-  // Attempt to extract the Indexth variant type from the CVariant
+  // Reads the payload of a variant as its Index-th alternative
   template <typename Variant, std::size_t Index>
-  bool tryVariant(std::optional<Variant> &loc, std::string_view key,
-                  std::size_t code) {
+  static std::optional<Variant> getAlternative(IdlValue &payload) {
     using T = std::variant_alternative_t<Index, Variant>;
 
-    if (loc.has_value()) return false;
-
-    // check code, key & Index match
-    if (T::__CANDID_VARIANT_NAME != key || T::__CANDID_VARIANT_CODE != code)
-      return false;
+    auto value = std::move(payload).take<T>();
+    if (!value.has_value()) return std::nullopt;
 
-    // get to obtain the inner type
-    auto v = get<T>();
-    if (!v.has_value()) return false;
-
-    // initialize loc with the proper type
-    loc.emplace(std::in_place_index<Index>, std::move(v.value()));
-    return true;
+    return std::make_optional<Variant>(std::in_place_index<Index>,
+                                       std::move(value.value()));
   }
 
+  // The alternative is found from the label id, through a table built at
+  // compile time, without converting the label to a string.
   template <typename... Ts, std::size_t... Indices>
   std::optional<std::variant<Ts...>> getVariant(
       std::index_sequence<Indices...>) {
     using Variant = std::variant<Ts...>;
+    using GetFn = std::optional<Variant> (*)(IdlValue &);
 
-    auto cvariant_data = asCVariant();
-    if (!cvariant_data.has_value()) return std::nullopt;
+    static constexpr candid::LabelIndex<sizeof...(Ts)> labels{
+        {candid::idl_hash(Ts::__CANDID_VARIANT_NAME)...}};
+    static constexpr std::array<GetFn, sizeof...(Ts)> getters{
+        &getAlternative<Variant, Indices>...};
 
-    auto [key, code, variant] = std::move(cvariant_data.value());
+    if (ptr == nullptr) return std::nullopt;
 
-    std::optional<Variant> result;
+    uint32_t id = 0;
+    IDLValue *payload = taking ? variant_take_from_idl_value(ptr.get(), &id)
+                               : variant_id_from_idl_value(ptr.get(), &id);
+    if (payload == nullptr) return std::nullopt;
 
-    (variant.tryVariant<Variant, Indices>(result, key, code), ...);
+    IdlValue value(payload);
+    auto alternative = labels.find(id);
+    if (alternative == sizeof...(Ts)) return std::nullopt;
 
-    return result;
+    return getters[alternative](value);
   }
 
  public:
@@ -570,12 +925,13 @@ class IdlValue {
   static IdlValue reserved();
 
   /**
-   * static constructor for to create an idlValue with a list of records.
+   * static constructor for to create an idlValue of type Record.
    *
-   * @tparam An unordered_map containing a list of records.
+   * @tparam The fields of the record, see idl_record.h. Their values are moved
+   * into the new IdlValue.
    *
    */
-  static IdlValue FromRecord(std::unordered_map<std::string, IdlValue> &fields);
+  static IdlValue FromRecord(IdlRecord &&fields);
 
   /**
    * static constructor for to create an idlValue of type Variant.
@@ -622,9 +978,7 @@ class IdlValue {
         auto opt = getOpt();
         if (!opt.has_value()) return std::nullopt;
 
-        auto value = std::move(opt.value());
-
-        return value.get<U>();
+        return std::move(opt.value()).take<U>();
       }
       case IdlValueType::None:
         return T{std::nullopt};
@@ -673,12 +1027,49 @@ class IdlValue {
   }
 
   /**
-   * Generic Getter specialized to get an unordered_map or records.
+   * Consuming getter, `std::move(value).take<T>()` reads like get<T>() but
+   * moves vectors, options, variants and records out of the value instead of
+   * copying them. The value is left empty.
    *
    * @treturns The value contained in this instance.
    *
    */
-  std::unordered_map<std::string, IdlValue> getRecord();
+  template <typename T>
+  std::optional<T> take() && {
+    taking = true;
+    auto value = get<T>();
+    taking = false;
+    return value;
+  }
+
+  /**
+   * Getter to get the fields of an IdlValue of type Record, see idl_record.h.
+   * The values are copied, `take<IdlRecord>()` moves them out instead.
+   *
+   * @treturns The fields of the record, none if it is not a record.
+   *
+   */
+  IdlRecord getRecord();
+
+  /**
+   * Iterates over the fields of a record in place:
+   * `for (auto field : value.fields())` yields the label of each field and a
+   * reference to its value, without copying them.
+   *
+   * @treturns The fields of the record, none if it is not a record.
+   *
+   */
+  IdlValueRef::Fields fields() const { return IdlValueRef(ptr.get()).fields(); }
+
+  /**
+   * Iterates over the elements of a vector in place, without copying them.
+   *
+   * @treturns The elements of the vector, none if it is not a vector.
+   *
+   */
+  IdlValueRef::Elements elements() const {
+    return IdlValueRef(ptr.get()).elements();
+  }
 
   /**
    * Getter to get an IdlValue of type Opt or None.
@@ -708,8 +1099,60 @@ class IdlValue {
   IdlValueType type();
 };
 
+template <typename T>
+std::optional<T> IdlValueRef::get() const {
+  if (ptr == nullptr) return std::nullopt;
+
+  // borrows the value, getters only modify it while taking
+  struct Borrowed {
+    IdlValue value;
+    ~Borrowed() { value.ptr.release(); }
+  } borrowed{IdlValue(const_cast<IDLValue *>(ptr))};
+
+  return borrowed.value.template get<T>();
+}
+
+template <typename T>
+std::optional<T> IdlValue::RecordReader::read(std::size_t i) {
+  if (fields != nullptr) return value(i).take<T>();
+
+  return IdlValueRef(record_field_ref(record, i, nullptr, nullptr, nullptr))
+      .get<T>();
+}
+
 /******************** Private ***********************/
 
+template <typename T>
+void IdlValue::setScalar(IdlValueType type, T value) {
+  scalarType = type;
+  if constexpr (std::is_same_v<T, bool>) {
+    scalar.b = value;
+  } else if constexpr (std::is_same_v<T, float>) {
+    scalar.f32 = value;
+  } else if constexpr (std::is_same_v<T, double>) {
+    scalar.f64 = value;
+  } else if constexpr (std::is_signed_v<T>) {
+    scalar.integer = value;
+  } else {
+    scalar.nat = value;
+  }
+}
+
+template <typename T>
+T IdlValue::scalarAs() const {
+  if constexpr (std::is_same_v<T, bool>) {
+    return scalar.b;
+  } else if constexpr (std::is_same_v<T, float>) {
+    return scalar.f32;
+  } else if constexpr (std::is_same_v<T, double>) {
+    return scalar.f64;
+  } else if constexpr (std::is_signed_v<T>) {
+    return static_cast<T>(scalar.integer);
+  } else {
+    return static_cast<T>(scalar.nat);
+  }
+}
+
 template <typename Tuple, size_t... Indices>
 void IdlValue::initializeFromTuple(Tuple &tuple,
                                    std::index_sequence<Indices...>) {
@@ -718,7 +1161,7 @@ void IdlValue::initializeFromTuple(Tuple &tuple,
 
   auto func = [&](auto &&tp, auto index) {
     IdlValue val(std::move(tp));
-    values.push_back(val.ptr.release());
+    values.push_back(val.release());
 
     // Array to store the resulting bytes
     std::array<uint8_t, 4> bytes;
@@ -747,24 +1190,96 @@ void IdlValue::initializeFromTuple(Tuple &tuple,
                                   values.data(), values.size(), true));
 }
 
-IDL_VALUE_PRIMITIVES(nat8, uint8_t)
-IDL_VALUE_PRIMITIVES(nat16, uint16_t)
-IDL_VALUE_PRIMITIVES(nat32, uint32_t)
-IDL_VALUE_PRIMITIVES(nat64, uint64_t)
-IDL_VALUE_PRIMITIVES(int8, int8_t)
-IDL_VALUE_PRIMITIVES(int16, int16_t)
-IDL_VALUE_PRIMITIVES(int32, int32_t)
-IDL_VALUE_PRIMITIVES(int64, int64_t)
-IDL_VALUE_PRIMITIVES(float32, float)
-IDL_VALUE_PRIMITIVES(float64, double)
-IDL_VALUE_PRIMITIVES(bool, bool)
+template <typename T, typename... Fs>
+void IdlValue::initializeFromRecord(T &record, std::tuple<Fs...> *) {
+  static_assert(helper::record_ids_sorted<std::tuple<Fs...>>::value,
+                "Record fields must be listed by increasing label id");
+
+  // little endian ids, as idl_value_with_record reads them
+  static constexpr std::array<std::array<uint8_t, 4>, sizeof...(Fs)> ids{
+      {{static_cast<uint8_t>(Fs::id), static_cast<uint8_t>(Fs::id >> 8),
+        static_cast<uint8_t>(Fs::id >> 16),
+        static_cast<uint8_t>(Fs::id >> 24)}...}};
+  static const auto keys = [] {
+    std::array<const char *, sizeof...(Fs)> keys{};
+    for (std::size_t i = 0; i < ids.size(); ++i)
+      keys[i] = reinterpret_cast<const char *>(ids[i].data());
+    return keys;
+  }();
+
+  std::array<IDLValue *, sizeof...(Fs)> values{
+      IdlValue(std::move(record.*Fs::member)).release()...};
+
+  ptr.reset(idl_value_with_record(keys.data(), keys.size(), values.data(),
+                                  values.size(), true));
+}
+
+template <typename T, typename... Fs>
+std::optional<T> IdlValue::getFromRecord(std::tuple<Fs...> *) {
+  RecordReader fields(ptr.get(), taking);
+  if (!fields.valid()) return std::nullopt;
+
+  std::size_t len = fields.size();
+  std::size_t next = 0;
+
+  // Fields usually come sorted by id like ours, so each search starts where
+  // the previous one ended and the whole record is walked once.
+  auto find = [&](uint32_t id) {
+    for (std::size_t n = 0; n < len; ++n) {
+      std::size_t i = (next + n) % len;
+      if (fields.id(i) == id) {
+        next = i + 1;
+        return i;
+      }
+    }
+    return len;
+  };
+
+  // default initialized, unit records have explicit constructors; every
+  // member is either read or an optional left empty
+  T result;
+  auto readField = [&](auto field) {
+    using F = decltype(field);
+    using M = helper::record_member_t<T, F>;
 
+    std::size_t i = find(F::id);
+    if (i == len) return helper::is_optional_v<M>;
+
+    auto member = fields.template read<M>(i);
+    if (!member.has_value()) return false;
+
+    result.*F::member = std::move(member.value());
+    return true;
+  };
+
+  if (!(readField(Fs{}) && ...)) return std::nullopt;
+  return std::make_optional<T>(std::move(result));
+}
+
+IDL_VALUE_PRIMITIVES(Nat8, uint8_t)
+IDL_VALUE_PRIMITIVES(Nat16, uint16_t)
+IDL_VALUE_PRIMITIVES(Nat32, uint32_t)
+IDL_VALUE_PRIMITIVES(Nat64, uint64_t)
+IDL_VALUE_PRIMITIVES(Int8, int8_t)
+IDL_VALUE_PRIMITIVES(Int16, int16_t)
+IDL_VALUE_PRIMITIVES(Int32, int32_t)
+IDL_VALUE_PRIMITIVES(Int64, int64_t)
+IDL_VALUE_PRIMITIVES(Float32, float)
+IDL_VALUE_PRIMITIVES(Float64, double)
+IDL_VALUE_PRIMITIVES(Bool, bool)
+
+// Text crosses the FFI as a pointer and a length, copied once by Rust
 template <>
-inline IdlValue::IdlValue(std::string text) {
+inline IdlValue::IdlValue(std::string_view text) {
   // TODO: Use RetError
-  ptr.reset(idl_value_with_text(text.c_str(), nullptr));
+  ptr.reset(idl_value_with_text_len(
+      reinterpret_cast<const uint8_t *>(text.data()), text.size(), nullptr));
 }
 
+template <>
+inline IdlValue::IdlValue(std::string text)
+    : IdlValue(std::string_view(text)) {}
+
 template <>
 inline IdlValue::IdlValue(Number number) {
   // TODO: Use RetError
@@ -778,7 +1293,7 @@ inline IdlValue::IdlValue(std::optional<T> val) {
   if (val.has_value()) {
     // use move-constructor
     IdlValue value(std::move(val.value()));
-    ptr.reset(idl_value_with_opt(value.ptr.release()));
+    ptr.reset(idl_value_with_opt(value.release()));
   } else {
     ptr.reset(idl_value_with_none());
   }
@@ -786,12 +1301,17 @@ inline IdlValue::IdlValue(std::optional<T> val) {
 
 template <typename T, typename>
 inline IdlValue::IdlValue(std::vector<T> &&elems) {
+  if constexpr (helper::contiguous_vec<T>::value) {
+    ptr.reset(helper::contiguous_vec<T>::make(elems));
+    return;
+  }
+
   std::vector<const IDLValue *> cElems;
   cElems.reserve(elems.size());
 
   for (auto &&e : elems) {
     IdlValue val(std::move(e));
-    cElems.push_back(val.ptr.release());
+    cElems.push_back(val.release());
   }
 
   ptr.reset(idl_value_with_vec(cElems.data(), cElems.size()));
@@ -804,7 +1324,7 @@ inline IdlValue::IdlValue(std::vector<std::tuple<Args...>> &&elems) {
 
   for (auto &&e : elems) {
     IdlValue val(std::move(e));
-    cElems.push_back(val.ptr.release());
+    cElems.push_back(val.release());
   }
 
   ptr.reset(idl_value_with_vec(cElems.data(), cElems.size()));
@@ -859,52 +1379,48 @@ inline IdlValue::IdlValue(zondax::Func func) {
                                 func.method_name().c_str()));
 }
 
+template <>
+inline IdlValue::IdlValue(BlobView blob) {
+  ptr.reset(idl_value_with_blob(blob.data(), blob.size()));
+}
+
 template <>
 inline IdlValue::IdlValue(std::monostate) {
-  ptr.reset(idl_value_with_null());
+  scalarType = IdlValueType::Null;
 }
 
 inline IdlValue IdlValue::null(void) {
   IdlValue val;
-  val.ptr.reset(idl_value_with_null());
+  val.scalarType = IdlValueType::Null;
   return val;
 }
 
 inline IdlValue IdlValue::reserved(void) {
   IdlValue val;
-  val.ptr.reset(idl_value_with_reserved());
+  val.scalarType = IdlValueType::Reserved;
   return val;
 }
 
-PRIMITIVE_TYPES_GETTER(int8, int8_t)
-PRIMITIVE_TYPES_GETTER(int16, int16_t)
-PRIMITIVE_TYPES_GETTER(int32, int32_t)
-PRIMITIVE_TYPES_GETTER(int64, int64_t)
-PRIMITIVE_TYPES_GETTER(nat8, uint8_t)
-PRIMITIVE_TYPES_GETTER(nat16, uint16_t)
-PRIMITIVE_TYPES_GETTER(nat32, uint32_t)
-PRIMITIVE_TYPES_GETTER(nat64, uint64_t)
-PRIMITIVE_TYPES_GETTER(float32, float)
-PRIMITIVE_TYPES_GETTER(float64, double)
-PRIMITIVE_TYPES_GETTER(bool, bool)
+PRIMITIVE_TYPES_GETTER(int8, Int8, int8_t)
+PRIMITIVE_TYPES_GETTER(int16, Int16, int16_t)
+PRIMITIVE_TYPES_GETTER(int32, Int32, int32_t)
+PRIMITIVE_TYPES_GETTER(int64, Int64, int64_t)
+PRIMITIVE_TYPES_GETTER(nat8, Nat8, uint8_t)
+PRIMITIVE_TYPES_GETTER(nat16, Nat16, uint16_t)
+PRIMITIVE_TYPES_GETTER(nat32, Nat32, uint32_t)
+PRIMITIVE_TYPES_GETTER(nat64, Nat64, uint64_t)
+PRIMITIVE_TYPES_GETTER(float32, Float32, float)
+PRIMITIVE_TYPES_GETTER(float64, Float64, double)
+PRIMITIVE_TYPES_GETTER(bool, Bool, bool)
 
 template <>
 inline std::optional<std::string> IdlValue::getImpl(
     helper::tag_type<std::string> type) {
-  if (ptr == nullptr) return std::nullopt;
-
-  CText *ctext = text_from_idl_value(ptr.get());
-  if (ctext == nullptr) return std::nullopt;
-
-  const char *str = ctext_str(ctext);
-  if (str == nullptr) return std::nullopt;
-
-  // use c null-terminated string constructor
-  std::string s(str);
-
-  ctext_destroy(ctext);
+  // borrows the text, which is copied once, NULs included
+  auto text = IdlValueRef(ptr.get()).text();
+  if (!text.has_value()) return std::nullopt;
 
-  return std::make_optional<std::string>(s);
+  return std::make_optional<std::string>(*text);
 }
 
 template <>
@@ -968,11 +1484,8 @@ inline std::optional<zondax::Func> IdlValue::getImpl(
 template <>
 inline std::optional<std::vector<IdlValue>> IdlValue::getImpl(
     helper::tag_type<std::vector<IdlValue>> type) {
-  if (ptr == nullptr) return std::nullopt;
-
-  // call bellow creates a new IDLValue::Vec,
-  // this means it "clones" from this.ptr
-  struct CIDLValuesVec *cVec = vec_from_idl_value(ptr.get());
+  // copies the elements of ptr, or moves them out when taking
+  struct CIDLValuesVec *cVec = vecValues();
   if (cVec == nullptr) return std::nullopt;
 
   uintptr_t length = cidlval_vec_len(cVec);
@@ -1017,6 +1530,11 @@ inline std::optional<zondax::Service> IdlValue::getImpl(
 template <>
 inline std::optional<std::monostate> IdlValue::getImpl(
     helper::tag_type<std::monostate> type) {
+  if (scalarType != IdlValueType::Invalid) {
+    return scalarType == IdlValueType::Null
+               ? std::make_optional<std::monostate>()
+               : std::nullopt;
+  }
   if (ptr == nullptr) return std::nullopt;
 
   return idl_value_is_null(ptr.get()) ? std::make_optional<std::monostate>()
@@ -1030,7 +1548,8 @@ inline std::optional<std::unordered_map<std::string, IdlValue>>
 IdlValue::getImpl<std::unordered_map<std::string, IdlValue>>(
     helper::tag_type<std::unordered_map<std::string, IdlValue>> t) {
   if (ptr.get() == nullptr) return std::nullopt;
-  auto record = record_from_idl_value(ptr.get());
+  auto record = taking ? record_take_from_idl_value(ptr.get())
+                       : record_from_idl_value(ptr.get());
   if (record == nullptr) return std::nullopt;
 
   std::unordered_map<std::string, IdlValue> fields;
@@ -0,0 +1,297 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef IDL_VIEW_H
+#define IDL_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string_view>
+
+#include "blob.h"
+#include "candid.h"
+#include "idl_decoder.h"
+
+namespace zondax {
+
+/**
+ * Read only view of a value in a Candid message, obtained from
+ * `IdlDecoder::view()`.
+ *
+ * Nothing is decoded up front: text and blobs are returned as views into the
+ * message, records and vectors are walked lazily and only the values asked
+ * for are read. A view is a position and a type, it is cheap to copy, and
+ * reads through a cursor of its own: views and iterators over one decoder do
+ * not disturb each other nor the decoder. The message and the decoder must
+ * outlive it, and the decoder must not be moved.
+ */
+class IdlView {
+  friend class IdlDecoder;
+
+ public:
+  class Vec;
+  class Record;
+
+  struct Field;
+
+  IdlView()
+      : decoder(nullptr), type_(candid::ref(candid::Opcode::Null)), pos(0) {}
+
+  /**
+   * @brief The wire type, a negative opcode or an index in the type table.
+   */
+  candid::TypeRef type() const { return type_; }
+
+  /**
+   * @brief Decodes the value into an owned T, as `IdlDecoder::arg<T>()`.
+   */
+  template <typename T>
+  std::optional<T> get() const;
+
+  /**
+   * @brief Views a text value.
+   */
+  std::optional<std::string_view> text() const;
+
+  /**
+   * @brief Views a blob (`vec nat8`) value.
+   */
+  std::optional<BlobView> blob() const;
+
+  /**
+   * @brief Whether the value is null, reserved or an absent optional.
+   */
+  bool isNull() const;
+
+  /**
+   * @brief The value of a present optional.
+   */
+  std::optional<IdlView> opt() const;
+
+  std::optional<Vec> vec() const;
+
+  std::optional<Record> record() const;
+
+  /**
+   * @brief The alternative held by a variant.
+   */
+  std::optional<Field> variant() const;
+
+  /**
+   * @brief Looks a record field up by name, or by position for tuples.
+   */
+  std::optional<IdlView> field(std::string_view label) const;
+  std::optional<IdlView> field(uint32_t hash) const;
+
+ private:
+  IdlView(const IdlDecoder &decoder, candid::TypeRef type, std::size_t pos)
+      : decoder(&decoder), type_(type), pos(pos) {}
+
+  // A decoder of its own at the value, sharing the type table
+  IdlDecoder cursor() const { return IdlDecoder(*decoder, pos); }
+
+  // Position of the value following the one at `pos`
+  static std::size_t next(const IdlDecoder &decoder, candid::TypeRef type,
+                          std::size_t pos);
+
+  const IdlDecoder *decoder;
+  candid::TypeRef type_;
+  std::size_t pos;
+};
+
+/**
+ * A record field or a variant alternative.
+ */
+struct IdlView::Field {
+  uint32_t hash;
+  IdlView value;
+};
+
+/**
+ * The elements of a vector. Elements of a fixed size type are reached in
+ * constant time, the others by skipping the ones before them.
+ */
+class IdlView::Vec {
+  friend class IdlView;
+
+ public:
+  class iterator {
+    friend class Vec;
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = IdlView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = IdlView;
+
+    IdlView operator*() const { return IdlView(*decoder, inner, pos); }
+
+    iterator &operator++() {
+      pos = elemSize.has_value() ? pos + elemSize.value()
+                                 : IdlView::next(*decoder, inner, pos);
+      ++index;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      auto prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    bool operator==(const iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+   private:
+    iterator(const Vec &vec, std::size_t index, std::size_t pos)
+        : decoder(vec.decoder),
+          inner(vec.inner),
+          elemSize(vec.elemSize),
+          index(index),
+          pos(pos) {}
+
+    const IdlDecoder *decoder;
+    candid::TypeRef inner;
+    std::optional<std::size_t> elemSize;
+    std::size_t index;
+    std::size_t pos;
+  };
+
+  std::size_t size() const { return len; }
+  bool empty() const { return len == 0; }
+
+  /**
+   * @brief The element type.
+   */
+  candid::TypeRef type() const { return inner; }
+
+  iterator begin() const { return iterator(*this, 0, first); }
+  iterator end() const { return iterator(*this, len, 0); }
+
+  /**
+   * @brief The element at `i`, which must be less than `size()`.
+   */
+  IdlView operator[](std::size_t i) const;
+
+ private:
+  Vec(const IdlDecoder &decoder, candid::TypeRef inner, std::size_t first,
+      std::size_t len)
+      : decoder(&decoder),
+        inner(inner),
+        first(first),
+        len(len),
+        elemSize(decoder.fixedSize(inner)) {}
+
+  const IdlDecoder *decoder;
+  candid::TypeRef inner;
+  std::size_t first;
+  std::size_t len;
+  std::optional<std::size_t> elemSize;
+};
+
+/**
+ * The fields of a record, in the order of their label hashes.
+ */
+class IdlView::Record {
+  friend class IdlView;
+
+ public:
+  class iterator {
+    friend class Record;
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Field;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Field;
+
+    Field operator*() const {
+      const auto &f = decoder->field(*entry, index);
+      return Field{f.hash, IdlView(*decoder, f.type, pos)};
+    }
+
+    iterator &operator++() {
+      pos = IdlView::next(*decoder, decoder->field(*entry, index).type, pos);
+      ++index;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      auto prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    bool operator==(const iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+   private:
+    iterator(const Record &record, std::size_t index, std::size_t pos)
+        : decoder(record.decoder),
+          entry(record.entry),
+          index(index),
+          pos(pos) {}
+
+    const IdlDecoder *decoder;
+    const IdlDecoder::TypeEntry *entry;
+    std::size_t index;
+    std::size_t pos;
+  };
+
+  std::size_t size() const { return entry->fieldCount; }
+
+  iterator begin() const { return iterator(*this, 0, first); }
+  iterator end() const { return iterator(*this, entry->fieldCount, 0); }
+
+  /**
+   * @brief Looks a field up by label hash, skipping the fields before it.
+   */
+  std::optional<IdlView> find(uint32_t hash) const;
+  std::optional<IdlView> find(std::string_view label) const {
+    return find(candid::idl_hash(label));
+  }
+
+ private:
+  Record(const IdlDecoder &decoder, const IdlDecoder::TypeEntry &entry,
+         std::size_t first)
+      : decoder(&decoder), entry(&entry), first(first) {}
+
+  const IdlDecoder *decoder;
+  const IdlDecoder::TypeEntry *entry;
+  std::size_t first;
+};
+
+template <typename T>
+std::optional<T> IdlView::get() const {
+  static_assert(helper::is_idl_decodable_v<T>,
+                "Type can not be decoded, an IdlDecode specialization is "
+                "missing");
+
+  if (decoder == nullptr) return std::nullopt;
+  auto in = cursor();
+  return IdlDecode<T>::read(in, type_);
+}
+
+}  // namespace zondax
+
+#endif  // IDL_VIEW_H
@@ -0,0 +1,85 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef IDL_VISITOR_H
+#define IDL_VISITOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "candid.h"
+#include "idl_view.h"
+
+namespace zondax {
+
+/**
+ * What to do after a visitor event.
+ *
+ * `Skip` passes over the contents of the value just begun (the elements of a
+ * vector, the value of a field...), without reporting them. `Stop` ends the
+ * walk.
+ */
+enum class Visit { Continue, Skip, Stop };
+
+/**
+ * Receives the values of a Candid message as `IdlDecoder::visit()` reads
+ * them, so that no representation of the whole message is ever built.
+ *
+ * Composite values are reported as a begin event, their contents and an end
+ * event; an end event is not sent when the contents are skipped. Other
+ * values, including blobs (`vec nat8`), are reported by `value()` as a view
+ * that is only valid during the call.
+ *
+ * Every event does nothing by default, visitors override the ones they need.
+ */
+class IdlVisitor {
+ public:
+  virtual ~IdlVisitor() = default;
+
+  virtual Visit beginArg(std::size_t /*index*/,
+                         candid::TypeRef /*type*/) {
+    return Visit::Continue;
+  }
+  virtual Visit endArg(std::size_t /*index*/) { return Visit::Continue; }
+
+  virtual Visit value(const IdlView & /*value*/) { return Visit::Continue; }
+
+  virtual Visit beginVec(std::size_t /*len*/) { return Visit::Continue; }
+  virtual Visit endVec() { return Visit::Continue; }
+
+  virtual Visit beginRecord(std::size_t /*fields*/) { return Visit::Continue; }
+  /**
+   * @brief Sent before the value of each field.
+   */
+  virtual Visit recordField(uint32_t /*hash*/) { return Visit::Continue; }
+  virtual Visit endRecord() { return Visit::Continue; }
+
+  /**
+   * @brief Sent before the value of a present optional, or for an absent
+   * one, which has no contents.
+   */
+  virtual Visit beginOpt(bool /*present*/) { return Visit::Continue; }
+  virtual Visit endOpt() { return Visit::Continue; }
+
+  /**
+   * @brief Sent before the value of the alternative a variant holds.
+   */
+  virtual Visit beginVariant(uint32_t /*hash*/) { return Visit::Continue; }
+  virtual Visit endVariant() { return Visit::Continue; }
+};
+
+}  // namespace zondax
+
+#endif  // IDL_VISITOR_H
@@ -0,0 +1,82 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef LEB128_H
+#define LEB128_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Bulk LEB128 kernels, for vectors of `nat` and `int` values.
+ *
+ * The vectorised kernels find value boundaries sixteen (SSE2) or thirty-two
+ * (AVX2) bytes at a time from the continuation bits, then assemble each value
+ * without branching on its bytes. They are selected at compile time, builds
+ * for other targets use the scalar kernels.
+ */
+namespace zondax::candid::leb128 {
+
+/**
+ * @brief Decodes consecutive LEB128 numbers that fit in 64 bits.
+ *
+ * @param data The encoded numbers.
+ * @param size Length of `data`.
+ * @param out Where the values are written.
+ * @param count Number of values wanted.
+ * @param read Set to the number of bytes the decoded values took.
+ * @return The number of values decoded, less than `count` when the data ends
+ * or the next value does not fit in 64 bits.
+ */
+std::size_t decodeUnsigned(const uint8_t *data, std::size_t size,
+                           uint64_t *out, std::size_t count,
+                           std::size_t &read);
+
+/**
+ * @brief Decodes consecutive SLEB128 numbers that fit in 64 bits, see
+ * `decodeUnsigned`.
+ */
+std::size_t decodeSigned(const uint8_t *data, std::size_t size, int64_t *out,
+                         std::size_t count, std::size_t &read);
+
+/**
+ * @brief Finds the end of `count` consecutive LEB128 or SLEB128 numbers of
+ * any size.
+ *
+ * @param read Set to the number of bytes they take.
+ * @return false if `data` ends first.
+ */
+bool skip(const uint8_t *data, std::size_t size, std::size_t count,
+          std::size_t &read);
+
+/**
+ * Byte by byte kernels, used for the tails the vectorised ones leave and as
+ * the reference they are measured against.
+ */
+std::size_t decodeUnsignedScalar(const uint8_t *data, std::size_t size,
+                                 uint64_t *out, std::size_t count,
+                                 std::size_t &read);
+std::size_t decodeSignedScalar(const uint8_t *data, std::size_t size,
+                               int64_t *out, std::size_t count,
+                               std::size_t &read);
+
+/**
+ * @brief Name of the kernel compiled in: "avx2", "sse2" or "scalar".
+ */
+const char *kernel();
+
+}  // namespace zondax::candid::leb128
+
+#endif  // LEB128_H
@@ -0,0 +1,118 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "principal.h"
+
+namespace zondax {
+
+/**
+ * @brief Token bucket configuration.
+ *
+ * The bucket holds up to `burst` tokens and refills at `rate` tokens per
+ * second, every call consumes one token. A call arriving on an empty bucket is
+ * queued until a token is available if that happens within `maxWait`, and
+ * rejected otherwise. A `maxWait` of zero makes the limiter fail fast.
+ */
+struct RateLimit {
+  double rate = 1.0;
+  double burst = 1.0;
+  std::chrono::milliseconds maxWait{0};
+};
+
+/**
+ * @brief Client side admission control for canister calls.
+ *
+ * Limits can be set per canister, applying to every method of it, and per
+ * canister method. A call must be admitted by both buckets that apply to it.
+ * A limiter can be shared between agents, so that agents talking to the same
+ * canister share its limits.
+ *
+ * This class is thread safe.
+ */
+class RateLimiter {
+ public:
+  RateLimiter() = default;
+
+  // The inner mutex can not be copied or moved
+  RateLimiter(const RateLimiter &) = delete;
+  void operator=(const RateLimiter &) = delete;
+
+  /**
+   * @brief Limits every call to a canister.
+   *
+   * @param canister The canister id.
+   * @param limit The limit, a non positive rate removes it.
+   */
+  void setCanisterLimit(const Principal &canister, const RateLimit &limit);
+
+  /**
+   * @brief Limits the calls to one method of a canister.
+   *
+   * @param canister The canister id.
+   * @param method The method name.
+   * @param limit The limit, a non positive rate removes it.
+   */
+  void setMethodLimit(const Principal &canister, const std::string &method,
+                      const RateLimit &limit);
+
+  /**
+   * @brief Admits a call, waiting for it when the limits allow queueing.
+   *
+   * @param canister The canister id bytes.
+   * @param method The method being called.
+   * @return `std::nullopt` once the call is admitted, or an error message
+   * when it was rejected.
+   */
+  std::optional<std::string> acquire(const std::vector<uint8_t> &canister,
+                                     const std::string &method);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Bucket {
+    RateLimit limit;
+    double tokens;
+    Clock::time_point last;
+
+    explicit Bucket(const RateLimit &limit);
+
+    // Time until a token is available, refilling the bucket first
+    std::chrono::nanoseconds wait(Clock::time_point now);
+  };
+
+  std::mutex mtx;
+  std::map<std::vector<uint8_t>, Bucket> canisters;
+  // per canister, then per method; methods are looked up without building a
+  // key string
+  std::map<std::vector<uint8_t>, std::map<std::string, Bucket, std::less<>>>
+      methods;
+};
+
+}  // namespace zondax
+
+#endif  // RATE_LIMITER_H
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef SHARED_IDL_VALUE_H
+#define SHARED_IDL_VALUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "idl_args.h"
+#include "idl_value.h"
+
+namespace zondax {
+
+/**
+ * @brief An immutable `IdlValue` shared by reference counting.
+ *
+ * Copies share the same value, so a cached or broadcast result is handed to
+ * many consumers without copying it nor decoding it again. Nothing modifies
+ * the value once it is shared: it is read through `IdlValueRef`, and can be
+ * read from many threads at once.
+ *
+ * ```cpp
+ * zondax::SharedIdlValue shared(std::move(value));
+ * std::thread([shared] { shared.get<uint64_t>(); }).detach();
+ * ```
+ */
+class SharedIdlValue {
+ public:
+  SharedIdlValue() = default;
+
+  /**
+   * @brief Shares `value`, which is left empty.
+   */
+  explicit SharedIdlValue(IdlValue &&value);
+
+  IdlValueType type() const { return ref().type(); }
+
+  /**
+   * @brief Reads the value, as `IdlValueRef::get<T>()`.
+   */
+  template <typename T>
+  std::optional<T> get() const {
+    return ref().get<T>();
+  }
+
+  /**
+   * @brief A reference to the value, valid as long as this instance or a
+   * copy of it is alive.
+   */
+  IdlValueRef ref() const { return IdlValueRef(ptr.get()); }
+
+  /**
+   * @brief An owned copy of the value, which can be modified or moved from.
+   */
+  IdlValue copy() const;
+
+ private:
+  std::shared_ptr<const IDLValue> ptr;
+};
+
+/**
+ * @brief Immutable `IdlArgs` shared by reference counting, see
+ * `SharedIdlValue`.
+ */
+class SharedIdlArgs {
+ public:
+  SharedIdlArgs() = default;
+
+  /**
+   * @brief Shares `args`, which is left empty.
+   */
+  explicit SharedIdlArgs(IdlArgs &&args);
+
+  std::size_t size() const { return args == nullptr ? 0 : args->size(); }
+
+  /**
+   * @brief Borrows the value at `index`, which must be less than `size()`.
+   */
+  IdlValueRef operator[](std::size_t index) const {
+    return args == nullptr ? IdlValueRef(nullptr) : (*args)[index];
+  }
+
+  std::string getText() const;
+  std::vector<uint8_t> getBytes() const;
+
+ private:
+  std::shared_ptr<const IdlArgs> args;
+};
+
+}  // namespace zondax
+
+#endif  // SHARED_IDL_VALUE_H
@@ -0,0 +1,140 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace zondax {
+
+/**
+ * @brief Coalesces concurrent calls that share the same key.
+ *
+ * The first caller for a given key (the leader) executes the work, every
+ * caller arriving while that work is in flight blocks and receives the same
+ * result instead of executing it again. Once the leader finishes the key is
+ * released, so later calls execute normally. If the leader throws, every
+ * caller of the flight receives the exception.
+ *
+ * @tparam T The type produced by the coalesced work.
+ */
+template <typename T>
+class SingleFlight {
+ public:
+  /**
+   * @brief Outcome of SingleFlight::Do.
+   *
+   * `value` is shared between every caller of the same flight. `exclusive` is
+   * set only for the leader when no other caller joined the flight, in which
+   * case the leader is the sole owner and may move out of `value`.
+   */
+  struct Result {
+    std::shared_ptr<T> value;
+    bool exclusive;
+  };
+
+  SingleFlight() = default;
+
+  // The inner mutex can not be copied or moved
+  SingleFlight(const SingleFlight &) = delete;
+  void operator=(const SingleFlight &) = delete;
+
+  /**
+   * @brief Executes `fn` unless a call with the same key is already running,
+   * in which case the result of that call is awaited and returned.
+   *
+   * @param key Identifies calls that are interchangeable.
+   * @param fn Callable returning a T, only invoked by the leader.
+   * @return The (possibly shared) result.
+   */
+  template <typename F>
+  Result Do(const std::string &key, F &&fn);
+
+  /**
+   * @brief Number of callers waiting for the call in flight for `key`.
+   */
+  std::size_t waiting(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = calls.find(key);
+    return it == calls.end() ? 0 : it->second->joined;
+  }
+
+ private:
+  struct Call {
+    std::shared_ptr<T> value;
+    std::exception_ptr error;
+    std::size_t joined = 0;
+    bool done = false;
+  };
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::unordered_map<std::string, std::shared_ptr<Call>> calls;
+};
+
+template <typename T>
+template <typename F>
+typename SingleFlight<T>::Result SingleFlight<T>::Do(const std::string &key,
+                                                     F &&fn) {
+  std::unique_lock<std::mutex> lock(mtx);
+
+  auto it = calls.find(key);
+  if (it != calls.end()) {
+    // keep the call alive even after the leader removes it from the map
+    auto call = it->second;
+    ++call->joined;
+    cv.wait(lock, [&call] { return call->done; });
+    if (call->error) std::rethrow_exception(call->error);
+    return Result{call->value, false};
+  }
+
+  auto call = std::make_shared<Call>();
+  calls.emplace(key, call);
+  lock.unlock();
+
+  std::shared_ptr<T> value;
+  try {
+    value = std::make_shared<T>(fn());
+  } catch (...) {
+    // the waiters get the exception too
+    lock.lock();
+    call->error = std::current_exception();
+    call->done = true;
+    calls.erase(key);
+    cv.notify_all();
+    throw;
+  }
+
+  lock.lock();
+  call->value = value;
+  call->done = true;
+  calls.erase(key);
+  bool exclusive = call->joined == 0;
+  cv.notify_all();
+
+  return Result{std::move(value), exclusive};
+}
+
+}  // namespace zondax
+
+#endif  // SINGLE_FLIGHT_H
@@ -18,11 +18,18 @@
 
 // #include <bits/utility.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <variant>
 
+#include "doctest.h"
+
 using zondax::IdlArgs;
 
 namespace zondax {
@@ -34,24 +41,29 @@ void Agent::error_callback(const unsigned char* data, int len,
 }
 
 // declare move constructor
-Agent::Agent(Agent&& o) noexcept {
-  agent = o.agent;
-  o.agent = nullptr;
-}
+Agent::Agent(Agent&& o) noexcept
+    : endpoints(std::move(o.endpoints)),
+      hedge(o.hedge),
+      hedger(std::move(o.hedger)),
+      inflight(std::move(o.inflight)),
+      coalesceQueries(o.coalesceQueries),
+      canister(std::move(o.canister)),
+      limiter(std::move(o.limiter)) {}
 
 // declare move assignment
 Agent& Agent::operator=(Agent&& o) noexcept {
   // check they are not the same object
   if (&o == this) return *this;
 
-  // now release our inner agent.
-  if (agent != nullptr) agent_destroy(agent);
-
-  // now takes ownership of the o.agent
-  agent = o.agent;
-
-  // ensure o.agent is null
-  o.agent = nullptr;
+  // our inner agents are released once no in flight request uses them
+  // the previous hedger waits for its attempts before the endpoints go
+  hedger = std::move(o.hedger);
+  endpoints = std::move(o.endpoints);
+  hedge = o.hedge;
+  inflight = std::move(o.inflight);
+  coalesceQueries = o.coalesceQueries;
+  canister = std::move(o.canister);
+  limiter = std::move(o.limiter);
 
   return *this;
 }
@@ -59,40 +71,222 @@ Agent& Agent::operator=(Agent&& o) noexcept {
 std::variant<Agent, std::string> Agent::create_agent(
     std::string url, zondax::Identity id, zondax::Principal& principal,
     const std::vector<char>& did_content) {
-  // string to get error message from callback
-  std::string data;
-
-  RetError ret;
-  ret.user_data = (void*)&data;
-  ret.call = Agent::error_callback;
+  return create_agent(std::vector<std::string>{std::move(url)}, std::move(id),
+                      principal, did_content);
+}
 
-  FFIAgent* c_agent = agent_create_wrap(
-      url.c_str(), id.getPtr(), id.getType(), principal.getBytes().data(),
-      principal.getBytes().size(), did_content.data(), &ret);
+std::variant<Agent, std::string> Agent::create_agent(
+    const std::vector<std::string>& urls, zondax::Identity id,
+    zondax::Principal& principal, const std::vector<char>& did_content) {
+  if (urls.empty()) return std::string("At least one url is required");
 
-  if (c_agent == nullptr) {
-    std::variant<Agent, std::string> error(data);
-    return error;
-  }
+  // the did content is read as a C string by the rust side
+  std::string did(did_content.begin(), did_content.end());
+  auto canister = principal.getBytes();
 
   // here we can use private default constructor, but users can't, also if
   // default were disabled using the delete keyboard, we would not be able to
   // use it here.
   auto cpp_agent = Agent();
 
-  cpp_agent.agent = c_agent;
+  for (const auto& url : urls) {
+    // string to get error message from callback
+    std::string data;
+
+    RetError ret;
+    ret.user_data = (void*)&data;
+    ret.call = Agent::error_callback;
+
+    FFIAgent* c_agent =
+        agent_create_wrap(url.c_str(), id.getPtr(), id.getType(),
+                          canister.data(), canister.size(), did.c_str(), &ret);
+
+    if (c_agent == nullptr) {
+      std::variant<Agent, std::string> error(data);
+      return error;
+    }
+
+    Endpoint endpoint;
+    endpoint.agent = std::shared_ptr<FFIAgent>(c_agent, agent_destroy);
+    endpoint.latency = std::make_shared<LatencyTracker>();
+    cpp_agent.endpoints.push_back(std::move(endpoint));
+  }
+
+  cpp_agent.canister = std::move(canister);
+
   std::variant<Agent, std::string> ok(std::move(cpp_agent));
 
   return ok;
 }
 
+void Agent::setRateLimiter(std::shared_ptr<RateLimiter> rateLimiter) noexcept {
+  limiter = std::move(rateLimiter);
+}
+
+std::optional<std::string> Agent::admit(const std::string& method) {
+  if (limiter == nullptr) return std::nullopt;
+
+  return limiter->acquire(canister, method);
+}
+
 /* *********************** Query ************************/
 
+void Agent::setQueryCoalescing(bool enabled) noexcept {
+  coalesceQueries = enabled;
+}
+
+void Agent::setHedgePolicy(const HedgePolicy& policy) noexcept {
+  hedge = policy;
+  hedger->setMaxWorkers(policy.maxWorkers);
+}
+
+Agent::QueryOutcome Agent::queryEndpoint(const Endpoint& endpoint,
+                                         const std::string& method,
+                                         const QueryArgs& args) {
+  RetError ret;
+  std::string data;
+  ret.user_data = (void*)&data;
+  ret.call = Agent::error_callback;
+
+  auto start = std::chrono::steady_clock::now();
+
+  CBytes* reply;
+  if (auto message = std::get_if<1>(&args))
+    reply = agent_query_bytes_wrap(endpoint.agent.get(), method.c_str(),
+                                   message->data(), message->size(), &ret);
+  else
+    reply = agent_query_raw_wrap(endpoint.agent.get(), method.c_str(),
+                                 std::get<0>(args).c_str(), &ret);
+
+  if (reply == nullptr) return data;
+
+  endpoint.latency->record(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start));
+
+  const uint8_t* bytes = cbytes_ptr(reply);
+  std::vector<uint8_t> out(bytes, bytes + cbytes_len(reply));
+  cbytes_destroy(reply);
+
+  return out;
+}
+
+std::vector<std::size_t> Agent::endpointOrder() const {
+  std::vector<std::size_t> order(endpoints.size());
+  std::vector<std::chrono::microseconds> p95(endpoints.size());
+
+  for (std::size_t i = 0; i < endpoints.size(); ++i) {
+    order[i] = i;
+    // endpoints without enough samples are tried in declaration order
+    p95[i] = endpoints[i].latency->percentile(0.95).value_or(
+        std::chrono::microseconds::max());
+  }
+
+  std::stable_sort(order.begin(), order.end(), [&p95](auto a, auto b) {
+    return p95[a] < p95[b];
+  });
+
+  return order;
+}
+
+std::chrono::microseconds Agent::hedgeDelay(const Endpoint& endpoint) const {
+  std::chrono::microseconds delay = hedge.delay;
+
+  if (hedge.adaptive) {
+    auto p95 = endpoint.latency->percentile(0.95);
+    if (p95.has_value()) delay = p95.value();
+  }
+
+  return std::max(delay, std::chrono::microseconds(1000));
+}
+
+Agent::QueryOutcome Agent::queryHedged(const std::string& method,
+                                       const QueryArgs& args) {
+  std::vector<Endpoint> order;
+  for (auto i : endpointOrder()) order.push_back(endpoints[i]);
+
+  auto attempts = std::min(std::max<std::size_t>(hedge.maxAttempts, 1),
+                           endpoints.size());
+
+  // copies, the losing attempts outlive this call
+  auto attempt = [order, method, args](std::size_t i) {
+    return queryEndpoint(order[i], method, args);
+  };
+  auto delay = [this, &order](std::size_t i) { return hedgeDelay(order[i]); };
+
+  return hedger->race(attempts, std::move(attempt), delay);
+}
+
+Agent::QueryOutcome Agent::queryOnce(const std::string& method,
+                                     const QueryArgs& args) {
+  if (!hedge.enabled || endpoints.size() < 2)
+    return queryEndpoint(endpoints.front(), method, args);
+
+  return queryHedged(method, args);
+}
+
+Agent::Reply Agent::QueryBytes(const std::string& method,
+                               zondax::IdlArgs&& args) {
+  if (endpoints.empty()) return std::string("Agent instance uninitialized");
+
+  CText* arg = idl_args_to_text(args.getPtr().get());
+  std::string text(ctext_str(arg), ctext_len(arg));
+  ctext_destroy(arg);
+
+  return query(method, std::move(text));
+}
+
+Agent::Reply Agent::QueryEncoded(const std::string& method,
+                                 std::vector<uint8_t>&& message) {
+  if (endpoints.empty()) return std::string("Agent instance uninitialized");
+
+  return query(method, std::move(message));
+}
+
+Agent::Reply Agent::query(const std::string& method, QueryArgs&& args) {
+  if (!coalesceQueries || inflight == nullptr) {
+    auto rejected = admit(method);
+    if (rejected.has_value()) return rejected.value();
+
+    return queryOnce(method, args);
+  }
+
+  // method names can not contain a NUL, so this can not collide; the kind
+  // of arguments is part of the key, text and bytes are never mixed up
+  std::string key = method;
+  key.push_back('\0');
+  key.push_back(args.index() == 0 ? 't' : 'b');
+  std::visit([&key](const auto& data) { key.append(data.begin(), data.end()); },
+             args);
+
+  // only the leader goes over the wire, so only the leader is admitted
+  auto flight = inflight->Do(key, [&]() -> QueryOutcome {
+    auto rejected = admit(method);
+    if (rejected.has_value()) return rejected.value();
+
+    return queryOnce(method, args);
+  });
+
+  if (flight.value == nullptr)
+    return std::string("Coalesced query failed before completion");
+
+  // the leader of a flight nobody joined owns the result, everybody else
+  // gets its own copy as the shared one may be read concurrently.
+  if (flight.exclusive) return std::move(*flight.value);
+
+  return *flight.value;
+}
+
 std::variant<IdlArgs, std::string> Agent::Query(const std::string& method,
                                                 zondax::IdlArgs&& args) {
-  if (agent == nullptr) return std::string("Agent instance uninitialized");
+  auto reply = QueryBytes(method, std::move(args));
+  if (reply.index() == 1) return std::get<1>(reply);
 
-  CText* arg = idl_args_to_text(args.getPtr().get());
+  return decodeReply(method, std::get<0>(reply));
+}
+
+std::variant<IdlArgs, std::string> Agent::decodeReply(
+    const std::string& method, const std::vector<uint8_t>& reply) {
+  if (endpoints.empty()) return std::string("Agent instance uninitialized");
 
   RetError ret;
   std::string data;
@@ -100,42 +294,232 @@ std::variant<IdlArgs, std::string> Agent::Query(const std::string& method,
   ret.call = Agent::error_callback;
 
   IDLArgs* argsPtr =
-      agent_query_wrap(agent, method.c_str(), ctext_str(arg), &ret);
+      agent_decode_reply_wrap(endpoints.front().agent.get(), method.c_str(),
+                              reply.data(), reply.size(), &ret);
 
   if (argsPtr == nullptr) return std::string(data);
 
   auto idlArgs = IdlArgs(argsPtr);
   idlArgs.ensureNonEmpty();
 
-  return std::move(idlArgs);
+  return idlArgs;
 }
 
 /* *********************** Update ************************/
 
-std::variant<IdlArgs, std::string> Agent::Update(const std::string& method,
-                                                 IdlArgs&& args) {
-  if (agent == nullptr) return std::string("Agent instance uninitialized");
+Agent::Reply Agent::UpdateBytes(const std::string& method, IdlArgs&& args) {
+  if (endpoints.empty()) return std::string("Agent instance uninitialized");
+
+  auto rejected = admit(method);
+  if (rejected.has_value()) return rejected.value();
 
   CText* arg = idl_args_to_text(args.getPtr().get());
+  std::string text(ctext_str(arg), ctext_len(arg));
+  ctext_destroy(arg);
 
   RetError ret;
   std::string data;
   ret.user_data = (void*)&data;
   ret.call = Agent::error_callback;
 
-  IDLArgs* argsPtr =
-      agent_update_wrap(agent, method.c_str(), ctext_str(arg), &ret);
+  CBytes* reply =
+      agent_update_raw_wrap(endpoints.front().agent.get(), method.c_str(),
+                            text.c_str(), &ret);
 
-  if (argsPtr == nullptr) return std::string(data);
+  if (reply == nullptr) return std::string(data);
 
-  auto idlArgs = IdlArgs(argsPtr);
-  idlArgs.ensureNonEmpty();
+  const uint8_t* bytes = cbytes_ptr(reply);
+  std::vector<uint8_t> out(bytes, bytes + cbytes_len(reply));
+  cbytes_destroy(reply);
+
+  return out;
+}
+
+Agent::Reply Agent::UpdateBytes(const std::string& method, ArgWriter&& args) {
+  if (endpoints.empty()) return std::string("Agent instance uninitialized");
+
+  auto released = args.release();
+  if (released.index() == 1) return std::get<1>(released);
+
+  return UpdateEncoded(method, std::get<0>(released));
+}
+
+Agent::Reply Agent::UpdateEncoded(const std::string& method,
+                                  CBytes* message) {
+  if (endpoints.empty()) {
+    cbytes_destroy(message);
+    return std::string("Agent instance uninitialized");
+  }
+
+  auto rejected = admit(method);
+  if (rejected.has_value()) {
+    cbytes_destroy(message);
+    return rejected.value();
+  }
+
+  RetError ret;
+  std::string data;
+  ret.user_data = (void*)&data;
+  ret.call = Agent::error_callback;
+
+  // the wrapper takes ownership of the message
+  CBytes* reply = agent_update_bytes_wrap(endpoints.front().agent.get(),
+                                          method.c_str(), message, &ret);
+
+  if (reply == nullptr) return std::string(data);
+
+  const uint8_t* bytes = cbytes_ptr(reply);
+  std::vector<uint8_t> out(bytes, bytes + cbytes_len(reply));
+  cbytes_destroy(reply);
+
+  return out;
+}
+
+std::variant<IdlArgs, std::string> Agent::Update(const std::string& method,
+                                                 ArgWriter&& args) {
+  auto reply = UpdateBytes(method, std::move(args));
+  if (reply.index() == 1) return std::get<1>(reply);
 
-  return std::move(idlArgs);
+  return decodeReply(method, std::get<0>(reply));
 }
 
-Agent::~Agent() {
-  if (agent != nullptr) agent_destroy(agent);
+std::variant<IdlArgs, std::string> Agent::Update(const std::string& method,
+                                                 IdlArgs&& args) {
+  auto reply = UpdateBytes(method, std::move(args));
+  if (reply.index() == 1) return std::get<1>(reply);
+
+  return decodeReply(method, std::get<0>(reply));
+}
+
+/* *********************** IdlTree ************************/
+
+std::variant<IdlTree, std::string> Agent::QueryTree(
+    const std::string& method, const IdlTree& args,
+    std::pmr::memory_resource* resource) {
+  auto encoded = args.encode();
+  if (encoded.index() == 1) return std::get<1>(encoded);
+
+  auto reply = QueryEncoded(method, std::move(std::get<0>(encoded)));
+  if (reply.index() == 1) return std::get<1>(reply);
+
+  return IdlTree::decode(std::get<0>(reply), resource);
+}
+
+std::variant<IdlTree, std::string> Agent::UpdateTree(
+    const std::string& method, const IdlTree& args,
+    std::pmr::memory_resource* resource) {
+  auto encoded = args.encode();
+  if (encoded.index() == 1) return std::get<1>(encoded);
+
+  // copied once, into the buffer the request takes over
+  const auto& bytes = std::get<0>(encoded);
+  CBytes* message = cbytes_with_capacity(bytes.size());
+  cbytes_append(message, bytes.data(), bytes.size());
+
+  auto reply = UpdateEncoded(method, message);
+  if (reply.index() == 1) return std::get<1>(reply);
+
+  return IdlTree::decode(std::get<0>(reply), resource);
 }
 
+Agent::~Agent() {}
+
 }  // namespace zondax
+
+// ------------------------------------------------- TESTS
+using namespace zondax;
+
+TEST_CASE("SingleFlight runs alone calls exclusively") {
+  SingleFlight<int> group;
+  int calls = 0;
+
+  auto result = group.Do("key", [&]() { return ++calls; });
+
+  REQUIRE(calls == 1);
+  REQUIRE(result.exclusive);
+  REQUIRE(*result.value == 1);
+
+  // the key is released once the call completes
+  auto again = group.Do("key", [&]() { return ++calls; });
+  REQUIRE(calls == 2);
+  REQUIRE(*again.value == 2);
+}
+
+TEST_CASE("SingleFlight coalesces concurrent calls with the same key") {
+  SingleFlight<int> group;
+  std::atomic<int> calls{0};
+  constexpr std::size_t kCallers = 8;
+
+  // the leader only completes once every other caller joined its flight
+  auto work = [&]() {
+    ++calls;
+    while (group.waiting("same") < kCallers - 1) std::this_thread::yield();
+    return 42;
+  };
+
+  std::vector<std::thread> threads;
+  std::vector<int> results(kCallers, 0);
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    threads.emplace_back(
+        [&, i]() { results[i] = *group.Do("same", work).value; });
+  }
+
+  for (auto &t : threads) t.join();
+
+  REQUIRE(calls == 1);
+  for (auto r : results) REQUIRE(r == 42);
+}
+
+TEST_CASE("SingleFlight passes the exception of the leader on") {
+  SingleFlight<int> group;
+  std::atomic<int> calls{0};
+  std::atomic<int> failed{0};
+  constexpr std::size_t kCallers = 4;
+
+  auto work = [&]() -> int {
+    ++calls;
+    while (group.waiting("same") < kCallers - 1) std::this_thread::yield();
+    throw std::runtime_error("query failed");
+  };
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < kCallers; ++i) {
+    threads.emplace_back([&]() {
+      try {
+        group.Do("same", work);
+      } catch (const std::runtime_error &) {
+        ++failed;
+      }
+    });
+  }
+
+  for (auto &t : threads) t.join();
+
+  REQUIRE(calls == 1);
+  REQUIRE(failed == (int)kCallers);
+}
+
+TEST_CASE("SingleFlight does not coalesce different keys") {
+  SingleFlight<int> group;
+  int calls = 0;
+
+  group.Do("a", [&]() { return ++calls; });
+  group.Do("b", [&]() { return ++calls; });
+
+  REQUIRE(calls == 2);
+}
+
+TEST_CASE("Agent calls returning several values read them as a tuple") {
+  using Reply = std::variant<std::optional<std::tuple<std::string, uint64_t>>,
+                             std::string>;
+  std::string arg;
+
+  using QueryReply =
+      decltype(std::declval<Agent &>().Query<std::string, uint64_t>(
+          std::declval<const std::string &>(), arg));
+  using UpdateReply =
+      decltype(std::declval<Agent &>().Update<std::string, uint64_t>(
+          std::declval<const std::string &>(), arg));
+  static_assert(std::is_same_v<QueryReply, Reply>);
+  static_assert(std::is_same_v<UpdateReply, Reply>);
+}
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "arg_writer.h"
+
+#include "doctest.h"
+
+namespace zondax {
+
+ArgWriter::ArgWriter(std::size_t sizeHint)
+    : buffer(cbytes_with_capacity(sizeHint)),
+      nextArg(0),
+      pending(0),
+      elementTag(nullptr) {
+  staging.reserve(std::min(sizeHint, kFlushSize) + 1024);
+}
+
+ArgWriter::ArgWriter(ArgWriter &&o) noexcept
+    : buffer(o.buffer),
+      staging(std::move(o.staging)),
+      table(std::move(o.table)),
+      argTypes(std::move(o.argTypes)),
+      nextArg(o.nextArg),
+      pending(o.pending),
+      elementTag(o.elementTag) {
+  o.buffer = nullptr;
+}
+
+ArgWriter &ArgWriter::operator=(ArgWriter &&o) noexcept {
+  if (this != &o) {
+    if (buffer != nullptr) cbytes_destroy(buffer);
+    buffer = o.buffer;
+    staging = std::move(o.staging);
+    table = std::move(o.table);
+    argTypes = std::move(o.argTypes);
+    nextArg = o.nextArg;
+    pending = o.pending;
+    elementTag = o.elementTag;
+    o.buffer = nullptr;
+  }
+  return *this;
+}
+
+ArgWriter::~ArgWriter() {
+  if (buffer != nullptr) cbytes_destroy(buffer);
+}
+
+std::size_t ArgWriter::size() const {
+  if (buffer == nullptr) return 0;
+  return cbytes_len(buffer) + staging.size();
+}
+
+void ArgWriter::flush(bool force) {
+  if (staging.empty() || (!force && staging.size() < kFlushSize)) return;
+
+  cbytes_append(buffer, staging.data(), staging.size());
+  staging.clear();
+}
+
+std::variant<CBytes *, std::string> ArgWriter::release() {
+  if (buffer == nullptr) return std::string("Arguments already released");
+  if (!complete()) return std::string("Missing arguments");
+
+  flush(true);
+
+  CBytes *out = buffer;
+  buffer = nullptr;
+  return out;
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+
+using namespace zondax;
+
+namespace {
+std::vector<uint8_t> take(ArgWriter &writer) {
+  auto released = writer.release();
+  REQUIRE(released.index() == 0);
+
+  CBytes *bytes = std::get<0>(released);
+  std::vector<uint8_t> out(cbytes_ptr(bytes),
+                           cbytes_ptr(bytes) + cbytes_len(bytes));
+  cbytes_destroy(bytes);
+  return out;
+}
+}  // namespace
+
+TEST_CASE("ArgWriter writes what IdlEncoder writes") {
+  using Row = std::tuple<uint64_t, std::string>;
+  std::vector<Row> rows;
+  for (uint64_t i = 0; i < 20000; ++i) rows.emplace_back(i, std::to_string(i));
+  std::vector<uint8_t> blob(200000, 7);
+
+  auto expected = IdlEncoder::encode(std::string("batch"), rows, blob);
+  REQUIRE(expected.index() == 0);
+
+  auto writer =
+      ArgWriter::create<std::string, std::vector<Row>, std::vector<uint8_t>>();
+  REQUIRE(writer.arg(std::string("batch")));
+  REQUIRE(writer.beginVec<Row>(rows.size()));
+  for (const auto &row : rows) REQUIRE(writer.element(row));
+  REQUIRE(!writer.complete());
+  REQUIRE(writer.arg(BlobView(blob)));
+  REQUIRE(writer.complete());
+  REQUIRE(writer.size() == std::get<0>(expected).size());
+
+  REQUIRE(take(writer) == std::get<0>(expected));
+  REQUIRE(writer.release().index() == 1);
+}
+
+TEST_CASE("ArgWriter checks the declared types") {
+  auto writer = ArgWriter::create<uint32_t, std::vector<uint16_t>>();
+
+  // wrong type, nothing is written
+  auto size = writer.size();
+  REQUIRE(!writer.arg(uint64_t(1)));
+  REQUIRE(!writer.beginVec<uint16_t>(1));
+  REQUIRE(writer.size() == size);
+  REQUIRE(writer.release().index() == 1);
+
+  REQUIRE(writer.arg(uint32_t(1)));
+  REQUIRE(writer.beginVec<uint16_t>(2));
+  REQUIRE(!writer.element(uint32_t(1)));
+  REQUIRE(writer.element(uint16_t(1)));
+  REQUIRE(writer.element(uint16_t(2)));
+  REQUIRE(!writer.element(uint16_t(3)));
+  REQUIRE(!writer.arg(uint32_t(1)));
+
+  auto expected = IdlEncoder::encode(uint32_t(1), std::vector<uint16_t>{1, 2});
+  REQUIRE(take(writer) == std::get<0>(expected));
+}
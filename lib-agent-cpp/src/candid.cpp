@@ -0,0 +1,375 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "candid.h"
+
+#include "doctest.h"
+
+namespace zondax::candid {
+
+bool writeBigNumber(std::vector<uint8_t>& out, std::string_view decimal,
+                    bool isSigned) {
+  bool negative = false;
+  if (!decimal.empty() && (decimal[0] == '-' || decimal[0] == '+')) {
+    negative = decimal[0] == '-';
+    decimal.remove_prefix(1);
+  }
+  if (decimal.empty() || (negative && !isSigned)) return false;
+
+  // little endian base 2^32 limbs of the magnitude
+  std::vector<uint32_t> limbs{0};
+  bool digits = false;
+  for (char c : decimal) {
+    if (c == '_') continue;
+    if (c < '0' || c > '9') return false;
+    digits = true;
+
+    uint64_t carry = static_cast<uint64_t>(c - '0');
+    for (auto& limb : limbs) {
+      uint64_t v = static_cast<uint64_t>(limb) * 10 + carry;
+      limb = static_cast<uint32_t>(v);
+      carry = v >> 32;
+    }
+    if (carry != 0) limbs.push_back(static_cast<uint32_t>(carry));
+  }
+  if (!digits) return false;
+
+  if (!isSigned) {
+    bool more = true;
+    while (more) {
+      uint8_t byte = limbs[0] & 0x7f;
+      for (std::size_t i = 0; i < limbs.size(); ++i) {
+        uint32_t next = i + 1 < limbs.size() ? limbs[i + 1] : 0;
+        limbs[i] = (limbs[i] >> 7) | (next << 25);
+      }
+      more = std::any_of(limbs.begin(), limbs.end(),
+                         [](uint32_t l) { return l != 0; });
+      out.push_back(more ? byte | 0x80 : byte);
+    }
+    return true;
+  }
+
+  // two's complement, with a spare limb so the sign bit is always present
+  limbs.push_back(0);
+  if (negative) {
+    uint64_t carry = 1;
+    for (auto& limb : limbs) {
+      uint64_t v = static_cast<uint64_t>(~limb) + carry;
+      limb = static_cast<uint32_t>(v);
+      carry = v >> 32;
+    }
+  }
+
+  bool more = true;
+  while (more) {
+    uint8_t byte = limbs[0] & 0x7f;
+    for (std::size_t i = 0; i + 1 < limbs.size(); ++i)
+      limbs[i] = (limbs[i] >> 7) | (limbs[i + 1] << 25);
+    limbs.back() = static_cast<uint32_t>(static_cast<int32_t>(limbs.back()) >> 7);
+
+    bool zero = std::all_of(limbs.begin(), limbs.end(),
+                            [](uint32_t l) { return l == 0; });
+    bool minusOne = std::all_of(limbs.begin(), limbs.end(),
+                                [](uint32_t l) { return l == 0xffffffff; });
+    if ((zero && !(byte & 0x40)) || (minusOne && (byte & 0x40))) {
+      more = false;
+    } else {
+      byte |= 0x80;
+    }
+    out.push_back(byte);
+  }
+
+  return true;
+}
+
+bool readBigNumber(Reader& in, bool isSigned, std::string& out) {
+  // little endian base 2^32 limbs, filled 7 bits at a time
+  std::vector<uint32_t> limbs;
+  std::size_t bits = 0;
+  uint8_t byte;
+  do {
+    if (bits / 7 == kMaxBigNumberBytes || !in.readByte(byte)) return false;
+
+    uint32_t group = byte & 0x7f;
+    std::size_t limb = bits / 32, offset = bits % 32;
+    if (limbs.size() <= limb + 1) limbs.resize(limb + 2, 0);
+    limbs[limb] |= group << offset;
+    if (offset > 25) limbs[limb + 1] |= group >> (32 - offset);
+    bits += 7;
+  } while (byte & 0x80);
+
+  bool negative = isSigned && (byte & 0x40);
+  if (negative) {
+    // sign extend then take the two's complement to get the magnitude
+    std::size_t limb = bits / 32, offset = bits % 32;
+    if (offset != 0) limbs[limb] |= ~uint32_t(0) << offset;
+    for (std::size_t i = limb + 1; i < limbs.size(); ++i) limbs[i] = ~uint32_t(0);
+
+    uint64_t carry = 1;
+    for (auto& l : limbs) {
+      uint64_t v = static_cast<uint64_t>(~l) + carry;
+      l = static_cast<uint32_t>(v);
+      carry = v >> 32;
+    }
+  }
+
+  while (limbs.size() > 1 && limbs.back() == 0) limbs.pop_back();
+
+  // repeated division by 10^9, collecting the digits from the lowest
+  std::string digits;
+  bool zero = false;
+  while (!zero) {
+    uint64_t rem = 0;
+    zero = true;
+    for (auto it = limbs.rbegin(); it != limbs.rend(); ++it) {
+      uint64_t cur = (rem << 32) | *it;
+      *it = static_cast<uint32_t>(cur / 1000000000);
+      rem = cur % 1000000000;
+      if (*it != 0) zero = false;
+    }
+    for (int i = 0; i < 9; ++i) {
+      digits.push_back(static_cast<char>('0' + rem % 10));
+      rem /= 10;
+      if (zero && rem == 0) break;
+    }
+  }
+
+  while (digits.size() > 1 && digits.back() == '0') digits.pop_back();
+  if (negative) digits.push_back('-');
+
+  out.assign(digits.rbegin(), digits.rend());
+  return true;
+}
+
+std::size_t TypeTable::reserve() {
+  entries.emplace_back();
+  return entries.size() - 1;
+}
+
+TypeRef TypeTable::commit(std::size_t index,
+                          const std::vector<uint8_t>& entry) {
+  std::string key(entry.begin(), entry.end());
+
+  auto it = indexes.find(key);
+  if (it != indexes.end()) {
+    // an equal type already has an entry, so do its components and nothing
+    // was added after our reservation
+    entries.resize(index);
+    return static_cast<TypeRef>(it->second);
+  }
+
+  indexes.emplace(key, index);
+  entries[index] = std::move(key);
+
+  return static_cast<TypeRef>(index);
+}
+
+void TypeTable::truncate(std::size_t size) {
+  while (entries.size() > size) {
+    indexes.erase(entries.back());
+    entries.pop_back();
+  }
+}
+
+void TypeTable::write(std::vector<uint8_t>& out) const {
+  writeLeb128(out, entries.size());
+  for (const auto& entry : entries) out.insert(out.end(), entry.begin(), entry.end());
+}
+
+void TypeTable::clear() {
+  entries.clear();
+  indexes.clear();
+}
+
+void writeHeader(std::vector<uint8_t>& out, const TypeTable& table,
+                 const TypeRef* argTypes, std::size_t count) {
+  out.insert(out.end(), std::begin(kMagic), std::end(kMagic));
+  table.write(out);
+
+  writeLeb128(out, count);
+  for (std::size_t i = 0; i < count; ++i) writeSleb128(out, argTypes[i]);
+}
+
+}  // namespace zondax::candid
+
+// ------------------------------------------------- TESTS
+using namespace zondax::candid;
+
+TEST_CASE("Candid label hashes") {
+  REQUIRE(idl_hash("") == 0);
+  REQUIRE(idl_hash("a") == 97);
+  // from the Candid specification examples
+  REQUIRE(idl_hash("foo") == 5097222);
+  REQUIRE(idl_hash("bar") == 4895187);
+  static_assert(idl_hash("a") == 97);
+}
+
+TEST_CASE("Candid label index") {
+  static constexpr LabelIndex<4> labels{
+      {idl_hash("foo"), idl_hash("bar"), idl_hash("a"), idl_hash("zz")}};
+  static_assert(labels.find(idl_hash("bar")) == 1);
+
+  REQUIRE(labels.find(idl_hash("foo")) == 0);
+  REQUIRE(labels.find(idl_hash("a")) == 2);
+  REQUIRE(labels.find(idl_hash("zz")) == 3);
+  REQUIRE(labels.find(idl_hash("other")) == 4);
+  REQUIRE(labels.find(0) == 4);
+  REQUIRE(labels.find(UINT32_MAX) == 4);
+}
+
+TEST_CASE("Candid LEB128 and SLEB128") {
+  std::vector<uint8_t> out;
+
+  writeLeb128(out, 0);
+  writeLeb128(out, 127);
+  writeLeb128(out, 624485);
+  REQUIRE(out == std::vector<uint8_t>{0x00, 0x7f, 0xe5, 0x8e, 0x26});
+
+  out.clear();
+  writeSleb128(out, -1);
+  writeSleb128(out, 63);
+  writeSleb128(out, 64);
+  writeSleb128(out, -123456);
+  REQUIRE(out ==
+          std::vector<uint8_t>{0x7f, 0x3f, 0xc0, 0x00, 0xc0, 0xbb, 0x78});
+}
+
+TEST_CASE("Candid big numbers") {
+  std::vector<uint8_t> out;
+
+  REQUIRE(writeBigNumber(out, "624485", false));
+  REQUIRE(out == std::vector<uint8_t>{0xe5, 0x8e, 0x26});
+
+  out.clear();
+  REQUIRE(writeBigNumber(out, "-123456", true));
+  REQUIRE(out == std::vector<uint8_t>{0xc0, 0xbb, 0x78});
+
+  // 2^64 does not fit a machine word
+  out.clear();
+  REQUIRE(writeBigNumber(out, "18446744073709551616", false));
+  REQUIRE(out == std::vector<uint8_t>{0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+                                      0x80, 0x80, 0x02});
+
+  out.clear();
+  REQUIRE(writeBigNumber(out, "-18446744073709551616", true));
+  REQUIRE(out == std::vector<uint8_t>{0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+                                      0x80, 0x80, 0x7e});
+
+  out.clear();
+  REQUIRE(writeBigNumber(out, "1_000", true));
+  REQUIRE(out == std::vector<uint8_t>{0xe8, 0x07});
+
+  out.clear();
+  REQUIRE(!writeBigNumber(out, "-1", false));
+  REQUIRE(!writeBigNumber(out, "12a", true));
+  REQUIRE(!writeBigNumber(out, "", true));
+  REQUIRE(out.empty());
+}
+
+TEST_CASE("Candid type table shares equal entries") {
+  TypeTable table;
+
+  // record { vec nat8; vec nat8 } takes index 0, its component index 1
+  auto record = table.reserve();
+  std::vector<TypeRef> fields;
+  for (int i = 0; i < 2; ++i) {
+    auto vec = table.reserve();
+    std::vector<uint8_t> entry;
+    writeSleb128(entry, ref(Opcode::Vec));
+    writeSleb128(entry, ref(Opcode::Nat8));
+    fields.push_back(table.commit(vec, entry));
+  }
+  REQUIRE(fields[0] == 1);
+  REQUIRE(fields[1] == 1);
+
+  std::vector<uint8_t> entry;
+  writeSleb128(entry, ref(Opcode::Record));
+  writeLeb128(entry, 2);
+  for (int i = 0; i < 2; ++i) {
+    writeLeb128(entry, i);
+    writeSleb128(entry, fields[i]);
+  }
+  REQUIRE(table.commit(record, entry) == 0);
+  REQUIRE(table.size() == 2);
+
+  std::vector<uint8_t> out;
+  table.write(out);
+  REQUIRE(out == std::vector<uint8_t>{2, 0x6c, 2, 0, 1, 1, 1, 0x6d, 0x7b});
+}
+
+TEST_CASE("Candid reader") {
+  std::vector<uint8_t> bytes{0xe5, 0x8e, 0x26, 0xc0, 0xbb, 0x78, 0x01,
+                             0x02, 0x03, 0x04, 0x80};
+  Reader in(bytes.data(), bytes.size());
+
+  uint64_t leb;
+  int64_t sleb;
+  uint32_t fixed;
+  REQUIRE(in.readLeb128(leb));
+  REQUIRE(leb == 624485);
+  REQUIRE(in.readSleb128(sleb));
+  REQUIRE(sleb == -123456);
+  REQUIRE(in.readFixed(fixed));
+  REQUIRE(fixed == 0x04030201);
+
+  // truncated number
+  REQUIRE(!in.readLeb128(leb));
+
+  std::vector<uint8_t> overflow(11, 0xff);
+  Reader over(overflow.data(), overflow.size());
+  REQUIRE(!over.readLeb128(leb));
+}
+
+TEST_CASE("Candid big numbers round trip") {
+  for (auto number : {"0", "127", "-1", "-64", "64", "624485", "-123456",
+                      "18446744073709551616", "-18446744073709551616",
+                      "123456789012345678901234567890"}) {
+    std::vector<uint8_t> bytes;
+    REQUIRE(writeBigNumber(bytes, number, true));
+
+    Reader in(bytes.data(), bytes.size());
+    std::string decoded;
+    REQUIRE(readBigNumber(in, true, decoded));
+    REQUIRE(decoded == number);
+    REQUIRE(in.remaining() == 0);
+  }
+
+  std::vector<uint8_t> bytes;
+  REQUIRE(writeBigNumber(bytes, "18446744073709551616", false));
+  Reader in(bytes.data(), bytes.size());
+  std::string decoded;
+  REQUIRE(readBigNumber(in, false, decoded));
+  REQUIRE(decoded == "18446744073709551616");
+}
+
+TEST_CASE("Candid big numbers have a maximum length") {
+  // the longest number accepted, 2^(7 * kMaxBigNumberBytes) - 1
+  std::vector<uint8_t> longest(kMaxBigNumberBytes, 0xff);
+  longest.back() = 0x7f;
+  Reader in(longest.data(), longest.size());
+  std::string decoded;
+  REQUIRE(readBigNumber(in, false, decoded));
+  REQUIRE(decoded.size() > 8000);
+
+  // one more byte is rejected, before the rest is read
+  std::vector<uint8_t> overlong(1 << 20, 0xff);
+  overlong.back() = 0x7f;
+  Reader over(overlong.data(), overlong.size());
+  REQUIRE(!readBigNumber(over, false, decoded));
+  REQUIRE(over.remaining() == overlong.size() - kMaxBigNumberBytes);
+
+  Reader signedOver(overlong.data(), overlong.size());
+  REQUIRE(!readBigNumber(signedOver, true, decoded));
+}
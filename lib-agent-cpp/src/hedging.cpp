@@ -0,0 +1,375 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "hedging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <utility>
+
+#include "doctest.h"
+
+namespace zondax {
+
+LatencyTracker::LatencyTracker(std::size_t capacity, std::size_t minSamples)
+    : capacity(std::max<std::size_t>(capacity, 1)),
+      minSamples(std::max<std::size_t>(minSamples, 1)),
+      next(0) {
+  samples.reserve(this->capacity);
+}
+
+void LatencyTracker::record(std::chrono::microseconds latency) {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  if (samples.size() < capacity) {
+    samples.push_back(latency.count());
+  } else {
+    // overwrite the oldest sample
+    samples[next] = latency.count();
+  }
+  next = (next + 1) % capacity;
+}
+
+std::optional<std::chrono::microseconds> LatencyTracker::percentile(
+    double p) const {
+  std::vector<int64_t> window;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (samples.size() < minSamples) return std::nullopt;
+    window = samples;
+  }
+
+  p = std::clamp(p, 0.0, 1.0);
+  auto rank = static_cast<std::size_t>(
+      std::ceil(p * static_cast<double>(window.size())));
+  auto index = rank == 0 ? 0 : rank - 1;
+
+  std::nth_element(window.begin(), window.begin() + index, window.end());
+
+  return std::chrono::microseconds(window[index]);
+}
+
+QueryHedger::~QueryHedger() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  ready.notify_all();
+
+  // workers drain the attempts still queued or in flight first
+  for (auto &worker : workers) worker.join();
+}
+
+void QueryHedger::submit(std::function<void()> task) {
+  std::lock_guard<std::mutex> lock(mtx);
+  tasks.push_back(std::move(task));
+
+  if (tasks.size() > idle && workers.size() < maxWorkers) {
+    workers.emplace_back(&QueryHedger::work, this);
+  } else {
+    ready.notify_one();
+  }
+}
+
+void QueryHedger::work() {
+  std::unique_lock<std::mutex> lock(mtx);
+
+  for (;;) {
+    if (tasks.empty()) {
+      if (stopping) return;
+
+      ++idle;
+      ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+      --idle;
+      continue;
+    }
+
+    auto task = std::move(tasks.front());
+    tasks.pop_front();
+
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+std::size_t QueryHedger::workerCount() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return workers.size();
+}
+
+void QueryHedger::setMaxWorkers(std::size_t maxWorkers) {
+  std::lock_guard<std::mutex> lock(mtx);
+  this->maxWorkers = std::max<std::size_t>(maxWorkers, 1);
+}
+
+QueryHedger::Outcome QueryHedger::race(std::size_t attempts, Attempt attempt,
+                                       const Delay &delay) {
+  // state shared with the attempts, which outlive this call when they lose
+  // the race
+  struct Race {
+    std::mutex mtx;
+    std::condition_variable cv;
+    Attempt attempt;
+    std::optional<std::vector<uint8_t>> winner;
+    std::string error;
+    std::size_t pending = 0;
+  };
+
+  auto state = std::make_shared<Race>();
+  state->attempt = std::move(attempt);
+  attempts = std::max<std::size_t>(attempts, 1);
+
+  std::unique_lock<std::mutex> lock(state->mtx);
+
+  auto launch = [this, &state](std::size_t i) {
+    ++state->pending;
+    submit([state, i]() {
+      auto outcome = state->attempt(i);
+
+      std::lock_guard<std::mutex> guard(state->mtx);
+      --state->pending;
+      if (outcome.index() == 0) {
+        // late answers are dropped, the first valid one is kept
+        if (!state->winner.has_value())
+          state->winner = std::move(std::get<0>(outcome));
+      } else {
+        state->error = std::move(std::get<1>(outcome));
+      }
+      state->cv.notify_all();
+    });
+  };
+
+  auto settled = [&state]() {
+    return state->winner.has_value() || state->pending == 0;
+  };
+
+  std::size_t launched = 0;
+  launch(launched++);
+
+  while (!state->winner.has_value()) {
+    if (launched == attempts) {
+      state->cv.wait(lock, settled);
+      if (state->pending == 0) break;
+      continue;
+    }
+
+    // hedge once the attempt in flight is slower than expected, or right
+    // away when every attempt so far failed
+    state->cv.wait_for(lock, delay(launched - 1), settled);
+    if (!state->winner.has_value()) launch(launched++);
+  }
+
+  if (state->winner.has_value()) return std::move(state->winner.value());
+
+  return state->error;
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+using namespace zondax;
+
+TEST_CASE("LatencyTracker needs enough samples") {
+  LatencyTracker tracker(8, 4);
+
+  tracker.record(std::chrono::microseconds(10));
+  tracker.record(std::chrono::microseconds(20));
+  tracker.record(std::chrono::microseconds(30));
+  REQUIRE(!tracker.percentile(0.95).has_value());
+
+  tracker.record(std::chrono::microseconds(40));
+  REQUIRE(tracker.percentile(0.95).has_value());
+}
+
+TEST_CASE("LatencyTracker percentiles") {
+  LatencyTracker tracker(100, 1);
+
+  for (int i = 100; i >= 1; --i) tracker.record(std::chrono::microseconds(i));
+
+  REQUIRE(tracker.percentile(0.95).value().count() == 95);
+  REQUIRE(tracker.percentile(0.5).value().count() == 50);
+  REQUIRE(tracker.percentile(1.0).value().count() == 100);
+  REQUIRE(tracker.percentile(0.0).value().count() == 1);
+}
+
+TEST_CASE("LatencyTracker keeps a sliding window") {
+  LatencyTracker tracker(4, 1);
+
+  for (int i = 0; i < 4; ++i) tracker.record(std::chrono::microseconds(1000));
+  for (int i = 0; i < 4; ++i) tracker.record(std::chrono::microseconds(1));
+
+  REQUIRE(tracker.percentile(1.0).value().count() == 1);
+}
+
+namespace {
+
+// A query attempt blocked until the test releases it
+struct Gate {
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool open = false;
+
+  void release() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      open = true;
+    }
+    cv.notify_all();
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this] { return open; });
+  }
+};
+
+QueryHedger::Outcome reply(uint8_t byte) {
+  return std::vector<uint8_t>{byte};
+}
+
+constexpr auto kNever = std::chrono::hours(1);
+
+}  // namespace
+
+TEST_CASE("QueryHedger returns the first attempt when it is fast") {
+  std::atomic<int> calls{0};
+  QueryHedger hedger;
+
+  auto outcome = hedger.race(
+      3,
+      [&](std::size_t i) {
+        ++calls;
+        return reply(static_cast<uint8_t>(i));
+      },
+      [](std::size_t) { return kNever; });
+
+  REQUIRE(outcome.index() == 0);
+  REQUIRE(std::get<0>(outcome) == std::vector<uint8_t>{0});
+  REQUIRE(calls == 1);
+}
+
+TEST_CASE("QueryHedger hedges a slow endpoint") {
+  Gate slow;
+  std::atomic<bool> slowDone{false};
+  {
+    QueryHedger hedger;
+
+    auto outcome = hedger.race(
+        2,
+        [&](std::size_t i) {
+          if (i == 0) {
+            // answers only once the race is over
+            slow.wait();
+            slowDone = true;
+            return reply(0);
+          }
+          return reply(1);
+        },
+        [](std::size_t) { return std::chrono::microseconds(1000); });
+
+    REQUIRE(outcome.index() == 0);
+    REQUIRE(std::get<0>(outcome) == std::vector<uint8_t>{1});
+    REQUIRE(!slowDone);
+
+    // the losing attempt completes before the hedger is gone
+    slow.release();
+  }
+  REQUIRE(slowDone);
+}
+
+TEST_CASE("QueryHedger fails over right away") {
+  QueryHedger hedger;
+
+  // the delay is never waited for, the first attempt failed
+  auto outcome = hedger.race(
+      2,
+      [](std::size_t i) -> QueryHedger::Outcome {
+        if (i == 0) return std::string("replica unavailable");
+        return reply(1);
+      },
+      [](std::size_t) { return kNever; });
+
+  REQUIRE(outcome.index() == 0);
+  REQUIRE(std::get<0>(outcome) == std::vector<uint8_t>{1});
+}
+
+TEST_CASE("QueryHedger reports the last error when every attempt fails") {
+  std::atomic<int> calls{0};
+  QueryHedger hedger;
+
+  auto outcome = hedger.race(
+      3,
+      [&](std::size_t i) -> QueryHedger::Outcome {
+        ++calls;
+        return "failed " + std::to_string(i);
+      },
+      [](std::size_t) { return kNever; });
+
+  REQUIRE(outcome.index() == 1);
+  REQUIRE(std::get<1>(outcome) == "failed 2");
+  REQUIRE(calls == 3);
+}
+
+TEST_CASE("QueryHedger reuses its workers") {
+  QueryHedger hedger;
+
+  for (int i = 0; i < 50; ++i) {
+    auto outcome = hedger.race(
+        2, [](std::size_t) { return reply(7); },
+        [](std::size_t) { return kNever; });
+    REQUIRE(outcome.index() == 0);
+  }
+
+  // one attempt at a time was ever in flight, a completed attempt may
+  // still be returning its worker when the next one is submitted
+  REQUIRE(hedger.workerCount() <= 2);
+}
+
+TEST_CASE("QueryHedger bounds its workers") {
+  constexpr std::size_t kQueries = 12;
+  Gate gate;
+  std::atomic<std::size_t> started{0};
+  std::vector<QueryHedger::Outcome> outcomes(kQueries);
+  QueryHedger hedger(3);
+
+  // a burst of concurrent queries whose attempts all block
+  std::vector<std::thread> queries;
+  for (std::size_t q = 0; q < kQueries; ++q) {
+    queries.emplace_back([&, q]() {
+      outcomes[q] = hedger.race(
+          1,
+          [&](std::size_t) {
+            ++started;
+            gate.wait();
+            return reply(9);
+          },
+          [](std::size_t) { return kNever; });
+    });
+  }
+
+  while (started < 3) std::this_thread::yield();
+  REQUIRE(hedger.workerCount() == 3);
+
+  // the queued attempts run once workers are free
+  gate.release();
+  for (auto &query : queries) query.join();
+
+  REQUIRE(started == kQueries);
+  REQUIRE(hedger.workerCount() == 3);
+  for (auto &outcome : outcomes) REQUIRE(outcome.index() == 0);
+}
@@ -0,0 +1,183 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "idl_arena.h"
+
+#include <algorithm>
+#include <new>
+
+#include "doctest.h"
+
+namespace zondax {
+
+IdlArena::IdlArena(std::size_t chunkSize, std::pmr::memory_resource *upstream)
+    : IdlArena(nullptr, 0, upstream) {
+  nextChunk = std::max<std::size_t>(chunkSize, sizeof(Chunk) * 2);
+}
+
+IdlArena::IdlArena(void *buffer, std::size_t size,
+                   std::pmr::memory_resource *upstream)
+    : upstream(upstream),
+      buffer(static_cast<uint8_t *>(buffer)),
+      bufferSize(size),
+      nextChunk(std::max<std::size_t>(size, kDefaultChunk)),
+      head(nullptr),
+      cursor(static_cast<uint8_t *>(buffer)),
+      limit(static_cast<uint8_t *>(buffer) + size),
+      used_(0),
+      chunks_(0) {}
+
+void IdlArena::release() {
+  while (head != nullptr) {
+    auto prev = head->prev;
+    upstream->deallocate(head, head->size, alignof(std::max_align_t));
+    head = prev;
+  }
+
+  cursor = buffer;
+  limit = buffer + bufferSize;
+  used_ = 0;
+  chunks_ = 0;
+}
+
+void *IdlArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+  auto align = [&] {
+    auto address = reinterpret_cast<uintptr_t>(cursor);
+    return (alignment - address % alignment) % alignment;
+  };
+
+  auto padding = cursor == nullptr ? 0 : align();
+  if (cursor == nullptr || padding > static_cast<std::size_t>(limit - cursor) ||
+      bytes > static_cast<std::size_t>(limit - cursor) - padding) {
+    grow(bytes, alignment);
+    padding = align();
+  }
+
+  auto allocated = cursor + padding;
+  cursor = allocated + bytes;
+  used_ += bytes;
+  return allocated;
+}
+
+void IdlArena::grow(std::size_t bytes, std::size_t alignment) {
+  // room for the header and the worst alignment of the allocation
+  auto needed = sizeof(Chunk) + alignment + bytes;
+  if (needed < bytes) throw std::bad_alloc();
+
+  auto size = std::max(nextChunk, needed);
+  auto chunk = static_cast<Chunk *>(
+      upstream->allocate(size, alignof(std::max_align_t)));
+  chunk->prev = head;
+  chunk->size = size;
+
+  head = chunk;
+  cursor = reinterpret_cast<uint8_t *>(chunk + 1);
+  limit = reinterpret_cast<uint8_t *>(chunk) + size;
+  ++chunks_;
+
+  // geometric growth, a call only takes a few chunks
+  if (nextChunk <= SIZE_MAX / 2) nextChunk *= 2;
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+
+using namespace zondax;
+
+namespace {
+// Counts what goes through to the heap
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  std::size_t allocations = 0;
+  std::size_t live = 0;
+
+ private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations;
+    ++live;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *p, std::size_t bytes,
+                     std::size_t alignment) override {
+    --live;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+}  // namespace
+
+TEST_CASE("IdlArena allocates from the caller buffer first") {
+  alignas(std::max_align_t) uint8_t buffer[256];
+  IdlArena arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+  auto a = static_cast<uint8_t *>(arena.allocate(3, 1));
+  auto b = static_cast<uint64_t *>(arena.allocate(16, alignof(uint64_t)));
+  REQUIRE(a == buffer);
+  REQUIRE(reinterpret_cast<uintptr_t>(b) % alignof(uint64_t) == 0);
+  REQUIRE(reinterpret_cast<uint8_t *>(b) < buffer + sizeof(buffer));
+  REQUIRE(arena.used() == 19);
+  REQUIRE(arena.chunks() == 0);
+
+  // without an upstream, running out of buffer fails
+  REQUIRE_THROWS_AS((void)arena.allocate(512, 1), std::bad_alloc);
+
+  arena.release();
+  REQUIRE(arena.used() == 0);
+  REQUIRE(arena.allocate(1, 1) == buffer);
+}
+
+TEST_CASE("IdlArena takes growing chunks and returns them at once") {
+  CountingResource heap;
+  {
+    IdlArena arena(1024, &heap);
+    for (int i = 0; i < 1000; ++i) {
+      auto p = static_cast<uint32_t *>(arena.allocate(64, alignof(uint32_t)));
+      *p = i;
+    }
+    // 64000 bytes in chunks of 1, 2, 4... KiB
+    REQUIRE(arena.chunks() <= 7);
+    REQUIRE(heap.live == arena.chunks());
+
+    // larger than a chunk
+    auto big = arena.allocate(1 << 20, 64);
+    REQUIRE(reinterpret_cast<uintptr_t>(big) % 64 == 0);
+
+    auto taken = heap.allocations;
+    arena.release();
+    REQUIRE(heap.live == 0);
+    REQUIRE(heap.allocations == taken);
+
+    REQUIRE(arena.allocate(8, 8) != nullptr);
+    REQUIRE(heap.live == 1);
+  }
+  REQUIRE(heap.live == 0);
+}
+
+TEST_CASE("IdlArena backs standard containers") {
+  alignas(std::max_align_t) uint8_t buffer[4096];
+  IdlArena arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+  std::pmr::vector<uint32_t> values(&arena);
+  values.reserve(100);
+  for (uint32_t i = 0; i < 100; ++i) values.push_back(i * i);
+  REQUIRE(values[99] == 99 * 99);
+  REQUIRE(reinterpret_cast<uint8_t *>(values.data()) >= buffer);
+  REQUIRE(reinterpret_cast<uint8_t *>(values.data()) <
+          buffer + sizeof(buffer));
+}
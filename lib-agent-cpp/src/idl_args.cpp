@@ -15,6 +15,7 @@
  ********************************************************************************/
 #include "idl_args.h"
 
+#include "doctest.h"
 #include "idl_value.h"
 #include "zondax_ic.h"
 
@@ -61,7 +62,7 @@ IdlArgs::IdlArgs(std::string text) {
   ptr.reset(idl_args_from_text(text.c_str(), nullptr));
 }
 
-std::string IdlArgs::getText() {
+std::string IdlArgs::getText() const {
   CText* cText = idl_args_to_text(ptr.get());
   const char* str = ctext_str(cText);
   uintptr_t len = ctext_len(cText);
@@ -72,7 +73,7 @@ std::string IdlArgs::getText() {
   return text;
 }
 
-std::vector<uint8_t> IdlArgs::getBytes() {
+std::vector<uint8_t> IdlArgs::getBytes() const {
   if (ptr == nullptr) {
     std::cerr << "IDLArgs instance uninitialized" << std::endl;
     return std::vector<uint8_t>();
@@ -108,5 +109,62 @@ std::vector<zondax::IdlValue> IdlArgs::getVec() {
   return vec;
 }
 
+std::vector<zondax::IdlValue> IdlArgs::takeVec() && {
+  if (ptr == nullptr) {
+    return std::vector<zondax::IdlValue>();
+  }
+
+  CIDLValuesVec* cVec = idl_args_take_vec(ptr.get());
+  uintptr_t len = cidlval_vec_len(cVec);
+  std::vector<zondax::IdlValue> vec;
+  vec.reserve(len);
+
+  for (uintptr_t i = 0; i < len; ++i) {
+    vec.emplace_back(cidlval_vec_value_take(cVec, i));
+  }
+
+  cidlval_vec_destroy(cVec);
+  return vec;
+}
+
+std::size_t IdlArgs::size() const {
+  return ptr == nullptr ? 0 : idl_args_len(ptr.get());
+}
+
+IdlValueRef IdlArgs::operator[](std::size_t index) const {
+  return IdlValueRef(ptr == nullptr ? nullptr
+                                    : idl_args_value_ref(ptr.get(), index));
+}
+
 std::unique_ptr<IDLArgs> IdlArgs::getPtr() { return std::move(ptr); }
 }  // namespace zondax
+
+// ------------------------------------------------- TESTS
+
+using namespace zondax;
+
+TEST_CASE("IdlArgs values are taken as a tuple") {
+  std::vector<IdlValue> values;
+  values.emplace_back(std::string("zondax"));
+  values.emplace_back(uint64_t{42});
+  values.emplace_back(std::make_optional(std::vector<uint8_t>{1, 2}));
+  IdlArgs args(values);
+  IdlArgs again(args.getBytes());
+  IdlArgs other(args.getBytes());
+
+  auto tuple = std::move(args).takeTuple<std::string, uint64_t,
+                                         std::optional<std::vector<uint8_t>>>();
+  REQUIRE(tuple.has_value());
+  REQUIRE(std::get<0>(*tuple) == "zondax");
+  REQUIRE(std::get<1>(*tuple) == uint64_t{42});
+  REQUIRE(std::get<2>(*tuple) == std::vector<uint8_t>{1, 2});
+
+  // not as many types as values
+  REQUIRE(!std::move(again).takeTuple<std::string, uint64_t>().has_value());
+
+  // a value of another type
+  auto mismatch =
+      std::move(other).takeTuple<std::string, std::string,
+                                 std::optional<std::vector<uint8_t>>>();
+  REQUIRE(!mismatch.has_value());
+}
@@ -0,0 +1,764 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "idl_decoder.h"
+
+#include "doctest.h"
+#include "idl_encoder.h"
+#include "idl_view.h"
+
+namespace zondax {
+
+namespace {
+// Elements of zero sized types take no bytes, their count must be bounded
+constexpr uint64_t kMaxEmptyElements = 1 << 20;
+
+std::optional<std::size_t> primitiveSize(candid::TypeRef type) {
+  switch (static_cast<candid::Opcode>(type)) {
+    case candid::Opcode::Null:
+    case candid::Opcode::Reserved:
+      return 0;
+    case candid::Opcode::Bool:
+    case candid::Opcode::Nat8:
+    case candid::Opcode::Int8:
+      return 1;
+    case candid::Opcode::Nat16:
+    case candid::Opcode::Int16:
+      return 2;
+    case candid::Opcode::Nat32:
+    case candid::Opcode::Int32:
+    case candid::Opcode::Float32:
+      return 4;
+    case candid::Opcode::Nat64:
+    case candid::Opcode::Int64:
+    case candid::Opcode::Float64:
+      return 8;
+    default:
+      return std::nullopt;
+  }
+}
+
+bool isPrimitive(candid::TypeRef type) {
+  return (type <= candid::ref(candid::Opcode::Null) &&
+          type >= candid::ref(candid::Opcode::Empty)) ||
+         type == candid::ref(candid::Opcode::Principal);
+}
+}  // namespace
+
+std::variant<IdlDecoder, std::string> IdlDecoder::create(const uint8_t* data,
+                                                         std::size_t size) {
+  IdlDecoder decoder;
+  decoder.in = candid::Reader(data, size);
+
+  std::string error;
+  if (!decoder.parseHeader(error)) return error;
+
+  return decoder;
+}
+
+bool IdlDecoder::validRef(candid::TypeRef type) const {
+  return isPrimitive(type) ||
+         (type >= 0 && static_cast<uint64_t>(type) < types->table.size());
+}
+
+bool IdlDecoder::parseHeader(std::string& error) {
+  const uint8_t* magic;
+  if (!in.readBytes(sizeof(candid::kMagic), magic) ||
+      std::memcmp(magic, candid::kMagic, sizeof(candid::kMagic)) != 0) {
+    error = "Not a Candid message";
+    return false;
+  }
+
+  error = "Invalid type table";
+
+  auto& table = owned->table;
+  auto& fields = owned->fields;
+
+  uint64_t count;
+  if (!in.readLeb128(count) || count > in.remaining()) return false;
+  table.reserve(count);
+
+  // entries may reference later ones, references are checked at the end
+  std::vector<candid::TypeRef> refs;
+
+  for (uint64_t i = 0; i < count; ++i) {
+    int64_t op;
+    if (!in.readSleb128(op)) return false;
+
+    TypeEntry entry{static_cast<candid::Opcode>(op), 0,
+                    static_cast<uint32_t>(fields.size()), 0};
+
+    switch (entry.op) {
+      case candid::Opcode::Opt:
+      case candid::Opcode::Vec:
+        if (!in.readSleb128(entry.inner)) return false;
+        refs.push_back(entry.inner);
+        break;
+
+      case candid::Opcode::Record:
+      case candid::Opcode::Variant: {
+        uint64_t len;
+        if (!in.readLeb128(len) || len > in.remaining()) return false;
+        entry.fieldCount = static_cast<uint32_t>(len);
+
+        for (uint64_t f = 0; f < len; ++f) {
+          uint64_t hash;
+          Field field;
+          if (!in.readLeb128(hash) || hash > UINT32_MAX ||
+              !in.readSleb128(field.type))
+            return false;
+          field.hash = static_cast<uint32_t>(hash);
+
+          // labels are strictly increasing
+          if (f > 0 && field.hash <= fields.back().hash) return false;
+
+          fields.push_back(field);
+          refs.push_back(field.type);
+        }
+        break;
+      }
+
+      case candid::Opcode::Func: {
+        // arguments then results
+        for (int list = 0; list < 2; ++list) {
+          uint64_t len;
+          if (!in.readLeb128(len)) return false;
+          for (uint64_t a = 0; a < len; ++a) {
+            candid::TypeRef type;
+            if (!in.readSleb128(type)) return false;
+            refs.push_back(type);
+          }
+        }
+        uint64_t annotations;
+        if (!in.readLeb128(annotations) || !in.skip(annotations))
+          return false;
+        break;
+      }
+
+      case candid::Opcode::Service: {
+        uint64_t len;
+        if (!in.readLeb128(len)) return false;
+        for (uint64_t m = 0; m < len; ++m) {
+          uint64_t nameLen;
+          candid::TypeRef type;
+          if (!in.readLeb128(nameLen) || !in.skip(nameLen) ||
+              !in.readSleb128(type))
+            return false;
+          refs.push_back(type);
+        }
+        break;
+      }
+
+      default:
+        return false;
+    }
+
+    table.push_back(entry);
+  }
+
+  for (auto type : refs)
+    if (!validRef(type)) return false;
+
+  computeSizes();
+
+  error = "Invalid argument types";
+
+  uint64_t args;
+  if (!in.readLeb128(args) || args > in.remaining()) return false;
+  argTypes.reserve(args);
+
+  for (uint64_t i = 0; i < args; ++i) {
+    candid::TypeRef type;
+    if (!in.readSleb128(type) || !validRef(type)) return false;
+    argTypes.push_back(type);
+  }
+
+  error.clear();
+  return true;
+}
+
+const IdlDecoder::TypeEntry* IdlDecoder::entry(candid::TypeRef type,
+                                               candid::Opcode op) const {
+  if (type < 0 || static_cast<uint64_t>(type) >= types->table.size())
+    return nullptr;
+
+  const auto& e = types->table[type];
+  return e.op == op ? &e : nullptr;
+}
+
+std::optional<std::size_t> IdlDecoder::fixedSize(candid::TypeRef type) const {
+  if (type >= 0)
+    return static_cast<uint64_t>(type) < types->sizes.size()
+               ? types->sizes[type]
+               : std::nullopt;
+  return primitiveSize(type);
+}
+
+void IdlDecoder::computeSizes() {
+  const auto& table = owned->table;
+  auto& sizes = owned->sizes;
+  sizes.assign(table.size(), std::nullopt);
+
+  // entries are visited depth first, without recursion as chains of entries
+  // can be as long as the table; an entry met again while its fields are
+  // being visited is recursive, which never has a fixed size
+  enum : uint8_t { kNew, kVisiting, kDone };
+  std::vector<uint8_t> state(table.size(), kNew);
+  std::vector<std::pair<uint32_t, uint32_t>> stack;
+
+  for (uint32_t root = 0; root < table.size(); ++root) {
+    if (state[root] != kNew) continue;
+    state[root] = kVisiting;
+    stack.emplace_back(root, 0);
+
+    while (!stack.empty()) {
+      auto [index, next] = stack.back();
+      const auto &e = table[index];
+
+      if (e.op == candid::Opcode::Record && next < e.fieldCount) {
+        ++stack.back().second;
+        auto type = field(e, next).type;
+        if (type >= 0 && state[type] == kNew) {
+          state[type] = kVisiting;
+          stack.emplace_back(static_cast<uint32_t>(type), 0);
+        }
+        continue;
+      }
+
+      stack.pop_back();
+      state[index] = kDone;
+      if (e.op != candid::Opcode::Record) continue;
+
+      // every field is visited, sizes add up saturating
+      std::optional<std::size_t> size = 0;
+      for (uint32_t i = 0; size.has_value() && i < e.fieldCount; ++i) {
+        auto type = field(e, i).type;
+        auto fieldSize = type >= 0 ? (state[type] == kDone ? sizes[type]
+                                                           : std::nullopt)
+                                   : primitiveSize(type);
+        if (!fieldSize.has_value()) {
+          size.reset();
+        } else if (fieldSize.value() > SIZE_MAX - size.value()) {
+          size = SIZE_MAX;
+        } else {
+          size = size.value() + fieldSize.value();
+        }
+      }
+      sizes[index] = size;
+    }
+  }
+}
+
+bool IdlDecoder::checkLength(candid::TypeRef type, uint64_t len) const {
+  auto size = fixedSize(type);
+  if (size.has_value() && size.value() == 0) return len <= kMaxEmptyElements;
+
+  // every other element takes at least one byte
+  if (len > in.remaining()) return false;
+  return !size.has_value() || len <= in.remaining() / size.value();
+}
+
+bool IdlDecoder::skip(candid::TypeRef type) {
+  if (depth >= kMaxDepth) return false;
+
+  if (auto size = fixedSize(type)) return in.skip(size.value());
+
+  uint64_t len;
+  uint8_t flag;
+  std::string number;
+
+  switch (static_cast<candid::Opcode>(type)) {
+    case candid::Opcode::Nat:
+      return candid::readBigNumber(in, false, number);
+    case candid::Opcode::Int:
+      return candid::readBigNumber(in, true, number);
+    case candid::Opcode::Text:
+      return in.readLeb128(len) && in.skip(len);
+    case candid::Opcode::Principal:
+      return in.readByte(flag) && flag == 1 && in.readLeb128(len) &&
+             in.skip(len);
+    case candid::Opcode::Empty:
+      return false;
+    default:
+      break;
+  }
+
+  if (type < 0 || static_cast<uint64_t>(type) >= types->table.size())
+    return false;
+  const auto &e = types->table[type];
+
+  ++depth;
+  bool ok = false;
+
+  switch (e.op) {
+    case candid::Opcode::Opt:
+      ok = in.readByte(flag) && flag <= 1 && (flag == 0 || skip(e.inner));
+      break;
+
+    case candid::Opcode::Vec: {
+      if (!in.readLeb128(len) || !checkLength(e.inner, len)) break;
+
+      if (auto size = fixedSize(e.inner)) {
+        ok = in.skip(len * size.value());
+        break;
+      }
+
+      if (e.inner == candid::ref(candid::Opcode::Nat) ||
+          e.inner == candid::ref(candid::Opcode::Int)) {
+        ok = in.skipLeb128(len);
+        break;
+      }
+
+      ok = true;
+      for (uint64_t i = 0; ok && i < len; ++i) ok = skip(e.inner);
+      break;
+    }
+
+    case candid::Opcode::Record:
+      ok = true;
+      for (uint32_t i = 0; ok && i < e.fieldCount; ++i)
+        ok = skip(field(e, i).type);
+      break;
+
+    case candid::Opcode::Variant:
+      ok = in.readLeb128(len) && len < e.fieldCount &&
+           skip(field(e, len).type);
+      break;
+
+    case candid::Opcode::Func:
+      ok = in.readByte(flag) && flag == 1 &&
+           skip(candid::ref(candid::Opcode::Principal)) &&
+           skip(candid::ref(candid::Opcode::Text));
+      break;
+
+    case candid::Opcode::Service:
+      ok = skip(candid::ref(candid::Opcode::Principal));
+      break;
+
+    default:
+      break;
+  }
+
+  --depth;
+  return ok;
+}
+
+std::optional<std::vector<Number>> IdlDecode<std::vector<Number>>::read(
+    IdlDecoder &decoder, candid::TypeRef type) {
+  auto vec = decoder.entry(type, candid::Opcode::Vec);
+  if (vec == nullptr) return std::nullopt;
+
+  bool isNat = vec->inner == candid::ref(candid::Opcode::Nat);
+  if (!isNat && vec->inner != candid::ref(candid::Opcode::Int))
+    return std::nullopt;
+
+  auto &in = decoder.reader();
+  uint64_t len;
+  if (!in.readLeb128(len) || !decoder.checkLength(vec->inner, len))
+    return std::nullopt;
+
+  std::vector<Number> values;
+  values.reserve(len);
+
+  // numbers are decoded in batches, the ones not fitting in 64 bits one by one
+  constexpr std::size_t kBatch = 256;
+  uint64_t naturals[kBatch];
+  int64_t integers[kBatch];
+
+  while (values.size() < len) {
+    std::size_t wanted = std::min<uint64_t>(kBatch, len - values.size());
+    std::size_t n;
+
+    if (isNat) {
+      n = in.readLeb128Bulk(naturals, wanted);
+      for (std::size_t i = 0; i < n; ++i)
+        values.push_back(Number{std::to_string(naturals[i])});
+    } else {
+      n = in.readSleb128Bulk(integers, wanted);
+      for (std::size_t i = 0; i < n; ++i)
+        values.push_back(Number{std::to_string(integers[i])});
+    }
+
+    if (n < wanted) {
+      Number number;
+      if (!candid::readBigNumber(in, !isNat, number.value)) return std::nullopt;
+      values.push_back(std::move(number));
+    }
+  }
+
+  return std::make_optional(std::move(values));
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+
+using namespace zondax;
+
+namespace {
+struct Shape_circle {
+  static constexpr std::string_view __CANDID_VARIANT_NAME{"circle"};
+  static constexpr std::size_t __CANDID_VARIANT_CODE{0};
+};
+struct Shape_size {
+  static constexpr std::string_view __CANDID_VARIANT_NAME{"size"};
+  static constexpr std::size_t __CANDID_VARIANT_CODE{1};
+};
+}  // namespace
+
+TEST_CASE("IdlDecoder reads what IdlEncoder writes") {
+  std::vector<std::tuple<uint32_t, std::optional<std::string>>> rows;
+  for (uint32_t i = 0; i < 100; ++i)
+    rows.emplace_back(i, i % 2 ? std::optional<std::string>(std::to_string(i))
+                               : std::nullopt);
+
+  auto encoded = IdlEncoder::encode(true, int64_t(-7), 1.5, std::string("hi"),
+                                    rows);
+  REQUIRE(encoded.index() == 0);
+
+  auto decoded = IdlDecoder::decode<bool, int64_t, double, std::string,
+                                    decltype(rows)>(std::get<0>(encoded));
+  REQUIRE(decoded.index() == 0);
+
+  auto &values = std::get<0>(decoded);
+  REQUIRE(std::get<0>(values) == true);
+  REQUIRE(std::get<1>(values) == -7);
+  REQUIRE(std::get<2>(values) == 1.5);
+  REQUIRE(std::get<3>(values) == "hi");
+  REQUIRE(std::get<4>(values) == rows);
+}
+
+TEST_CASE("IdlDecoder reads the reference encoding") {
+  // (true, principal "2vxsx-fae", -12 : int32)
+  std::vector<uint8_t> bytes{68, 73,  68,  76,  0,   3,   126, 104, 117,
+                             1,  1,   1,   4,   244, 255, 255, 255};
+
+  auto decoded = IdlDecoder::decode<bool, Principal, int32_t>(bytes);
+  REQUIRE(decoded.index() == 0);
+
+  auto &values = std::get<0>(decoded);
+  REQUIRE(std::get<0>(values) == true);
+  REQUIRE(std::get<1>(values).getBytes() == std::vector<uint8_t>{4});
+  REQUIRE(std::get<2>(values) == -12);
+}
+
+TEST_CASE("IdlDecoder skips extra fields and fills missing optionals") {
+  auto encoded = IdlEncoder::encode(std::tuple<uint8_t, std::string, bool>{
+      1, "extra", true});
+  REQUIRE(encoded.index() == 0);
+
+  // field 1 is unknown to a pair, read as fields 0 and 1 of the tuple only
+  auto pair = IdlDecoder::decode<std::tuple<uint8_t, std::string>>(
+      std::get<0>(encoded));
+  REQUIRE(pair.index() == 0);
+  REQUIRE(std::get<0>(std::get<0>(pair)) == std::make_tuple(1, "extra"));
+
+  auto wider = IdlDecoder::decode<std::tuple<
+      uint8_t, std::string, bool, std::optional<uint64_t>>>(
+      std::get<0>(encoded));
+  REQUIRE(wider.index() == 0);
+  REQUIRE(!std::get<3>(std::get<0>(std::get<0>(wider))).has_value());
+
+  // a missing non optional field is an error
+  auto missing = IdlDecoder::decode<std::tuple<uint8_t, std::string, bool,
+                                               uint64_t>>(std::get<0>(encoded));
+  REQUIRE(missing.index() == 1);
+
+  // as are missing non optional arguments
+  REQUIRE(IdlDecoder::decode<std::tuple<uint8_t, std::string, bool>,
+                             std::optional<bool>>(std::get<0>(encoded))
+              .index() == 0);
+  REQUIRE(IdlDecoder::decode<std::tuple<uint8_t, std::string, bool>, bool>(
+              std::get<0>(encoded))
+              .index() == 1);
+}
+
+TEST_CASE("IdlDecoder variants and numbers") {
+  using Shape = std::variant<Shape_circle, Shape_size>;
+
+  auto encoded = IdlEncoder::encode(Shape{Shape_size{}}, Number{"-12345678901234567890"});
+  REQUIRE(encoded.index() == 0);
+
+  auto decoded = IdlDecoder::decode<Shape, Number>(std::get<0>(encoded));
+  REQUIRE(decoded.index() == 0);
+  REQUIRE(std::get<0>(std::get<0>(decoded)).index() == 1);
+  REQUIRE(std::get<1>(std::get<0>(decoded)).value == "-12345678901234567890");
+}
+
+TEST_CASE("IdlDecoder rejects malformed messages") {
+  auto encoded = IdlEncoder::encode(std::vector<uint16_t>{1, 2, 3});
+  REQUIRE(encoded.index() == 0);
+  auto bytes = std::get<0>(encoded);
+
+  // wrong type
+  REQUIRE(IdlDecoder::decode<std::vector<uint32_t>>(bytes).index() == 1);
+
+  // truncated
+  bytes.pop_back();
+  REQUIRE(IdlDecoder::decode<std::vector<uint16_t>>(bytes).index() == 1);
+
+  // bad magic
+  REQUIRE(IdlDecoder::decode<bool>({'D', 'I', 'D', 'X', 0, 1, 0x7e, 1})
+              .index() == 1);
+
+  // dangling type reference
+  REQUIRE(IdlDecoder::decode<std::vector<uint16_t>>(
+              {'D', 'I', 'D', 'L', 1, 0x6d, 5, 1, 0, 0})
+              .index() == 1);
+
+  // a huge vector of a zero sized type
+  REQUIRE(IdlDecoder::decode<std::vector<std::monostate>>(
+              {'D', 'I', 'D', 'L', 1, 0x6d, 0x7f, 1, 0, 0xff, 0xff, 0xff, 0xff,
+               0x0f})
+              .index() == 1);
+}
+
+TEST_CASE("IdlDecoder sizes deep type tables in linear time") {
+  // entry i is record {0: i + 1; 1: i + 1}, the last one record {0: nat8}
+  // or record {0: text}: sizing entry 0 by walking the fields would visit
+  // 2^kDepth of them
+  constexpr int kDepth = 80;
+
+  for (auto leaf : {candid::Opcode::Nat8, candid::Opcode::Text}) {
+    std::vector<uint8_t> bytes{'D', 'I', 'D', 'L'};
+    candid::writeLeb128(bytes, kDepth + 2);
+    for (int i = 0; i < kDepth; ++i) {
+      candid::writeSleb128(bytes, candid::ref(candid::Opcode::Record));
+      bytes.push_back(2);
+      bytes.push_back(0);
+      candid::writeSleb128(bytes, i + 1);
+      bytes.push_back(1);
+      candid::writeSleb128(bytes, i + 1);
+    }
+    candid::writeSleb128(bytes, candid::ref(candid::Opcode::Record));
+    bytes.push_back(1);
+    bytes.push_back(0);
+    candid::writeSleb128(bytes, candid::ref(leaf));
+    // the argument, vec of entry 0
+    candid::writeSleb128(bytes, candid::ref(candid::Opcode::Vec));
+    bytes.push_back(0);
+    bytes.push_back(1);
+    candid::writeSleb128(bytes, kDepth + 1);
+    // an empty vector, then a huge one
+    bytes.push_back(0);
+
+    auto created = IdlDecoder::create(bytes.data(), bytes.size());
+    REQUIRE(created.index() == 0);
+    auto &decoder = std::get<0>(created);
+
+    if (leaf == candid::Opcode::Nat8) {
+      // 2^80 bytes saturate
+      REQUIRE(decoder.fixedSize(kDepth) == 1);
+      REQUIRE(decoder.fixedSize(kDepth - 1) == 2);
+      REQUIRE(decoder.fixedSize(0) == SIZE_MAX);
+    } else {
+      REQUIRE(!decoder.fixedSize(kDepth).has_value());
+      REQUIRE(!decoder.fixedSize(0).has_value());
+    }
+    REQUIRE(decoder.view().has_value());
+
+    bytes.back() = 1;
+    auto huge = IdlDecoder::create(bytes.data(), bytes.size());
+    REQUIRE(huge.index() == 0);
+    REQUIRE(!std::get<0>(huge).view().has_value());
+  }
+
+  // recursive records have no fixed size: record {0: opt 0}
+  auto created = IdlDecoder::create(
+      std::vector<uint8_t>{'D', 'I', 'D', 'L', 2, 0x6c, 1, 0, 1, 0x6e, 0, 0}
+          .data(),
+      12);
+  REQUIRE(created.index() == 0);
+  REQUIRE(!std::get<0>(created).fixedSize(0).has_value());
+}
+
+TEST_CASE("IdlDecoder reads mismatched optionals as null") {
+  auto encoded = IdlEncoder::encode(std::optional<std::string>("text"),
+                                    std::string("text"), uint8_t(5),
+                                    std::make_tuple(std::string("field")));
+  REQUIRE(encoded.index() == 0);
+
+  auto decoded = IdlDecoder::decode<
+      std::optional<uint32_t>, std::optional<uint32_t>, uint8_t,
+      std::tuple<std::optional<uint8_t>>>(std::get<0>(encoded));
+  REQUIRE(decoded.index() == 0);
+
+  auto &[opt, value, byte, record] = std::get<0>(decoded);
+  REQUIRE(!opt.has_value());
+  REQUIRE(!value.has_value());
+  REQUIRE(byte == 5);
+  REQUIRE(!std::get<0>(record).has_value());
+
+  // a malformed value is not read as null
+  auto truncated = std::get<0>(IdlEncoder::encode(std::string("text")));
+  truncated.pop_back();
+  REQUIRE(IdlDecoder::decode<std::optional<uint32_t>>(truncated).index() == 1);
+}
+
+TEST_CASE("IdlDecoder reads vectors of numbers of any size") {
+  std::vector<Number> numbers;
+  for (int i = -50; i < 50; ++i)
+    numbers.push_back(Number{std::to_string(int64_t(i) * 1000000007)});
+  numbers.push_back(Number{"-340282366920938463463374607431768211456"});
+  numbers.push_back(Number{"9223372036854775807"});
+  numbers.push_back(Number{"0"});
+
+  auto encoded = IdlEncoder::encode(numbers);
+  REQUIRE(encoded.index() == 0);
+
+  auto decoded = IdlDecoder::decode<std::vector<Number>>(std::get<0>(encoded));
+  REQUIRE(decoded.index() == 0);
+
+  auto &values = std::get<0>(std::get<0>(decoded));
+  REQUIRE(values.size() == numbers.size());
+  for (std::size_t i = 0; i < values.size(); ++i)
+    REQUIRE(values[i].value == numbers[i].value);
+
+  // record { 0 : bool; 1 : vec nat } holding a number over 64 bits, and a
+  // nat8 after it
+  std::vector<uint8_t> nat{'D',  'I',  'D',  'L',  2,    0x6d, 0x7d, 0x6c,
+                           2,    0,    0x7e, 1,    0,    2,    1,    0x7b,
+                           1,    3,    5,    0x80, 0x80, 0x80, 0x80, 0x80,
+                           0x80, 0x80, 0x80, 0x80, 0x80, 0x01, 0xac, 0x02,
+                           42};
+
+  auto full = IdlDecoder::decode<std::tuple<bool, std::vector<Number>>,
+                                 uint8_t>(nat);
+  REQUIRE(full.index() == 0);
+  auto &naturals = std::get<1>(std::get<0>(std::get<0>(full)));
+  REQUIRE(naturals.size() == 3);
+  REQUIRE(naturals[0].value == "5");
+  REQUIRE(naturals[1].value == "1180591620717411303424");
+  REQUIRE(naturals[2].value == "300");
+  REQUIRE(std::get<1>(std::get<0>(full)) == 42);
+
+  // the vector is skipped when the tuple does not have it
+  auto skipped = IdlDecoder::decode<std::tuple<bool>, uint8_t>(nat);
+  REQUIRE(skipped.index() == 0);
+  REQUIRE(std::get<1>(std::get<0>(skipped)) == 42);
+}
+
+TEST_CASE("IdlDecoder views blobs in the message") {
+  std::string text("bytes in a blob");
+  auto encoded = IdlEncoder::encode(BlobView(text), std::vector<uint8_t>{7});
+  REQUIRE(encoded.index() == 0);
+
+  // both are the same vec nat8 type
+  auto &bytes = std::get<0>(encoded);
+  REQUIRE(bytes[4] == 1);
+
+  auto decoded = IdlDecoder::decode<BlobView, std::vector<uint8_t>>(bytes);
+  REQUIRE(decoded.index() == 0);
+
+  auto view = std::get<0>(std::get<0>(decoded));
+  REQUIRE(view.asString() == text);
+  REQUIRE(view.data() > bytes.data());
+  REQUIRE(view.end() < bytes.data() + bytes.size());
+  REQUIRE(std::get<1>(std::get<0>(decoded)) == std::vector<uint8_t>{7});
+
+  REQUIRE(IdlDecoder::decode<BlobView>(
+              std::get<0>(IdlEncoder::encode(std::vector<int8_t>{1})))
+              .index() == 1);
+}
+
+namespace {
+struct Entry {
+  uint64_t amount;
+  std::string memo;
+  std::optional<uint32_t> fee;
+};
+}  // namespace
+
+namespace zondax {
+template <>
+struct IdlRecordFields<Entry> {
+  using type =
+      std::tuple<RecordField<candid::idl_hash("fee"), &Entry::fee>,
+                 RecordField<candid::idl_hash("memo"), &Entry::memo>,
+                 RecordField<candid::idl_hash("amount"), &Entry::amount>>;
+};
+}  // namespace zondax
+
+TEST_CASE("IdlDecoder reads records from their field table") {
+  std::vector<Entry> entries{{1, "one", 10}, {2, "two", std::nullopt}};
+  auto encoded = IdlEncoder::encode(entries);
+  REQUIRE(encoded.index() == 0);
+
+  auto decoded = IdlDecoder::decode<std::vector<Entry>>(std::get<0>(encoded));
+  REQUIRE(decoded.index() == 0);
+  auto &back = std::get<0>(std::get<0>(decoded));
+  REQUIRE(back.size() == 2);
+  REQUIRE(back[0].amount == 1);
+  REQUIRE(back[0].memo == "one");
+  REQUIRE(back[0].fee == 10u);
+  REQUIRE(back[1].memo == "two");
+  REQUIRE(!back[1].fee.has_value());
+}
+
+namespace {
+// the same record, as seen by an older client or a newer server
+struct EntryNoFee {
+  uint64_t amount;
+  std::string memo;
+};
+struct EntryAmount {
+  uint64_t amount;
+};
+struct EntryRequiredFee {
+  uint64_t amount;
+  uint32_t fee;
+};
+}  // namespace
+
+namespace zondax {
+template <>
+struct IdlRecordFields<EntryNoFee> {
+  using type =
+      std::tuple<RecordField<candid::idl_hash("memo"), &EntryNoFee::memo>,
+                 RecordField<candid::idl_hash("amount"), &EntryNoFee::amount>>;
+};
+
+template <>
+struct IdlRecordFields<EntryAmount> {
+  using type =
+      std::tuple<RecordField<candid::idl_hash("amount"), &EntryAmount::amount>>;
+};
+
+template <>
+struct IdlRecordFields<EntryRequiredFee> {
+  using type = std::tuple<
+      RecordField<candid::idl_hash("fee"), &EntryRequiredFee::fee>,
+      RecordField<candid::idl_hash("amount"), &EntryRequiredFee::amount>>;
+};
+}  // namespace zondax
+
+TEST_CASE("IdlDecoder skips unknown record fields and fills optionals") {
+  auto full = IdlEncoder::encode(Entry{7, "seven", 70});
+  auto noFee = IdlEncoder::encode(EntryNoFee{8, "eight"});
+  REQUIRE(full.index() == 0);
+  REQUIRE(noFee.index() == 0);
+
+  // fee and memo are skipped
+  auto narrow = IdlDecoder::decode<EntryAmount>(std::get<0>(full));
+  REQUIRE(narrow.index() == 0);
+  REQUIRE(std::get<0>(std::get<0>(narrow)).amount == 7);
+
+  auto filled = IdlDecoder::decode<Entry>(std::get<0>(noFee));
+  REQUIRE(filled.index() == 0);
+  REQUIRE(!std::get<0>(std::get<0>(filled)).fee.has_value());
+
+  REQUIRE(IdlDecoder::decode<EntryRequiredFee>(std::get<0>(noFee)).index() ==
+          1);
+}
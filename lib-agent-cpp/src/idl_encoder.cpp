@@ -0,0 +1,256 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "idl_encoder.h"
+
+#include "doctest.h"
+#include "idl_args.h"
+
+namespace zondax {
+
+const std::vector<uint8_t>& IdlEncoder::finish() {
+  message.clear();
+  candid::writeHeader(message, table, argTypes.data(), argTypes.size());
+  message.insert(message.end(), values.begin(), values.end());
+
+  return message;
+}
+
+void IdlEncoder::clear() {
+  table.clear();
+  argTypes.clear();
+  values.clear();
+  message.clear();
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+using namespace zondax;
+
+namespace {
+// Encodes the values through IdlValue and the rust implementation
+template <typename... Args>
+std::vector<uint8_t> reference_bytes(Args... args) {
+  std::vector<IdlValue> values;
+  (values.emplace_back(IdlValue(std::move(args))), ...);
+
+  IdlArgs idlArgs(values);
+  return idlArgs.getBytes();
+}
+
+template <typename... Args>
+std::vector<uint8_t> native_bytes(const Args &...args) {
+  auto result = IdlEncoder::encode(args...);
+  REQUIRE(result.index() == 0);
+  return std::get<0>(result);
+}
+
+struct Color_red {
+  explicit Color_red() = default;
+  static constexpr std::string_view __CANDID_VARIANT_NAME{"red"};
+  static constexpr std::size_t __CANDID_VARIANT_CODE{1};
+};
+
+struct Color_green {
+  explicit Color_green() = default;
+  static constexpr std::string_view __CANDID_VARIANT_NAME{"green"};
+  static constexpr std::size_t __CANDID_VARIANT_CODE{0};
+};
+}  // namespace
+
+TEST_CASE("IdlEncoder matches the reference encoding of primitives") {
+  REQUIRE(native_bytes(true) == reference_bytes(true));
+  REQUIRE(native_bytes(std::string("hello")) ==
+          reference_bytes(std::string("hello")));
+  REQUIRE(native_bytes(uint8_t(7), uint16_t(300), uint32_t(70000),
+                       uint64_t(1) << 40) ==
+          reference_bytes(uint8_t(7), uint16_t(300), uint32_t(70000),
+                          uint64_t(1) << 40));
+  REQUIRE(native_bytes(int8_t(-7), int16_t(-300), int32_t(-70000),
+                       -(int64_t(1) << 40)) ==
+          reference_bytes(int8_t(-7), int16_t(-300), int32_t(-70000),
+                          -(int64_t(1) << 40)));
+  REQUIRE(native_bytes(1.5f, -2.25) == reference_bytes(1.5f, -2.25));
+  REQUIRE(native_bytes(std::monostate{}) == reference_bytes(std::monostate{}));
+  REQUIRE(native_bytes(Number{"-123456789012345678901234567890"}) ==
+          reference_bytes(Number{"-123456789012345678901234567890"}));
+}
+
+TEST_CASE("IdlEncoder matches the reference encoding of principals") {
+  auto reference = IdlArgs("(true, principal \"2vxsx-fae\", -12 : int32)");
+
+  Principal anonymous;
+  REQUIRE(native_bytes(true, anonymous, int32_t(-12)) ==
+          reference.getBytes());
+  REQUIRE(native_bytes(true, anonymous, int32_t(-12)) ==
+          std::vector<uint8_t>{68, 73, 68, 76, 0, 3, 126, 104, 117, 1, 1, 1,
+                               4, 244, 255, 255, 255});
+}
+
+TEST_CASE("IdlEncoder matches the reference encoding of composite types") {
+  std::vector<uint32_t> numbers{1, 2, 3};
+  REQUIRE(native_bytes(numbers) == reference_bytes(numbers));
+
+  std::vector<std::string> words{"a", "bc"};
+  REQUIRE(native_bytes(words) == reference_bytes(words));
+
+  std::optional<uint16_t> some(42);
+  REQUIRE(native_bytes(some) == reference_bytes(some));
+
+  auto tuple = std::make_tuple(uint64_t(5), std::string("five"));
+  REQUIRE(native_bytes(tuple) == reference_bytes(tuple));
+
+  // equal types share a type table entry
+  auto blobs = std::make_tuple(std::vector<uint8_t>{1, 2},
+                               std::vector<uint8_t>{3});
+  REQUIRE(native_bytes(blobs) == reference_bytes(blobs));
+
+  std::vector<std::tuple<uint8_t, std::optional<std::string>>> rows;
+  rows.emplace_back(1, std::string("one"));
+  rows.emplace_back(2, std::string("two"));
+  auto native = native_bytes(rows, numbers);
+  REQUIRE(native == reference_bytes(std::move(rows), numbers));
+}
+
+TEST_CASE("IdlEncoder types follow the C++ types") {
+  // an absent optional keeps its inner type: opt nat8
+  std::optional<uint8_t> none;
+  REQUIRE(native_bytes(none) ==
+          std::vector<uint8_t>{'D', 'I', 'D', 'L', 1, 0x6e, 0x7b, 1, 0, 0});
+
+  // variants are typed with all their alternatives, sorted by label hash
+  std::variant<Color_green, Color_red> color{Color_red{}};
+  REQUIRE(candid::idl_hash("red") < candid::idl_hash("green"));
+  REQUIRE(native_bytes(color) ==
+          std::vector<uint8_t>{'D',  'I',  'D',  'L',  1,    0x6b, 2,
+                               0xd1, 0xb2, 0xdb, 0x02, 0x7f, 0xc3, 0x9d,
+                               0xb4, 0xcf, 0x09, 0x7f, 1,    0,    0});
+}
+
+TEST_CASE("IdlEncoder can be reused") {
+  IdlEncoder encoder;
+
+  REQUIRE(encoder.arg(std::vector<uint8_t>{1, 2, 3}));
+  auto first = encoder.finish();
+
+  // a value that can not be encoded leaves the encoder untouched
+  REQUIRE(!encoder.arg(std::make_tuple(std::vector<uint8_t>{},
+                                       Number{"not a number"})));
+  REQUIRE(encoder.finish() == first);
+
+  encoder.clear();
+  REQUIRE(encoder.arg(std::vector<uint8_t>{1, 2, 3}));
+  REQUIRE(encoder.finish() == first);
+}
+
+TEST_CASE("EncodePlan writes only the values") {
+  using Row = std::tuple<uint64_t, std::string, std::optional<Number>>;
+  const auto &plan = EncodePlan<std::vector<Row>, bool>::get();
+  REQUIRE(&plan == &EncodePlan<std::vector<Row>, bool>::get());
+
+  std::vector<Row> rows;
+  rows.emplace_back(7, "seven", Number{"-7"});
+  rows.emplace_back(8, "eight", std::nullopt);
+
+  IdlEncoder encoder;
+  REQUIRE(encoder.arg(rows));
+  REQUIRE(encoder.arg(true));
+  auto expected = encoder.finish();
+
+  // the header is a prefix of every message
+  REQUIRE(std::equal(plan.header().begin(), plan.header().end(),
+                     expected.begin()));
+
+  std::vector<uint8_t> out{0xaa};
+  REQUIRE(plan.encode(out, rows, true));
+  REQUIRE(out.size() == expected.size() + 1);
+  REQUIRE(std::equal(expected.begin(), expected.end(), out.begin() + 1));
+
+  // a value that can not be encoded leaves the output untouched
+  rows.emplace_back(9, "nine", Number{"nine"});
+  REQUIRE(!plan.encode(out, rows, false));
+  REQUIRE(out.size() == expected.size() + 1);
+
+  REQUIRE(EncodePlan<>::get().header() ==
+          std::vector<uint8_t>{'D', 'I', 'D', 'L', 0, 0});
+}
+
+namespace {
+struct Point {
+  uint8_t x;
+  std::string label;
+};
+
+struct Transfer {
+  std::optional<uint64_t> fee;
+  std::string to;
+  uint64_t amount;
+};
+}  // namespace
+
+namespace zondax {
+template <>
+struct IdlRecordFields<Point> {
+  using type = std::tuple<RecordField<0, &Point::x>, RecordField<1, &Point::label>>;
+};
+
+template <>
+struct IdlRecordFields<Transfer> {
+  using type =
+      std::tuple<RecordField<candid::idl_hash("to"), &Transfer::to>,
+                 RecordField<candid::idl_hash("fee"), &Transfer::fee>,
+                 RecordField<candid::idl_hash("amount"), &Transfer::amount>>;
+};
+}  // namespace zondax
+
+TEST_CASE("IdlEncoder writes records from their field table") {
+  // numbered labels are the ones of a tuple
+  REQUIRE(native_bytes(Point{3, "three"}) ==
+          native_bytes(std::make_tuple(uint8_t(3), std::string("three"))));
+
+  static_assert(candid::idl_hash("to") < candid::idl_hash("fee") &&
+                candid::idl_hash("fee") < candid::idl_hash("amount"));
+  auto bytes = native_bytes(Transfer{10000, "alice", 5});
+
+  std::vector<uint8_t> expected{'D', 'I', 'D', 'L', 2, 0x6c, 3};
+  candid::writeLeb128(expected, candid::idl_hash("to"));
+  expected.push_back(0x71);
+  candid::writeLeb128(expected, candid::idl_hash("fee"));
+  expected.push_back(1);
+  candid::writeLeb128(expected, candid::idl_hash("amount"));
+  expected.insert(expected.end(), {0x78, 0x6e, 0x78, 1, 0, 5, 'a', 'l', 'i',
+                                   'c', 'e', 1, 0x10, 0x27, 0, 0, 0, 0, 0, 0,
+                                   5, 0, 0, 0, 0, 0, 0, 0});
+  REQUIRE(bytes == expected);
+}
+
+TEST_CASE("Arguments holding a Number are typed by the .did file") {
+  using Colors = std::variant<Color_red, Color_green>;
+  static_assert(helper::is_idl_typed_v<uint64_t>);
+  static_assert(helper::is_idl_typed_v<std::vector<uint8_t>>);
+  static_assert(helper::is_idl_typed_v<Transfer>);
+  static_assert(helper::is_idl_typed_v<std::vector<Point>>);
+  static_assert(helper::is_idl_typed_v<std::optional<Colors>>);
+
+  // nat and int are both generated as Number
+  static_assert(!helper::is_idl_typed_v<Number>);
+  static_assert(!helper::is_idl_typed_v<std::optional<Number>>);
+  static_assert(!helper::is_idl_typed_v<std::tuple<uint8_t, Number>>);
+
+  // and types that can not be encoded at all
+  static_assert(!helper::is_idl_typed_v<IdlValue>);
+  static_assert(!helper::is_idl_typed_v<const char *>);
+}
@@ -0,0 +1,151 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "idl_record.h"
+
+#include <algorithm>
+
+#include "doctest.h"
+
+namespace zondax {
+
+IdlRecord::const_iterator IdlRecord::lowerBound(uint32_t id) const {
+  return std::lower_bound(
+      fields.begin(), fields.end(), id,
+      [](const Field &field, uint32_t id) { return field.id < id; });
+}
+
+IdlRecord::iterator IdlRecord::lowerBound(uint32_t id) {
+  return std::lower_bound(
+      fields.begin(), fields.end(), id,
+      [](const Field &field, uint32_t id) { return field.id < id; });
+}
+
+IdlValue &IdlRecord::set(uint32_t id, IdlValue value) {
+  // fields are usually added in order
+  if (fields.empty() || fields.back().id < id) {
+    fields.push_back(Field{id, std::move(value)});
+    return fields.back().value;
+  }
+
+  auto it = lowerBound(id);
+  if (it != fields.end() && it->id == id) {
+    it->value = std::move(value);
+    return it->value;
+  }
+
+  return fields.insert(it, Field{id, std::move(value)})->value;
+}
+
+IdlValue *IdlRecord::find(uint32_t id) {
+  auto it = lowerBound(id);
+  if (it == fields.end() || it->id != id) return nullptr;
+  return &it->value;
+}
+
+bool IdlRecord::contains(uint32_t id) const {
+  auto it = lowerBound(id);
+  return it != fields.end() && it->id == id;
+}
+
+std::optional<IdlValue> IdlRecord::take(uint32_t id) {
+  auto it = lowerBound(id);
+  if (it == fields.end() || it->id != id) return std::nullopt;
+
+  std::optional<IdlValue> value(std::move(it->value));
+  fields.erase(it);
+  return value;
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+
+using namespace zondax;
+
+TEST_CASE("IdlRecord keeps its fields sorted by label id") {
+  IdlRecord record;
+  record.set("name", IdlValue(std::string("zondax")));
+  record.set(1, IdlValue(uint8_t{1}));
+  record.set(0, IdlValue(uint8_t{0}));
+  record.set(candid::idl_hash("zzz"), IdlValue(true));
+
+  REQUIRE(record.size() == 4);
+  uint32_t previous = 0;
+  for (const auto &field : record) {
+    REQUIRE(field.id >= previous);
+    previous = field.id;
+  }
+
+  REQUIRE(record.contains("name"));
+  REQUIRE(record.contains(candid::idl_hash("name")));
+  REQUIRE(!record.contains("other"));
+  REQUIRE(record.find("other") == nullptr);
+  REQUIRE(record.find(1)->get<uint8_t>() == uint8_t{1});
+
+  // setting a field again replaces its value
+  record.set(1, IdlValue(uint8_t{7}));
+  REQUIRE(record.size() == 4);
+  REQUIRE(record.find(1)->get<uint8_t>() == uint8_t{7});
+
+  auto name = record.take("name");
+  REQUIRE(name.has_value());
+  REQUIRE(name->get<std::string>() == "zondax");
+  REQUIRE(!record.contains("name"));
+  REQUIRE(!record.take("name").has_value());
+  REQUIRE(record.size() == 3);
+}
+
+TEST_CASE("IdlRecord to and from IdlValue") {
+  IdlRecord record(3);
+  record.set("balance", IdlValue(uint64_t{42}));
+  record.set("owner", IdlValue(std::string("alice")));
+  record.set("memo", IdlValue(std::vector<uint8_t>{1, 2, 3}));
+
+  IdlValue value(std::move(record));
+  REQUIRE(value.type() == IdlValueType::Record);
+
+  auto back = value.get<IdlRecord>();
+  REQUIRE(back.has_value());
+  REQUIRE(back->size() == 3);
+  REQUIRE(back->find("balance")->get<uint64_t>() == uint64_t{42});
+  REQUIRE(back->find("owner")->get<std::string>() == "alice");
+  auto memo = back->find("memo")->get<std::vector<uint8_t>>();
+  REQUIRE(memo == std::vector<uint8_t>{1, 2, 3});
+
+  // getRecord copies the fields, take moves them out
+  REQUIRE(value.getRecord().size() == 3);
+  REQUIRE(value.getRecord().find("owner")->get<std::string>() == "alice");
+  REQUIRE(std::move(value).take<IdlRecord>()->size() == 3);
+  REQUIRE(value.getRecord().empty());
+
+  // not a record
+  IdlValue text(std::string("text"));
+  REQUIRE(!text.get<IdlRecord>().has_value());
+  REQUIRE(text.getRecord().empty());
+
+  // records nest into vectors
+  std::vector<IdlRecord> rows;
+  for (uint64_t i = 0; i < 3; ++i) {
+    IdlRecord row;
+    row.set("id", IdlValue(i));
+    rows.push_back(std::move(row));
+  }
+  IdlValue table(std::move(rows));
+  auto decoded = table.get<std::vector<IdlRecord>>();
+  REQUIRE(decoded.has_value());
+  REQUIRE(decoded->size() == 3);
+  REQUIRE((*decoded)[2].find("id")->get<uint64_t>() == uint64_t{2});
+}
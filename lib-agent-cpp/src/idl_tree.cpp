@@ -0,0 +1,1223 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "idl_tree.h"
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <utility>
+
+#include "doctest.h"
+#include "idl_arena.h"
+#include "idl_decoder.h"
+#include "idl_encoder.h"
+
+namespace zondax {
+
+/******************** Building ***********************/
+
+IdlTree::Node &IdlTree::append(IdlValueType type, uint8_t flags) {
+  uint32_t label = 0;
+
+  if (stack.empty()) {
+    ++roots;
+  } else {
+    auto &parent = nodes[stack.back()];
+    // unlabeled record fields are numbered, as tuples
+    if (pendingLabel.has_value()) {
+      label = pendingLabel.value();
+    } else if (parent.type() == IdlValueType::Record) {
+      label = parent.children.count;
+    }
+
+    ++parent.children.count;
+    if ((parent.type() == IdlValueType::Opt ||
+         parent.type() == IdlValueType::Variant) &&
+        parent.children.count > 1)
+      valid = false;
+  }
+  pendingLabel.reset();
+
+  if (nodes.size() >= std::numeric_limits<uint32_t>::max()) valid = false;
+
+  auto &node = nodes.emplace_back();
+  node.kind = static_cast<uint8_t>(type);
+  node.flags = flags;
+  node.label = label;
+  node.nat = 0;
+  return node;
+}
+
+IdlTree::Span IdlTree::store(const void *bytes, std::size_t size) {
+  if (data.size() + size > std::numeric_limits<uint32_t>::max()) {
+    valid = false;
+    return Span{0, 0};
+  }
+
+  Span span{static_cast<uint32_t>(data.size()), static_cast<uint32_t>(size)};
+  auto begin = static_cast<const uint8_t *>(bytes);
+  data.insert(data.end(), begin, begin + size);
+  return span;
+}
+
+IdlTree &IdlTree::leaf(IdlValueType type, Span span, uint8_t flags) {
+  append(type, flags).span = span;
+  return *this;
+}
+
+IdlTree &IdlTree::beginComposite(IdlValueType type) {
+  auto index = static_cast<uint32_t>(nodes.size());
+  // the end is only known once the value is ended
+  append(type).children =
+      Children{std::numeric_limits<uint32_t>::max(), 0};
+  stack.push_back(index);
+  return *this;
+}
+
+IdlTree &IdlTree::endComposite(IdlValueType type) {
+  if (stack.empty() || nodes[stack.back()].type() != type ||
+      pendingLabel.has_value()) {
+    valid = false;
+    return *this;
+  }
+
+  auto &node = nodes[stack.back()];
+  node.children.end = static_cast<uint32_t>(nodes.size());
+  if ((type == IdlValueType::Opt || type == IdlValueType::Variant) &&
+      node.children.count != 1)
+    valid = false;
+
+  stack.pop_back();
+  return *this;
+}
+
+IdlTree &IdlTree::null() {
+  append(IdlValueType::Null);
+  return *this;
+}
+
+IdlTree &IdlTree::reserved() {
+  append(IdlValueType::Reserved);
+  return *this;
+}
+
+IdlTree &IdlTree::text(std::string_view value) {
+  return leaf(IdlValueType::Text, store(value.data(), value.size()));
+}
+
+IdlTree &IdlTree::blob(BlobView value) {
+  return leaf(IdlValueType::Vec, store(value.data(), value.size()), kBlob);
+}
+
+IdlTree &IdlTree::nat(const Number &value) {
+  const auto &decimal = value.value;
+  uint64_t small;
+  auto [end, error] =
+      std::from_chars(decimal.data(), decimal.data() + decimal.size(), small);
+  if (error == std::errc() && end == decimal.data() + decimal.size()) {
+    append(IdlValueType::Nat).nat = small;
+    return *this;
+  }
+
+  // checked once here, so that encoding can not fail on it
+  std::vector<uint8_t> encoded;
+  if (!candid::writeBigNumber(encoded, decimal, false)) valid = false;
+  return leaf(IdlValueType::Nat, store(decimal.data(), decimal.size()), kBig);
+}
+
+IdlTree &IdlTree::integer(const Number &value) {
+  const auto &decimal = value.value;
+  int64_t small;
+  auto [end, error] =
+      std::from_chars(decimal.data(), decimal.data() + decimal.size(), small);
+  if (error == std::errc() && end == decimal.data() + decimal.size()) {
+    append(IdlValueType::Int).integer = small;
+    return *this;
+  }
+
+  std::vector<uint8_t> encoded;
+  if (!candid::writeBigNumber(encoded, decimal, true)) valid = false;
+  return leaf(IdlValueType::Int, store(decimal.data(), decimal.size()), kBig);
+}
+
+IdlTree &IdlTree::principal(BlobView bytes) {
+  return leaf(IdlValueType::Principal, store(bytes.data(), bytes.size()));
+}
+
+IdlTree &IdlTree::service(BlobView principal) {
+  return leaf(IdlValueType::Service,
+              store(principal.data(), principal.size()));
+}
+
+IdlTree &IdlTree::func(BlobView principal, std::string_view method) {
+  // the length of the principal, the principal, then the method name
+  if (principal.size() > 0xff) valid = false;
+  auto len = static_cast<uint8_t>(principal.size());
+
+  auto span = store(&len, 1);
+  span.size += store(principal.data(), principal.size()).size;
+  span.size += store(method.data(), method.size()).size;
+  return leaf(IdlValueType::Func, span);
+}
+
+IdlTree &IdlTree::none() {
+  append(IdlValueType::None);
+  return *this;
+}
+
+IdlTree &IdlTree::beginOpt() { return beginComposite(IdlValueType::Opt); }
+IdlTree &IdlTree::endOpt() { return endComposite(IdlValueType::Opt); }
+
+IdlTree &IdlTree::beginVec() { return beginComposite(IdlValueType::Vec); }
+IdlTree &IdlTree::endVec() { return endComposite(IdlValueType::Vec); }
+
+IdlTree &IdlTree::beginRecord() {
+  return beginComposite(IdlValueType::Record);
+}
+
+IdlTree &IdlTree::field(uint32_t id) {
+  if (stack.empty() || nodes[stack.back()].type() != IdlValueType::Record)
+    valid = false;
+  pendingLabel = id;
+  return *this;
+}
+
+IdlTree &IdlTree::endRecord() { return endComposite(IdlValueType::Record); }
+
+IdlTree &IdlTree::beginVariant(uint32_t id) {
+  beginComposite(IdlValueType::Variant);
+  pendingLabel = id;
+  return *this;
+}
+
+IdlTree &IdlTree::endVariant() { return endComposite(IdlValueType::Variant); }
+
+void IdlTree::clear() {
+  nodes.clear();
+  data.clear();
+  roots = 0;
+  stack.clear();
+  pendingLabel.reset();
+  valid = true;
+}
+
+/******************** Reading ***********************/
+
+IdlTree::iterator IdlTree::begin() const { return iterator(*this, 0); }
+
+IdlTree::iterator IdlTree::end() const {
+  return iterator(*this, static_cast<uint32_t>(nodes.size()));
+}
+
+IdlTree::Ref IdlTree::operator[](std::size_t i) const {
+  auto it = begin();
+  while (i-- > 0) ++it;
+  return *it;
+}
+
+std::optional<std::string_view> IdlTree::Ref::bytes(IdlValueType type) const {
+  const auto &n = node();
+  if (n.type() != type) return std::nullopt;
+
+  return std::string_view(
+      reinterpret_cast<const char *>(tree->data.data()) + n.span.offset,
+      n.span.size);
+}
+
+std::optional<std::string_view> IdlTree::Ref::text() const {
+  return bytes(IdlValueType::Text);
+}
+
+std::optional<BlobView> IdlTree::Ref::blob() const {
+  if (!(node().flags & kBlob)) return std::nullopt;
+  return BlobView(bytes(IdlValueType::Vec).value());
+}
+
+bool IdlTree::Ref::isNull() const {
+  auto t = type();
+  return t == IdlValueType::Null || t == IdlValueType::Reserved ||
+         t == IdlValueType::None;
+}
+
+std::optional<IdlTree::Ref> IdlTree::Ref::opt() const {
+  if (type() != IdlValueType::Opt) return std::nullopt;
+  return Ref(*tree, index + 1);
+}
+
+std::optional<IdlTree::Ref> IdlTree::Ref::variant() const {
+  if (type() != IdlValueType::Variant || node().children.count == 0)
+    return std::nullopt;
+  return Ref(*tree, index + 1);
+}
+
+std::optional<IdlTree::Ref> IdlTree::Ref::field(uint32_t id) const {
+  if (type() != IdlValueType::Record) return std::nullopt;
+
+  for (auto field : *this) {
+    if (field.label() == id) return field;
+  }
+  return std::nullopt;
+}
+
+std::size_t IdlTree::Ref::size() const {
+  const auto &n = node();
+  if (n.flags & kBlob) return n.span.size;
+  return n.composite() ? n.children.count : 0;
+}
+
+IdlTree::Ref IdlTree::Ref::operator[](std::size_t i) const {
+  const auto &n = node();
+  // contents without composite values take one node each
+  if (tree->next(index) - index - 1 == n.children.count)
+    return Ref(*tree, index + 1 + i);
+
+  auto it = begin();
+  while (i-- > 0) ++it;
+  return *it;
+}
+
+IdlTree::iterator IdlTree::Ref::begin() const {
+  return iterator(*tree, node().composite() ? index + 1 : index);
+}
+
+IdlTree::iterator IdlTree::Ref::end() const {
+  return iterator(*tree, node().composite() ? tree->next(index) : index);
+}
+
+/******************** Conversions ***********************/
+
+std::variant<IdlTree, std::string> IdlTree::decode(
+    const uint8_t *data, std::size_t size,
+    std::pmr::memory_resource *resource) {
+  auto created = IdlDecoder::create(data, size);
+  if (created.index() == 1) return std::get<1>(created);
+
+  // text and blobs are copied from the message, so they fit in its size
+  IdlTree tree(resource);
+  tree.data.reserve(size);
+  auto error = std::get<0>(created).readTree(tree);
+  if (error.has_value()) return error.value();
+
+  return tree;
+}
+
+namespace {
+
+// Nesting allowed in the values of a tree, as when decoding
+constexpr std::size_t kMaxDepth = 512;
+
+bool isScalar(IdlValueType type) {
+  switch (type) {
+    case IdlValueType::Opt:
+    case IdlValueType::None:
+    case IdlValueType::Vec:
+    case IdlValueType::Record:
+    case IdlValueType::Variant:
+      return false;
+    default:
+      return true;
+  }
+}
+
+candid::Opcode opcode(IdlValueType type) {
+  switch (type) {
+    case IdlValueType::Bool:
+      return candid::Opcode::Bool;
+    case IdlValueType::Null:
+      return candid::Opcode::Null;
+    case IdlValueType::Text:
+      return candid::Opcode::Text;
+    case IdlValueType::Int:
+      return candid::Opcode::Int;
+    case IdlValueType::Nat:
+      return candid::Opcode::Nat;
+    case IdlValueType::Nat8:
+      return candid::Opcode::Nat8;
+    case IdlValueType::Nat16:
+      return candid::Opcode::Nat16;
+    case IdlValueType::Nat32:
+      return candid::Opcode::Nat32;
+    case IdlValueType::Nat64:
+      return candid::Opcode::Nat64;
+    case IdlValueType::Int8:
+      return candid::Opcode::Int8;
+    case IdlValueType::Int16:
+      return candid::Opcode::Int16;
+    case IdlValueType::Int32:
+      return candid::Opcode::Int32;
+    case IdlValueType::Int64:
+      return candid::Opcode::Int64;
+    case IdlValueType::Float32:
+      return candid::Opcode::Float32;
+    case IdlValueType::Float64:
+      return candid::Opcode::Float64;
+    case IdlValueType::Principal:
+      return candid::Opcode::Principal;
+    case IdlValueType::Service:
+      return candid::Opcode::Service;
+    case IdlValueType::Func:
+      return candid::Opcode::Func;
+    case IdlValueType::Reserved:
+      return candid::Opcode::Reserved;
+    default:
+      return candid::Opcode::Empty;
+  }
+}
+
+}  // namespace
+
+/**
+ * Encodes a tree: the types of its values are inferred as shapes, which are
+ * then written to the type table, then the values are written.
+ */
+class IdlTree::Encoder {
+ public:
+  explicit Encoder(const IdlTree &tree) : tree(tree) {}
+
+  std::variant<std::vector<uint8_t>, std::string> encode() {
+    std::vector<uint32_t> argShapes;
+    for (auto arg : tree) {
+      auto shape = infer(arg.index, 0);
+      if (!shape.has_value()) return error;
+      argShapes.push_back(shape.value());
+    }
+
+    candid::TypeTable table;
+    std::vector<candid::TypeRef> argTypes;
+    argTypes.reserve(argShapes.size());
+    for (auto shape : argShapes) argTypes.push_back(typeOf(table, shape));
+
+    std::vector<uint8_t> out;
+    candid::writeHeader(out, table, argTypes.data(), argTypes.size());
+
+    std::size_t i = 0;
+    for (auto arg : tree) write(out, arg.index, argShapes[i++]);
+
+    return out;
+  }
+
+ private:
+  // A type inferred from values. Empty vectors and absent optionals leave
+  // their inner type unknown (Invalid) until another value tells it.
+  struct Shape {
+    IdlValueType type;
+    uint32_t inner;
+    // record fields or variant alternatives, by increasing id
+    std::vector<std::pair<uint32_t, uint32_t>> fields;
+  };
+
+  static constexpr uint32_t kUnknown = std::numeric_limits<uint32_t>::max();
+
+  const Node &node(uint32_t index) const { return tree.nodes[index]; }
+
+  uint32_t add(IdlValueType type, uint32_t inner = kUnknown) {
+    shapes.push_back(Shape{type, inner, {}});
+    return static_cast<uint32_t>(shapes.size() - 1);
+  }
+
+  std::optional<uint32_t> fail(std::string message) {
+    error = std::move(message);
+    return std::nullopt;
+  }
+
+  std::optional<uint32_t> infer(uint32_t index, std::size_t depth) {
+    if (depth >= kMaxDepth) return fail("Values nested too deeply");
+
+    const auto &n = node(index);
+    auto type = n.type();
+    if (isScalar(type)) return add(type);
+
+    switch (type) {
+      case IdlValueType::None:
+        return add(IdlValueType::Opt, add(IdlValueType::Invalid));
+
+      case IdlValueType::Opt: {
+        auto inner = infer(index + 1, depth + 1);
+        if (!inner.has_value()) return std::nullopt;
+        return add(IdlValueType::Opt, inner.value());
+      }
+
+      case IdlValueType::Vec: {
+        if (n.flags & kBlob)
+          return add(IdlValueType::Vec, add(IdlValueType::Nat8));
+
+        auto inner = add(IdlValueType::Invalid);
+        for (auto elem : Ref(tree, index)) {
+          if (!merge(inner, elem.index, depth + 1))
+            return fail("Vector elements have different types");
+        }
+        return add(IdlValueType::Vec, inner);
+      }
+
+      case IdlValueType::Record:
+      case IdlValueType::Variant: {
+        std::vector<std::pair<uint32_t, uint32_t>> fields;
+        fields.reserve(n.children.count);
+        for (auto field : Ref(tree, index)) {
+          auto inner = infer(field.index, depth + 1);
+          if (!inner.has_value()) return std::nullopt;
+          fields.emplace_back(field.label(), inner.value());
+        }
+
+        std::sort(fields.begin(), fields.end());
+        for (std::size_t i = 1; i < fields.size(); ++i) {
+          if (fields[i - 1].first == fields[i].first)
+            return fail("Duplicated record field");
+        }
+
+        auto shape = add(type);
+        shapes[shape].fields = std::move(fields);
+        return shape;
+      }
+
+      default:
+        return fail("Invalid value");
+    }
+  }
+
+  // Checks a value against a shape, filling the parts the shape does not
+  // know yet
+  bool merge(uint32_t shape, uint32_t index, std::size_t depth) {
+    if (depth >= kMaxDepth) return false;
+
+    const auto &n = node(index);
+    auto type = n.type();
+
+    if (shapes[shape].type == IdlValueType::Invalid) {
+      auto inferred = infer(index, depth);
+      if (!inferred.has_value()) return false;
+      // copied, as the reference may be invalidated by infer()
+      auto value = shapes[inferred.value()];
+      shapes[shape] = std::move(value);
+      return true;
+    }
+
+    if (type == IdlValueType::None)
+      return shapes[shape].type == IdlValueType::Opt;
+    if (shapes[shape].type != type) return false;
+
+    switch (type) {
+      case IdlValueType::Opt:
+        return merge(shapes[shape].inner, index + 1, depth + 1);
+
+      case IdlValueType::Vec: {
+        auto inner = shapes[shape].inner;
+        if (n.flags & kBlob) {
+          if (shapes[inner].type == IdlValueType::Invalid)
+            shapes[inner].type = IdlValueType::Nat8;
+          return shapes[inner].type == IdlValueType::Nat8;
+        }
+
+        for (auto elem : Ref(tree, index)) {
+          if (!merge(inner, elem.index, depth + 1)) return false;
+        }
+        return true;
+      }
+
+      case IdlValueType::Record: {
+        if (n.children.count != shapes[shape].fields.size() ||
+            !distinctLabels(index))
+          return false;
+        for (auto field : Ref(tree, index)) {
+          auto inner = find(shape, field.label());
+          if (!inner.has_value() || !merge(inner.value(), field.index, depth + 1))
+            return false;
+        }
+        return true;
+      }
+
+      case IdlValueType::Variant: {
+        auto alternative = Ref(tree, index).variant().value();
+        auto inner = find(shape, alternative.label());
+        if (inner.has_value())
+          return merge(inner.value(), alternative.index, depth + 1);
+
+        // another alternative of the same variant
+        auto added = infer(alternative.index, depth + 1);
+        if (!added.has_value()) return false;
+        auto &fields = shapes[shape].fields;
+        auto at = std::lower_bound(
+            fields.begin(), fields.end(),
+            std::make_pair(alternative.label(), uint32_t(0)));
+        fields.emplace(at, alternative.label(), added.value());
+        return true;
+      }
+
+      default:
+        return true;
+    }
+  }
+
+  // Fields added by increasing id are checked without sorting them
+  bool distinctLabels(uint32_t index) const {
+    bool increasing = true;
+    bool first = true;
+    uint32_t last = 0;
+    for (auto field : Ref(tree, index)) {
+      if (!first && field.label() <= last) {
+        increasing = false;
+        break;
+      }
+      first = false;
+      last = field.label();
+    }
+    if (increasing) return true;
+
+    std::vector<uint32_t> labels;
+    for (auto field : Ref(tree, index)) labels.push_back(field.label());
+    std::sort(labels.begin(), labels.end());
+    return std::adjacent_find(labels.begin(), labels.end()) == labels.end();
+  }
+
+  std::optional<uint32_t> find(uint32_t shape, uint32_t id) const {
+    const auto &fields = shapes[shape].fields;
+    auto at = std::lower_bound(fields.begin(), fields.end(),
+                               std::make_pair(id, uint32_t(0)));
+    if (at == fields.end() || at->first != id) return std::nullopt;
+    return at->second;
+  }
+
+  candid::TypeRef typeOf(candid::TypeTable &table, uint32_t shape) {
+    auto type = shapes[shape].type;
+    if (type != IdlValueType::Opt && type != IdlValueType::Vec &&
+        type != IdlValueType::Record && type != IdlValueType::Variant &&
+        type != IdlValueType::Service && type != IdlValueType::Func)
+      return candid::ref(opcode(type));
+
+    auto index = table.reserve();
+    std::vector<uint8_t> entry;
+
+    switch (type) {
+      case IdlValueType::Opt:
+      case IdlValueType::Vec: {
+        auto inner = typeOf(table, shapes[shape].inner);
+        candid::writeSleb128(entry,
+                             candid::ref(type == IdlValueType::Opt
+                                             ? candid::Opcode::Opt
+                                             : candid::Opcode::Vec));
+        candid::writeSleb128(entry, inner);
+        break;
+      }
+
+      case IdlValueType::Record:
+      case IdlValueType::Variant: {
+        std::vector<candid::TypeRef> inner;
+        for (auto [id, fieldShape] : shapes[shape].fields)
+          inner.push_back(typeOf(table, fieldShape));
+
+        candid::writeSleb128(entry,
+                             candid::ref(type == IdlValueType::Record
+                                             ? candid::Opcode::Record
+                                             : candid::Opcode::Variant));
+        candid::writeLeb128(entry, inner.size());
+        for (std::size_t i = 0; i < inner.size(); ++i) {
+          candid::writeLeb128(entry, shapes[shape].fields[i].first);
+          candid::writeSleb128(entry, inner[i]);
+        }
+        break;
+      }
+
+      case IdlValueType::Service:
+        // typed without methods, as IdlEncode<Service>
+        candid::writeSleb128(entry, candid::ref(candid::Opcode::Service));
+        candid::writeLeb128(entry, 0);
+        break;
+
+      default:
+        // functions are typed without arguments, results nor annotations
+        candid::writeSleb128(entry, candid::ref(candid::Opcode::Func));
+        candid::writeLeb128(entry, 0);
+        candid::writeLeb128(entry, 0);
+        candid::writeLeb128(entry, 0);
+        break;
+    }
+
+    return table.commit(index, entry);
+  }
+
+  void writeBytes(std::vector<uint8_t> &out, const Node &n) const {
+    candid::writeLeb128(out, n.span.size);
+    auto begin = tree.data.data() + n.span.offset;
+    out.insert(out.end(), begin, begin + n.span.size);
+  }
+
+  std::string_view decimal(const Node &n) const {
+    return std::string_view(
+        reinterpret_cast<const char *>(tree.data.data()) + n.span.offset,
+        n.span.size);
+  }
+
+  void write(std::vector<uint8_t> &out, uint32_t index, uint32_t shape) const {
+    const auto &n = node(index);
+
+    switch (n.type()) {
+      case IdlValueType::Null:
+      case IdlValueType::Reserved:
+        break;
+      case IdlValueType::Bool:
+        out.push_back(n.b ? 1 : 0);
+        break;
+      case IdlValueType::Nat:
+        if (n.flags & kBig) {
+          candid::writeBigNumber(out, decimal(n), false);
+        } else {
+          candid::writeLeb128(out, n.nat);
+        }
+        break;
+      case IdlValueType::Int:
+        if (n.flags & kBig) {
+          candid::writeBigNumber(out, decimal(n), true);
+        } else {
+          candid::writeSleb128(out, n.integer);
+        }
+        break;
+      case IdlValueType::Nat8:
+        candid::writeFixed(out, static_cast<uint8_t>(n.nat));
+        break;
+      case IdlValueType::Nat16:
+        candid::writeFixed(out, static_cast<uint16_t>(n.nat));
+        break;
+      case IdlValueType::Nat32:
+        candid::writeFixed(out, static_cast<uint32_t>(n.nat));
+        break;
+      case IdlValueType::Nat64:
+        candid::writeFixed(out, n.nat);
+        break;
+      case IdlValueType::Int8:
+        candid::writeFixed(out, static_cast<int8_t>(n.integer));
+        break;
+      case IdlValueType::Int16:
+        candid::writeFixed(out, static_cast<int16_t>(n.integer));
+        break;
+      case IdlValueType::Int32:
+        candid::writeFixed(out, static_cast<int32_t>(n.integer));
+        break;
+      case IdlValueType::Int64:
+        candid::writeFixed(out, n.integer);
+        break;
+      case IdlValueType::Float32:
+        candid::writeFixed(out, n.f32);
+        break;
+      case IdlValueType::Float64:
+        candid::writeFixed(out, n.f64);
+        break;
+      case IdlValueType::Text:
+        writeBytes(out, n);
+        break;
+      case IdlValueType::Principal:
+      case IdlValueType::Service:
+        out.push_back(1);
+        writeBytes(out, n);
+        break;
+      case IdlValueType::Func: {
+        auto bytes = tree.data.data() + n.span.offset;
+        std::size_t len = bytes[0];
+        out.push_back(1);
+        out.push_back(1);
+        candid::writeLeb128(out, len);
+        out.insert(out.end(), bytes + 1, bytes + 1 + len);
+        candid::writeLeb128(out, n.span.size - 1 - len);
+        out.insert(out.end(), bytes + 1 + len, bytes + n.span.size);
+        break;
+      }
+      case IdlValueType::None:
+        out.push_back(0);
+        break;
+      case IdlValueType::Opt:
+        out.push_back(1);
+        write(out, index + 1, shapes[shape].inner);
+        break;
+      case IdlValueType::Vec:
+        if (n.flags & kBlob) {
+          writeBytes(out, n);
+          break;
+        }
+        candid::writeLeb128(out, n.children.count);
+        for (auto elem : Ref(tree, index))
+          write(out, elem.index, shapes[shape].inner);
+        break;
+      case IdlValueType::Record:
+        writeRecord(out, index, shape);
+        break;
+      case IdlValueType::Variant: {
+        auto alternative = Ref(tree, index).variant().value();
+        const auto &fields = shapes[shape].fields;
+        auto at = std::lower_bound(
+            fields.begin(), fields.end(),
+            std::make_pair(alternative.label(), uint32_t(0)));
+        candid::writeLeb128(out, at - fields.begin());
+        write(out, alternative.index, at->second);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  // Fields are written by increasing id, they usually already are in that
+  // order
+  void writeRecord(std::vector<uint8_t> &out, uint32_t index,
+                   uint32_t shape) const {
+    const auto &fields = shapes[shape].fields;
+    Ref record(tree, index);
+
+    bool sorted = true;
+    uint32_t last = 0;
+    std::size_t i = 0;
+    for (auto field : record) {
+      if (i++ > 0 && field.label() <= last) {
+        sorted = false;
+        break;
+      }
+      last = field.label();
+    }
+
+    if (sorted) {
+      i = 0;
+      for (auto field : record) write(out, field.index, fields[i++].second);
+      return;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> order;
+    order.reserve(fields.size());
+    for (auto field : record) order.emplace_back(field.label(), field.index);
+    std::sort(order.begin(), order.end());
+
+    for (i = 0; i < order.size(); ++i)
+      write(out, order[i].second, fields[i].second);
+  }
+
+  const IdlTree &tree;
+  std::vector<Shape> shapes;
+  std::string error;
+};
+
+std::variant<std::vector<uint8_t>, std::string> IdlTree::encode() const {
+  if (!valid || !stack.empty() || pendingLabel.has_value())
+    return std::string("Values were not built completely");
+
+  return Encoder(*this).encode();
+}
+
+/******************** IdlDecoder ***********************/
+
+std::optional<std::string> IdlDecoder::readTree(IdlTree &tree) {
+  while (nextArg < argTypes.size()) {
+    if (!buildTree(tree, argTypes[nextArg++]))
+      return std::string("Malformed argument");
+  }
+  return std::nullopt;
+}
+
+bool IdlDecoder::buildTree(IdlTree &tree, candid::TypeRef type) {
+  if (depth >= kMaxDepth) return false;
+
+  using candid::Opcode;
+
+  // fixed size numbers and floats
+  auto fixed = [&](auto value) {
+    if (!in.readFixed(value)) return false;
+    tree.add(value);
+    return true;
+  };
+  // text, principal and service ids
+  auto bytes = [&](IdlValueType as) {
+    uint64_t len;
+    const uint8_t *data;
+    if (!in.readLeb128(len) || !in.readBytes(len, data)) return false;
+    tree.leaf(as, tree.store(data, len));
+    return true;
+  };
+  auto reference = [&](IdlValueType as) {
+    uint8_t flag;
+    return in.readByte(flag) && flag == 1 && bytes(as);
+  };
+  auto big = [&](IdlValueType as, bool isSigned) {
+    std::string decimal;
+    if (!candid::readBigNumber(in, isSigned, decimal)) return false;
+    tree.leaf(as, tree.store(decimal.data(), decimal.size()), IdlTree::kBig);
+    return true;
+  };
+
+  if (type < 0) {
+    uint8_t flag;
+    auto start = in.position();
+
+    switch (static_cast<Opcode>(type)) {
+      case Opcode::Null:
+        tree.null();
+        return true;
+      case Opcode::Reserved:
+        tree.reserved();
+        return true;
+      case Opcode::Bool:
+        if (!in.readByte(flag) || flag > 1) return false;
+        tree.add(flag == 1);
+        return true;
+      case Opcode::Nat: {
+        uint64_t value;
+        if (in.readLeb128(value)) {
+          tree.append(IdlValueType::Nat).nat = value;
+          return true;
+        }
+        in.seek(start);
+        return big(IdlValueType::Nat, false);
+      }
+      case Opcode::Int: {
+        // up to 9 bytes (63 bits) fit in an int64_t
+        std::size_t len = 0;
+        do {
+          if (!in.readByte(flag)) return false;
+          ++len;
+        } while (flag & 0x80);
+        in.seek(start);
+
+        int64_t value;
+        if (len <= 9 && in.readSleb128(value)) {
+          tree.append(IdlValueType::Int).integer = value;
+          return true;
+        }
+        return big(IdlValueType::Int, true);
+      }
+      case Opcode::Nat8:
+        return fixed(uint8_t());
+      case Opcode::Nat16:
+        return fixed(uint16_t());
+      case Opcode::Nat32:
+        return fixed(uint32_t());
+      case Opcode::Nat64:
+        return fixed(uint64_t());
+      case Opcode::Int8:
+        return fixed(int8_t());
+      case Opcode::Int16:
+        return fixed(int16_t());
+      case Opcode::Int32:
+        return fixed(int32_t());
+      case Opcode::Int64:
+        return fixed(int64_t());
+      case Opcode::Float32:
+        return fixed(float());
+      case Opcode::Float64:
+        return fixed(double());
+      case Opcode::Text:
+        return bytes(IdlValueType::Text);
+      case Opcode::Principal:
+        return reference(IdlValueType::Principal);
+      default:
+        return false;
+    }
+  }
+
+  if (!validRef(type)) return false;
+  const auto &e = types->table[type];
+
+  ++depth;
+  bool built = false;
+  uint64_t len;
+  uint8_t flag;
+
+  switch (e.op) {
+    case Opcode::Opt:
+      if (!in.readByte(flag) || flag > 1) break;
+      if (flag == 0) {
+        tree.none();
+        built = true;
+        break;
+      }
+      tree.beginOpt();
+      built = buildTree(tree, e.inner);
+      tree.endOpt();
+      break;
+
+    case Opcode::Vec: {
+      if (!in.readLeb128(len) || !checkLength(e.inner, len)) break;
+
+      if (e.inner == candid::ref(Opcode::Nat8)) {
+        const uint8_t *data;
+        if (!in.readBytes(len, data)) break;
+        tree.leaf(IdlValueType::Vec, tree.store(data, len), IdlTree::kBlob);
+        built = true;
+        break;
+      }
+
+      // grown geometrically, small nested vectors must not reallocate the
+      // nodes each time
+      auto needed = tree.nodes.size() + len + 1;
+      if (needed > tree.nodes.capacity())
+        tree.nodes.reserve(std::max(needed, tree.nodes.capacity() * 2));
+      tree.beginVec();
+      built = true;
+      for (uint64_t i = 0; built && i < len; ++i)
+        built = buildTree(tree, e.inner);
+      tree.endVec();
+      break;
+    }
+
+    case Opcode::Record:
+      tree.beginRecord();
+      built = true;
+      for (uint32_t i = 0; built && i < e.fieldCount; ++i) {
+        const auto &f = field(e, i);
+        tree.field(f.hash);
+        built = buildTree(tree, f.type);
+      }
+      tree.endRecord();
+      break;
+
+    case Opcode::Variant: {
+      if (!in.readLeb128(len) || len >= e.fieldCount) break;
+      const auto &f = field(e, len);
+      tree.beginVariant(f.hash);
+      built = buildTree(tree, f.type);
+      tree.endVariant();
+      break;
+    }
+
+    case Opcode::Service:
+      built = reference(IdlValueType::Service);
+      break;
+
+    case Opcode::Func: {
+      std::vector<uint8_t> principal;
+      uint64_t methodLen;
+      const uint8_t *method;
+      if (!in.readByte(flag) || flag != 1 ||
+          !helper::read_principal_bytes(in, principal) ||
+          !in.readLeb128(methodLen) || !in.readBytes(methodLen, method))
+        break;
+      tree.func(BlobView(principal),
+                std::string_view(reinterpret_cast<const char *>(method),
+                                 methodLen));
+      built = true;
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  --depth;
+  return built;
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+
+using namespace zondax;
+
+TEST_CASE("IdlTree builds and reads values") {
+  IdlTree tree;
+  tree.beginRecord()
+      .field("memo")
+      .blob(std::string_view("abc"))
+      .field("amount")
+      .add(uint64_t(250))
+      .field("to")
+      .text("alice")
+      .field("fee")
+      .none()
+      .endRecord();
+  tree.beginVec();
+  for (uint16_t i = 0; i < 100; ++i) tree.add(i);
+  tree.endVec();
+  tree.beginVariant("Ok").add(int32_t(-7)).endVariant();
+  tree.beginOpt().nat(Number{"340282366920938463463374607431768211456"}).endOpt();
+
+  REQUIRE(tree.size() == 4);
+
+  auto record = tree[0];
+  REQUIRE(record.type() == IdlValueType::Record);
+  REQUIRE(record.size() == 4);
+  REQUIRE(record.field("amount")->get<uint64_t>() == 250);
+  REQUIRE(!record.field("amount")->get<uint32_t>().has_value());
+  REQUIRE(record.field("to")->get<std::string>() == "alice");
+  REQUIRE(record.field("memo")->blob()->asString() == "abc");
+  REQUIRE(record.field("fee")->isNull());
+  REQUIRE(!record.field("from").has_value());
+
+  auto vec = tree[1];
+  REQUIRE(vec.size() == 100);
+  REQUIRE(vec[42].get<uint16_t>() == 42);
+  uint32_t sum = 0;
+  for (auto elem : vec) sum += elem.get<uint16_t>().value();
+  REQUIRE(sum == 4950);
+
+  auto variant = tree[2].variant();
+  REQUIRE(variant.has_value());
+  REQUIRE(variant->label() == candid::idl_hash("Ok"));
+  REQUIRE(variant->get<int32_t>() == -7);
+
+  auto number = tree[3].opt()->get<Number>();
+  REQUIRE(number.has_value());
+  REQUIRE(number->value == "340282366920938463463374607431768211456");
+}
+
+TEST_CASE("IdlTree encodes as IdlEncoder") {
+  IdlTree tree;
+  tree.beginRecord().add(uint64_t(1)).text("one").endRecord();
+  tree.beginVec().beginOpt().add(uint16_t(7)).endOpt().none().endVec();
+  tree.blob(std::string_view("\x01\x02"));
+
+  auto encoded = tree.encode();
+  REQUIRE(encoded.index() == 0);
+
+  auto expected = IdlEncoder::encode(
+      std::tuple<uint64_t, std::string>{1, "one"},
+      std::vector<std::optional<uint16_t>>{7, std::nullopt},
+      std::vector<uint8_t>{1, 2});
+  REQUIRE(expected.index() == 0);
+  REQUIRE(std::get<0>(encoded) == std::get<0>(expected));
+
+  // and decodes back the same
+  auto decoded = IdlTree::decode(std::get<0>(encoded));
+  REQUIRE(decoded.index() == 0);
+  auto reencoded = std::get<0>(decoded).encode();
+  REQUIRE(reencoded.index() == 0);
+  REQUIRE(std::get<0>(reencoded) == std::get<0>(encoded));
+}
+
+TEST_CASE("IdlTree infers the types of vector elements") {
+  IdlTree tree;
+  // the first element leaves the inner types unknown
+  tree.beginVec();
+  tree.beginRecord().field("a").none().field("b").beginVec().endVec().endRecord();
+  tree.beginRecord()
+      .field("b")
+      .beginVec()
+      .text("x")
+      .endVec()
+      .field("a")
+      .beginOpt()
+      .add(int8_t(-1))
+      .endOpt()
+      .endRecord();
+  tree.endVec();
+  // variants holding different alternatives
+  tree.beginVec();
+  tree.beginVariant("Ok").add(uint32_t(5)).endVariant();
+  tree.beginVariant("Err").text("failed").endVariant();
+  tree.endVec();
+
+  auto encoded = tree.encode();
+  REQUIRE(encoded.index() == 0);
+  const auto &bytes = std::get<0>(encoded);
+
+  auto created = IdlDecoder::create(bytes.data(), bytes.size());
+  REQUIRE(created.index() == 0);
+  auto &decoder = std::get<0>(created);
+  auto rows = decoder.arg<
+      std::vector<std::tuple<std::optional<int8_t>, std::vector<std::string>>>>();
+  // a and b are not the tuple fields 0 and 1
+  REQUIRE(!rows.has_value());
+
+  auto decoded = IdlTree::decode(bytes);
+  REQUIRE(decoded.index() == 0);
+  auto &values = std::get<0>(decoded);
+  REQUIRE(values[0][1].field("a")->opt()->get<int8_t>() == -1);
+  REQUIRE(values[0][1].field("b")->operator[](0).text() == "x");
+  REQUIRE(values[0][0].field("a")->isNull());
+  REQUIRE(values[1][1].variant()->label() == candid::idl_hash("Err"));
+  REQUIRE(values[1][1].variant()->text() == "failed");
+  REQUIRE(values[1][0].variant()->get<uint32_t>() == 5);
+}
+
+TEST_CASE("IdlTree decodes big numbers and references") {
+  IdlTree tree;
+  tree.integer(Number{"-170141183460469231731687303715884105728"});
+  tree.integer(Number{"-5"});
+  tree.nat(Number{"18446744073709551615"});
+  tree.principal(std::string_view("\x04"));
+  tree.func(std::string_view("\x01\x02"), "transfer");
+  tree.reserved();
+
+  auto encoded = tree.encode();
+  REQUIRE(encoded.index() == 0);
+  auto decoded = IdlTree::decode(std::get<0>(encoded));
+  REQUIRE(decoded.index() == 0);
+  auto &values = std::get<0>(decoded);
+
+  REQUIRE(values.size() == 6);
+  REQUIRE(values[0].get<Number>()->value ==
+          "-170141183460469231731687303715884105728");
+  REQUIRE(values[1].get<Number>()->value == "-5");
+  REQUIRE(values[2].get<Number>()->value == "18446744073709551615");
+  REQUIRE(values[3].type() == IdlValueType::Principal);
+  REQUIRE(values[4].type() == IdlValueType::Func);
+  REQUIRE(values[5].isNull());
+
+  auto reencoded = values.encode();
+  REQUIRE(reencoded.index() == 0);
+  REQUIRE(std::get<0>(reencoded) == std::get<0>(encoded));
+}
+
+TEST_CASE("IdlTree rejects incomplete and mixed values") {
+  IdlTree open;
+  open.beginVec().add(true);
+  REQUIRE(open.encode().index() == 1);
+
+  IdlTree unbalanced;
+  unbalanced.beginVec().endRecord();
+  REQUIRE(unbalanced.encode().index() == 1);
+
+  IdlTree mixed;
+  mixed.beginVec().add(true).text("no").endVec();
+  REQUIRE(mixed.encode().index() == 1);
+
+  IdlTree badNumber;
+  badNumber.nat(Number{"12a"});
+  REQUIRE(badNumber.encode().index() == 1);
+
+  auto truncated = std::get<0>(IdlEncoder::encode(std::string("text")));
+  truncated.pop_back();
+  REQUIRE(IdlTree::decode(truncated).index() == 1);
+}
+
+TEST_CASE("IdlTree decodes into an arena") {
+  using Row = std::tuple<uint64_t, std::string, std::vector<uint8_t>>;
+  std::vector<Row> rows;
+  for (uint64_t i = 0; i < 50000; ++i)
+    rows.emplace_back(i, "row " + std::to_string(i),
+                      std::vector<uint8_t>(4, static_cast<uint8_t>(i)));
+  auto encoded = IdlEncoder::encode(rows);
+  REQUIRE(encoded.index() == 0);
+  const auto &bytes = std::get<0>(encoded);
+
+  // the nodes and the data only: no allocation per value
+  IdlArena arena;
+  std::size_t needed;
+  {
+    auto decoded = IdlTree::decode(bytes, &arena);
+    REQUIRE(decoded.index() == 0);
+    auto table = std::get<0>(decoded)[0];
+    REQUIRE(table.size() == rows.size());
+    REQUIRE(table[49999][1].text() == "row 49999");
+    REQUIRE(arena.chunks() <= 8);
+    needed = arena.used();
+  }
+  arena.release();
+
+  // a caller buffer sized after a first call, without any heap allocation
+  std::vector<std::max_align_t> buffer(needed / sizeof(std::max_align_t) + 64);
+  IdlArena fixed(buffer.data(), buffer.size() * sizeof(std::max_align_t),
+                 std::pmr::null_memory_resource());
+  for (int call = 0; call < 3; ++call) {
+    auto decoded = IdlTree::decode(bytes, &fixed);
+    REQUIRE(decoded.index() == 0);
+    REQUIRE(std::get<0>(decoded)[0][7][0].get<uint64_t>() == 7);
+    fixed.release();
+  }
+}
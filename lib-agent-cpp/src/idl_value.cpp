@@ -15,6 +15,7 @@
  ********************************************************************************/
 #include "idl_value.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <memory>
@@ -22,8 +23,10 @@
 #include <unordered_map>
 #include <variant>
 
+#include "candid.h"
 #include "doctest.h"
 #include "func.h"
+#include "idl_record.h"
 #include "service.h"
 #include "zondax_ic.h"
 
@@ -31,20 +34,33 @@ namespace zondax {
 
 /******************** Public ***********************/
 
-IdlValue::IdlValue(IdlValue &&o) noexcept : ptr(std::move(o.ptr)) {}
+IdlValue::IdlValue(IdlValue &&o) noexcept
+    : ptr(std::move(o.ptr)), scalarType(o.scalarType), scalar(o.scalar) {
+  o.scalarType = IdlValueType::Invalid;
+}
 
 IdlValue &IdlValue::operator=(IdlValue &&o) noexcept {
   if (&o == this) return *this;
 
   ptr = std::move(o.ptr);
+  scalarType = o.scalarType;
+  scalar = o.scalar;
+  o.scalarType = IdlValueType::Invalid;
 
   return *this;
 }
 
 IdlValueType IdlValue::type() {
-  if (ptr.get() == nullptr) return IdlValueType::Null;
+  if (scalarType != IdlValueType::Invalid) return scalarType;
+  return IdlValueRef(ptr.get()).type();
+}
+
+/******************** IdlValueRef ***********************/
 
-  uint32_t ty = idl_value_type(ptr.get());
+IdlValueType IdlValueRef::type() const {
+  if (ptr == nullptr) return IdlValueType::Null;
+
+  uint32_t ty = idl_value_type(ptr);
 
   auto max = static_cast<uint8_t>(IdlValueType::Reserved);
 
@@ -53,29 +69,33 @@ IdlValueType IdlValue::type() {
   return static_cast<IdlValueType>(ty);
 }
 
+std::optional<std::string_view> IdlValueRef::text() const {
+  if (ptr == nullptr) return std::nullopt;
+
+  uintptr_t len = 0;
+  const uint8_t *text = text_ref_from_idl_value(ptr, &len);
+  if (text == nullptr) return std::nullopt;
+
+  return std::string_view(reinterpret_cast<const char *>(text), len);
+}
+
 /******************** T -> IdlValue ***********************/
 
-IdlValue IdlValue::FromRecord(
-    std::unordered_map<std::string, IdlValue> &fields) {
-  std::vector<const char *> cKeys;
-  cKeys.reserve(fields.size());
-  std::vector<const IDLValue *> cElems;
-  cElems.reserve(fields.size());
+IdlValue IdlValue::FromRecord(IdlRecord &&record) {
+  std::vector<CRecordField> fields;
+  fields.reserve(record.size());
 
-  for (auto &[key, value] : fields) {
-    cKeys.push_back(key.c_str());
-    cElems.push_back(value.ptr.release());
+  for (auto &field : record) {
+    fields.push_back(CRecordField{field.id, field.value.release()});
   }
 
-  auto p = idl_value_with_record(cKeys.data(), cKeys.size(), cElems.data(),
-                                 cElems.size(), false);
-  return IdlValue(p);
+  return IdlValue(idl_value_with_record_ids(fields.data(), fields.size()));
 }
 
 // TODO: improve the constructors below
 
 IdlValue IdlValue::FromVariant(std::string key, IdlValue *val, uint64_t code) {
-  auto p = idl_value_with_variant(key.c_str(), val->ptr.release(), code);
+  auto p = idl_value_with_variant(key.c_str(), val->release(), code);
   return IdlValue(p);
 }
 
@@ -100,51 +120,132 @@ IdlValue::asCVariant() {
   return std::make_optional(std::make_tuple(key, code, std::move(idlvalue)));
 }
 
-std::unordered_map<std::string, IdlValue> IdlValue::getRecord() {
-  std::unordered_map<std::string, IdlValue> fields;
-  auto record = record_from_idl_value(ptr.get());
-
-  if (record == nullptr) return fields;
+IdlRecord IdlValue::getRecord() {
+  IdlRecord record;
+  RecordReader fields(ptr.get(), taking);
+  if (!fields.valid()) return record;
 
-  auto len = crecord_keys_len(record);
+  record.reserve(fields.size());
+  for (std::size_t i = 0; i < fields.size(); ++i)
+    record.fields.push_back(IdlRecord::Field{fields.id(i), fields.value(i)});
 
-  for (uintptr_t i = 0; i < len; ++i) {
-    auto cKey = crecord_take_key(record, i);
-    auto cVal = crecord_take_val(record, i);
+  // Candid sorts fields by id, only records built by hand may not be
+  auto byId = [](const IdlRecord::Field &a, const IdlRecord::Field &b) {
+    return a.id < b.id;
+  };
+  if (!std::is_sorted(record.begin(), record.end(), byId))
+    std::sort(record.begin(), record.end(), byId);
 
-    if (cKey == nullptr || cVal == nullptr) return fields;
+  return record;
+}
 
-    auto str = ctext_str(cKey);
-    if (str == nullptr) return fields;
+IdlValue::RecordReader::RecordReader(IDLValue *value, bool taking) {
+  if (value == nullptr) return;
 
-    auto key = std::string("");
-    if (str != nullptr) {
-      // because str is null terminated, we should use the
-      // string constructor for it.
-      key = std::string(str);
-    }
+  if (taking) {
+    fields = record_ids_from_idl_value(value);
+    if (fields == nullptr) return;
 
-    IdlValue val(cVal);
+    ids = crecord_ids(fields);
+    len = crecord_vals_len(fields);
+  } else {
+    if (IdlValueRef(value).type() != IdlValueType::Record) return;
 
-    fields.emplace(std::make_pair(key, std::move(val)));
+    len = record_fields_len(value);
   }
+  record = value;
+}
+
+IdlValue::RecordReader::~RecordReader() {
+  if (fields != nullptr) crecord_destroy(fields);
+}
+
+uint32_t IdlValue::RecordReader::id(std::size_t i) const {
+  if (ids != nullptr) return ids[i];
+
+  uint32_t id = 0;
+  record_field_ref(record, i, &id, nullptr, nullptr);
+  return id;
+}
 
-  crecord_destroy(record);
+IdlValue IdlValue::RecordReader::value(std::size_t i) {
+  if (fields != nullptr) return IdlValue(crecord_take_val(fields, i));
 
-  return std::move(fields);
+  // the caller owns the field, so it is copied
+  return IdlValue(
+      idl_value_clone(record_field_ref(record, i, nullptr, nullptr, nullptr)));
 }
 
 std::optional<IdlValue> IdlValue::getOpt() {
   if (ptr == nullptr) return std::nullopt;
 
-  IDLValue *result = opt_from_idl_value(ptr.get());
+  IDLValue *result = taking ? opt_take_from_idl_value(ptr.get())
+                            : opt_from_idl_value(ptr.get());
 
   if (result == nullptr) return std::nullopt;
 
   return IdlValue(result);
 }
 
-std::unique_ptr<IDLValue> IdlValue::getPtr() { return std::move(ptr); }
+std::unique_ptr<IDLValue> IdlValue::getPtr() {
+  raw();
+  return std::move(ptr);
+}
+
+/******************** Private ***********************/
+
+IDLValue *IdlValue::raw() {
+  if (scalarType == IdlValueType::Invalid) return ptr.get();
+
+  IDLValue *p = nullptr;
+  switch (scalarType) {
+    case IdlValueType::Bool:
+      p = idl_value_with_bool(scalar.b);
+      break;
+    case IdlValueType::Null:
+      p = idl_value_with_null();
+      break;
+    case IdlValueType::Reserved:
+      p = idl_value_with_reserved();
+      break;
+    case IdlValueType::Nat8:
+      p = idl_value_with_nat8(static_cast<uint8_t>(scalar.nat));
+      break;
+    case IdlValueType::Nat16:
+      p = idl_value_with_nat16(static_cast<uint16_t>(scalar.nat));
+      break;
+    case IdlValueType::Nat32:
+      p = idl_value_with_nat32(static_cast<uint32_t>(scalar.nat));
+      break;
+    case IdlValueType::Nat64:
+      p = idl_value_with_nat64(scalar.nat);
+      break;
+    case IdlValueType::Int8:
+      p = idl_value_with_int8(static_cast<int8_t>(scalar.integer));
+      break;
+    case IdlValueType::Int16:
+      p = idl_value_with_int16(static_cast<int16_t>(scalar.integer));
+      break;
+    case IdlValueType::Int32:
+      p = idl_value_with_int32(static_cast<int32_t>(scalar.integer));
+      break;
+    case IdlValueType::Int64:
+      p = idl_value_with_int64(scalar.integer);
+      break;
+    case IdlValueType::Float32:
+      p = idl_value_with_float32(scalar.f32);
+      break;
+    case IdlValueType::Float64:
+      p = idl_value_with_float64(scalar.f64);
+      break;
+    default:
+      break;
+  }
+
+  ptr.reset(p);
+  scalarType = IdlValueType::Invalid;
+  return p;
+}
 
 }  // namespace zondax
 
@@ -174,6 +275,47 @@ TEST_CASE_TEMPLATE_DEFINE("IdlValue from/to float/double", T, test_id_floats) {
 
 TEST_CASE_TEMPLATE_INVOKE(test_id_floats, float, double);
 
+TEST_CASE("IdlValue holds primitives inline") {
+  IdlValue nat(uint16_t{500});
+  REQUIRE(nat.type() == IdlValueType::Nat16);
+  REQUIRE(nat.get<uint16_t>() == uint16_t{500});
+  // only the exact type is read back, as from a Rust value
+  REQUIRE(!nat.get<uint32_t>().has_value());
+  REQUIRE(!nat.get<std::string>().has_value());
+
+  IdlValue neg(int8_t{-3});
+  REQUIRE(neg.get<int8_t>() == int8_t{-3});
+
+  REQUIRE(IdlValue::null().type() == IdlValueType::Null);
+  REQUIRE(IdlValue::null().get<std::monostate>().has_value());
+  REQUIRE(IdlValue::reserved().type() == IdlValueType::Reserved);
+  REQUIRE(!IdlValue::reserved().get<std::monostate>().has_value());
+
+  // moving carries the inline value
+  IdlValue moved(std::move(neg));
+  REQUIRE(moved.type() == IdlValueType::Int8);
+  REQUIRE(moved.get<int8_t>() == int8_t{-3});
+
+  // the Rust value is made when it is taken
+  IdlValue flag(true);
+  IdlValue boxed(flag.getPtr().release());
+  REQUIRE(boxed.type() == IdlValueType::Bool);
+  REQUIRE(boxed.get<bool>() == true);
+
+  IdlValue half(0.5);
+  IdlValue boxedHalf(half.getPtr().release());
+  REQUIRE(boxedHalf.get<double>() == 0.5);
+
+  IdlValue null(IdlValue::null().getPtr().release());
+  REQUIRE(null.get<std::monostate>().has_value());
+
+  // and inline values still nest into composite ones
+  IdlValue tuple(std::make_tuple(uint8_t{1}, int64_t{-2}, false));
+  auto back = tuple.get<std::tuple<uint8_t, int64_t, bool>>();
+  REQUIRE(back.has_value());
+  REQUIRE(std::get<1>(*back) == -2);
+}
+
 TEST_CASE("IdlValue from/to string") {
   std::string str("Zondax");
   IdlValue value(str);
@@ -182,6 +324,27 @@ TEST_CASE("IdlValue from/to string") {
   REQUIRE(back.value() == str);
 }
 
+TEST_CASE("IdlValue text keeps its length") {
+  using namespace std::string_literals;
+
+  // embedded NULs are kept both ways
+  auto text = "{\"log\": \"a\0b\"}"s;
+  IdlValue value(text);
+  REQUIRE(value.get<std::string>() == text);
+
+  std::string_view view("Zondax, and more", 6);
+  IdlValue fromView(view);
+  REQUIRE(fromView.get<std::string>() == "Zondax");
+
+  IdlValue empty(std::string_view{});
+  REQUIRE(empty.type() == IdlValueType::Text);
+  REQUIRE(empty.get<std::string>() == "");
+
+  // invalid UTF-8 is rejected
+  IdlValue invalid(std::string_view("\xff\xfe"));
+  REQUIRE(!invalid.get<std::string>().has_value());
+}
+
 TEST_CASE("IdlValue from/to Vec<string>") {
   std::string str("Zondax");
   std::vector<std::string> vec{str, str, str, str, str};
@@ -228,6 +391,50 @@ TEST_CASE_TEMPLATE_DEFINE("IdlValue from/to vector of floats", T,
 }
 TEST_CASE_TEMPLATE_INVOKE(test_id_vector_floats, float, double);
 
+TEST_CASE("IdlValue from/to blob") {
+  std::vector<uint8_t> bytes(1 << 20);
+  for (std::size_t i = 0; i < bytes.size(); ++i) bytes[i] = i * 31;
+
+  IdlValue fromView((BlobView(bytes)));
+  auto back = fromView.get<std::vector<uint8_t>>();
+  REQUIRE(back.has_value());
+  REQUIRE(back.value() == bytes);
+
+  // a blob is a vec nat8
+  IdlValue fromText(BlobView(std::string_view("abc")));
+  auto asVec = fromText.get<std::vector<IdlValue>>();
+  REQUIRE(asVec.has_value());
+  REQUIRE(asVec.value().size() == 3);
+  REQUIRE(asVec.value()[1].get<uint8_t>() == 'b');
+
+  IdlValue notBlob(std::vector<uint16_t>{1, 2});
+  REQUIRE(!notBlob.get<std::vector<uint8_t>>().has_value());
+}
+
+TEST_CASE("IdlValue from/to contiguous vectors") {
+  std::vector<int64_t> prices(4096);
+  for (std::size_t i = 0; i < prices.size(); ++i)
+    prices[i] = static_cast<int64_t>(i * i) - 1000000;
+  auto copy = prices;
+
+  IdlValue value(std::move(prices));
+  REQUIRE(value.get<std::vector<int64_t>>() == copy);
+  // the elements have the type of the vector
+  REQUIRE(!value.get<std::vector<uint64_t>>().has_value());
+  auto elems = value.get<std::vector<IdlValue>>();
+  REQUIRE(elems.has_value());
+  REQUIRE(elems.value()[0].get<int64_t>() == -1000000);
+
+  std::vector<bool> flags{true, false, false, true};
+  IdlValue fromBools((std::vector<bool>(flags)));
+  REQUIRE(fromBools.get<std::vector<bool>>() == flags);
+
+  IdlValue empty(std::vector<double>{});
+  auto back = empty.get<std::vector<double>>();
+  REQUIRE(back.has_value());
+  REQUIRE(back.value().empty());
+}
+
 TEST_CASE("IdlValue from/to tuple") {
   // Get Principal from slice of bytes
   std::vector<uint8_t> slice = {0x1};
@@ -283,6 +490,53 @@ TEST_CASE("IdlValue from/to vector<std::tuple<Args...>>") {
   REQUIRE(copy == vec2);
 }
 
+TEST_CASE("IdlValue tuples are read by position") {
+  // a longer record reads as its leading fields
+  IdlRecord wide;
+  wide.set(0, IdlValue(std::string("a")));
+  wide.set(1, IdlValue(uint32_t{2}));
+  wide.set(2, IdlValue(true));
+  auto pair = IdlValue::FromRecord(std::move(wide))
+                  .get<std::tuple<std::string, uint32_t>>();
+  REQUIRE(pair.has_value());
+  REQUIRE(std::get<0>(*pair) == "a");
+  REQUIRE(std::get<1>(*pair) == 2);
+
+  // labels must be 0, 1, ...
+  IdlRecord gap;
+  gap.set(0, IdlValue(std::string("a")));
+  gap.set(2, IdlValue(uint32_t{2}));
+  REQUIRE(!IdlValue::FromRecord(std::move(gap))
+               .get<std::tuple<std::string, uint32_t>>()
+               .has_value());
+
+  IdlRecord named;
+  named.set("first", IdlValue(std::string("a")));
+  REQUIRE(!IdlValue::FromRecord(std::move(named))
+               .get<std::tuple<std::string>>()
+               .has_value());
+
+  // as must the types of the fields
+  IdlValue mismatch(std::make_tuple(std::string("a"), uint64_t{2}));
+  REQUIRE(!mismatch.get<std::tuple<std::string, uint32_t>>().has_value());
+
+  // and a record too short
+  IdlValue single(std::make_tuple(std::string("a")));
+  REQUIRE(!single.get<std::tuple<std::string, uint32_t>>().has_value());
+
+  // a failed read leaves the value readable, with another type or again
+  REQUIRE(std::get<1>(*mismatch.get<std::tuple<std::string, uint64_t>>()) ==
+          2);
+  REQUIRE(single.get<std::tuple<std::string>>() ==
+          std::make_tuple(std::string("a")));
+  REQUIRE(mismatch.get<std::tuple<std::string, uint64_t>>().has_value());
+
+  // take moves the fields out
+  auto taken = std::move(mismatch).take<std::tuple<std::string, uint64_t>>();
+  REQUIRE(std::get<0>(*taken) == "a");
+  REQUIRE(!mismatch.get<std::tuple<std::string, uint64_t>>().has_value());
+}
+
 TEST_CASE("IdlValue from/to std::optional<T>") {
   uint32_t num = 100;
   std::optional<uint32_t> op(num);
@@ -321,70 +575,41 @@ struct Sender_report {
   std::string report;
 };
 
+// field tables as the generated bindings declare them
+namespace zondax {
 template <>
-IdlValue::IdlValue(Peer_authentication peer) {
-  std::unordered_map<std::string, IdlValue> fields;
+struct IdlRecordFields<Peer_authentication> {
+  using type = std::tuple<
+      RecordField<candid::idl_hash("value"), &Peer_authentication::value>>;
+};
 
-  {
-    auto name = std::string("value");
-    auto val = IdlValue(peer.value);
-    fields.emplace(std::make_pair(name, std::move(val)));
-  }
+template <>
+struct IdlRecordFields<Sender_report> {
+  using type = std::tuple<
+      RecordField<candid::idl_hash("report"), &Sender_report::report>>;
+};
+}  // namespace zondax
 
-  *this = std::move(IdlValue::FromRecord(fields));
+template <>
+IdlValue::IdlValue(Peer_authentication peer) {
+  initializeFromRecord(peer);
 }
 
 template <>
 IdlValue::IdlValue(Sender_report sender) {
-  std::unordered_map<std::string, IdlValue> fields;
-
-  {
-    auto name = std::string("report");
-    auto val = IdlValue(sender.report);
-    fields.emplace(std::make_pair(name, std::move(val)));
-  }
-
-  *this = std::move(IdlValue::FromRecord(fields));
+  initializeFromRecord(sender);
 }
 
 template <>
 std::optional<Peer_authentication> IdlValue::getImpl(
     helper::tag_type<Peer_authentication> t) {
-  Peer_authentication result;
-
-  auto fields = getRecord();
-  {
-    auto field = std::move(fields["value"]);
-    auto val = field.get<std::string>();
-
-    if (val.has_value()) {
-      result.value = std::move(val.value());
-    } else {
-      return std::nullopt;
-    }
-  }
-
-  return std::make_optional(std::move(result));
+  return getFromRecord<Peer_authentication>();
 }
 
 template <>
 std::optional<Sender_report> IdlValue::getImpl(
     helper::tag_type<Sender_report> t) {
-  Sender_report result;
-
-  auto fields = getRecord();
-  {
-    auto field = std::move(fields["report"]);
-    auto val = field.get<std::string>();
-
-    if (val.has_value()) {
-      result.report = std::move(val.value());
-    } else {
-      return std::nullopt;
-    }
-  }
-
-  return std::make_optional(std::move(result));
+  return getFromRecord<Sender_report>();
 }
 
 TEST_CASE("IdlValue from/to std::variant<Peer_authentication, Sender_report>") {
@@ -408,3 +633,186 @@ TEST_CASE("IdlValue from/to std::variant<Peer_authentication, Sender_report>") {
   auto peer2 = std::get<Peer_authentication>(var2);
   REQUIRE(peer2.value.compare(auth.value));
 }
+
+TEST_CASE("IdlValue variants are matched by label") {
+  using Event = std::variant<Peer_authentication, Sender_report>;
+
+  // the alternative comes from the label, whatever its position in the type
+  // of the sender
+  Sender_report sender;
+  sender.report = "done";
+  IdlValue report(std::move(sender));
+  auto value = IdlValue::FromVariant("report", &report, 5);
+  auto event = value.get<Event>();
+  REQUIRE(event.has_value());
+  REQUIRE(std::holds_alternative<Sender_report>(*event));
+  REQUIRE(std::get<Sender_report>(*event).report == "done");
+
+  IdlValue other(std::string("x"));
+  REQUIRE(!IdlValue::FromVariant("other", &other, 0).get<Event>().has_value());
+
+  // a known label with a payload of another type
+  IdlValue text(std::string("x"));
+  REQUIRE(!IdlValue::FromVariant("report", &text, 1).get<Event>().has_value());
+
+  IdlValue notVariant(std::string("report"));
+  REQUIRE(!notVariant.get<Event>().has_value());
+}
+
+TEST_CASE("IdlValue take moves the value out") {
+  using Event = std::variant<Peer_authentication, Sender_report>;
+
+  // get copies the payload, the variant can be read again
+  Sender_report sender;
+  sender.report = "done";
+  IdlValue report(std::move(sender));
+  auto value = IdlValue::FromVariant("report", &report, 5);
+  REQUIRE(value.get<Event>().has_value());
+  auto event = std::move(value).take<Event>();
+  REQUIRE(event.has_value());
+  REQUIRE(std::get<Sender_report>(*event).report == "done");
+
+  std::vector<std::string> names{"a", "b", "c"};
+  IdlValue vec(std::move(names));
+  auto taken = std::move(vec).take<std::vector<std::string>>();
+  REQUIRE(taken == std::vector<std::string>{"a", "b", "c"});
+  // the elements were moved out, an empty Vec is left
+  REQUIRE(vec.get<std::vector<std::string>>()->empty());
+
+  IdlValue opt(std::make_optional(std::vector<std::optional<std::string>>{
+      std::string("x"), std::nullopt}));
+  using Nested = std::optional<std::vector<std::optional<std::string>>>;
+  auto inner = std::move(opt).take<Nested>();
+  REQUIRE(inner.has_value());
+  REQUIRE(inner->has_value());
+  REQUIRE((*inner)->size() == 2);
+  REQUIRE((**inner)[0] == "x");
+  REQUIRE(!(**inner)[1].has_value());
+
+  IdlValue record(std::make_tuple(std::string("zondax"), uint64_t{7}));
+  auto map =
+      std::move(record).take<std::unordered_map<std::string, IdlValue>>();
+  REQUIRE(map.has_value());
+  REQUIRE(map->size() == 2);
+  REQUIRE(map->at("0").get<std::string>() == "zondax");
+
+  IdlValue text(std::string("text"));
+  REQUIRE(!std::move(text).take<std::vector<std::string>>().has_value());
+}
+
+struct Account {
+  std::string owner;
+  std::optional<std::vector<uint8_t>> subaccount;
+  uint64_t balance;
+};
+
+namespace zondax {
+template <>
+struct IdlRecordFields<Account> {
+  // sorted by label id: balance, owner, subaccount
+  using type =
+      std::tuple<RecordField<candid::idl_hash("balance"), &Account::balance>,
+                 RecordField<candid::idl_hash("owner"), &Account::owner>,
+                 RecordField<candid::idl_hash("subaccount"),
+                             &Account::subaccount>>;
+};
+}  // namespace zondax
+
+template <>
+IdlValue::IdlValue(Account account) {
+  initializeFromRecord(account);
+}
+
+template <>
+std::optional<Account> IdlValue::getImpl(helper::tag_type<Account>) {
+  return getFromRecord<Account>();
+}
+
+TEST_CASE("IdlValue from/to record with a field table") {
+  Account account{"alice", std::nullopt, 42};
+  IdlValue value(std::move(account));
+  REQUIRE(value.type() == IdlValueType::Record);
+  auto same = value.get<Account>();
+  REQUIRE(same.has_value());
+  REQUIRE(same->owner == "alice");
+  REQUIRE(!same->subaccount.has_value());
+  // get reads the fields in place, take moves them out
+  REQUIRE(value.get<Account>()->balance == 42);
+  REQUIRE(std::move(value).take<Account>()->owner == "alice");
+  REQUIRE(value.type() == IdlValueType::Record);
+  REQUIRE(!value.get<Account>().has_value());
+
+  IdlValue again(Account{"bob", std::vector<uint8_t>{1, 2}, 7});
+  auto back = again.get<Account>();
+  REQUIRE(back.has_value());
+  REQUIRE(back->owner == "bob");
+  REQUIRE(back->subaccount == std::vector<uint8_t>{1, 2});
+  REQUIRE(back->balance == 7);
+
+  // a missing optional field is null, a missing required one an error
+  IdlRecord partial;
+  partial.set("owner", IdlValue(std::string("carol")));
+  partial.set("balance", IdlValue(uint64_t(1)));
+  auto named = IdlValue::FromRecord(std::move(partial)).get<Account>();
+  REQUIRE(named.has_value());
+  REQUIRE(named->owner == "carol");
+  REQUIRE(!named->subaccount.has_value());
+
+  IdlRecord owner;
+  owner.set("owner", IdlValue(std::string("carol")));
+  REQUIRE(!IdlValue::FromRecord(std::move(owner)).get<Account>().has_value());
+
+  // a field that does not match leaves the value readable
+  IdlRecord wrong;
+  wrong.set("owner", IdlValue(std::string("dave")));
+  wrong.set("balance", IdlValue(uint32_t(3)));
+  auto mismatch = IdlValue::FromRecord(std::move(wrong));
+  REQUIRE(!mismatch.get<Account>().has_value());
+  REQUIRE(mismatch.fields().size() == 2);
+  REQUIRE(mismatch.getRecord().find("owner")->get<std::string>() == "dave");
+}
+
+TEST_CASE("IdlValue fields and elements are borrowed") {
+  std::vector<uint64_t> ids{1, 2, 3};
+  std::vector<const IDLValue *> vals{
+      IdlValue(std::string("zero")).getPtr().release(),
+      IdlValue(std::move(ids)).getPtr().release(),
+      IdlValue(Account{"alice", std::nullopt, 42}).getPtr().release()};
+  std::vector<const char *> keys{"name", "ids", "account"};
+  IdlValue value(idl_value_with_record(keys.data(), keys.size(), vals.data(),
+                                       vals.size(), false));
+
+  std::size_t count = 0;
+  uint64_t sum = 0;
+  for (auto field : value.fields()) {
+    ++count;
+    REQUIRE(field.id == candid::idl_hash(field.name));
+    if (field.name == "name") {
+      REQUIRE(field.value.type() == IdlValueType::Text);
+      REQUIRE(field.value.text() == std::string_view("zero"));
+    } else if (field.name == "ids") {
+      REQUIRE(field.value.elements().size() == 3);
+      for (auto id : field.value.elements()) sum += id.get<uint64_t>().value();
+    } else {
+      // records are read in place
+      REQUIRE(field.value.get<Account>()->balance == 42);
+      REQUIRE(field.value.get<Account>()->owner == "alice");
+      auto inner = field.value.fields();
+      REQUIRE(inner.size() == 3);
+      REQUIRE((*inner.begin()).name.empty());
+      REQUIRE((*inner.begin()).id == candid::idl_hash("balance"));
+    }
+  }
+  REQUIRE(count == 3);
+  REQUIRE(sum == 6);
+
+  // nothing was moved out
+  REQUIRE(value.fields().size() == 3);
+  auto record = value.get<std::unordered_map<std::string, IdlValue>>();
+  REQUIRE(record->at("ids").get<std::vector<uint64_t>>()->size() == 3);
+
+  IdlValue text(std::string("text"));
+  REQUIRE(text.fields().empty());
+  REQUIRE(text.elements().empty());
+  REQUIRE(IdlValue(uint8_t{1}).fields().empty());
+}
@@ -0,0 +1,315 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "idl_view.h"
+
+#include "doctest.h"
+#include "idl_encoder.h"
+
+namespace zondax {
+
+std::optional<IdlView> IdlDecoder::view() {
+  if (nextArg >= argTypes.size()) return std::nullopt;
+
+  auto type = argTypes[nextArg];
+  auto pos = in.position();
+  // once skipped the value is known to be well formed, so moving around it
+  // later can not fail
+  if (!skip(type)) return std::nullopt;
+
+  ++nextArg;
+  return IdlView(*this, type, pos);
+}
+
+std::size_t IdlView::next(const IdlDecoder &decoder, candid::TypeRef type,
+                          std::size_t pos) {
+  IdlDecoder in(decoder, pos);
+  in.skip(type);
+  return in.reader().position();
+}
+
+std::optional<std::string_view> IdlView::text() const {
+  if (decoder == nullptr || type_ != candid::ref(candid::Opcode::Text))
+    return std::nullopt;
+
+  auto in = cursor();
+  uint64_t len;
+  const uint8_t *bytes;
+  if (!in.reader().readLeb128(len) || !in.reader().readBytes(len, bytes))
+    return std::nullopt;
+
+  return std::string_view(reinterpret_cast<const char *>(bytes), len);
+}
+
+std::optional<BlobView> IdlView::blob() const {
+  if (decoder == nullptr) return std::nullopt;
+
+  auto in = cursor();
+  return IdlDecode<BlobView>::read(in, type_);
+}
+
+bool IdlView::isNull() const {
+  if (type_ == candid::ref(candid::Opcode::Null) ||
+      type_ == candid::ref(candid::Opcode::Reserved))
+    return true;
+
+  if (decoder == nullptr ||
+      decoder->entry(type_, candid::Opcode::Opt) == nullptr)
+    return false;
+
+  auto in = cursor();
+  uint8_t flag;
+  return in.reader().readByte(flag) && flag == 0;
+}
+
+std::optional<IdlView> IdlView::opt() const {
+  if (decoder == nullptr) return std::nullopt;
+
+  auto opt = decoder->entry(type_, candid::Opcode::Opt);
+  if (opt == nullptr) return std::nullopt;
+
+  auto in = cursor();
+  uint8_t flag;
+  if (!in.reader().readByte(flag) || flag != 1) return std::nullopt;
+
+  return IdlView(*decoder, opt->inner, pos + 1);
+}
+
+std::optional<IdlView::Vec> IdlView::vec() const {
+  if (decoder == nullptr) return std::nullopt;
+
+  auto vec = decoder->entry(type_, candid::Opcode::Vec);
+  if (vec == nullptr) return std::nullopt;
+
+  auto in = cursor();
+  uint64_t len;
+  if (!in.reader().readLeb128(len)) return std::nullopt;
+
+  return Vec(*decoder, vec->inner, in.reader().position(), len);
+}
+
+std::optional<IdlView::Record> IdlView::record() const {
+  if (decoder == nullptr) return std::nullopt;
+
+  auto record = decoder->entry(type_, candid::Opcode::Record);
+  if (record == nullptr) return std::nullopt;
+
+  return Record(*decoder, *record, pos);
+}
+
+std::optional<IdlView::Field> IdlView::variant() const {
+  if (decoder == nullptr) return std::nullopt;
+
+  auto variant = decoder->entry(type_, candid::Opcode::Variant);
+  if (variant == nullptr) return std::nullopt;
+
+  auto in = cursor();
+  uint64_t index;
+  if (!in.reader().readLeb128(index) || index >= variant->fieldCount)
+    return std::nullopt;
+
+  const auto &field = decoder->field(*variant, index);
+  return Field{field.hash,
+               IdlView(*decoder, field.type, in.reader().position())};
+}
+
+std::optional<IdlView> IdlView::field(std::string_view label) const {
+  return field(candid::idl_hash(label));
+}
+
+std::optional<IdlView> IdlView::field(uint32_t hash) const {
+  auto fields = record();
+  if (!fields.has_value()) return std::nullopt;
+  return fields->find(hash);
+}
+
+IdlView IdlView::Vec::operator[](std::size_t i) const {
+  if (elemSize.has_value())
+    return IdlView(*decoder, inner, first + i * elemSize.value());
+
+  auto it = begin();
+  for (std::size_t n = 0; n < i; ++n) ++it;
+  return *it;
+}
+
+std::optional<IdlView> IdlView::Record::find(uint32_t hash) const {
+  // fields are sorted by hash
+  for (auto it = begin(); it != end(); ++it) {
+    auto field = *it;
+    if (field.hash == hash) return field.value;
+    if (field.hash > hash) break;
+  }
+  return std::nullopt;
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+
+using namespace zondax;
+
+namespace {
+struct Event_trade {
+  static constexpr std::string_view __CANDID_VARIANT_NAME{"trade"};
+  static constexpr std::size_t __CANDID_VARIANT_CODE{0};
+  std::tuple<uint64_t, double> value;
+};
+struct Event_halt {
+  static constexpr std::string_view __CANDID_VARIANT_NAME{"halt"};
+  static constexpr std::size_t __CANDID_VARIANT_CODE{1};
+};
+}  // namespace
+
+template <>
+struct zondax::IdlEncode<Event_trade> {
+  using Payload = IdlEncode<std::tuple<uint64_t, double>>;
+  static candid::TypeRef type(candid::TypeTable &table) {
+    return Payload::type(table);
+  }
+  static bool write(std::vector<uint8_t> &out, const Event_trade &trade) {
+    return Payload::write(out, trade.value);
+  }
+};
+
+TEST_CASE("IdlView walks a message without decoding it") {
+  using Row = std::tuple<std::string, std::vector<uint8_t>,
+                         std::optional<std::vector<uint32_t>>>;
+  std::vector<Row> rows;
+  for (uint32_t i = 0; i < 50; ++i) {
+    std::optional<std::vector<uint32_t>> pair;
+    if (i % 3) pair = std::vector<uint32_t>{i, i * 2};
+    rows.emplace_back("row " + std::to_string(i),
+                      std::vector<uint8_t>(i, static_cast<uint8_t>(i)), pair);
+  }
+
+  auto encoded = IdlEncoder::encode(std::string("header"), rows,
+                                    std::vector<uint16_t>{1, 2, 3}, true);
+  REQUIRE(encoded.index() == 0);
+  const auto &bytes = std::get<0>(encoded);
+
+  auto created = IdlDecoder::create(bytes.data(), bytes.size());
+  REQUIRE(created.index() == 0);
+  auto &decoder = std::get<0>(created);
+
+  auto header = decoder.view();
+  REQUIRE(header.has_value());
+  REQUIRE(header->text() == "header");
+  REQUIRE(!header->vec().has_value());
+
+  auto table = decoder.view();
+  REQUIRE(table.has_value());
+  auto vec = table->vec();
+  REQUIRE(vec.has_value());
+  REQUIRE(vec->size() == rows.size());
+
+  // text and blobs point into the message
+  auto name = (*vec)[42].field(0u)->text();
+  REQUIRE(name == "row 42");
+  REQUIRE(name->data() >= reinterpret_cast<const char *>(bytes.data()));
+  REQUIRE(name->data() < reinterpret_cast<const char *>(bytes.data()) +
+                             bytes.size());
+
+  uint32_t i = 0;
+  for (auto row : *vec) {
+    auto blob = row.field(1u)->blob();
+    REQUIRE(blob.has_value());
+    REQUIRE(blob->size() == i);
+
+    auto opt = row.field(2u);
+    REQUIRE(opt->isNull() == (i % 3 == 0));
+    if (auto values = opt->opt()) {
+      REQUIRE(values->get<std::vector<uint32_t>>() ==
+              std::vector<uint32_t>{i, i * 2});
+      REQUIRE((*values->vec())[1].get<uint32_t>() == i * 2);
+    }
+
+    auto record = row.record();
+    REQUIRE(record.has_value());
+    std::size_t fields = 0;
+    for (auto field : *record) REQUIRE(field.hash == fields++);
+    REQUIRE(fields == record->size());
+    REQUIRE(!row.field(3u).has_value());
+    ++i;
+  }
+  REQUIRE(i == rows.size());
+
+  // fixed size elements are reached directly
+  auto numbers = decoder.view();
+  REQUIRE((*numbers->vec())[2].get<uint16_t>() == 3);
+  REQUIRE(!(*numbers->vec())[2].get<uint32_t>().has_value());
+
+  // views do not move the decoder
+  REQUIRE(decoder.arg<bool>() == true);
+  REQUIRE(!decoder.view().has_value());
+}
+
+TEST_CASE("IdlView iterators over one decoder are independent") {
+  std::vector<std::string> words{"one", "two", "three", "four"};
+  std::vector<std::vector<uint8_t>> blobs{{1}, {2, 2}, {3, 3, 3}, {4}};
+  auto encoded = IdlEncoder::encode(words, blobs);
+  REQUIRE(encoded.index() == 0);
+  const auto &bytes = std::get<0>(encoded);
+
+  auto created = IdlDecoder::create(bytes.data(), bytes.size());
+  REQUIRE(created.index() == 0);
+  auto &decoder = std::get<0>(created);
+  auto first = decoder.view()->vec();
+  auto second = decoder.view()->vec();
+  REQUIRE(first.has_value());
+  REQUIRE(second.has_value());
+
+  // two walks of variable size elements, interleaved with reads
+  auto a = first->begin();
+  auto b = second->begin();
+  auto again = first->begin();
+  for (std::size_t i = 0; i < words.size(); ++i, ++a, ++b) {
+    REQUIRE((*a).text() == words[i]);
+    REQUIRE((*b).blob()->size() == blobs[i].size());
+    REQUIRE((*second)[words.size() - 1 - i].get<std::vector<uint8_t>>() ==
+            blobs[words.size() - 1 - i]);
+    if (i % 2 == 0) {
+      REQUIRE((*again).get<std::string>() == words[i / 2]);
+      ++again;
+    }
+  }
+  REQUIRE(a == first->end());
+  REQUIRE(b == second->end());
+  REQUIRE(decoder.argCount() == 2);
+}
+
+TEST_CASE("IdlView variants and labels") {
+  using Event = std::variant<Event_trade, Event_halt>;
+  auto encoded = IdlEncoder::encode(Event{Event_trade{{7, 2.5}}});
+  REQUIRE(encoded.index() == 0);
+  const auto &bytes = std::get<0>(encoded);
+
+  auto created = IdlDecoder::create(bytes.data(), bytes.size());
+  REQUIRE(created.index() == 0);
+  auto event = std::get<0>(created).view();
+  REQUIRE(event.has_value());
+
+  auto alternative = event->variant();
+  REQUIRE(alternative.has_value());
+  REQUIRE(alternative->hash == candid::idl_hash("trade"));
+  REQUIRE(alternative->value.field(1u)->get<double>() == 2.5);
+  REQUIRE(!alternative->value.field("price").has_value());
+
+  // a malformed argument has no view
+  auto truncated = bytes;
+  truncated.pop_back();
+  auto broken = IdlDecoder::create(truncated.data(), truncated.size());
+  REQUIRE(broken.index() == 0);
+  REQUIRE(!std::get<0>(broken).view().has_value());
+}
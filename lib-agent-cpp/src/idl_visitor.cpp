@@ -0,0 +1,306 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "idl_visitor.h"
+
+#include "doctest.h"
+#include "idl_encoder.h"
+
+namespace zondax {
+
+std::optional<std::string> IdlDecoder::visit(IdlVisitor &visitor) {
+  while (nextArg < argTypes.size()) {
+    auto index = nextArg++;
+    auto type = argTypes[index];
+    auto start = in.position();
+
+    auto action = visitor.beginArg(index, type);
+    if (action == Visit::Stop) {
+      --nextArg;
+      return std::nullopt;
+    }
+
+    auto walked = action == Visit::Skip
+                      ? (skip(type) ? Walked::Done : Walked::Failed)
+                      : walk(visitor, type);
+
+    if (walked == Walked::Failed) return std::string("Malformed argument");
+    if (walked == Walked::Stopped) {
+      // the rest of the argument is passed, so that the following ones can
+      // still be read
+      in.seek(start);
+      return skip(type) ? std::nullopt
+                        : std::make_optional<std::string>("Malformed argument");
+    }
+
+    if (action == Visit::Continue && visitor.endArg(index) == Visit::Stop)
+      return std::nullopt;
+  }
+
+  return std::nullopt;
+}
+
+IdlDecoder::Walked IdlDecoder::walk(IdlVisitor &visitor,
+                                    candid::TypeRef type) {
+  if (depth >= kMaxDepth) return Walked::Failed;
+
+  auto start = in.position();
+
+  // the visitor sees the value, then it is checked and passed
+  auto leaf = [&]() {
+    auto action = visitor.value(IdlView(*this, type, start));
+    if (!skip(type)) return Walked::Failed;
+    return action == Visit::Stop ? Walked::Stopped : Walked::Done;
+  };
+  // contents the visitor does not want are skipped as a whole
+  auto skipped = [&]() {
+    in.seek(start);
+    return skip(type) ? Walked::Done : Walked::Failed;
+  };
+  auto end = [](Visit action) {
+    return action == Visit::Stop ? Walked::Stopped : Walked::Done;
+  };
+
+  if (type < 0) return leaf();
+  const auto &e = types->table[type];
+
+  ++depth;
+  auto walked = Walked::Failed;
+  Visit action;
+  uint64_t len;
+  uint8_t flag;
+
+  switch (e.op) {
+    case candid::Opcode::Vec:
+      if (e.inner == candid::ref(candid::Opcode::Nat8)) {
+        walked = leaf();
+        break;
+      }
+
+      if (!in.readLeb128(len) || !checkLength(e.inner, len)) break;
+      action = visitor.beginVec(len);
+      if (action != Visit::Continue) {
+        walked = action == Visit::Stop ? Walked::Stopped : skipped();
+        break;
+      }
+
+      walked = Walked::Done;
+      for (uint64_t i = 0; walked == Walked::Done && i < len; ++i)
+        walked = walk(visitor, e.inner);
+      if (walked == Walked::Done) walked = end(visitor.endVec());
+      break;
+
+    case candid::Opcode::Record:
+      action = visitor.beginRecord(e.fieldCount);
+      if (action != Visit::Continue) {
+        walked = action == Visit::Stop ? Walked::Stopped : skipped();
+        break;
+      }
+
+      walked = Walked::Done;
+      for (uint32_t i = 0; walked == Walked::Done && i < e.fieldCount; ++i) {
+        const auto &f = field(e, i);
+        action = visitor.recordField(f.hash);
+        if (action == Visit::Stop) {
+          walked = Walked::Stopped;
+        } else if (action == Visit::Skip) {
+          walked = skip(f.type) ? Walked::Done : Walked::Failed;
+        } else {
+          walked = walk(visitor, f.type);
+        }
+      }
+      if (walked == Walked::Done) walked = end(visitor.endRecord());
+      break;
+
+    case candid::Opcode::Opt:
+      if (!in.readByte(flag) || flag > 1) break;
+      action = visitor.beginOpt(flag == 1);
+      if (action != Visit::Continue || flag == 0) {
+        walked = action == Visit::Stop ? Walked::Stopped : skipped();
+        break;
+      }
+
+      walked = walk(visitor, e.inner);
+      if (walked == Walked::Done) walked = end(visitor.endOpt());
+      break;
+
+    case candid::Opcode::Variant: {
+      if (!in.readLeb128(len) || len >= e.fieldCount) break;
+      const auto &f = field(e, len);
+      action = visitor.beginVariant(f.hash);
+      if (action != Visit::Continue) {
+        walked = action == Visit::Stop ? Walked::Stopped : skipped();
+        break;
+      }
+
+      walked = walk(visitor, f.type);
+      if (walked == Walked::Done) walked = end(visitor.endVariant());
+      break;
+    }
+
+    default:
+      // references to services and functions
+      walked = leaf();
+      break;
+  }
+
+  --depth;
+  return walked;
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+
+using namespace zondax;
+
+namespace {
+// Sums a column of a table without decoding the rows
+struct ColumnSum : IdlVisitor {
+  uint32_t column;
+  bool inColumn = false;
+  uint64_t sum = 0;
+  std::size_t rows = 0;
+  std::size_t depth = 0;
+
+  explicit ColumnSum(uint32_t column) : column(column) {}
+
+  Visit beginVec(std::size_t) override {
+    ++depth;
+    return Visit::Continue;
+  }
+  Visit endVec() override {
+    --depth;
+    return Visit::Continue;
+  }
+  Visit beginRecord(std::size_t) override {
+    ++rows;
+    return Visit::Continue;
+  }
+  Visit recordField(uint32_t hash) override {
+    inColumn = hash == column;
+    return inColumn ? Visit::Continue : Visit::Skip;
+  }
+  Visit value(const IdlView &value) override {
+    if (inColumn) sum += value.get<uint64_t>().value_or(0);
+    return Visit::Continue;
+  }
+};
+
+// Records every event, to check their order
+struct Trace : IdlVisitor {
+  std::string events;
+  std::size_t stopAfter = SIZE_MAX;
+
+  Visit add(const std::string &event) {
+    events += event + " ";
+    return --stopAfter == 0 ? Visit::Stop : Visit::Continue;
+  }
+
+  Visit beginArg(std::size_t i, candid::TypeRef) override {
+    return add("arg" + std::to_string(i));
+  }
+  Visit endArg(std::size_t) override { return add("/arg"); }
+  Visit value(const IdlView &v) override {
+    if (auto text = v.text()) return add(std::string(*text));
+    if (auto blob = v.blob()) return add("blob" + std::to_string(blob->size()));
+    return add(std::to_string(v.get<uint16_t>().value_or(0)));
+  }
+  Visit beginVec(std::size_t len) override {
+    return add("vec" + std::to_string(len));
+  }
+  Visit endVec() override { return add("/vec"); }
+  Visit beginRecord(std::size_t) override { return add("rec"); }
+  Visit recordField(uint32_t hash) override {
+    return add("." + std::to_string(hash));
+  }
+  Visit endRecord() override { return add("/rec"); }
+  Visit beginOpt(bool present) override {
+    return add(present ? "opt" : "none");
+  }
+  Visit endOpt() override { return add("/opt"); }
+};
+}  // namespace
+
+TEST_CASE("IdlDecoder visits a table column by column") {
+  std::vector<std::tuple<std::string, uint64_t, std::vector<uint8_t>>> rows;
+  uint64_t expected = 0;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    rows.emplace_back(std::to_string(i), i * 3, std::vector<uint8_t>(16));
+    expected += i * 3;
+  }
+
+  auto encoded = IdlEncoder::encode(rows);
+  REQUIRE(encoded.index() == 0);
+  const auto &bytes = std::get<0>(encoded);
+
+  auto created = IdlDecoder::create(bytes.data(), bytes.size());
+  REQUIRE(created.index() == 0);
+
+  ColumnSum visitor(1);
+  REQUIRE(!std::get<0>(created).visit(visitor).has_value());
+  REQUIRE(visitor.sum == expected);
+  REQUIRE(visitor.rows == rows.size());
+  REQUIRE(visitor.depth == 0);
+}
+
+TEST_CASE("IdlDecoder visitor events") {
+  auto encoded = IdlEncoder::encode(
+      std::string("a"),
+      std::vector<std::optional<uint16_t>>{7, std::nullopt},
+      std::tuple<uint16_t, std::vector<uint8_t>>{1, {1, 2}});
+  REQUIRE(encoded.index() == 0);
+  const auto &bytes = std::get<0>(encoded);
+
+  {
+    auto created = IdlDecoder::create(bytes.data(), bytes.size());
+    Trace trace;
+    REQUIRE(!std::get<0>(created).visit(trace).has_value());
+    REQUIRE(trace.events ==
+            "arg0 a /arg arg1 vec2 opt 7 /opt none /vec /arg "
+            "arg2 rec .0 1 .1 blob2 /rec /arg ");
+  }
+
+  {
+    // stopping leaves the remaining arguments to the decoder
+    auto created = IdlDecoder::create(bytes.data(), bytes.size());
+    auto &decoder = std::get<0>(created);
+    Trace trace;
+    trace.stopAfter = 3;
+    REQUIRE(!decoder.visit(trace).has_value());
+    REQUIRE(trace.events == "arg0 a /arg ");
+    REQUIRE(decoder.arg<std::vector<std::optional<uint16_t>>>().has_value());
+  }
+
+  {
+    // as does stopping inside an argument
+    auto created = IdlDecoder::create(bytes.data(), bytes.size());
+    auto &decoder = std::get<0>(created);
+    Trace trace;
+    trace.stopAfter = 6;
+    REQUIRE(!decoder.visit(trace).has_value());
+    REQUIRE(trace.events == "arg0 a /arg arg1 vec2 opt ");
+    REQUIRE(decoder.arg<std::tuple<uint16_t, std::vector<uint8_t>>>()
+                .has_value());
+  }
+
+  {
+    auto truncated = bytes;
+    truncated.pop_back();
+    auto created = IdlDecoder::create(truncated.data(), truncated.size());
+    Trace trace;
+    REQUIRE(std::get<0>(created).visit(trace).has_value());
+  }
+}
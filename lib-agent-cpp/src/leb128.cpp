@@ -0,0 +1,408 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "leb128.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "doctest.h"
+
+namespace zondax::candid::leb128 {
+
+namespace {
+
+// Decodes the number at data[pos], false if it is truncated or does not fit
+// in 64 bits. `pos` is only moved on success.
+bool decodeOne(const uint8_t *data, std::size_t size, std::size_t &pos,
+               uint64_t &out) {
+  uint64_t value = 0;
+  std::size_t p = pos;
+  for (unsigned shift = 0; shift < 64 && p < size; shift += 7) {
+    uint8_t byte = data[p++];
+    // the last byte only has room for bit 63
+    if (shift == 63 && (byte & 0x7e)) return false;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      out = value;
+      pos = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool decodeOne(const uint8_t *data, std::size_t size, std::size_t &pos,
+               int64_t &out) {
+  uint64_t value = 0;
+  std::size_t p = pos;
+  for (unsigned shift = 0; shift < 64 && p < size; shift += 7) {
+    uint8_t byte = data[p++];
+    // the last byte holds bit 63, its other bits must extend it
+    if (shift == 63 && byte != 0x00 && byte != 0x7f) return false;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      if (shift + 7 < 64 && (byte & 0x40)) value |= ~uint64_t(0) << (shift + 7);
+      out = static_cast<int64_t>(value);
+      pos = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T>
+std::size_t decodeScalar(const uint8_t *data, std::size_t size, T *out,
+                         std::size_t count, std::size_t &read) {
+  std::size_t pos = 0;
+  std::size_t n = 0;
+  while (n < count && decodeOne(data, size, pos, out[n])) ++n;
+  read = pos;
+  return n;
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+#if defined(__AVX2__)
+constexpr std::size_t kWindow = 32;
+constexpr uint64_t kWindowMask = 0xffffffff;
+
+// Bit i is set when byte i of the window is followed by more bytes of its
+// number
+inline uint64_t continuations(const uint8_t *window) {
+  auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(window));
+  return static_cast<uint32_t>(_mm256_movemask_epi8(bytes));
+}
+#else
+constexpr std::size_t kWindow = 16;
+constexpr uint64_t kWindowMask = 0xffff;
+
+inline uint64_t continuations(const uint8_t *window) {
+  auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(window));
+  return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+}
+#endif
+
+// Drops the continuation bits of 8 bytes, packing their 7 bit groups
+inline uint64_t compact(uint64_t bytes) {
+#if defined(__BMI2__)
+  return _pext_u64(bytes, 0x7f7f7f7f7f7f7f7f);
+#else
+  // merges the groups two by two
+  uint64_t value = (bytes & 0x007f007f007f007f) |
+                   ((bytes & 0x7f007f007f007f00) >> 1);
+  value = (value & 0x00003fff00003fff) | ((value & 0x3fff00003fff0000) >> 2);
+  return (value & 0x000000000fffffff) | ((value & 0x0fffffff00000000) >> 4);
+#endif
+}
+
+// Assembles a number of `len` (1 to 8) bytes from the 8 bytes it starts.
+template <typename T>
+inline T assemble(uint64_t bytes, unsigned len) {
+  if (len < 8) bytes &= (uint64_t(1) << (8 * len)) - 1;
+  uint64_t value = compact(bytes);
+
+  if constexpr (std::is_signed_v<T>) {
+    unsigned shift = 64 - 7 * len;
+    return static_cast<int64_t>(value << shift) >> shift;
+  } else {
+    return value;
+  }
+}
+
+// Assembles a number of 9 or 10 bytes, false if it does not fit in 64 bits.
+template <typename T>
+inline bool assembleLong(uint64_t bytes, const uint8_t *rest, unsigned len,
+                         T &out) {
+  uint64_t value = compact(bytes) | (static_cast<uint64_t>(rest[0] & 0x7f) << 56);
+
+  if (len == 10) {
+    // the last byte holds bit 63, for an int its other bits must extend it
+    uint8_t last = rest[1];
+    if constexpr (std::is_signed_v<T>) {
+      if (last != 0x00 && last != 0x7f) return false;
+    } else {
+      if (last & 0x7e) return false;
+    }
+    value |= static_cast<uint64_t>(last) << 63;
+  } else if constexpr (std::is_signed_v<T>) {
+    value = static_cast<int64_t>(value << 1) >> 1;
+  }
+
+  out = static_cast<T>(value);
+  return true;
+}
+
+template <typename T>
+inline T fromByte(uint8_t byte) {
+  if constexpr (std::is_signed_v<T>) {
+    // sign extends the 7 bits
+    return static_cast<int8_t>(byte << 1) >> 1;
+  } else {
+    return byte;
+  }
+}
+
+template <typename T>
+std::size_t decodeVector(const uint8_t *data, std::size_t size, T *out,
+                         std::size_t count, std::size_t &read) {
+  std::size_t pos = 0;
+  std::size_t n = 0;
+
+  // values are assembled from 8 byte loads, which may go past the window
+  while (n < count && size - pos >= kWindow + 8) {
+    uint64_t more = continuations(data + pos);
+
+    if (more == 0) {
+      // a window of one byte numbers
+      std::size_t take = std::min(kWindow, count - n);
+      for (std::size_t i = 0; i < take; ++i)
+        out[n + i] = fromByte<T>(data[pos + i]);
+      n += take;
+      pos += take;
+      continue;
+    }
+
+    uint64_t ends = ~more & kWindowMask;
+    std::size_t start = 0;
+    while (ends != 0 && n < count) {
+      unsigned end = __builtin_ctzll(ends);
+      unsigned len = end - start + 1;
+      if (len > 10) break;
+
+      uint64_t bytes;
+      std::memcpy(&bytes, data + pos + start, sizeof(bytes));
+      if (len <= 8) {
+        out[n] = assemble<T>(bytes, len);
+      } else if (!assembleLong(bytes, data + pos + start + 8, len, out[n])) {
+        break;
+      }
+      ++n;
+
+      start = end + 1;
+      ends &= ends - 1;
+    }
+    pos += start;
+
+    // a number running past the window, or over 64 bits
+    if (start == 0) {
+      if (!decodeOne(data, size, pos, out[n])) break;
+      ++n;
+    }
+  }
+
+  std::size_t tail;
+  n += decodeScalar(data + pos, size - pos, out + n, count - n, tail);
+  read = pos + tail;
+  return n;
+}
+
+#endif
+
+}  // namespace
+
+std::size_t decodeUnsignedScalar(const uint8_t *data, std::size_t size,
+                                 uint64_t *out, std::size_t count,
+                                 std::size_t &read) {
+  return decodeScalar(data, size, out, count, read);
+}
+
+std::size_t decodeSignedScalar(const uint8_t *data, std::size_t size,
+                               int64_t *out, std::size_t count,
+                               std::size_t &read) {
+  return decodeScalar(data, size, out, count, read);
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+std::size_t decodeUnsigned(const uint8_t *data, std::size_t size,
+                           uint64_t *out, std::size_t count,
+                           std::size_t &read) {
+  return decodeVector(data, size, out, count, read);
+}
+
+std::size_t decodeSigned(const uint8_t *data, std::size_t size, int64_t *out,
+                         std::size_t count, std::size_t &read) {
+  return decodeVector(data, size, out, count, read);
+}
+
+bool skip(const uint8_t *data, std::size_t size, std::size_t count,
+          std::size_t &read) {
+  std::size_t pos = 0;
+
+  while (count > 0 && size - pos >= kWindow) {
+    uint64_t ends = ~continuations(data + pos) & kWindowMask;
+    auto found = static_cast<std::size_t>(__builtin_popcountll(ends));
+
+    if (found < count) {
+      count -= found;
+      pos += kWindow;
+      continue;
+    }
+
+    // the last number ends within this window
+    for (; count > 1; --count) ends &= ends - 1;
+    read = pos + __builtin_ctzll(ends) + 1;
+    return true;
+  }
+
+  for (; count > 0 && pos < size; ++pos)
+    if (!(data[pos] & 0x80)) --count;
+
+  read = pos;
+  return count == 0;
+}
+
+const char *kernel() {
+#if defined(__AVX2__)
+  return "avx2";
+#else
+  return "sse2";
+#endif
+}
+
+#else
+
+std::size_t decodeUnsigned(const uint8_t *data, std::size_t size,
+                           uint64_t *out, std::size_t count,
+                           std::size_t &read) {
+  return decodeScalar(data, size, out, count, read);
+}
+
+std::size_t decodeSigned(const uint8_t *data, std::size_t size, int64_t *out,
+                         std::size_t count, std::size_t &read) {
+  return decodeScalar(data, size, out, count, read);
+}
+
+bool skip(const uint8_t *data, std::size_t size, std::size_t count,
+          std::size_t &read) {
+  std::size_t pos = 0;
+  for (; count > 0 && pos < size; ++pos)
+    if (!(data[pos] & 0x80)) --count;
+
+  read = pos;
+  return count == 0;
+}
+
+const char *kernel() { return "scalar"; }
+
+#endif
+
+}  // namespace zondax::candid::leb128
+
+// ------------------------------------------------- TESTS
+
+#include <random>
+#include <vector>
+
+using namespace zondax::candid;
+
+namespace {
+void pushUnsigned(std::vector<uint8_t> &out, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value != 0) byte |= 0x80;
+    out.push_back(byte);
+  } while (value != 0);
+}
+
+void pushSigned(std::vector<uint8_t> &out, int64_t value) {
+  bool more = true;
+  while (more) {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    more = !((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)));
+    out.push_back(more ? byte | 0x80 : byte);
+  }
+}
+
+// Mixes small and large numbers, as ledger balances and amounts do
+uint64_t sample(std::mt19937_64 &rng) {
+  return rng() >> (rng() % 64);
+}
+}  // namespace
+
+TEST_CASE("LEB128 bulk decoding matches the scalar decoding") {
+  std::mt19937_64 rng(7);
+
+  for (int round = 0; round < 200; ++round) {
+    std::size_t count = rng() % 300;
+    std::vector<uint64_t> naturals(count);
+    std::vector<int64_t> integers(count);
+    std::vector<uint8_t> unsignedBytes, signedBytes;
+
+    for (std::size_t i = 0; i < count; ++i) {
+      naturals[i] = round % 2 ? sample(rng) : rng() % 128;
+      integers[i] = static_cast<int64_t>(sample(rng));
+      pushUnsigned(unsignedBytes, naturals[i]);
+      pushSigned(signedBytes, integers[i]);
+    }
+
+    std::vector<uint64_t> gotNaturals(count);
+    std::size_t read;
+    REQUIRE(leb128::decodeUnsigned(unsignedBytes.data(), unsignedBytes.size(),
+                                   gotNaturals.data(), count, read) == count);
+    REQUIRE(read == unsignedBytes.size());
+    REQUIRE(gotNaturals == naturals);
+
+    std::vector<int64_t> gotIntegers(count);
+    REQUIRE(leb128::decodeSigned(signedBytes.data(), signedBytes.size(),
+                                 gotIntegers.data(), count, read) == count);
+    REQUIRE(read == signedBytes.size());
+    REQUIRE(gotIntegers == integers);
+
+    REQUIRE(leb128::skip(signedBytes.data(), signedBytes.size(), count, read));
+    REQUIRE(read == signedBytes.size());
+  }
+}
+
+TEST_CASE("LEB128 bulk decoding stops before numbers over 64 bits") {
+  std::vector<uint8_t> bytes;
+  for (int i = 0; i < 40; ++i) pushSigned(bytes, INT64_MIN + i);
+  pushSigned(bytes, INT64_MAX);
+  std::size_t valid = bytes.size();
+
+  // 2^63 as an int, one bit too large
+  bytes.insert(bytes.end(), {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+                             0x80, 0x01});
+  for (int i = 0; i < 40; ++i) bytes.push_back(0x05);
+
+  std::vector<int64_t> values(100);
+  std::size_t read;
+  REQUIRE(leb128::decodeSigned(bytes.data(), bytes.size(), values.data(), 100,
+                               read) == 41);
+  REQUIRE(read == valid);
+  REQUIRE(values[0] == INT64_MIN);
+  REQUIRE(values[40] == INT64_MAX);
+
+  // as a nat it fits
+  std::vector<uint64_t> naturals(41);
+  REQUIRE(leb128::decodeUnsigned(bytes.data() + valid, bytes.size() - valid,
+                                 naturals.data(), 41, read) == 41);
+  REQUIRE(naturals[0] == uint64_t(1) << 63);
+  REQUIRE(naturals[40] == 5);
+
+  // truncated
+  REQUIRE(leb128::decodeUnsigned(bytes.data() + valid, 5, naturals.data(), 1,
+                                 read) == 0);
+  REQUIRE(read == 0);
+  REQUIRE(!leb128::skip(bytes.data() + valid, 5, 1, read));
+}
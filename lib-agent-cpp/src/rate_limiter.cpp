@@ -0,0 +1,176 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "doctest.h"
+
+namespace zondax {
+
+RateLimiter::Bucket::Bucket(const RateLimit& limit)
+    : limit(limit),
+      tokens(std::max(limit.burst, 1.0)),
+      last(Clock::now()) {}
+
+std::chrono::nanoseconds RateLimiter::Bucket::wait(Clock::time_point now) {
+  std::chrono::duration<double> elapsed = now - last;
+  last = now;
+
+  auto burst = std::max(limit.burst, 1.0);
+  tokens = std::min(burst, tokens + elapsed.count() * limit.rate);
+
+  if (tokens >= 1.0) return std::chrono::nanoseconds(0);
+
+  // tokens may be negative, accounting for the calls already queued
+  std::chrono::duration<double> missing((1.0 - tokens) / limit.rate);
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(missing);
+}
+
+void RateLimiter::setCanisterLimit(const Principal& canister,
+                                   const RateLimit& limit) {
+  auto key = canister.getBytes();
+
+  std::lock_guard<std::mutex> lock(mtx);
+  canisters.erase(key);
+  if (limit.rate > 0) canisters.emplace(std::move(key), Bucket(limit));
+}
+
+void RateLimiter::setMethodLimit(const Principal& canister,
+                                 const std::string& method,
+                                 const RateLimit& limit) {
+  auto key = canister.getBytes();
+
+  std::lock_guard<std::mutex> lock(mtx);
+  auto& limits = methods[key];
+  limits.erase(method);
+  if (limit.rate > 0) limits.emplace(method, Bucket(limit));
+  if (limits.empty()) methods.erase(key);
+}
+
+std::optional<std::string> RateLimiter::acquire(
+    const std::vector<uint8_t>& canister, const std::string& method) {
+  std::chrono::nanoseconds wait(0);
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (canisters.empty() && methods.empty()) return std::nullopt;
+
+    auto now = Clock::now();
+
+    Bucket* buckets[2] = {nullptr, nullptr};
+
+    auto c = canisters.find(canister);
+    if (c != canisters.end()) buckets[0] = &c->second;
+
+    auto limits = methods.find(canister);
+    if (limits != methods.end()) {
+      auto m = limits->second.find(method);
+      if (m != limits->second.end()) buckets[1] = &m->second;
+    }
+
+    // check every bucket before consuming, a rejected call takes no token
+    for (auto* bucket : buckets) {
+      if (bucket == nullptr) continue;
+
+      auto needed = bucket->wait(now);
+      if (needed > bucket->limit.maxWait)
+        return "Rate limit exceeded for method " + method;
+
+      wait = std::max(wait, needed);
+    }
+
+    for (auto* bucket : buckets)
+      if (bucket != nullptr) bucket->tokens -= 1.0;
+  }
+
+  // the token is reserved, so we can wait without holding the lock
+  if (wait.count() > 0) std::this_thread::sleep_for(wait);
+
+  return std::nullopt;
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+using namespace zondax;
+
+namespace {
+const std::vector<uint8_t> kCanister = {0x00, 0x00, 0x00, 0x00,
+                                        0x00, 0x00, 0x00, 0x01};
+}
+
+TEST_CASE("RateLimiter admits calls without limits") {
+  RateLimiter limiter;
+
+  for (int i = 0; i < 100; ++i)
+    REQUIRE(!limiter.acquire(kCanister, "greet").has_value());
+}
+
+TEST_CASE("RateLimiter fails fast once the burst is used") {
+  RateLimiter limiter;
+  Principal canister(kCanister);
+  limiter.setCanisterLimit(canister, RateLimit{1.0, 3.0});
+
+  for (int i = 0; i < 3; ++i)
+    REQUIRE(!limiter.acquire(kCanister, "greet").has_value());
+
+  REQUIRE(limiter.acquire(kCanister, "greet").has_value());
+  REQUIRE(limiter.acquire(kCanister, "other").has_value());
+}
+
+TEST_CASE("RateLimiter limits methods independently") {
+  RateLimiter limiter;
+  Principal canister(kCanister);
+  limiter.setMethodLimit(canister, "greet", RateLimit{1.0, 1.0});
+
+  REQUIRE(!limiter.acquire(kCanister, "greet").has_value());
+  REQUIRE(limiter.acquire(kCanister, "greet").has_value());
+  REQUIRE(!limiter.acquire(kCanister, "other").has_value());
+
+  // a non positive rate removes the limit
+  limiter.setMethodLimit(canister, "greet", RateLimit{0.0, 1.0});
+  REQUIRE(!limiter.acquire(kCanister, "greet").has_value());
+}
+
+TEST_CASE("RateLimiter queues calls within the maximum wait") {
+  RateLimiter limiter;
+  Principal canister(kCanister);
+  limiter.setCanisterLimit(
+      canister, RateLimit{100.0, 1.0, std::chrono::milliseconds(25)});
+
+  auto start = std::chrono::steady_clock::now();
+  // the second and third calls wait for a refill, 10ms each
+  for (int i = 0; i < 3; ++i)
+    REQUIRE(!limiter.acquire(kCanister, "greet").has_value());
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  REQUIRE(elapsed >= std::chrono::milliseconds(15));
+
+  // queued calls reserve tokens, so concurrent calls past the maximum wait
+  // are rejected
+  std::atomic<int> rejected{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&]() {
+      if (limiter.acquire(kCanister, "greet").has_value()) ++rejected;
+    });
+  }
+  for (auto &t : threads) t.join();
+
+  REQUIRE(rejected > 0);
+}
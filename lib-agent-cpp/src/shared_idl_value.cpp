@@ -0,0 +1,118 @@
+/*******************************************************************************
+ *   (c) 2018 - 2023 Zondax AG
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ ********************************************************************************/
+#include "shared_idl_value.h"
+
+#include <atomic>
+#include <thread>
+
+#include "doctest.h"
+#include "idl_record.h"
+
+namespace zondax {
+
+// getPtr() boxes inline values, so every read goes through the Rust value
+SharedIdlValue::SharedIdlValue(IdlValue &&value) : ptr(value.getPtr()) {}
+
+IdlValue SharedIdlValue::copy() const {
+  if (ptr == nullptr) return IdlValue();
+  return IdlValue(idl_value_clone(ptr.get()));
+}
+
+SharedIdlArgs::SharedIdlArgs(IdlArgs &&args)
+    : args(std::make_shared<const IdlArgs>(std::move(args))) {}
+
+std::string SharedIdlArgs::getText() const {
+  return args == nullptr ? std::string() : args->getText();
+}
+
+std::vector<uint8_t> SharedIdlArgs::getBytes() const {
+  return args == nullptr ? std::vector<uint8_t>() : args->getBytes();
+}
+
+}  // namespace zondax
+
+// ------------------------------------------------- TESTS
+
+using namespace zondax;
+
+TEST_CASE("SharedIdlValue copies share one value") {
+  IdlRecord record;
+  record.set("balance", IdlValue(uint64_t{42}));
+  record.set("owner", IdlValue(std::string("alice")));
+  SharedIdlValue shared(IdlValue(std::move(record)));
+  SharedIdlValue other = shared;
+
+  REQUIRE(other.type() == IdlValueType::Record);
+  REQUIRE(other.ref().fields().size() == 2);
+  REQUIRE(shared.ref().fields().size() == 2);
+
+  // records are read in place, the shared value is left as it was
+  auto fields = shared.get<IdlRecord>();
+  REQUIRE(fields->find("balance")->get<uint64_t>() == uint64_t{42});
+  REQUIRE(other.get<IdlRecord>()->size() == 2);
+
+  // an owned copy can be taken apart
+  auto owned = other.copy();
+  REQUIRE(owned.getRecord().size() == 2);
+  REQUIRE(shared.ref().fields().size() == 2);
+
+  // inline values are shared too
+  SharedIdlValue number(IdlValue(uint32_t{7}));
+  REQUIRE(number.type() == IdlValueType::Nat32);
+  REQUIRE(number.get<uint32_t>() == uint32_t{7});
+
+  SharedIdlValue empty;
+  REQUIRE(!empty.get<uint32_t>().has_value());
+}
+
+TEST_CASE("SharedIdlValue is read from many threads") {
+  std::vector<uint64_t> numbers(1000);
+  for (uint64_t i = 0; i < numbers.size(); ++i) numbers[i] = i;
+  SharedIdlValue shared(IdlValue(std::move(numbers)));
+
+  std::atomic<int> matches{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([shared, &matches] {
+      uint64_t sum = 0;
+      for (auto element : shared.ref().elements())
+        sum += element.get<uint64_t>().value_or(0);
+      auto copy = shared.get<std::vector<uint64_t>>();
+      if (sum == 999 * 1000 / 2 && copy.has_value() && copy->size() == 1000)
+        ++matches;
+    });
+  }
+  for (auto &thread : threads) thread.join();
+
+  REQUIRE(matches == 8);
+}
+
+TEST_CASE("SharedIdlArgs copies share one set of arguments") {
+  std::vector<IdlValue> values;
+  values.emplace_back(std::string("zondax"));
+  values.emplace_back(uint8_t{1});
+  SharedIdlArgs shared{IdlArgs(values)};
+  SharedIdlArgs other = shared;
+
+  REQUIRE(other.size() == 2);
+  REQUIRE(other[0].text() == std::string_view("zondax"));
+  REQUIRE(other[1].get<uint8_t>() == uint8_t{1});
+  REQUIRE(shared.getText() == other.getText());
+  REQUIRE(shared.getBytes() == IdlArgs(shared.getBytes()).getBytes());
+
+  SharedIdlArgs empty;
+  REQUIRE(empty.size() == 0);
+}